@@ -165,3 +165,100 @@ LOCAL_MODULE:= codec
 
 include $(BUILD_EXECUTABLE)
 
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=               \
+        looperbench.cpp         \
+
+LOCAL_SHARED_LIBRARIES := \
+	libstagefright_foundation liblog libutils
+
+LOCAL_CFLAGS += -Wno-multichar
+
+LOCAL_MODULE_TAGS := debug
+
+LOCAL_MODULE:= looperbench
+
+include $(BUILD_EXECUTABLE)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=               \
+        messagebench.cpp        \
+
+LOCAL_SHARED_LIBRARIES := \
+	libstagefright_foundation liblog libutils
+
+LOCAL_CFLAGS += -Wno-multichar
+
+LOCAL_MODULE_TAGS := debug
+
+LOCAL_MODULE:= messagebench
+
+include $(BUILD_EXECUTABLE)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=               \
+        sampletablebench.cpp    \
+
+LOCAL_SHARED_LIBRARIES := \
+	libstagefright liblog libutils libstagefright_foundation
+
+LOCAL_C_INCLUDES:= \
+	frameworks/av/media/libstagefright \
+	$(TOP)/frameworks/native/include/media/openmax
+
+LOCAL_CFLAGS += -Wno-multichar
+
+LOCAL_MODULE_TAGS := debug
+
+LOCAL_MODULE:= sampletablebench
+
+include $(BUILD_EXECUTABLE)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=               \
+        scanbench.cpp           \
+
+LOCAL_SHARED_LIBRARIES := \
+	libstagefright_foundation liblog libutils
+
+LOCAL_CFLAGS += -Wno-multichar
+
+LOCAL_MODULE_TAGS := debug
+
+LOCAL_MODULE:= scanbench
+
+include $(BUILD_EXECUTABLE)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=               \
+        colorconvbench.cpp      \
+
+LOCAL_SHARED_LIBRARIES := \
+	libstagefright liblog libutils libstagefright_foundation
+
+LOCAL_C_INCLUDES:= \
+	$(TOP)/frameworks/native/include/media/openmax
+
+LOCAL_CFLAGS += -Wno-multichar
+
+LOCAL_MODULE_TAGS := debug
+
+LOCAL_MODULE:= colorconvbench
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,351 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Converts synthetic frames of every source format to every output format
+// supported by ColorConverter, checks the result against a golden image
+// computed pixel by pixel with the arithmetic and addressing of the original
+// scalar loops, and reports the throughput on one thread and on several.
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "colorconvbench"
+#include <utils/Log.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/ColorConverter.h>
+#include <media/stagefright/MediaErrors.h>
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-w width] [-h height] [-t threads] [-n iterations]\n"
+                    "\t\t-w width of the timed frames (default 1920)\n"
+                    "\t\t-h height of the timed frames (default 1080)\n"
+                    "\t\t-t threads for the banded conversion (default: automatic)\n"
+                    "\t\t-n conversions timed per format (default 50)\n",
+                    me);
+
+    exit(1);
+}
+
+namespace android {
+
+static const OMX_COLOR_FORMATTYPE kSrcFormats[] = {
+    OMX_COLOR_FormatYUV420Planar,
+    OMX_COLOR_FormatCbYCrY,
+    OMX_QCOM_COLOR_FormatYVU420SemiPlanar,
+    OMX_COLOR_FormatYUV420SemiPlanar,
+    OMX_TI_COLOR_FormatYUV420PackedSemiPlanar,
+};
+
+static const char *const kSrcNames[] = {
+    "YUV420Planar",
+    "CbYCrY",
+    "QCOMYVU420SemiPlanar",
+    "YUV420SemiPlanar",
+    "TIYUV420PackedSemiPlanar",
+};
+
+static const OMX_COLOR_FORMATTYPE kDstFormats[] = {
+    OMX_COLOR_Format16bitRGB565,
+    (OMX_COLOR_FORMATTYPE)ColorConverter::kColorFormat32bitRGBA8888,
+    OMX_COLOR_Format32bitARGB8888,
+};
+
+static const char *const kDstNames[] = {
+    "RGB565",
+    "RGBA8888",
+    "BGRA8888",
+};
+
+static const size_t kNumSrcFormats = sizeof(kSrcFormats) / sizeof(kSrcFormats[0]);
+static const size_t kNumDstFormats = sizeof(kDstFormats) / sizeof(kDstFormats[0]);
+
+struct Frame {
+    size_t mWidth, mHeight;
+    size_t mCropLeft, mCropTop, mCropRight, mCropBottom;
+
+    size_t cropWidth() const { return mCropRight - mCropLeft + 1; }
+    size_t cropHeight() const { return mCropBottom - mCropTop + 1; }
+};
+
+static size_t bytesPerPixel(OMX_COLOR_FORMATTYPE dstFormat) {
+    return dstFormat == OMX_COLOR_Format16bitRGB565 ? 2 : 4;
+}
+
+static uint8_t clip(signed x) {
+    return x < 0 ? 0 : x > 255 ? 255 : x;
+}
+
+// Fetches the samples of pixel (x, y) of the crop rectangle the way the
+// original conversion loops did, including their quirks. Returns whether
+// red and blue come out swapped.
+static bool getSamples(
+        OMX_COLOR_FORMATTYPE srcFormat, bool dst32bit,
+        const uint8_t *bits, const Frame &src, size_t dstWidth,
+        size_t x, size_t y, signed *Y, signed *U, signed *V) {
+    size_t w = src.mWidth;
+    const uint8_t *src_y = bits + src.mCropTop * w + src.mCropLeft;
+    const uint8_t *src_uv = src_y + w * src.mHeight + src.mCropTop * w + src.mCropLeft;
+
+    switch (srcFormat) {
+        case OMX_COLOR_FormatYUV420Planar:
+        {
+            const uint8_t *src_u =
+                src_y + w * src.mHeight + src.mCropTop * (w / 2) + src.mCropLeft / 2;
+            const uint8_t *src_v = src_u + (w / 2) * (src.mHeight / 2);
+
+            *Y = src_y[y * w + x];
+            *U = src_u[(y / 2) * (w / 2) + x / 2];
+            *V = src_v[(y / 2) * (w / 2) + x / 2];
+            return false;
+        }
+
+        case OMX_COLOR_FormatCbYCrY:
+        {
+            // The original loop offsets the crop rectangle by the width of
+            // the destination.
+            const uint8_t *row =
+                bits + (src.mCropTop * dstWidth + src.mCropLeft) * 2 + y * w * 2;
+
+            *Y = row[x * 2 + 1];
+            *U = row[(x & ~1) * 2];
+            *V = row[(x & ~1) * 2 + 2];
+            return false;
+        }
+
+        case OMX_QCOM_COLOR_FormatYVU420SemiPlanar:
+        case OMX_COLOR_FormatYUV420SemiPlanar:
+        {
+            const uint8_t *row = src_uv + (y / 2) * w;
+            signed first = row[x & ~1];
+            signed second = row[(x & ~1) + 1];
+            bool vFirst = srcFormat == OMX_QCOM_COLOR_FormatYVU420SemiPlanar;
+
+            *Y = src_y[y * w + x];
+            if (!dst32bit) {
+                // Chroma swapped, and red and blue to make up for it.
+                vFirst = !vFirst;
+            }
+            *U = vFirst ? second : first;
+            *V = vFirst ? first : second;
+            return !dst32bit;
+        }
+
+        case OMX_TI_COLOR_FormatYUV420PackedSemiPlanar:
+        {
+            // The original loop ignores the crop rectangle for luma.
+            const uint8_t *row = bits + w * (src.mHeight - src.mCropTop / 2) + (y / 2) * w;
+
+            *Y = bits[y * w + x];
+            *U = row[x & ~1];
+            *V = row[(x & ~1) + 1];
+            return false;
+        }
+
+        default:
+            CHECK(!"unknown source format");
+            return false;
+    }
+}
+
+static void makeGoldenImage(
+        OMX_COLOR_FORMATTYPE srcFormat, OMX_COLOR_FORMATTYPE dstFormat,
+        const uint8_t *bits, const Frame &src, uint8_t *dst, size_t dstWidth) {
+    bool dst32bit = bytesPerPixel(dstFormat) == 4;
+
+    for (size_t y = 0; y < src.cropHeight(); ++y) {
+        for (size_t x = 0; x < src.cropWidth(); ++x) {
+            signed Y, U, V;
+            bool swapRedBlue = getSamples(
+                    srcFormat, dst32bit, bits, src, dstWidth, x, y, &Y, &U, &V);
+
+            signed tmp = (Y - 16) * 298;
+            signed b = (tmp + (U - 128) * 517) / 256;
+            signed g = (tmp - (V - 128) * 208 - (U - 128) * 100) / 256;
+            signed r = (tmp + (V - 128) * 409) / 256;
+
+            if (dstFormat == OMX_COLOR_Format32bitARGB8888) {
+                swapRedBlue = !swapRedBlue;
+            }
+            if (swapRedBlue) {
+                tmp = r; r = b; b = tmp;
+            }
+
+            if (dst32bit) {
+                uint8_t *pixel = dst + (y * dstWidth + x) * 4;
+                pixel[0] = clip(r);
+                pixel[1] = clip(g);
+                pixel[2] = clip(b);
+                pixel[3] = 0xff;
+            } else {
+                ((uint16_t *)dst)[y * dstWidth + x] =
+                    ((clip(r) >> 3) << 11) | ((clip(g) >> 2) << 5) | (clip(b) >> 3);
+            }
+        }
+    }
+}
+
+static uint8_t *makeFrame(const Frame &src) {
+    // Large enough for every layout, including the quirky ones.
+    size_t size = src.mWidth * src.mHeight * 2 + 64;
+    uint8_t *bits = new uint8_t[size];
+    for (size_t i = 0; i < size; ++i) {
+        bits[i] = rand();
+    }
+    return bits;
+}
+
+static status_t convert(
+        ColorConverter *converter, const uint8_t *bits, const Frame &src, uint8_t *dst) {
+    return converter->convert(
+            bits, src.mWidth, src.mHeight,
+            src.mCropLeft, src.mCropTop, src.mCropRight, src.mCropBottom,
+            dst, src.cropWidth(), src.cropHeight(),
+            0, 0, src.cropWidth() - 1, src.cropHeight() - 1);
+}
+
+// Returns the number of mismatching conversions.
+static int checkGoldenImages(const Frame &src, size_t numThreads) {
+    uint8_t *bits = makeFrame(src);
+    size_t dstSize = src.cropWidth() * src.cropHeight() * 4;
+    uint8_t *golden = new uint8_t[dstSize];
+    uint8_t *dst = new uint8_t[dstSize];
+    int failures = 0;
+
+    for (size_t i = 0; i < kNumSrcFormats; ++i) {
+        for (size_t j = 0; j < kNumDstFormats; ++j) {
+            memset(golden, 0xa5, dstSize);
+            memset(dst, 0xa5, dstSize);
+            makeGoldenImage(kSrcFormats[i], kDstFormats[j], bits, src, golden,
+                    src.cropWidth());
+
+            ColorConverter converter(kSrcFormats[i], kDstFormats[j]);
+            CHECK(converter.isValid());
+            converter.setNumThreads(numThreads);
+
+            if (convert(&converter, bits, src, dst) != OK
+                    || memcmp(golden, dst, dstSize)) {
+                printf("%ux%u crop %u,%u-%u,%u, %u threads: %s -> %s MISMATCH\n",
+                        (unsigned)src.mWidth, (unsigned)src.mHeight,
+                        (unsigned)src.mCropLeft, (unsigned)src.mCropTop,
+                        (unsigned)src.mCropRight, (unsigned)src.mCropBottom,
+                        (unsigned)numThreads, kSrcNames[i], kDstNames[j]);
+                ++failures;
+            }
+        }
+    }
+
+    delete[] dst;
+    delete[] golden;
+    delete[] bits;
+
+    return failures;
+}
+
+static double timeConversion(
+        ColorConverter *converter, const uint8_t *bits, const Frame &src,
+        uint8_t *dst, int iterations) {
+    int64_t startUs = ALooper::GetNowUs();
+    for (int i = 0; i < iterations; ++i) {
+        CHECK_EQ(convert(converter, bits, src, dst), (status_t)OK);
+    }
+    int64_t elapsedUs = ALooper::GetNowUs() - startUs;
+
+    return (double)src.cropWidth() * src.cropHeight() * iterations / elapsedUs;
+}
+
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+    int width = 1920;
+    int height = 1080;
+    int numThreads = 0;
+    int iterations = 50;
+
+    int res;
+    while ((res = getopt(argc, argv, "w:h:t:n:")) >= 0) {
+        switch (res) {
+            case 'w':
+                width = atoi(optarg);
+                break;
+            case 'h':
+                height = atoi(optarg);
+                break;
+            case 't':
+                numThreads = atoi(optarg);
+                break;
+            case 'n':
+                iterations = atoi(optarg);
+                break;
+            default:
+                usage(me);
+        }
+    }
+    if (width < 2 || height < 2 || (width & 1) || (height & 1)
+            || numThreads < 0 || iterations <= 0) {
+        usage(me);
+    }
+
+    srand(1);
+
+    // Small and large frames, odd crop widths and heights, and crop offsets.
+    static const Frame kGoldenFrames[] = {
+        { 176, 144, 0, 0, 175, 143 },
+        { 322, 242, 2, 2, 318, 238 },
+        { 1920, 1088, 0, 0, 1919, 1079 },
+        { 1280, 736, 16, 4, 1262, 723 },
+    };
+
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(kGoldenFrames) / sizeof(kGoldenFrames[0]); ++i) {
+        failures += checkGoldenImages(kGoldenFrames[i], 1);
+        failures += checkGoldenImages(kGoldenFrames[i], 4);
+    }
+    printf("golden images: %s\n", failures ? "FAILED" : "all bit-exact");
+
+    Frame frame = {
+        (size_t)width, (size_t)height, 0, 0, (size_t)width - 1, (size_t)height - 1
+    };
+    uint8_t *bits = makeFrame(frame);
+    uint8_t *dst = new uint8_t[width * height * 4];
+
+    for (size_t i = 0; i < kNumSrcFormats; ++i) {
+        for (size_t j = 0; j < kNumDstFormats; ++j) {
+            ColorConverter converter(kSrcFormats[i], kDstFormats[j]);
+
+            converter.setNumThreads(1);
+            double single = timeConversion(&converter, bits, frame, dst, iterations);
+
+            converter.setNumThreads(numThreads);
+            double banded = timeConversion(&converter, bits, frame, dst, iterations);
+
+            printf("%-24s -> %-8s  1 thread %7.1f Mpixel/s, banded %7.1f Mpixel/s\n",
+                    kSrcNames[i], kDstNames[j], single, banded);
+        }
+    }
+
+    delete[] dst;
+    delete[] bits;
+
+    return failures ? 1 : 0;
+}
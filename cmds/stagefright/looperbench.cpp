@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Posts messages to a single ALooper from several threads, and reports the
+// throughput and the post->deliver latency, or for delayed messages the
+// lateness of the delivery relative to the requested time.
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "looperbench"
+#include <utils/Log.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-p producers] [-n messages] [-d percent] [-D max delay]\n"
+                    "\t\t-p number of posting threads (default 4)\n"
+                    "\t\t-n messages posted by each thread (default 100000)\n"
+                    "\t\t-d percentage of delayed messages (default 0)\n"
+                    "\t\t-D maximum delay in us of delayed messages (default 10000)\n",
+                    me);
+
+    exit(1);
+}
+
+namespace android {
+
+struct BenchHandler : public AHandler {
+    enum {
+        kWhatPing = 'ping',
+    };
+
+    BenchHandler(size_t total)
+        : mTotal(total),
+          mReceived(0),
+          mImmediateUs(new int64_t[total]),
+          mNumImmediate(0),
+          mLateUs(new int64_t[total]),
+          mNumLate(0) {
+    }
+
+    void waitForCompletion() {
+        Mutex::Autolock autoLock(mLock);
+        while (mReceived < mTotal) {
+            mCondition.wait(mLock);
+        }
+    }
+
+    void report(int64_t elapsedUs) {
+        printf("%u messages in %lld us: %.0f messages/s\n",
+                (unsigned)mReceived, elapsedUs, mReceived * 1E6 / elapsedUs);
+        report("post->deliver latency", mImmediateUs, mNumImmediate);
+        report("delayed delivery lateness", mLateUs, mNumLate);
+    }
+
+protected:
+    virtual ~BenchHandler() {
+        delete[] mImmediateUs;
+        delete[] mLateUs;
+    }
+
+    virtual void onMessageReceived(const sp<AMessage> &msg) {
+        int64_t nowUs = ALooper::GetNowUs();
+        int64_t whenUs;
+        CHECK(msg->findInt64("whenUs", &whenUs));
+        int32_t delayed;
+        CHECK(msg->findInt32("delayed", &delayed));
+
+        // only the looper thread writes the samples
+        if (delayed) {
+            mLateUs[mNumLate++] = nowUs - whenUs;
+        } else {
+            mImmediateUs[mNumImmediate++] = nowUs - whenUs;
+        }
+
+        Mutex::Autolock autoLock(mLock);
+        if (++mReceived == mTotal) {
+            mCondition.signal();
+        }
+    }
+
+private:
+    static int compare(const void *a, const void *b) {
+        int64_t x = *(const int64_t *)a;
+        int64_t y = *(const int64_t *)b;
+        return x < y ? -1 : x > y ? 1 : 0;
+    }
+
+    static void report(const char *title, int64_t *samples, size_t n) {
+        if (n == 0) {
+            return;
+        }
+        qsort(samples, n, sizeof(samples[0]), compare);
+        printf("%s over %u messages: min %lld us, median %lld us, 99%% %lld us, max %lld us\n",
+                title, (unsigned)n, samples[0], samples[n / 2], samples[n * 99 / 100],
+                samples[n - 1]);
+    }
+
+    Mutex mLock;
+    Condition mCondition;
+    size_t mTotal;
+    size_t mReceived;
+
+    int64_t *mImmediateUs;
+    size_t mNumImmediate;
+    int64_t *mLateUs;
+    size_t mNumLate;
+
+    DISALLOW_EVIL_CONSTRUCTORS(BenchHandler);
+};
+
+struct Producer {
+    pthread_t mThread;
+    ALooper::handler_id mTarget;
+    int mNumMessages;
+    int mDelayedPercent;
+    int64_t mMaxDelayUs;
+    unsigned mSeed;
+
+    static void *ThreadWrapper(void *me) {
+        static_cast<Producer *>(me)->threadEntry();
+        return NULL;
+    }
+
+    void threadEntry() {
+        for (int i = 0; i < mNumMessages; ++i) {
+            int64_t delayUs = 0;
+            if ((int)(rand_r(&mSeed) % 100) < mDelayedPercent) {
+                delayUs = 1 + rand_r(&mSeed) % mMaxDelayUs;
+            }
+            sp<AMessage> msg = new AMessage(BenchHandler::kWhatPing, mTarget);
+            msg->setInt64("whenUs", ALooper::GetNowUs() + delayUs);
+            msg->setInt32("delayed", delayUs > 0);
+            msg->post(delayUs);
+        }
+    }
+};
+
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+    int numProducers = 4;
+    int numMessages = 100000;
+    int delayedPercent = 0;
+    int64_t maxDelayUs = 10000;
+
+    int res;
+    while ((res = getopt(argc, argv, "p:n:d:D:")) >= 0) {
+        switch (res) {
+            case 'p':
+                numProducers = atoi(optarg);
+                break;
+            case 'n':
+                numMessages = atoi(optarg);
+                break;
+            case 'd':
+                delayedPercent = atoi(optarg);
+                break;
+            case 'D':
+                maxDelayUs = atoll(optarg);
+                break;
+            default:
+                usage(me);
+        }
+    }
+    if (numProducers <= 0 || numMessages <= 0 || delayedPercent < 0 || delayedPercent > 100
+            || maxDelayUs <= 0) {
+        usage(me);
+    }
+
+    sp<ALooper> looper = new ALooper;
+    looper->setName("looperbench");
+    looper->start();
+
+    sp<BenchHandler> handler = new BenchHandler((size_t)numProducers * numMessages);
+    looper->registerHandler(handler);
+
+    Producer *producers = new Producer[numProducers];
+    int64_t startUs = ALooper::GetNowUs();
+    for (int i = 0; i < numProducers; ++i) {
+        producers[i].mTarget = handler->id();
+        producers[i].mNumMessages = numMessages;
+        producers[i].mDelayedPercent = delayedPercent;
+        producers[i].mMaxDelayUs = maxDelayUs;
+        producers[i].mSeed = i + 1;
+        pthread_create(&producers[i].mThread, NULL, Producer::ThreadWrapper, &producers[i]);
+    }
+    for (int i = 0; i < numProducers; ++i) {
+        pthread_join(producers[i].mThread, NULL);
+    }
+    handler->waitForCompletion();
+    int64_t elapsedUs = ALooper::GetNowUs() - startUs;
+
+    handler->report(elapsedUs);
+
+    looper->unregisterHandler(handler->id());
+    looper->stop();
+    delete[] producers;
+
+    return 0;
+}
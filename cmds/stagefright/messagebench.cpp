@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the cost of building, querying, copying and posting AMessages
+// the way ACodec does for every buffer it hands around.
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "messagebench"
+#include <utils/Log.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-n iterations] [-i extra items]\n"
+                    "\t\t-n number of messages per test (default 1000000)\n"
+                    "\t\t-i items set in each message besides the usual "
+                    "buffer fields (default 4)\n",
+                    me);
+
+    exit(1);
+}
+
+namespace android {
+
+struct SinkHandler : public AHandler {
+    SinkHandler(size_t total)
+        : mTotal(total),
+          mReceived(0) {
+    }
+
+    void waitForCompletion() {
+        Mutex::Autolock autoLock(mLock);
+        while (mReceived < mTotal) {
+            mCondition.wait(mLock);
+        }
+    }
+
+protected:
+    virtual void onMessageReceived(const sp<AMessage> &msg) {
+        int32_t bufferID;
+        CHECK(msg->findInt32("buffer-id", &bufferID));
+
+        Mutex::Autolock autoLock(mLock);
+        if (++mReceived == mTotal) {
+            mCondition.signal();
+        }
+    }
+
+private:
+    Mutex mLock;
+    Condition mCondition;
+    size_t mTotal;
+    size_t mReceived;
+
+    DISALLOW_EVIL_CONSTRUCTORS(SinkHandler);
+};
+
+static const char *kExtraNames[] = {
+    "width", "height", "stride", "slice-height", "color-format",
+    "crop-left", "crop-top", "crop-right", "crop-bottom", "rotation",
+};
+
+static sp<AMessage> buildMessage(int i, int numExtra, ALooper::handler_id target) {
+    sp<AMessage> msg = new AMessage('fill', target);
+    msg->setInt32("buffer-id", i);
+    msg->setInt64("timeUs", i * 33333ll);
+    msg->setInt32("flags", 0);
+    msg->setSize("range-offset", 0);
+    msg->setSize("range-length", 4096);
+    for (int j = 0; j < numExtra; ++j) {
+        msg->setInt32(kExtraNames[j], j);
+    }
+    return msg;
+}
+
+static void report(const char *title, int n, int64_t elapsedUs) {
+    printf("%-24s %8.1f ns/message\n", title, elapsedUs * 1E3 / n);
+}
+
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+    int n = 1000000;
+    int numExtra = 4;
+
+    int res;
+    while ((res = getopt(argc, argv, "n:i:")) >= 0) {
+        switch (res) {
+            case 'n':
+                n = atoi(optarg);
+                break;
+            case 'i':
+                numExtra = atoi(optarg);
+                break;
+            default:
+                usage(me);
+        }
+    }
+    if (n <= 0 || numExtra < 0
+            || numExtra > (int)(sizeof(kExtraNames) / sizeof(kExtraNames[0]))) {
+        usage(me);
+    }
+
+    // set: build a fresh message and release it
+    int64_t startUs = ALooper::GetNowUs();
+    for (int i = 0; i < n; ++i) {
+        buildMessage(i, numExtra, 0);
+    }
+    report("new+set", n, ALooper::GetNowUs() - startUs);
+
+    // find: query present and absent fields of one message
+    sp<AMessage> msg = buildMessage(0, numExtra, 0);
+    int64_t sum = 0;
+    startUs = ALooper::GetNowUs();
+    for (int i = 0; i < n; ++i) {
+        int32_t bufferID, flags;
+        int64_t timeUs;
+        size_t size;
+        CHECK(msg->findInt32("buffer-id", &bufferID));
+        CHECK(msg->findInt64("timeUs", &timeUs));
+        CHECK(msg->findInt32("flags", &flags));
+        CHECK(msg->findSize("range-length", &size));
+        CHECK(!msg->findInt32("eos", &flags));
+        sum += bufferID + timeUs + flags + size;
+    }
+    report("find (5 lookups)", n, ALooper::GetNowUs() - startUs);
+
+    // dup: copy a notification template and fill in one field, as ACodec does
+    startUs = ALooper::GetNowUs();
+    for (int i = 0; i < n; ++i) {
+        sp<AMessage> notify = msg->dup();
+        notify->setInt32("buffer-id", i);
+    }
+    report("dup+set", n, ALooper::GetNowUs() - startUs);
+
+    // dup without modification, e.g. a reply that is only read
+    startUs = ALooper::GetNowUs();
+    for (int i = 0; i < n; ++i) {
+        sp<AMessage> copy = msg->dup();
+        int32_t bufferID;
+        CHECK(copy->findInt32("buffer-id", &bufferID));
+    }
+    report("dup+find", n, ALooper::GetNowUs() - startUs);
+
+    // post: build and deliver through a looper
+    sp<ALooper> looper = new ALooper;
+    looper->setName("messagebench");
+    looper->start();
+
+    sp<SinkHandler> handler = new SinkHandler(n);
+    looper->registerHandler(handler);
+
+    startUs = ALooper::GetNowUs();
+    for (int i = 0; i < n; ++i) {
+        buildMessage(i, numExtra, handler->id())->post();
+    }
+    handler->waitForCompletion();
+    report("new+set+post+deliver", n, ALooper::GetNowUs() - startUs);
+
+    looper->unregisterHandler(handler->id());
+    looper->stop();
+
+    CHECK_GT(sum, 0ll);
+
+    return 0;
+}
@@ -16,8 +16,12 @@
 
 #include "SineSource.h"
 
+#include <sys/resource.h>
+#include <unistd.h>
+
 #include <binder/ProcessState.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/AudioPlayer.h>
 #include <media/stagefright/CameraSource.h>
 #include <media/stagefright/FileSource.h>
@@ -38,6 +42,200 @@ static const int32_t kVideoBitRate = 512 * 1024;
 static const int32_t kAudioBitRate = 12200;
 static const int64_t kDurationUs = 10000000LL;  // 10 seconds
 
+
+// Feeds synthetic encoded frames to the MPEG4Writer as fast as it takes
+// them, for "record -w": the frames carry no real media, only the sizes
+// and the timestamps of the given bit rate.
+class EncodedFrameSource : public MediaSource {
+
+public:
+    EncodedFrameSource(bool isAudio, int32_t bitRate, int64_t durationUs)
+        : mIsAudio(isAudio),
+          mFrameDurationUs(isAudio ? 1024 * 1000000LL / 48000 : 1000000LL / 30),
+          mDurationUs(durationUs),
+          mFrameSize(bitRate / 8 * mFrameDurationUs / 1000000LL),
+          mNumFramesOutput(0),
+          mSentCodecConfig(false) {
+        // Sync frames, once a second, are four times the size of the others.
+        mGroup.add_buffer(new MediaBuffer(mFrameSize * 4));
+        mGroup.add_buffer(new MediaBuffer(mFrameSize * 4));
+    }
+
+    virtual sp<MetaData> getFormat() {
+        sp<MetaData> meta = new MetaData;
+        if (mIsAudio) {
+            meta->setCString(kKeyMIMEType, MEDIA_MIMETYPE_AUDIO_AAC);
+            meta->setInt32(kKeySampleRate, 48000);
+            meta->setInt32(kKeyChannelCount, 2);
+        } else {
+            // Stand-in parameter sets; the frames are not decodable anyway.
+            static const uint8_t kAVCC[] = {
+                0x01, 0x42, 0xc0, 0x28, 0xff,
+                0xe1, 0x00, 0x04, 0x67, 0x42, 0xc0, 0x28,
+                0x01, 0x00, 0x02, 0x68, 0xce,
+            };
+            meta->setCString(kKeyMIMEType, MEDIA_MIMETYPE_VIDEO_AVC);
+            meta->setInt32(kKeyWidth, 1920);
+            meta->setInt32(kKeyHeight, 1080);
+            meta->setData(kKeyAVCC, kTypeAVCC, kAVCC, sizeof(kAVCC));
+        }
+        return meta;
+    }
+
+    virtual status_t start(MetaData *params) {
+        mNumFramesOutput = 0;
+        mSentCodecConfig = false;
+        return OK;
+    }
+
+    virtual status_t stop() {
+        return OK;
+    }
+
+    virtual status_t read(
+            MediaBuffer **buffer, const MediaSource::ReadOptions *options) {
+        int64_t timeUs = mNumFramesOutput * mFrameDurationUs;
+        if (timeUs >= mDurationUs) {
+            return ERROR_END_OF_STREAM;
+        }
+
+        status_t err = mGroup.acquire_buffer(buffer);
+        if (err != OK) {
+            return err;
+        }
+        (*buffer)->meta_data()->clear();
+
+        if (mIsAudio && !mSentCodecConfig) {
+            // AAC LC, 48 kHz, stereo
+            static const uint8_t kAudioSpecificConfig[] = { 0x11, 0x90 };
+            memcpy((*buffer)->data(), kAudioSpecificConfig, sizeof(kAudioSpecificConfig));
+            (*buffer)->set_range(0, sizeof(kAudioSpecificConfig));
+            (*buffer)->meta_data()->setInt32(kKeyIsCodecConfig, true);
+            mSentCodecConfig = true;
+            return OK;
+        }
+
+        bool isSync = mIsAudio || (timeUs % 1000000LL) < mFrameDurationUs;
+        size_t size = isSync && !mIsAudio ? mFrameSize * 4 : mFrameSize;
+        memset((*buffer)->data(), mNumFramesOutput & 0xff, size);
+        (*buffer)->set_range(0, size);
+        (*buffer)->meta_data()->setInt64(kKeyTime, timeUs);
+        if (!mIsAudio) {
+            (*buffer)->meta_data()->setInt64(kKeyDecodingTime, timeUs);
+        }
+        (*buffer)->meta_data()->setInt32(kKeyIsSyncFrame, isSync);
+        ++mNumFramesOutput;
+        return OK;
+    }
+
+protected:
+    virtual ~EncodedFrameSource() {}
+
+private:
+    MediaBufferGroup mGroup;
+    bool mIsAudio;
+    int64_t mFrameDurationUs;
+    int64_t mDurationUs;
+    size_t mFrameSize;
+    int64_t mNumFramesOutput;
+    bool mSentCodecConfig;
+
+    EncodedFrameSource(const EncodedFrameSource &);
+    EncodedFrameSource &operator=(const EncodedFrameSource &);
+};
+
+static int64_t getCpuTimeUs(int64_t *systemUs) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    *systemUs = usage.ru_stime.tv_sec * 1000000LL + usage.ru_stime.tv_usec;
+    return usage.ru_utime.tv_sec * 1000000LL + usage.ru_utime.tv_usec;
+}
+
+// Records synthetic 1080p video and AAC audio tracks into a file as fast
+// as possible, and reports the write system calls and the CPU time spent.
+static int benchmarkWriter(const char *me, int argc, char **argv) {
+    int32_t videoBitRate = 20000000;
+    int64_t durationUs = 30000000LL;
+    int numVideoTracks = 1;
+    int numAudioTracks = 1;
+    int64_t fragmentDurationUs = 0;
+
+    int res;
+    while ((res = getopt(argc, argv, "b:d:v:a:f:")) >= 0) {
+        switch (res) {
+            case 'b':
+                videoBitRate = atoi(optarg) * 1000;
+                break;
+            case 'd':
+                durationUs = atoll(optarg) * 1000000LL;
+                break;
+            case 'v':
+                numVideoTracks = atoi(optarg);
+                break;
+            case 'a':
+                numAudioTracks = atoi(optarg);
+                break;
+            case 'f':
+                fragmentDurationUs = atoll(optarg) * 1000LL;
+                break;
+            default:
+                numVideoTracks = -1;
+                break;
+        }
+    }
+    if (optind + 1 != argc || videoBitRate <= 0 || durationUs <= 0
+            || numVideoTracks < 0 || numAudioTracks < 0
+            || numVideoTracks + numAudioTracks == 0 || fragmentDurationUs < 0) {
+        fprintf(stderr, "usage: %s -w [-b video kbps] [-d seconds] [-v video tracks] "
+                        "[-a audio tracks] [-f fragment ms] <filename>\n", me);
+        return 1;
+    }
+
+    sp<MPEG4Writer> writer = new MPEG4Writer(argv[optind]);
+    for (int i = 0; i < numVideoTracks; ++i) {
+        writer->addSource(new EncodedFrameSource(false, videoBitRate, durationUs));
+    }
+    for (int i = 0; i < numAudioTracks; ++i) {
+        writer->addSource(new EncodedFrameSource(true, 128000, durationUs));
+    }
+    CHECK_EQ((status_t)OK, writer->setFragmentDuration(fragmentDurationUs));
+
+    sp<MetaData> params = new MetaData;
+    params->setInt32(kKeyNotRealTime, true);
+    params->setInt32(kKeyBitRate, numVideoTracks * videoBitRate);
+
+    int64_t startSystemUs;
+    int64_t startUserUs = getCpuTimeUs(&startSystemUs);
+    int64_t startUs = ALooper::GetNowUs();
+    CHECK_EQ((status_t)OK, writer->start(params.get()));
+    while (!writer->reachedEOS()) {
+        usleep(10000);
+    }
+    status_t err = writer->stop();
+    int64_t elapsedUs = ALooper::GetNowUs() - startUs;
+    int64_t systemUs;
+    int64_t userUs = getCpuTimeUs(&systemUs) - startUserUs;
+    systemUs -= startSystemUs;
+
+    uint32_t numWriteCalls;
+    int64_t numBytesWritten;
+    writer->getWriteStats(&numWriteCalls, &numBytesWritten);
+
+    printf("%lld bytes in %.2f s: %.1f Mbit/s\n",
+            numBytesWritten, elapsedUs / 1E6, numBytesWritten * 8.0 / elapsedUs);
+    printf("%u write calls: %.1f calls/s, %.1f KB per call\n",
+            numWriteCalls, numWriteCalls * 1E6 / elapsedUs,
+            numWriteCalls ? numBytesWritten / 1024.0 / numWriteCalls : 0.0);
+    printf("cpu: user %.2f s, system %.2f s, %.1f%% of one core\n",
+            userUs / 1E6, systemUs / 1E6, (userUs + systemUs) * 100.0 / elapsedUs);
+
+    if (err != OK && err != ERROR_END_OF_STREAM) {
+        fprintf(stderr, "record failed: %d\n", err);
+        return 1;
+    }
+    return 0;
+}
+
 #if 0
 class DummySource : public MediaSource {
 
@@ -296,6 +494,10 @@ int main(int argc, char **argv) {
 #else
 
 int main(int argc, char **argv) {
+    if (argc > 1 && !strcmp(argv[1], "-w")) {
+        return benchmarkWriter(argv[0], argc - 1, argv + 1);
+    }
+
     android::ProcessState::self()->startThreadPool();
 
     OMXClient client;
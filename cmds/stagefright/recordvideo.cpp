@@ -44,20 +44,25 @@ static void usage(const char *me) {
     fprintf(stderr, "       -p encoder profile. see omx il header (default: encoder specific)\n");
     fprintf(stderr, "       -v video codec: [0] AVC [1] M4V [2] H263 (default: 0)\n");
     fprintf(stderr, "       -s(oftware) prefer software codec\n");
-    fprintf(stderr, "The output file is /sdcard/output.mp4\n");
+    fprintf(stderr, "       -y raw YUV input file, in the -c color format and -w x -t size,\n");
+    fprintf(stderr, "          read again from the start if it has fewer than -n frames\n");
+    fprintf(stderr, "          (default: frames with undefined content)\n");
+    fprintf(stderr, "       -o output file (default: /sdcard/output.mp4)\n");
     exit(1);
 }
 
 class DummySource : public MediaSource {
 
 public:
-    DummySource(int width, int height, int nFrames, int fps, int colorFormat)
+    DummySource(int width, int height, int nFrames, int fps, int colorFormat,
+                FILE *yuvFile = NULL)
         : mWidth(width),
           mHeight(height),
           mMaxNumFrames(nFrames),
           mFrameRate(fps),
           mColorFormat(colorFormat),
-          mSize((width * height * 3) / 2) {
+          mSize((width * height * 3) / 2),
+          mYUVFile(yuvFile) {
 
         mGroup.add_buffer(new MediaBuffer(mSize));
     }
@@ -96,11 +101,16 @@ public:
             return err;
         }
 
-        // We don't care about the contents. we just test video encoder
-        // Also, by skipping the content generation, we can return from
-        // read() much faster.
+        // Without an input file we don't care about the contents. we just
+        // test video encoder. Also, by skipping the content generation, we
+        // can return from read() much faster.
         //char x = (char)((double)rand() / RAND_MAX * 255);
         //memset((*buffer)->data(), x, mSize);
+        if (mYUVFile != NULL && !readFrame((uint8_t *)(*buffer)->data())) {
+            (*buffer)->release();
+            *buffer = NULL;
+            return ERROR_IO;
+        }
         (*buffer)->set_range(0, mSize);
         (*buffer)->meta_data()->clear();
         (*buffer)->meta_data()->setInt64(
@@ -113,6 +123,15 @@ public:
 protected:
     virtual ~DummySource() {}
 
+    // Reads the next frame of the input file, wrapping around at its end.
+    bool readFrame(uint8_t *data) {
+        if (fread(data, 1, mSize, mYUVFile) == mSize) {
+            return true;
+        }
+        rewind(mYUVFile);
+        return fread(data, 1, mSize, mYUVFile) == mSize;
+    }
+
 private:
     MediaBufferGroup mGroup;
     int mWidth, mHeight;
@@ -120,6 +139,7 @@ private:
     int mFrameRate;
     int mColorFormat;
     size_t mSize;
+    FILE *mYUVFile;
     int64_t mNumFramesOutput;;
 
     DummySource(const DummySource &);
@@ -163,11 +183,12 @@ int main(int argc, char **argv) {
     int profile = -1;      // Encoder specific default
     int codec = 0;
     const char *fileName = "/sdcard/output.mp4";
+    const char *yuvFileName = NULL;
     bool preferSoftwareCodec = false;
 
     android::ProcessState::self()->startThreadPool();
     int res;
-    while ((res = getopt(argc, argv, "b:c:f:i:n:w:t:l:p:v:hs")) >= 0) {
+    while ((res = getopt(argc, argv, "b:c:f:i:n:w:t:l:p:v:y:o:hs")) >= 0) {
         switch (res) {
             case 'b':
             {
@@ -241,6 +262,18 @@ int main(int argc, char **argv) {
                 break;
             }
 
+            case 'y':
+            {
+                yuvFileName = optarg;
+                break;
+            }
+
+            case 'o':
+            {
+                fileName = optarg;
+                break;
+            }
+
             case 'h':
             default:
             {
@@ -250,12 +283,22 @@ int main(int argc, char **argv) {
         }
     }
 
+    FILE *yuvFile = NULL;
+    if (yuvFileName != NULL) {
+        yuvFile = fopen(yuvFileName, "rb");
+        if (yuvFile == NULL) {
+            fprintf(stderr, "unable to open %s\n", yuvFileName);
+            return 1;
+        }
+    }
+
     OMXClient client;
     CHECK_EQ(client.connect(), (status_t)OK);
 
     status_t err = OK;
     sp<MediaSource> source =
-        new DummySource(width, height, nFrames, frameRateFps, colorFormat);
+        new DummySource(width, height, nFrames, frameRateFps, colorFormat,
+                        yuvFile);
 
     sp<MetaData> enc_meta = new MetaData;
     switch (codec) {
@@ -302,6 +345,10 @@ int main(int argc, char **argv) {
     fprintf(stderr, "$\n");
     client.disconnect();
 
+    if (yuvFile != NULL) {
+        fclose(yuvFile);
+    }
+
     if (err != OK && err != ERROR_END_OF_STREAM) {
         fprintf(stderr, "record failed: %d\n", err);
         return 1;
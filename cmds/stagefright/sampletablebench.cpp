@@ -0,0 +1,426 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Writes a synthetic AVC track with B-frame reordering and a long sample
+// table to an MP4 file, then reports how long it takes the MPEG4Extractor
+// to open it and to seek around in it.
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "sampletablebench"
+#include <utils/Log.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaExtractor.h>
+#include <media/stagefright/MediaSource.h>
+#include <media/stagefright/MetaData.h>
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-n samples] [-g gop] [-s seeks] [-v] [file]\n"
+                    "\t\t-n number of video samples (default 1000000)\n"
+                    "\t\t-g samples between sync samples (default 30)\n"
+                    "\t\t-s number of random seeks (default 1000)\n"
+                    "\t\t-v variable frame rate, one time-to-sample entry per sample\n"
+                    "\t\tfile defaults to /data/local/tmp/sampletablebench.mp4\n",
+                    me);
+
+    exit(1);
+}
+
+namespace android {
+
+static const uint32_t kTimescale = 90000;
+static const uint32_t kFrameDuration = 3000;    // 30 fps
+static const uint32_t kSamplesPerChunk = 100;
+static const uint32_t kSampleSize = 5;          // 4 byte NAL length + 1 byte NAL
+
+// Writes boxes to a file, patching in their sizes when they are closed.
+struct BoxWriter {
+    BoxWriter(FILE *file)
+        : mFile(file),
+          mDepth(0) {
+    }
+
+    void beginBox(const char *type) {
+        CHECK_LT(mDepth, (int)(sizeof(mStart) / sizeof(mStart[0])));
+        mStart[mDepth++] = ftell(mFile);
+        writeInt32(0);
+        fwrite(type, 1, 4, mFile);
+    }
+
+    void endBox() {
+        CHECK_GT(mDepth, 0);
+        long start = mStart[--mDepth];
+        long end = ftell(mFile);
+        fseek(mFile, start, SEEK_SET);
+        writeInt32(end - start);
+        fseek(mFile, end, SEEK_SET);
+    }
+
+    void beginFullBox(const char *type) {
+        beginBox(type);
+        writeInt32(0);  // version 0, flags 0
+    }
+
+    void writeInt8(uint8_t x) {
+        fputc(x, mFile);
+    }
+
+    void writeInt16(uint16_t x) {
+        writeInt8(x >> 8);
+        writeInt8(x & 0xff);
+    }
+
+    void writeInt32(uint32_t x) {
+        writeInt16(x >> 16);
+        writeInt16(x & 0xffff);
+    }
+
+    void writeZeros(size_t n) {
+        while (n-- > 0) {
+            writeInt8(0);
+        }
+    }
+
+    long tell() const {
+        return ftell(mFile);
+    }
+
+private:
+    FILE *mFile;
+    long mStart[16];
+    int mDepth;
+};
+
+// Decode order I P B B P B B ..., each P is presented after the two B frames
+// that follow it.  Returns the composition offset in frames.
+static uint32_t compositionOffset(uint32_t sampleIndex, uint32_t gop) {
+    uint32_t i = sampleIndex % gop;
+    if (i == 0) {
+        return 1;
+    }
+
+    switch ((i - 1) % 3) {
+        case 0:  return 3;  // P
+        default: return 0;  // B
+    }
+}
+
+static void writeFile(
+        const char *path, uint32_t numSamples, uint32_t gop, bool variableFrameRate) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "unable to open %s\n", path);
+        exit(1);
+    }
+
+    BoxWriter w(file);
+
+    w.beginBox("ftyp");
+    fwrite("isom", 1, 4, file);
+    w.writeInt32(0);
+    fwrite("isomavc1", 1, 8, file);
+    w.endBox();
+
+    // Length prefixed single byte NAL units, IDR for sync samples.
+    w.beginBox("mdat");
+    long mdatStart = w.tell();
+    for (uint32_t i = 0; i < numSamples; ++i) {
+        w.writeInt32(1);
+        w.writeInt8(i % gop == 0 ? 0x65 : 0x41);
+    }
+    w.endBox();
+
+    unsigned seed = 1;
+    uint64_t duration = 0;
+    for (uint32_t i = 0; i < numSamples; ++i) {
+        duration += variableFrameRate
+            ? kFrameDuration - 100 + rand_r(&seed) % 200 : kFrameDuration;
+    }
+
+    w.beginBox("moov");
+
+    w.beginFullBox("mvhd");
+    w.writeInt32(0);                // creation time
+    w.writeInt32(0);                // modification time
+    w.writeInt32(1000);             // timescale
+    w.writeInt32(duration * 1000 / kTimescale);
+    w.writeInt32(0x10000);          // rate
+    w.writeInt16(0x100);            // volume
+    w.writeZeros(10);
+    static const uint32_t kMatrix[9] = {
+        0x10000, 0, 0, 0, 0x10000, 0, 0, 0, 0x40000000
+    };
+    for (size_t i = 0; i < 9; ++i) {
+        w.writeInt32(kMatrix[i]);
+    }
+    w.writeZeros(24);
+    w.writeInt32(2);                // next track id
+    w.endBox();
+
+    w.beginBox("trak");
+
+    w.beginFullBox("tkhd");
+    w.writeInt32(0);                // creation time
+    w.writeInt32(0);                // modification time
+    w.writeInt32(1);                // track id
+    w.writeInt32(0);
+    w.writeInt32(duration * 1000 / kTimescale);
+    w.writeZeros(16);
+    for (size_t i = 0; i < 9; ++i) {
+        w.writeInt32(kMatrix[i]);
+    }
+    w.writeInt32(320 << 16);
+    w.writeInt32(240 << 16);
+    w.endBox();
+
+    w.beginBox("mdia");
+
+    w.beginFullBox("mdhd");
+    w.writeInt32(0);                // creation time
+    w.writeInt32(0);                // modification time
+    w.writeInt32(kTimescale);
+    w.writeInt32(duration);
+    w.writeInt16(0x55c4);           // "und"
+    w.writeInt16(0);
+    w.endBox();
+
+    w.beginFullBox("hdlr");
+    w.writeInt32(0);
+    fwrite("vide", 1, 4, file);
+    w.writeZeros(12);
+    w.writeInt8(0);                 // empty name
+    w.endBox();
+
+    w.beginBox("minf");
+    w.beginBox("stbl");
+
+    w.beginFullBox("stsd");
+    w.writeInt32(1);
+    w.beginBox("avc1");
+    w.writeZeros(6);
+    w.writeInt16(1);                // data reference index
+    w.writeZeros(16);
+    w.writeInt16(320);
+    w.writeInt16(240);
+    w.writeInt32(0x480000);         // 72 dpi
+    w.writeInt32(0x480000);
+    w.writeInt32(0);
+    w.writeInt16(1);                // frame count
+    w.writeZeros(32);               // compressor name
+    w.writeInt16(0x18);             // depth
+    w.writeInt16(0xffff);
+    w.beginBox("avcC");
+    static const uint8_t kAVCC[] = {
+        0x01, 0x42, 0x00, 0x1e, 0xff,
+        0xe1, 0x00, 0x04, 0x67, 0x42, 0x00, 0x1e,
+        0x01, 0x00, 0x02, 0x68, 0xce,
+    };
+    fwrite(kAVCC, 1, sizeof(kAVCC), file);
+    w.endBox();
+    w.endBox();
+    w.endBox();
+
+    w.beginFullBox("stts");
+    if (variableFrameRate) {
+        seed = 1;
+        w.writeInt32(numSamples);
+        for (uint32_t i = 0; i < numSamples; ++i) {
+            w.writeInt32(1);
+            w.writeInt32(kFrameDuration - 100 + rand_r(&seed) % 200);
+        }
+    } else {
+        w.writeInt32(1);
+        w.writeInt32(numSamples);
+        w.writeInt32(kFrameDuration);
+    }
+    w.endBox();
+
+    w.beginFullBox("ctts");
+    long countOffset = w.tell();
+    w.writeInt32(0);
+    uint32_t numEntries = 0;
+    uint32_t run = 0;
+    for (uint32_t i = 0; i < numSamples; ++i) {
+        ++run;
+        if (i + 1 == numSamples
+                || compositionOffset(i + 1, gop) != compositionOffset(i, gop)) {
+            w.writeInt32(run);
+            w.writeInt32(compositionOffset(i, gop) * kFrameDuration);
+            ++numEntries;
+            run = 0;
+        }
+    }
+    long end = w.tell();
+    fseek(file, countOffset, SEEK_SET);
+    w.writeInt32(numEntries);
+    fseek(file, end, SEEK_SET);
+    w.endBox();
+
+    w.beginFullBox("stss");
+    w.writeInt32((numSamples + gop - 1) / gop);
+    for (uint32_t i = 0; i < numSamples; i += gop) {
+        w.writeInt32(i + 1);
+    }
+    w.endBox();
+
+    w.beginFullBox("stsz");
+    w.writeInt32(kSampleSize);
+    w.writeInt32(numSamples);
+    w.endBox();
+
+    uint32_t numChunks = numSamples / kSamplesPerChunk;
+
+    w.beginFullBox("stsc");
+    w.writeInt32(1);
+    w.writeInt32(1);                // first chunk
+    w.writeInt32(kSamplesPerChunk);
+    w.writeInt32(1);                // sample description
+    w.endBox();
+
+    w.beginFullBox("stco");
+    w.writeInt32(numChunks);
+    for (uint32_t i = 0; i < numChunks; ++i) {
+        w.writeInt32(mdatStart + i * kSamplesPerChunk * kSampleSize);
+    }
+    w.endBox();
+
+    w.endBox();  // stbl
+    w.endBox();  // minf
+    w.endBox();  // mdia
+    w.endBox();  // trak
+    w.endBox();  // moov
+
+    fclose(file);
+}
+
+static int64_t seek(const sp<MediaSource> &source, int64_t timeUs,
+        MediaSource::ReadOptions::SeekMode mode) {
+    MediaSource::ReadOptions options;
+    options.setSeekTo(timeUs, mode);
+
+    int64_t startUs = ALooper::GetNowUs();
+    MediaBuffer *buffer;
+    status_t err = source->read(&buffer, &options);
+    int64_t elapsedUs = ALooper::GetNowUs() - startUs;
+
+    if (err == OK) {
+        buffer->release();
+    } else if (err != ERROR_END_OF_STREAM) {
+        fprintf(stderr, "seek to %lld us failed (%d)\n", timeUs, err);
+    }
+
+    return elapsedUs;
+}
+
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+    int numSamples = 1000000;
+    int gop = 30;
+    int numSeeks = 1000;
+    bool variableFrameRate = false;
+
+    int res;
+    while ((res = getopt(argc, argv, "n:g:s:v")) >= 0) {
+        switch (res) {
+            case 'n':
+                numSamples = atoi(optarg);
+                break;
+            case 'g':
+                gop = atoi(optarg);
+                break;
+            case 's':
+                numSeeks = atoi(optarg);
+                break;
+            case 'v':
+                variableFrameRate = true;
+                break;
+            default:
+                usage(me);
+        }
+    }
+    if (numSamples < (int)kSamplesPerChunk || gop <= 0 || numSeeks <= 0
+            || optind + 1 < argc) {
+        usage(me);
+    }
+    // whole chunks only
+    numSamples -= numSamples % kSamplesPerChunk;
+
+    const char *path = optind < argc
+        ? argv[optind] : "/data/local/tmp/sampletablebench.mp4";
+
+    writeFile(path, numSamples, gop, variableFrameRate);
+
+    DataSource::RegisterDefaultSniffers();
+
+    int64_t startUs = ALooper::GetNowUs();
+    sp<DataSource> dataSource = DataSource::CreateFromURI(path);
+    CHECK(dataSource != NULL);
+    sp<MediaExtractor> extractor = MediaExtractor::Create(dataSource);
+    CHECK(extractor != NULL);
+    sp<MediaSource> source = extractor->getTrack(0);
+    CHECK(source != NULL);
+    CHECK_EQ(source->start(), (status_t)OK);
+    printf("%d samples, open %lld us\n", numSamples, ALooper::GetNowUs() - startUs);
+
+    int64_t durationUs;
+    CHECK(source->getFormat()->findInt64(kKeyDuration, &durationUs));
+
+    static const struct {
+        MediaSource::ReadOptions::SeekMode mMode;
+        const char *mName;
+    } kModes[] = {
+        { MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC, "previous sync" },
+        { MediaSource::ReadOptions::SEEK_NEXT_SYNC,     "next sync" },
+        { MediaSource::ReadOptions::SEEK_CLOSEST_SYNC,  "closest sync" },
+        { MediaSource::ReadOptions::SEEK_CLOSEST,       "closest" },
+    };
+
+    // the first seek pays for any index built on demand
+    printf("first seek %lld us\n",
+            seek(source, durationUs / 2, MediaSource::ReadOptions::SEEK_CLOSEST_SYNC));
+
+    unsigned seed = 1;
+    for (size_t m = 0; m < sizeof(kModes) / sizeof(kModes[0]); ++m) {
+        int64_t totalUs = 0;
+        int64_t maxUs = 0;
+        for (int i = 0; i < numSeeks; ++i) {
+            int64_t timeUs = (int64_t)((double)rand_r(&seed) / RAND_MAX * durationUs);
+            int64_t elapsedUs = seek(source, timeUs, kModes[m].mMode);
+            totalUs += elapsedUs;
+            if (elapsedUs > maxUs) {
+                maxUs = elapsedUs;
+            }
+        }
+        printf("%-14s %d seeks, average %lld us, max %lld us\n",
+                kModes[m].mName, numSeeks, totalUs / numSeeks, maxUs);
+    }
+
+    source->stop();
+
+    return 0;
+}
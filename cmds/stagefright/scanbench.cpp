@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Counts the H.264 start codes and the MPEG audio frame syncs in a stream,
+// once with the byte-at-a-time loops the parsers used to have and once with
+// the shared scanners of bytescan.h, and reports the throughput of each.
+// Without an input file, a synthetic H.264 stream of random NAL units and
+// a synthetic MP3 stream are used.
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "scanbench"
+#include <utils/Log.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/bytescan.h>
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-f file] [-s size] [-n iterations]\n"
+                    "\t\t-f scan this file instead of the synthetic streams\n"
+                    "\t\t-s size in MB of each synthetic stream (default 16)\n"
+                    "\t\t-n number of passes over each stream (default 10)\n",
+                    me);
+
+    exit(1);
+}
+
+namespace android {
+
+static size_t countStartCodesBytewise(const uint8_t *data, size_t size) {
+    size_t count = 0;
+    for (size_t i = 0; i + 2 < size; ++i) {
+        if (!memcmp("\x00\x00\x01", &data[i], 3)) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+static size_t countStartCodes(const uint8_t *data, size_t size) {
+    size_t count = 0;
+    size_t offset = 0;
+    while ((offset += findStartCodePrefix(&data[offset], size - offset)) < size) {
+        ++count;
+        ++offset;
+    }
+    return count;
+}
+
+static size_t countSyncWordsBytewise(const uint8_t *data, size_t size) {
+    size_t count = 0;
+    for (size_t i = 0; i + 1 < size; ++i) {
+        if (data[i] == 0xff && (data[i + 1] & 0xe0) == 0xe0) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+static size_t countSyncWords(const uint8_t *data, size_t size) {
+    size_t count = 0;
+    size_t offset = 0;
+    while ((offset += findSyncWord(&data[offset], size - offset, 0xe0)) < size) {
+        ++count;
+        ++offset;
+    }
+    return count;
+}
+
+static uint8_t *makeH264Stream(size_t size) {
+    uint8_t *data = new uint8_t[size];
+    size_t offset = 0;
+    while (offset < size) {
+        // NAL units of a few bytes (parameter sets) to tens of KB (slices),
+        // with emulation prevention keeping 0x00 0x00 0x0x out of payloads
+        size_t nalSize = 4 + (rand() % 8 == 0 ? rand() % 64 : rand() % 32768);
+        for (size_t i = 0; i < nalSize && offset < size; ++i, ++offset) {
+            if (i < 3) {
+                data[offset] = i < 2 ? 0x00 : 0x01;
+            } else {
+                uint8_t byte = rand();
+                if (byte <= 0x03 && offset >= 2
+                        && data[offset - 1] == 0x00 && data[offset - 2] == 0x00) {
+                    byte = 0x03;
+                }
+                data[offset] = byte;
+            }
+        }
+    }
+    return data;
+}
+
+static uint8_t *makeMP3Stream(size_t size) {
+    uint8_t *data = new uint8_t[size];
+    size_t offset = 0;
+    while (offset < size) {
+        // 128kbps 44.1kHz layer III frames
+        size_t frameSize = 417 + (rand() & 1);
+        for (size_t i = 0; i < frameSize && offset < size; ++i, ++offset) {
+            static const uint8_t kHeader[] = { 0xff, 0xfb, 0x90, 0x64 };
+            data[offset] = i < sizeof(kHeader) ? kHeader[i] : rand();
+        }
+    }
+    return data;
+}
+
+static void run(const char *title, const uint8_t *data, size_t size, int iterations,
+        size_t (*bytewise)(const uint8_t *, size_t),
+        size_t (*scanner)(const uint8_t *, size_t)) {
+    size_t expected = 0;
+    size_t found = 0;
+
+    int64_t startUs = ALooper::GetNowUs();
+    for (int i = 0; i < iterations; ++i) {
+        expected = bytewise(data, size);
+    }
+    int64_t bytewiseUs = ALooper::GetNowUs() - startUs;
+
+    startUs = ALooper::GetNowUs();
+    for (int i = 0; i < iterations; ++i) {
+        found = scanner(data, size);
+    }
+    int64_t scannerUs = ALooper::GetNowUs() - startUs;
+
+    double megabytes = (double)size * iterations / (1024 * 1024);
+    printf("%s: %u found%s, bytewise %.1f MB/s, scanner %.1f MB/s, speedup %.2fx\n",
+            title, (unsigned)found, found == expected ? "" : " (MISMATCH)",
+            megabytes * 1E6 / bytewiseUs, megabytes * 1E6 / scannerUs,
+            (double)bytewiseUs / scannerUs);
+}
+
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+    const char *path = NULL;
+    size_t size = 16 << 20;
+    int iterations = 10;
+
+    int res;
+    while ((res = getopt(argc, argv, "f:s:n:")) >= 0) {
+        switch (res) {
+            case 'f':
+                path = optarg;
+                break;
+            case 's':
+                size = (size_t)atoi(optarg) << 20;
+                break;
+            case 'n':
+                iterations = atoi(optarg);
+                break;
+            default:
+                usage(me);
+        }
+    }
+    if (size == 0 || iterations <= 0) {
+        usage(me);
+    }
+
+    if (path != NULL) {
+        int fd = open(path, O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+            fprintf(stderr, "unable to open %s\n", path);
+            return 1;
+        }
+        size = st.st_size;
+        uint8_t *data = new uint8_t[size];
+        ssize_t n = read(fd, data, size);
+        close(fd);
+        if (n != (ssize_t)size) {
+            fprintf(stderr, "unable to read %s\n", path);
+            return 1;
+        }
+
+        run("start codes", data, size, iterations,
+                countStartCodesBytewise, countStartCodes);
+        run("MPEG audio syncs", data, size, iterations,
+                countSyncWordsBytewise, countSyncWords);
+        delete[] data;
+
+        return 0;
+    }
+
+    srand(1);
+    uint8_t *h264 = makeH264Stream(size);
+    run("H.264 start codes", h264, size, iterations,
+            countStartCodesBytewise, countStartCodes);
+    delete[] h264;
+
+    uint8_t *mp3 = makeMP3Stream(size);
+    run("MP3 frame syncs", mp3, size, iterations,
+            countSyncWordsBytewise, countSyncWords);
+    delete[] mp3;
+
+    return 0;
+}
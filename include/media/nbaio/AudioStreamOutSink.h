@@ -23,6 +23,8 @@
 namespace android {
 
 // not multi-thread safe
+// In addition to the HAL stream's own format, a float format with the same sample rate and
+// channel count can be negotiated; write() then converts to 16-bit on the way to the HAL.
 class AudioStreamOutSink : public NBAIO_Sink {
 
 public:
@@ -43,7 +45,8 @@ public:
 
     // This is an over-estimate, and could dupe the caller into making a blocking write()
     // FIXME Use an audio HAL API to query the buffer emptying status when it's available.
-    virtual ssize_t availableToWrite() const { return mStreamBufferSizeBytes >> mBitShift; }
+    virtual ssize_t availableToWrite() const
+            { return mStreamBufferSizeBytes >> mStreamBitShift; }
 
     virtual ssize_t write(const void *buffer, size_t count);
 
@@ -59,8 +62,13 @@ public:
 #endif
 
 private:
+    ssize_t writeFloat(const float *buffer, size_t count);
+
     audio_stream_out * const mStream;
     size_t              mStreamBufferSizeBytes; // as reported by get_buffer_size()
+    NBAIO_Format        mStreamFormat;          // format of the HAL stream
+    size_t              mStreamBitShift;        // frame size of mStreamFormat as a bit shift
+    int16_t*            mConvertBuffer;         // HAL sized, allocated on first float write()
 };
 
 }   // namespace android
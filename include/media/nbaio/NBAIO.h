@@ -56,6 +56,8 @@ enum NBAIO_Format {
     Format_SR48_C2_I16,     // 48 kHz PCM stereo interleaved 16-bit signed
     Format_SR44_1_C1_I16,   // 44.1 kHz PCM mono interleaved 16-bit signed
     Format_SR48_C1_I16,     // 48 kHz PCM mono interleaved 16-bit signed
+    Format_SR44_1_C2_F32,   // 44.1 kHz PCM stereo interleaved float, full scale is +/-1.0
+    Format_SR48_C2_F32,     // 48 kHz PCM stereo interleaved float, full scale is +/-1.0
 };
 
 // Return the frame size of an NBAIO_Format in bytes
@@ -73,6 +75,13 @@ unsigned Format_sampleRate(NBAIO_Format format);
 // Return the channel count of an NBAIO_Format
 unsigned Format_channelCount(NBAIO_Format format);
 
+// Return true if the samples of an NBAIO_Format are float rather than 16-bit signed
+bool Format_isFloat(NBAIO_Format format);
+
+// Convert a sample rate in Hz and channel count to a float NBAIO_Format,
+// or Format_Invalid if there is no float format for that combination
+NBAIO_Format Format_from_SR_C_Float(unsigned sampleRate, unsigned channelCount);
+
 // Callbacks used by NBAIO_Sink::writeVia() and NBAIO_Source::readVia() below.
 typedef ssize_t (*writeVia_t)(void *user, void *buffer, size_t count);
 typedef ssize_t (*readVia_t)(void *user, const void *buffer,
@@ -24,6 +24,8 @@ namespace android {
 // Pipe is multi-thread safe for readers (see PipeReader), but safe for only a single writer thread.
 // It cannot UNDERRUN on write, unless we allow designation of a master reader that provides the
 // time-base. Readers can be added and removed dynamically, and it's OK to have no readers.
+// Readers never write to the Pipe, so they can each run on their own thread at their own pace;
+// each reader keeps count of how far it lags behind the writer and of the frames it lost.
 class Pipe : public NBAIO_Sink {
 
     friend class PipeReader;
@@ -52,11 +54,21 @@ public:
     virtual ssize_t write(const void *buffer, size_t count);
     //virtual ssize_t writeVia(writeVia_t via, size_t total, void *user, size_t block);
 
+    // number of PipeReader clients currently attached to this Pipe
+    int32_t readers() const;
+
+    // size used to keep fields that are written by different threads on separate cache lines
+    static const size_t kCacheLineSize = 64;
+
 private:
     const size_t    mMaxFrames;     // always a power of 2
     void * const    mBuffer;
-    volatile int32_t mRear;         // written by android_atomic_release_store
     volatile int32_t mReaders;      // number of PipeReader clients currently attached to this Pipe
+    // mRear is written on every write() and polled by every reader, so it has a cache line
+    // to itself rather than sharing one with the read-only fields above
+    char            mPadBeforeRear[kCacheLineSize];
+    volatile int32_t mRear;         // written by android_atomic_release_store
+    char            mPadAfterRear[kCacheLineSize - sizeof(int32_t)];
 };
 
 }   // namespace android
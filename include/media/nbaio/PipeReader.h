@@ -21,7 +21,8 @@
 
 namespace android {
 
-// PipeReader is safe for only a single thread
+// PipeReader is safe for only a single thread, except for the latency and overrun accessors
+// which may be called from any thread, e.g. for dumpsys.
 class PipeReader : public NBAIO_Source {
 
 public:
@@ -40,24 +41,47 @@ public:
     // NBAIO_Source interface
 
     //virtual size_t framesRead() const;
-    virtual size_t framesOverrun() { return mFramesOverrun; }
-    virtual size_t overruns()  { return mOverruns; }
+    virtual size_t framesOverrun();
+    virtual size_t overruns();
 
     virtual ssize_t availableToRead();
 
     virtual ssize_t read(void *buffer, size_t count, int64_t readPTS);
 
+    // Passes the frames to 'via' directly from the pipe's buffer, in at most two contiguous
+    // pieces of up to 'block' frames each, without an intermediate copy.
+    virtual ssize_t readVia(readVia_t via, size_t total, void *user,
+                            int64_t readPTS, size_t block = 0);
+
     // NBAIO_Source end
 
+    // Number of frames written to the pipe that this reader has not consumed yet.
+    // More than the pipe size means that the next read will report an OVERRUN.
+    size_t lag() const;
+
+    // Largest lag() observed by this reader's own availableToRead(), read() and readVia().
+    size_t maxLag() const;
+
 #if 0   // until necessary
     Pipe& pipe() const { return mPipe; }
 #endif
 
 private:
+    // update the counters after frames from oldFront up to mFront may have been overwritten
+    void        checkOverrun(int32_t oldFront);
+
     Pipe&       mPipe;
-    int32_t     mFront;         // follows behind mPipe.mRear
-    size_t      mFramesOverrun;
-    size_t      mOverruns;
+    // an overrun was counted by checkOverrun() and the writer may still be too far ahead,
+    // so the next availableToRead() must not count the same gap again; reader's thread only
+    bool        mOverrunCounted;
+    // the reader's position and counters are written only by the reader's thread, but are read
+    // by other threads, so they are kept apart from other readers' and from the Pipe's fields
+    char        mPadBefore[Pipe::kCacheLineSize];
+    volatile int32_t mFront;            // follows behind mPipe.mRear
+    volatile int32_t mFramesOverrun;    // frames skipped or overwritten before they were read
+    volatile int32_t mOverruns;         // number of overrun events
+    volatile int32_t mMaxLag;           // see maxLag()
+    char        mPadAfter[Pipe::kCacheLineSize - 4 * sizeof(int32_t)];
 };
 
 }   // namespace android
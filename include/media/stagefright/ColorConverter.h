@@ -28,11 +28,25 @@
 namespace android {
 
 struct ColorConverter {
+    enum {
+        // R, G, B, A in memory order, the layout of HAL_PIXEL_FORMAT_RGBA_8888
+        // and SkBitmap::kARGB_8888_Config. OMX has no color format for it,
+        // so this takes a value from the vendor extension range.
+        // OMX_COLOR_Format32bitARGB8888 is supported as well and yields
+        // B, G, R, A in memory order.
+        kColorFormat32bitRGBA8888 = 0x7F00A000,
+    };
+
     ColorConverter(OMX_COLOR_FORMATTYPE from, OMX_COLOR_FORMATTYPE to);
     ~ColorConverter();
 
     bool isValid() const;
 
+    // Frames large enough are converted in horizontal bands on up to
+    // |numThreads| threads, 0 (the default) picks a count based on the
+    // number of CPUs online.
+    void setNumThreads(size_t numThreads);
+
     status_t convert(
             const void *srcBits,
             size_t srcWidth, size_t srcHeight,
@@ -59,11 +73,29 @@ private:
         size_t mCropLeft, mCropTop, mCropRight, mCropBottom;
     };
 
+    struct YUVLayout;
+    struct RGBLayout;
+    struct Band;
+
     OMX_COLOR_FORMATTYPE mSrcFormat, mDstFormat;
     uint8_t *mClip;
+    size_t mNumThreads;
 
     uint8_t *initClip();
 
+    bool isDst32bit() const;
+    RGBLayout getRGBLayout(const BitmapParams &dst, bool swapRedBlue) const;
+
+    void convertRows(
+            const YUVLayout &src, const RGBLayout &dst, size_t width,
+            size_t firstRow, size_t numRows) const;
+
+    status_t convertFrame(
+            const YUVLayout &src, const RGBLayout &dst,
+            size_t width, size_t height);
+
+    static void *BandWrapper(void *me);
+
     status_t convertCbYCrY(
             const BitmapParams &src, const BitmapParams &dst);
 
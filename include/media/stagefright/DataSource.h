@@ -66,6 +66,14 @@ public:
         return ERROR_UNSUPPORTED;
     }
 
+    // Hints that the "size" bytes at "offset" are going to be read: again
+    // and again if "pin" is true, such as an index, or else next.  Caching
+    // sources use it to keep or prefetch the range; others ignore it.
+    virtual void hintRange(off64_t offset, size_t size, bool pin) {}
+
+    // Undoes a pinning hintRange() of the same range.
+    virtual void releaseRange(off64_t offset, size_t size) {}
+
     ////////////////////////////////////////////////////////////////////////////
 
     bool sniff(String8 *mimeType, float *confidence, sp<AMessage> *meta);
@@ -51,6 +51,18 @@ private:
     int64_t mLength;
     Mutex mLock;
 
+    // Reads go straight to pread64, which needs no lock; mLock only
+    // serializes the DRM path.  The file is deliberately not mapped: the fd
+    // may come from a client that can truncate it under us, and touching a
+    // mapping past the new end of the file raises SIGBUS.
+
+    // Access pattern tracking for readahead hints, see adviseAccess().
+    Mutex mHintLock;
+    off64_t mLastReadEnd;
+    off64_t mReadaheadEnd;
+
+    void adviseAccess(off64_t offset, size_t size);
+
     /*for DRM*/
     sp<DecryptHandle> mDecryptHandle;
     DrmManagerClient *mDrmManagerClient;
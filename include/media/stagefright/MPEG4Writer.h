@@ -56,15 +56,28 @@ public:
     status_t setInterleaveDuration(uint32_t duration);
     int32_t getTimeScale() const { return mTimeScale; }
 
+    // Write a fragmented file: the movie header goes out first with empty
+    // sample tables, followed by a 'moof'/'mdat' pair for every durationUs
+    // of media of each track. A recording that is cut short stays playable
+    // up to its last complete fragment. 0 (the default) disables it.
+    // Must be called before start().
+    status_t setFragmentDuration(int64_t durationUs);
+    int64_t fragmentDuration() const { return mFragmentDurationUs; }
+    bool isFragmented() const { return mFragmentDurationUs > 0; }
+
     status_t setGeoData(int latitudex10000, int longitudex10000);
     void setStartTimeOffsetMs(int ms) { mStartTimeOffsetMs = ms; }
     int32_t getStartTimeOffsetMs() const { return mStartTimeOffsetMs; }
 
+    // Number of write system calls made and bytes written so far.
+    void getWriteStats(uint32_t *numWriteCalls, int64_t *numBytesWritten);
+
 protected:
     virtual ~MPEG4Writer();
 
 private:
     class Track;
+    class WriteBehind;
 
     int  mFd;
     status_t mInitCheck;
@@ -89,6 +102,16 @@ private:
     int mLongitudex10000;
     bool mAreGeoTagsAvailable;
     int32_t mStartTimeOffsetMs;
+    int64_t mFragmentDurationUs;
+    uint32_t mFragmentSequenceNumber;
+    bool mMoovBoxWritten;  // Fragmented file only
+
+    // Media data goes out through the write-behind thread while recording;
+    // everything else is written directly, when nothing is queued there.
+    WriteBehind *mWriteBehind;
+    Mutex mWriteStatsLock;      // Guards the two counts below
+    uint32_t mNumWriteCalls;    // Direct and retired write-behind counts
+    int64_t mNumBytesWritten;
 
     Mutex mLock;
 
@@ -102,16 +125,29 @@ private:
     size_t numTracks();
     int64_t estimateMoovBoxSize(int32_t bitRate);
 
+    // Per-sample information of a movie fragment
+    struct FragmentSample {
+        uint32_t mSize;                     // Including the nal length prefix
+        uint32_t mDurationTicks;            // Track time scale based
+        uint32_t mCompositionOffsetTicks;   // Track time scale based
+        bool     mIsSync;
+    };
+
     struct Chunk {
         Track               *mTrack;        // Owner
         int64_t             mTimeStampUs;   // Timestamp of the 1st sample
         List<MediaBuffer *> mSamples;       // Sample data
 
+        // Fragmented file only: one chunk makes up a whole movie fragment
+        List<FragmentSample> mFragmentSamples;
+        int64_t             mBaseMediaDecodeTimeTicks;
+
         // Convenient constructor
-        Chunk(): mTrack(NULL), mTimeStampUs(0) {}
+        Chunk(): mTrack(NULL), mTimeStampUs(0), mBaseMediaDecodeTimeTicks(0) {}
 
         Chunk(Track *track, int64_t timeUs, List<MediaBuffer *> samples)
-            : mTrack(track), mTimeStampUs(timeUs), mSamples(samples) {
+            : mTrack(track), mTimeStampUs(timeUs), mSamples(samples),
+              mBaseMediaDecodeTimeTicks(0) {
         }
 
     };
@@ -125,6 +161,9 @@ private:
         // Max time interval between neighboring chunks
         int64_t mMaxInterChunkDurUs;
 
+        // Whether the track has buffered any chunk so far
+        bool mGotFirstChunk;
+
     };
 
     bool            mIsFirstChunk;
@@ -149,8 +188,16 @@ private:
     // Return true if a chunk is found; otherwise, return false.
     bool findChunkToWrite(Chunk *chunk);
 
-    // Actually write the given chunk to the file.
-    void writeChunkToFile(Chunk* chunk);
+    // Actually write the given chunk to the file. Whether every track
+    // has buffered a chunk is passed in, as checked under mLock.
+    void writeChunkToFile(Chunk* chunk, bool allTracksGotFirstChunk);
+
+    // Write the given chunk as a 'moof' box followed by its 'mdat' box.
+    void writeMovieFragment(Chunk* chunk, bool allTracksGotFirstChunk);
+
+    // Return whether every track has buffered a chunk, and thus
+    // has the codec specific data needed by the movie header.
+    bool allTracksGotFirstChunk_l() const;
 
     // Adjust other track media clock (presumably wall clock)
     // based on audio track media clock with the drift time.
@@ -166,6 +213,7 @@ private:
     void unlock();
 
     // Acquire lock before calling these methods
+    // The buffer is queued for writing and released once written.
     off64_t addSample_l(MediaBuffer *buffer);
     off64_t addLengthPrefixedSample_l(MediaBuffer *buffer);
 
@@ -178,6 +226,7 @@ private:
     void writeMvhdBox(int64_t durationUs);
     void writeMoovBox(int64_t durationUs);
     void writeFtypBox(MetaData *param);
+    void writeMvexBox();
     void writeUdtaBox();
     void writeGeoDataBox();
     void writeLatitude(int degreex10000);
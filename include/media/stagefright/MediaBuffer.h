@@ -99,6 +99,7 @@ private:
 
     MediaBufferObserver *mObserver;
     MediaBuffer *mNextBuffer;
+    MediaBuffer *mNextFreeBuffer;  // links the free lists of MediaBufferGroup
     int mRefCount;
 
     void *mData;
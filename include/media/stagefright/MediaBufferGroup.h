@@ -36,7 +36,19 @@ public:
 
     // Blocks until a buffer is available and returns it to the caller,
     // the returned buffer will have a reference count of 1.
-    status_t acquire_buffer(MediaBuffer **buffer);
+    // If nonBlocking is true, returns WOULD_BLOCK instead of blocking.
+    // If requestedSize is not 0, the returned buffer holds at least that
+    // many bytes.  A free buffer that is too small is grown to fit if it
+    // owns its data, so buffers need not be allocated at the worst case
+    // size up front.  Returns NO_MEMORY if growing a buffer failed.
+    status_t acquire_buffer(
+            MediaBuffer **buffer, bool nonBlocking = false, size_t requestedSize = 0);
+
+    // Same as the blocking acquire_buffer(), but returns TIMED_OUT if no
+    // suitable buffer became available within timeoutUs.  A timeoutUs of 0
+    // or less does not wait at all.
+    status_t acquire_buffer_timeout(
+            MediaBuffer **buffer, int64_t timeoutUs, size_t requestedSize = 0);
 
 protected:
     virtual void signalBufferReturned(MediaBuffer *buffer);
@@ -47,8 +59,31 @@ private:
     Mutex mLock;
     Condition mCondition;
 
+    enum {
+        // Free buffers of size [2^i, 2^(i + 1)) are kept in size class i.
+        kNumSizeClasses = 32,
+    };
+
     MediaBuffer *mFirstBuffer, *mLastBuffer;
 
+    // Buffers returned by their last release(), pushed without taking
+    // mLock and moved to the free lists by the next acquire.
+    MediaBuffer * volatile mReturnedBuffers;
+
+    // Free buffers by size class and a mask of the non-empty classes,
+    // protected by mLock.
+    MediaBuffer *mFreeBuffers[kNumSizeClasses];
+    uint32_t mFreeClassMask;
+
+    status_t acquire(MediaBuffer **out, int64_t timeoutNs, size_t requestedSize);
+
+    void takeReturnedBuffers_l();
+    void addFreeBuffer_l(MediaBuffer *buffer);
+    MediaBuffer *removeFreeBuffer_l(size_t requestedSize);
+    MediaBuffer *removeGrowableBuffer_l();
+
+    static size_t SizeClass(size_t size);
+
     MediaBufferGroup(const MediaBufferGroup &);
     MediaBufferGroup &operator=(const MediaBufferGroup &);
 };
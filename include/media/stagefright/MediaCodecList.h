@@ -79,6 +79,12 @@ private:
     KeyedVector<AString, size_t> mCodecQuirks;
     KeyedVector<AString, size_t> mTypes;
 
+    // Compiled form of the list that all lookups go through, mapped
+    // read-only from the cache file or held on the heap.
+    const uint8_t *mData;
+    size_t mDataSize;
+    bool mDataIsMapped;
+
     MediaCodecList();
     ~MediaCodecList();
 
@@ -100,6 +106,8 @@ private:
     status_t addTypeFromAttributes(const char **attrs);
     void addType(const char *name);
 
+    status_t compile(uint8_t **data, size_t *size) const;
+
 #ifdef QCOM_HARDWARE
     friend class QCUtilityClass;
 #endif
@@ -32,6 +32,12 @@ struct ABuffer : public RefBase {
     ABuffer(size_t capacity);
     ABuffer(void *data, size_t capacity);
 
+    // Returns a buffer sharing size bytes of buffer's data at offset,
+    // relative to its current range, without copying them.  The slice
+    // keeps buffer alive for as long as the slice itself is referenced.
+    static sp<ABuffer> CreateAsSlice(
+            const sp<ABuffer> &buffer, size_t offset, size_t size);
+
     void setFarewellMessage(const sp<AMessage> msg);
 
     uint8_t *base() { return (uint8_t *)mData; }
@@ -53,6 +59,7 @@ protected:
 private:
     sp<AMessage> mFarewell;
     sp<AMessage> mMeta;
+    sp<ABuffer> mParent;
 
     void *mData;
     size_t mCapacity;
@@ -25,6 +25,7 @@
 #include <utils/List.h>
 #include <utils/RefBase.h>
 #include <utils/threads.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -62,22 +63,41 @@ private:
     struct Event {
         int64_t mWhenUs;
         sp<AMessage> mMessage;
+        bool mDelayed;
+        uint32_t mSeq;      // order of arrival, for delayed events due at the same time
+        Event *mNext;
     };
 
+    // Any thread posts events by pushing them onto the lock-free stack mPostedEvents.
+    // The looper thread takes all of them at once, and moves them to the FIFO of
+    // immediate events or to the min-heap of delayed events, which only it accesses.
+    // mLock is only held to start and stop, and to wait for or signal a posted event
+    // when the stack was empty.
     Mutex mLock;
     Condition mQueueChangedCondition;
 
     AString mName;
 
-    List<Event> mEventQueue;
+    Event * volatile mPostedEvents;
+    Event *mImmediateHead;
+    Event *mImmediateTail;
+    Vector<Event *> mDelayedEvents;     // min-heap on (mWhenUs, mSeq)
+    uint32_t mNextSeq;
 
     struct LooperThread;
     sp<LooperThread> mThread;
     bool mRunningLocally;
+    volatile int32_t mRunning;          // mThread != NULL || mRunningLocally
 
     void post(const sp<AMessage> &msg, int64_t delayUs);
     bool loop();
 
+    static bool isEarlier(const Event *a, const Event *b);
+    void takePostedEvents();
+    void pushDelayedEvent(Event *event);
+    Event *popDelayedEvent();
+    void clearEvents();
+
     DISALLOW_EVIL_CONSTRUCTORS(ALooper);
 };
 
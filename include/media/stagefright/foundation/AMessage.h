@@ -32,6 +32,10 @@ struct Parcel;
 struct AMessage : public RefBase {
     AMessage(uint32_t what = 0, ALooper::handler_id target = 0);
 
+    // Messages and their items are recycled through small per-thread pools.
+    static void *operator new(size_t size);
+    static void operator delete(void *ptr, size_t size);
+
     static sp<AMessage> FromParcel(const Parcel &parcel);
     void writeToParcel(Parcel *parcel) const;
 
@@ -90,6 +94,8 @@ struct AMessage : public RefBase {
     // Performs a deep-copy of "this", contained messages are in turn "dup'ed".
     // Warning: RefBase items, i.e. "objects" are _not_ copied but only have
     // their refcount incremented.
+    // Unless "this" contains messages, the items are not copied until either
+    // "this" or the copy is modified.
     sp<AMessage> dup() const;
 
     AString debugString(int32_t indent = 0) const;
@@ -135,17 +141,32 @@ private:
             Rect rectValue;
         } u;
         const char *mName;
+        uint32_t mNameHash;
         Type mType;
     };
 
     enum {
         kMaxNumItems = 64
     };
-    Item mItems[kMaxNumItems];
-    size_t mNumItems;
+
+    // The items are kept in a refcounted table, which dup() shares between
+    // the message and its copy until one of them needs to modify it.
+    struct ItemTable {
+        volatile int32_t mRefCount;
+        size_t mNumItems;
+        Item mItems[kMaxNumItems];
+    };
+    ItemTable *mTable;  // NULL until the first item is set
+
+    static ItemTable *allocateTable();
+    static void releaseTable(ItemTable *table);
+    static void copyItems(ItemTable *to, const ItemTable *from);
+    static void freeItem(Item *item, const void *id);
+
+    // Returns a table of our own, copying a shared one first.
+    ItemTable *editTable();
 
     Item *allocateItem(const char *name);
-    void freeItem(Item *item);
     const Item *findItem(const char *name, Type type) const;
 
     void setObjectInternal(
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BYTESCAN_H_
+
+#define BYTESCAN_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+
+namespace android {
+
+// Returns the offset of the first 0x00 0x00 0x01 start code prefix that
+// lies entirely within data[0, size), or size if there is none.  Blocks of
+// data without any 0x00 byte are skipped 16 bytes at a time with SSE2 or
+// NEON compares, or a word at a time otherwise.
+size_t findStartCodePrefix(const uint8_t *data, size_t size);
+
+// Returns the offset of the first 0xff byte whose successor within
+// data[0, size) has all bits of mask set, or size if there is none.
+// mask 0xe0 finds MPEG audio frame sync candidates, 0xf0 ADTS ones.
+size_t findSyncWord(const uint8_t *data, size_t size, uint8_t mask);
+
+}  // namespace android
+
+#endif  // BYTESCAN_H_
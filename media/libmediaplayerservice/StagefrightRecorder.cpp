@@ -535,6 +535,21 @@ status_t StagefrightRecorder::setParamInterleaveDuration(int32_t durationUs) {
     return OK;
 }
 
+status_t StagefrightRecorder::setParamFragmentDuration(int64_t durationUs) {
+    ALOGV("setParamFragmentDuration: %lld", durationUs);
+    if (durationUs < 0) {
+        ALOGE("Fragment duration is negative: %lld us", durationUs);
+        return BAD_VALUE;
+    } else if (durationUs > 0 && durationUs < 500000) {  // 500 ms
+        // Each fragment has its own headers, which would make up for
+        // a significant portion of the saved contents
+        ALOGE("Fragment duration is too small: %lld us", durationUs);
+        return BAD_VALUE;
+    }
+    mFragmentDurationUs = durationUs;
+    return OK;
+}
+
 // If seconds <  0, only the first frame is I frame, and rest are all P frames
 // If seconds == 0, all frames are encoded as I frames. No P frames
 // If seconds >  0, it is the time spacing (seconds) between 2 neighboring I frames
@@ -690,6 +705,11 @@ status_t StagefrightRecorder::setParameter(
         if (safe_strtoi32(value.string(), &durationUs)) {
             return setParamInterleaveDuration(durationUs);
         }
+    } else if (key == "param-fragment-duration-us") {
+        int64_t durationUs;
+        if (safe_strtoi64(value.string(), &durationUs)) {
+            return setParamFragmentDuration(durationUs);
+        }
     } else if (key == "param-movie-time-scale") {
         int32_t timeScale;
         if (safe_strtoi32(value.string(), &timeScale)) {
@@ -1863,6 +1883,10 @@ status_t StagefrightRecorder::setupMPEG4Recording(
         reinterpret_cast<MPEG4Writer *>(writer.get())->
             setInterleaveDuration(mInterleaveDurationUs);
     }
+    if (mFragmentDurationUs > 0) {
+        reinterpret_cast<MPEG4Writer *>(writer.get())->
+            setFragmentDuration(mFragmentDurationUs);
+    }
     if (mLongitudex10000 > -3600000 && mLatitudex10000 > -3600000) {
         reinterpret_cast<MPEG4Writer *>(writer.get())->
             setGeoData(mLatitudex10000, mLongitudex10000);
@@ -2038,6 +2062,7 @@ status_t StagefrightRecorder::reset() {
     mAudioBitRate  = 12200;
 #endif
     mInterleaveDurationUs = 0;
+    mFragmentDurationUs = 0;
     mIFramesIntervalSec = 1;
     mAudioSourceNode = 0;
     mUse64BitFileOffset = false;
@@ -2112,6 +2137,8 @@ status_t StagefrightRecorder::dump(
     result.append(buffer);
     snprintf(buffer, SIZE, "     Interleave duration (us): %d\n", mInterleaveDurationUs);
     result.append(buffer);
+    snprintf(buffer, SIZE, "     Fragment duration (us): %lld\n", mFragmentDurationUs);
+    result.append(buffer);
     snprintf(buffer, SIZE, "     Progress notification: %lld us\n", mTrackEveryTimeDurationUs);
     result.append(buffer);
     snprintf(buffer, SIZE, "   Audio\n");
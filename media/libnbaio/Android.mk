@@ -30,3 +30,18 @@ LOCAL_SHARED_LIBRARIES := \
     libutils
 
 include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := test-pipe.cpp
+
+LOCAL_MODULE := test-pipe
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_SHARED_LIBRARIES := \
+    libnbaio \
+    libcutils \
+    libutils
+
+include $(BUILD_EXECUTABLE)
@@ -22,32 +22,64 @@
 
 namespace android {
 
+// round to nearest and saturate a float sample with full scale +/-1.0 to 16-bit
+static inline int16_t clamp16_from_float(float f)
+{
+    float scaled = f * 32768.0f;
+    if (scaled >= 32767.0f) {
+        return 32767;
+    }
+    if (scaled <= -32768.0f) {
+        return -32768;
+    }
+    return (int16_t) (scaled < 0 ? scaled - 0.5f : scaled + 0.5f);
+}
+
 AudioStreamOutSink::AudioStreamOutSink(audio_stream_out *stream) :
         NBAIO_Sink(),
         mStream(stream),
-        mStreamBufferSizeBytes(0)
+        mStreamBufferSizeBytes(0),
+        mStreamFormat(Format_Invalid),
+        mStreamBitShift(0),
+        mConvertBuffer(NULL)
 {
     ALOG_ASSERT(stream != NULL);
 }
 
 AudioStreamOutSink::~AudioStreamOutSink()
 {
+    delete[] mConvertBuffer;
 }
 
 ssize_t AudioStreamOutSink::negotiate(const NBAIO_Format offers[], size_t numOffers,
                                       NBAIO_Format counterOffers[], size_t& numCounterOffers)
 {
-    if (mFormat == Format_Invalid) {
+    if (mStreamFormat == Format_Invalid) {
         mStreamBufferSizeBytes = mStream->common.get_buffer_size(&mStream->common);
         audio_format_t streamFormat = mStream->common.get_format(&mStream->common);
         if (streamFormat == AUDIO_FORMAT_PCM_16_BIT) {
             uint32_t sampleRate = mStream->common.get_sample_rate(&mStream->common);
             audio_channel_mask_t channelMask =
                     (audio_channel_mask_t) mStream->common.get_channels(&mStream->common);
-            mFormat = Format_from_SR_C(sampleRate, popcount(channelMask));
-            mBitShift = Format_frameBitShift(mFormat);
+            mStreamFormat = Format_from_SR_C(sampleRate, popcount(channelMask));
+            mStreamBitShift = Format_frameBitShift(mStreamFormat);
         }
     }
+    // the float version of the stream format is accepted as well, and converted by write()
+    if (mStreamFormat != Format_Invalid) {
+        NBAIO_Format floatFormat = Format_from_SR_C_Float(Format_sampleRate(mStreamFormat),
+                Format_channelCount(mStreamFormat));
+        for (size_t i = 0; floatFormat != Format_Invalid && i < numOffers; ++i) {
+            if (offers[i] == floatFormat) {
+                mFormat = floatFormat;
+                mBitShift = Format_frameBitShift(floatFormat);
+                mNegotiated = true;
+                return i;
+            }
+        }
+    }
+    mFormat = mStreamFormat;
+    mBitShift = mStreamBitShift;
     return NBAIO_Sink::negotiate(offers, numOffers, counterOffers, numCounterOffers);
 }
 
@@ -57,6 +89,9 @@ ssize_t AudioStreamOutSink::write(const void *buffer, size_t count)
         return NEGOTIATE;
     }
     ALOG_ASSERT(mFormat != Format_Invalid);
+    if (Format_isFloat(mFormat)) {
+        return writeFloat((const float *) buffer, count);
+    }
     ssize_t ret = mStream->write(mStream, buffer, count << mBitShift);
     if (ret > 0) {
         ret >>= mBitShift;
@@ -67,6 +102,42 @@ ssize_t AudioStreamOutSink::write(const void *buffer, size_t count)
     return ret;
 }
 
+// Convert to the 16-bit stream format in HAL buffer sized pieces.  This is the only place where
+// a float mix is requantized and saturated.
+ssize_t AudioStreamOutSink::writeFloat(const float *buffer, size_t count)
+{
+    size_t maxFrames = mStreamBufferSizeBytes >> mStreamBitShift;
+    if (maxFrames == 0) {
+        return NEGOTIATE;
+    }
+    if (mConvertBuffer == NULL) {
+        mConvertBuffer = new int16_t[mStreamBufferSizeBytes / sizeof(int16_t)];
+    }
+    const unsigned channelCount = Format_channelCount(mFormat);
+    ssize_t written = 0;
+    while (count > 0) {
+        size_t frames = count < maxFrames ? count : maxFrames;
+        size_t samples = frames * channelCount;
+        for (size_t i = 0; i < samples; ++i) {
+            mConvertBuffer[i] = clamp16_from_float(buffer[i]);
+        }
+        ssize_t ret = mStream->write(mStream, mConvertBuffer, frames << mStreamBitShift);
+        if (ret <= 0) {
+            // FIXME verify HAL implementations are returning the correct error codes
+            return written > 0 ? written : ret;
+        }
+        ret >>= mStreamBitShift;
+        mFramesWritten += ret;
+        written += ret;
+        if ((size_t) ret < frames) {
+            break;
+        }
+        buffer += samples;
+        count -= frames;
+    }
+    return written;
+}
+
 status_t AudioStreamOutSink::getNextWriteTimestamp(int64_t *timestamp) {
     ALOG_ASSERT(timestamp != NULL);
 
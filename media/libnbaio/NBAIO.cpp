@@ -31,6 +31,9 @@ size_t Format_frameSize(NBAIO_Format format)
     case Format_SR44_1_C1_I16:
     case Format_SR48_C1_I16:
         return 1 * sizeof(short);
+    case Format_SR44_1_C2_F32:
+    case Format_SR48_C2_F32:
+        return 2 * sizeof(float);
     case Format_Invalid:
     default:
         return 0;
@@ -46,6 +49,9 @@ size_t Format_frameBitShift(NBAIO_Format format)
     case Format_SR44_1_C1_I16:
     case Format_SR48_C1_I16:
         return 1;   // 1 << 1 == 1 * sizeof(short)
+    case Format_SR44_1_C2_F32:
+    case Format_SR48_C2_F32:
+        return 3;   // 1 << 3 == 2 * sizeof(float)
     case Format_Invalid:
     default:
         return 0;
@@ -57,9 +63,11 @@ unsigned Format_sampleRate(NBAIO_Format format)
     switch (format) {
     case Format_SR44_1_C1_I16:
     case Format_SR44_1_C2_I16:
+    case Format_SR44_1_C2_F32:
         return 44100;
     case Format_SR48_C1_I16:
     case Format_SR48_C2_I16:
+    case Format_SR48_C2_F32:
         return 48000;
     case Format_Invalid:
     default:
@@ -75,6 +83,8 @@ unsigned Format_channelCount(NBAIO_Format format)
         return 1;
     case Format_SR44_1_C2_I16:
     case Format_SR48_C2_I16:
+    case Format_SR44_1_C2_F32:
+    case Format_SR48_C2_F32:
         return 2;
     case Format_Invalid:
     default:
@@ -82,6 +92,17 @@ unsigned Format_channelCount(NBAIO_Format format)
     }
 }
 
+bool Format_isFloat(NBAIO_Format format)
+{
+    switch (format) {
+    case Format_SR44_1_C2_F32:
+    case Format_SR48_C2_F32:
+        return true;
+    default:
+        return false;
+    }
+}
+
 NBAIO_Format Format_from_SR_C(unsigned sampleRate, unsigned channelCount)
 {
     if (sampleRate == 44100 && channelCount == 2) return Format_SR44_1_C2_I16;
@@ -91,6 +112,13 @@ NBAIO_Format Format_from_SR_C(unsigned sampleRate, unsigned channelCount)
     return Format_Invalid;
 }
 
+NBAIO_Format Format_from_SR_C_Float(unsigned sampleRate, unsigned channelCount)
+{
+    if (sampleRate == 44100 && channelCount == 2) return Format_SR44_1_C2_F32;
+    if (sampleRate == 48000 && channelCount == 2) return Format_SR48_C2_F32;
+    return Format_Invalid;
+}
+
 // This is a default implementation; it is expected that subclasses will optimize this.
 ssize_t NBAIO_Sink::writeVia(writeVia_t via, size_t total, void *user, size_t block)
 {
@@ -29,8 +29,8 @@ Pipe::Pipe(size_t maxFrames, NBAIO_Format format) :
         NBAIO_Sink(format),
         mMaxFrames(roundup(maxFrames)),
         mBuffer(malloc(mMaxFrames * Format_frameSize(format))),
-        mRear(0),
-        mReaders(0)
+        mReaders(0),
+        mRear(0)
 {
 }
 
@@ -67,4 +67,9 @@ ssize_t Pipe::write(const void *buffer, size_t count)
     return written;
 }
 
+int32_t Pipe::readers() const
+{
+    return android_atomic_acquire_load(&mReaders);
+}
+
 }   // namespace android
@@ -17,6 +17,7 @@
 #define LOG_TAG "PipeReader"
 //#define LOG_NDEBUG 0
 
+#include <cutils/atomic.h>
 #include <cutils/compiler.h>
 #include <utils/Log.h>
 #include <media/nbaio/PipeReader.h>
@@ -26,10 +27,12 @@ namespace android {
 PipeReader::PipeReader(Pipe& pipe) :
         NBAIO_Source(pipe.mFormat),
         mPipe(pipe),
+        mOverrunCounted(false),
         // any data already in the pipe is not visible to this PipeReader
         mFront(android_atomic_acquire_load(&pipe.mRear)),
         mFramesOverrun(0),
-        mOverruns(0)
+        mOverruns(0),
+        mMaxLag(0)
 {
     android_atomic_inc(&pipe.mReaders);
 }
@@ -40,6 +43,29 @@ PipeReader::~PipeReader()
     ALOG_ASSERT(readers > 0);
 }
 
+size_t PipeReader::framesOverrun()
+{
+    return (size_t) android_atomic_acquire_load(&mFramesOverrun);
+}
+
+size_t PipeReader::overruns()
+{
+    return (size_t) android_atomic_acquire_load(&mOverruns);
+}
+
+size_t PipeReader::lag() const
+{
+    // May be called from a thread other than the reader (e.g. for dump), so load mFront first:
+    // mRear never falls behind an earlier mFront, whereas a stale mRear can be behind mFront.
+    int32_t front = android_atomic_acquire_load(&mFront);
+    return (size_t) (android_atomic_acquire_load(&mPipe.mRear) - front);
+}
+
+size_t PipeReader::maxLag() const
+{
+    return (size_t) android_atomic_acquire_load(&mMaxLag);
+}
+
 ssize_t PipeReader::availableToRead()
 {
     if (CC_UNLIKELY(!mNegotiated)) {
@@ -48,36 +74,64 @@ ssize_t PipeReader::availableToRead()
     int32_t rear = android_atomic_acquire_load(&mPipe.mRear);
     // read() is not multi-thread safe w.r.t. itself, so no mutex or atomic op needed to read mFront
     size_t avail = rear - mFront;
+    if (CC_UNLIKELY(avail > (size_t) mMaxLag)) {
+        android_atomic_release_store(avail, &mMaxLag);
+    }
     if (CC_UNLIKELY(avail > mPipe.mMaxFrames)) {
         // Discard 1/16 of the most recent data in pipe to avoid another overrun immediately
         int32_t oldFront = mFront;
-        mFront = rear - mPipe.mMaxFrames + (mPipe.mMaxFrames >> 4);
-        mFramesOverrun += (size_t) (mFront - oldFront);
-        ++mOverruns;
+        int32_t front = rear - mPipe.mMaxFrames + (mPipe.mMaxFrames >> 4);
+        android_atomic_release_store(front, &mFront);
+        android_atomic_release_store(mFramesOverrun + (front - oldFront), &mFramesOverrun);
+        if (!mOverrunCounted) {
+            android_atomic_release_store(mOverruns + 1, &mOverruns);
+        }
+        mOverrunCounted = false;
         return OVERRUN;
     }
+    mOverrunCounted = false;
     return avail;
 }
 
+void PipeReader::checkOverrun(int32_t oldFront)
+{
+    // The writer may have wrapped around onto the frames at oldFront while they were being
+    // consumed.  They have already been handed out, so just count how many could be corrupt.
+    int32_t rear = android_atomic_acquire_load(&mPipe.mRear);
+    size_t span = (size_t) (rear - oldFront);
+    if (CC_UNLIKELY(span > mPipe.mMaxFrames)) {
+        size_t overwritten = span - mPipe.mMaxFrames;
+        size_t consumed = mFront - oldFront;
+        if (overwritten > consumed) {
+            overwritten = consumed;
+        }
+        android_atomic_release_store(mFramesOverrun + overwritten, &mFramesOverrun);
+        if (!mOverrunCounted) {
+            android_atomic_release_store(mOverruns + 1, &mOverruns);
+            mOverrunCounted = true;
+        }
+    }
+}
+
 ssize_t PipeReader::read(void *buffer, size_t count, int64_t readPTS)
 {
     ssize_t avail = availableToRead();
     if (CC_UNLIKELY(avail <= 0)) {
         return avail;
     }
-    // An overrun can occur from here on and be silently ignored,
-    // but it will be caught at next read()
+    // An overrun can occur from here on, it is counted after the copy and reported as an
+    // OVERRUN by the next read()
     if (CC_LIKELY(count > (size_t) avail)) {
         count = avail;
     }
-    size_t front = mFront & (mPipe.mMaxFrames - 1);
+    int32_t oldFront = mFront;
+    size_t front = oldFront & (mPipe.mMaxFrames - 1);
     size_t red = mPipe.mMaxFrames - front;
     if (CC_LIKELY(red > count)) {
         red = count;
     }
     // In particular, an overrun during the memcpy will result in reading corrupt data
     memcpy(buffer, (char *) mPipe.mBuffer + (front << mBitShift), red << mBitShift);
-    // We could re-read the rear pointer here to detect the corruption, but why bother?
     if (CC_UNLIKELY(front + red == mPipe.mMaxFrames)) {
         if (CC_UNLIKELY((count -= red) > front)) {
             count = front;
@@ -87,9 +141,54 @@ ssize_t PipeReader::read(void *buffer, size_t count, int64_t readPTS)
             red += count;
         }
     }
-    mFront += red;
+    android_atomic_release_store(oldFront + red, &mFront);
+    checkOverrun(oldFront);
     mFramesRead += red;
     return red;
 }
 
+ssize_t PipeReader::readVia(readVia_t via, size_t total, void *user,
+                            int64_t readPTS, size_t block)
+{
+    ssize_t avail = availableToRead();
+    if (CC_UNLIKELY(avail <= 0)) {
+        return avail;
+    }
+    if (CC_LIKELY(total > (size_t) avail)) {
+        total = avail;
+    }
+    if (block == 0 || block > total) {
+        block = total;
+    }
+    int32_t oldFront = mFront;
+    size_t accumulator = 0;
+    while (accumulator < total) {
+        size_t front = mFront & (mPipe.mMaxFrames - 1);
+        size_t count = total - accumulator;
+        if (count > block) {
+            count = block;
+        }
+        // the callback sees the frames in place, so a piece cannot wrap around
+        if (count > mPipe.mMaxFrames - front) {
+            count = mPipe.mMaxFrames - front;
+        }
+        ssize_t ret = via(user, (char *) mPipe.mBuffer + (front << mBitShift), count, readPTS);
+        if (ret <= 0) {
+            if (accumulator == 0) {
+                return ret;
+            }
+            break;
+        }
+        ALOG_ASSERT((size_t) ret <= count);
+        android_atomic_release_store(mFront + ret, &mFront);
+        accumulator += ret;
+        if ((size_t) ret < count) {
+            break;
+        }
+    }
+    checkOverrun(oldFront);
+    mFramesRead += accumulator;
+    return accumulator;
+}
+
 }   // namespace android
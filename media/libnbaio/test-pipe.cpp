@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the throughput of a Pipe written by one thread and read with readVia() by 1 to 8
+// reader threads.  The writer never lets the slowest reader fall more than half a pipe behind,
+// so that the readers' lag(), maxLag() and overrun counters can be checked at the end.
+// Meanwhile a monitor thread polls every reader's lag(), as a dump would, and checks that it
+// never comes out negative.
+
+#include <cutils/atomic.h>
+#include <media/nbaio/Pipe.h>
+#include <media/nbaio/PipeReader.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace android;
+
+static int usage(const char* name) {
+    fprintf(stderr,"Usage: %s [-r readers] [-p pipe frames] [-b block frames] [-n frames]\n", name);
+    fprintf(stderr,"    -r    maximum number of readers, every count from 1 is run (default 8)\n");
+    fprintf(stderr,"    -p    pipe size in frames (default 4096)\n");
+    fprintf(stderr,"    -b    frames per write and per readVia() callback (default 256)\n");
+    fprintf(stderr,"    -n    frames written per run (default 10000000)\n");
+    return -1;
+}
+
+static int64_t systemTimeNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+struct Reader {
+    PipeReader* reader;
+    size_t      block;
+    size_t      total;          // frames to read before exiting
+    size_t      read;
+    uint32_t    checksum;
+    pthread_t   thread;
+};
+
+static ssize_t consume(void* user, const void* buffer, size_t count, int64_t readPTS) {
+    Reader* r = (Reader*) user;
+    const int16_t* in = (const int16_t*) buffer;
+    uint32_t sum = r->checksum;
+    for (size_t i = 0; i < count * 2; i++) {
+        sum += in[i];
+    }
+    r->checksum = sum;
+    return count;
+}
+
+static void* readerLoop(void* arg) {
+    Reader* r = (Reader*) arg;
+    while (r->read < r->total) {
+        ssize_t ret = r->reader->readVia(consume, r->total - r->read, r, 0 /*readPTS*/,
+                r->block);
+        if (ret > 0) {
+            r->read += ret;
+        } else {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+struct Monitor {
+    Reader*         readers;
+    int             numReaders;
+    volatile int32_t done;
+    size_t          samples;
+    size_t          bad;            // lag() values that were really negative
+    pthread_t       thread;
+};
+
+static void* monitorLoop(void* arg) {
+    Monitor* m = (Monitor*) arg;
+    while (!android_atomic_acquire_load(&m->done)) {
+        for (int i = 0; i < m->numReaders; i++) {
+            if ((ssize_t) m->readers[i].reader->lag() < 0) {
+                m->bad++;
+            }
+            m->samples++;
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char* argv[]) {
+
+    const char* const progname = argv[0];
+    int maxReaders = 8;
+    size_t pipeFrames = 4096;
+    size_t block = 256;
+    size_t total = 10000000;
+
+    int ch;
+    while ((ch = getopt(argc, argv, "r:p:b:n:")) != -1) {
+        switch (ch) {
+        case 'r':
+            maxReaders = atoi(optarg);
+            break;
+        case 'p':
+            pipeFrames = atoi(optarg);
+            break;
+        case 'b':
+            block = atoi(optarg);
+            break;
+        case 'n':
+            total = atoi(optarg);
+            break;
+        default:
+            usage(progname);
+            return -1;
+        }
+    }
+    if (maxReaders <= 0 || pipeFrames < 2 || block == 0 || block > pipeFrames / 2 || total == 0) {
+        usage(progname);
+        return -1;
+    }
+
+    const NBAIO_Format format = Format_SR48_C2_I16;
+    int16_t* source = new int16_t[block * 2];
+    for (size_t i = 0; i < block * 2; i++) {
+        source[i] = (int16_t) rand();
+    }
+    // each reader consumes the same frames, so each must end with the same checksum
+    uint32_t expected = 0;
+    for (size_t n = 0; n < total; n += block) {
+        size_t count = total - n < block ? total - n : block;
+        for (size_t i = 0; i < count * 2; i++) {
+            expected += source[i];
+        }
+    }
+
+    int failures = 0;
+    for (int numReaders = 1; numReaders <= maxReaders; numReaders++) {
+        Pipe* pipe = new Pipe(pipeFrames, format);
+        size_t numCounterOffers = 0;
+        const NBAIO_Format offers[1] = {format};
+        pipe->negotiate(offers, 1, NULL, numCounterOffers);
+
+        Reader* readers = new Reader[numReaders];
+        for (int i = 0; i < numReaders; i++) {
+            Reader& r = readers[i];
+            r.reader = new PipeReader(*pipe);
+            numCounterOffers = 0;
+            r.reader->negotiate(offers, 1, NULL, numCounterOffers);
+            r.block = block;
+            r.total = total;
+            r.read = 0;
+            r.checksum = 0;
+        }
+
+        Monitor monitor;
+        monitor.readers = readers;
+        monitor.numReaders = numReaders;
+        monitor.done = 0;
+        monitor.samples = 0;
+        monitor.bad = 0;
+
+        int64_t start = systemTimeNs();
+        for (int i = 0; i < numReaders; i++) {
+            pthread_create(&readers[i].thread, NULL, readerLoop, &readers[i]);
+        }
+        pthread_create(&monitor.thread, NULL, monitorLoop, &monitor);
+        const size_t maxLag = pipeFrames / 2;
+        size_t written = 0;
+        while (written < total) {
+            // flow control is the writer's job
+            bool wait = false;
+            for (int i = 0; i < numReaders; i++) {
+                if (readers[i].reader->lag() + block > maxLag) {
+                    wait = true;
+                    break;
+                }
+            }
+            if (wait) {
+                sched_yield();
+                continue;
+            }
+            size_t count = total - written < block ? total - written : block;
+            written += pipe->write(source, count);
+        }
+        for (int i = 0; i < numReaders; i++) {
+            pthread_join(readers[i].thread, NULL);
+        }
+        int64_t elapsedNs = systemTimeNs() - start;
+        android_atomic_release_store(1, &monitor.done);
+        pthread_join(monitor.thread, NULL);
+
+        size_t overruns = 0;
+        size_t worstLag = 0;
+        bool match = true;
+        for (int i = 0; i < numReaders; i++) {
+            Reader& r = readers[i];
+            overruns += r.reader->overruns();
+            if (r.reader->maxLag() > worstLag) {
+                worstLag = r.reader->maxLag();
+            }
+            if (r.checksum != expected || r.reader->lag() != 0) {
+                match = false;
+            }
+            delete r.reader;
+        }
+        if (monitor.bad != 0) {
+            match = false;
+        }
+        if (!match || overruns != 0) {
+            failures++;
+        }
+        printf("%d reader%s  %8.2f Mframes/s per reader  %8.2f Mframes/s total  "
+                "max lag %5u  overruns %u  bad lag %u/%u  %s\n",
+                numReaders, numReaders > 1 ? "s" : " ",
+                total * 1e3 / elapsedNs, total * numReaders * 1e3 / elapsedNs,
+                (unsigned) worstLag, (unsigned) overruns, (unsigned) monitor.bad,
+                (unsigned) monitor.samples, match ? "ok" : "MISMATCH");
+
+        delete[] readers;
+        delete pipe;
+    }
+
+    delete[] source;
+    return failures ? 1 : 0;
+}
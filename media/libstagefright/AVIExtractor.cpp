@@ -183,11 +183,18 @@ status_t AVIExtractor::AVISource::read(
         }
 
         MediaBuffer *out;
-        CHECK_EQ(mBufferGroup->acquire_buffer(&out), (status_t)OK);
+        err = mBufferGroup->acquire_buffer(&out, false /* nonBlocking */, size);
+
+        if (err != OK) {
+            return err;
+        }
 
         ssize_t n = mExtractor->mDataSource->readAt(offset, out->data(), size);
 
         if (n < (ssize_t)size) {
+            out->release();
+            out = NULL;
+
             return n < 0 ? (status_t)n : (status_t)ERROR_MALFORMED;
         }
 
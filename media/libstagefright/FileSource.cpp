@@ -24,6 +24,10 @@
 
 namespace android {
 
+// Once reads are found to be sequential, keep this much of the file ahead of
+// the reader on its way into the page cache.
+static const int64_t kReadaheadSize = 512 * 1024;
+
 FileSource::FileSource(const char *filename)
     : mFd(-1),
       mOffset(0),
@@ -32,7 +36,9 @@ FileSource::FileSource(const char *filename)
       mDrmManagerClient(NULL),
       mDrmBufOffset(0),
       mDrmBufSize(0),
-      mDrmBuf(NULL){
+      mDrmBuf(NULL),
+      mLastReadEnd(0),
+      mReadaheadEnd(0) {
 
     mFd = open(filename, O_LARGEFILE | O_RDONLY);
 
@@ -51,7 +57,9 @@ FileSource::FileSource(int fd, int64_t offset, int64_t length)
       mDrmManagerClient(NULL),
       mDrmBufOffset(0),
       mDrmBufSize(0),
-      mDrmBuf(NULL){
+      mDrmBuf(NULL),
+      mLastReadEnd(0),
+      mReadaheadEnd(0) {
     CHECK(offset >= 0);
     CHECK(length >= 0);
 }
@@ -84,13 +92,42 @@ status_t FileSource::initCheck() const {
     return mFd >= 0 ? OK : NO_INIT;
 }
 
+// Extractors issue many small reads; only the access pattern decides whether
+// the kernel should read ahead.  Reads that stay within the readahead window
+// of the previous one count as sequential and keep the window kReadaheadSize
+// ahead of the reader, anything else just moves the window.
+void FileSource::adviseAccess(off64_t offset, size_t size) {
+    if (mHintLock.tryLock() != OK) {
+        return;     // someone else is advising, no need to wait
+    }
+
+    off64_t end = offset + size;
+    bool sequential =
+        offset >= mLastReadEnd - kReadaheadSize && offset <= mReadaheadEnd;
+    mLastReadEnd = end;
+
+    if (!sequential) {
+        mReadaheadEnd = end;
+    } else if (end + kReadaheadSize / 2 > mReadaheadEnd && mReadaheadEnd < mLength) {
+        off64_t start = mReadaheadEnd > end ? mReadaheadEnd : end;
+        mReadaheadEnd = end + kReadaheadSize;
+        if (mReadaheadEnd > mLength) {
+            mReadaheadEnd = mLength;
+        }
+
+#ifdef POSIX_FADV_WILLNEED
+        posix_fadvise(mFd, mOffset + start, mReadaheadEnd - start, POSIX_FADV_WILLNEED);
+#endif
+    }
+
+    mHintLock.unlock();
+}
+
 ssize_t FileSource::readAt(off64_t offset, void *data, size_t size) {
     if (mFd < 0) {
         return NO_INIT;
     }
 
-    Mutex::Autolock autoLock(mLock);
-
     if (mLength >= 0) {
         if (offset >= mLength) {
             return 0;  // read beyond EOF.
@@ -103,16 +140,13 @@ ssize_t FileSource::readAt(off64_t offset, void *data, size_t size) {
 
     if (mDecryptHandle != NULL && DecryptApiType::CONTAINER_BASED
             == mDecryptHandle->decryptApiType) {
+        Mutex::Autolock autoLock(mLock);
         return readAtDRM(offset, data, size);
-   } else {
-        off64_t result = lseek64(mFd, offset + mOffset, SEEK_SET);
-        if (result == -1) {
-            ALOGE("seek to %lld failed", offset + mOffset);
-            return UNKNOWN_ERROR;
-        }
-
-        return ::read(mFd, data, size);
     }
+
+    adviseAccess(offset, size);
+
+    return pread64(mFd, data, size, offset + mOffset);
 }
 
 status_t FileSource::getSize(off64_t *size) {
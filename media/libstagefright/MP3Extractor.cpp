@@ -27,6 +27,7 @@
 
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/bytescan.h>
 #include <media/stagefright/DataSource.h>
 #include <media/stagefright/MediaBuffer.h>
 #include <media/stagefright/MediaBufferGroup.h>
@@ -135,6 +136,19 @@ static bool Resync(
             }
         }
 
+        // Skip to the next byte that may begin a frame sync, keeping the
+        // last 3 bytes around if there is none in the buffered data.
+        size_t skip = findSyncWord(tmp, remainingBytes, 0xe0);
+        if (skip + 4 > (size_t)remainingBytes) {
+            skip = remainingBytes - 3;
+        }
+        if (skip > 0) {
+            pos += skip;
+            tmp += skip;
+            remainingBytes -= skip;
+            continue;
+        }
+
         uint32_t header = U32_AT(tmp);
 
         if (match_header != 0 && (header & kMask) != (match_header & kMask)) {
@@ -108,6 +108,8 @@ struct MPEG4DataSource : public DataSource {
     virtual ssize_t readAt(off64_t offset, void *data, size_t size);
     virtual status_t getSize(off64_t *size);
     virtual uint32_t flags();
+    virtual void hintRange(off64_t offset, size_t size, bool pin);
+    virtual void releaseRange(off64_t offset, size_t size);
 
     status_t setCachedRange(off64_t offset, size_t size);
 
@@ -173,6 +175,14 @@ uint32_t MPEG4DataSource::flags() {
     return mSource->flags();
 }
 
+void MPEG4DataSource::hintRange(off64_t offset, size_t size, bool pin) {
+    mSource->hintRange(offset, size, pin);
+}
+
+void MPEG4DataSource::releaseRange(off64_t offset, size_t size) {
+    mSource->releaseRange(offset, size);
+}
+
 status_t MPEG4DataSource::setCachedRange(off64_t offset, size_t size) {
     Mutex::Autolock autoLock(mLock);
 
@@ -297,7 +307,8 @@ MPEG4Extractor::MPEG4Extractor(const sp<DataSource> &source)
       mLastTrack(NULL),
       mFileMetaData(new MetaData),
       mFirstSINF(NULL),
-      mIsDrm(false) {
+      mIsDrm(false),
+      mFirstMdatOffset(-1) {
 }
 
 MPEG4Extractor::~MPEG4Extractor() {
@@ -318,6 +329,11 @@ MPEG4Extractor::~MPEG4Extractor() {
         sinf = next;
     }
     mFirstSINF = NULL;
+
+    for (size_t i = 0; i < mPinnedRanges.size(); ++i) {
+        mDataSource->releaseRange(
+                mPinnedRanges[i].mOffset, mPinnedRanges[i].mSize);
+    }
 }
 
 sp<MetaData> MPEG4Extractor::getMetaData() {
@@ -724,6 +740,15 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
 
                     if (cachedSource->setCachedRange(*offset, chunk_size) == OK) {
                         mDataSource = cachedSource;
+                    } else {
+                        // Read again on seeks; ask the caching source to
+                        // hold on to it instead.
+                        PinnedRange range;
+                        range.mOffset = *offset;
+                        range.mSize = chunk_size;
+                        mPinnedRanges.push(range);
+                        mDataSource->hintRange(
+                                range.mOffset, range.mSize, true /* pin */);
                     }
                 }
 
@@ -795,6 +820,14 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
             } else if (chunk_type == FOURCC('m', 'o', 'o', 'v')) {
                 mInitCheck = OK;
 
+                // With the movie header last, playback starts back at the
+                // media data; get a caching source going there now.
+                off64_t moovOffset = stop_offset - chunk_size;
+                if (mFirstMdatOffset >= 0 && mFirstMdatOffset < moovOffset) {
+                    mDataSource->hintRange(
+                            mFirstMdatOffset, kMediaDataHintSize, false /* pin */);
+                }
+
                 if (!mIsDrm) {
                     return UNKNOWN_ERROR;  // Return a dummy error.
                 } else {
@@ -1447,6 +1480,9 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
         case FOURCC('m', 'd', 'a', 't'):
         {
             if (!mIsDrm) {
+                if (mFirstMdatOffset < 0) {
+                    mFirstMdatOffset = data_offset;
+                }
                 *offset += chunk_size;
                 break;
             }
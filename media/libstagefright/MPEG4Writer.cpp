@@ -20,8 +20,10 @@
 
 #include <arpa/inet.h>
 
+#include <errno.h>
 #include <pthread.h>
 #include <sys/prctl.h>
+#include <sys/uio.h>
 
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/MPEG4Writer.h>
@@ -67,6 +69,7 @@ public:
     int64_t getEstimatedTrackSizeBytes() const;
     void writeTrackHeader(bool use32BitOffset = true);
     void bufferChunk(int64_t timestampUs);
+    void bufferFragment();
     bool isAvc() const { return mIsAvc; }
     bool isAudio() const { return mIsAudio; }
     bool isMPEG4() const { return mIsMPEG4; }
@@ -80,7 +83,10 @@ private:
         kSampleArraySize = 1000,
     };
 
-    // A helper class to handle faster write box with table entries
+    // A helper class to handle faster write box with table entries.
+    // The values are kept in fixed-size arrays, each holding
+    // elementCapacity entries, so that any of them is found in constant
+    // time and each array goes out with a single write.
     template<class TYPE>
     struct ListTableEntries {
         ListTableEntries(uint32_t elementCapacity, uint32_t entryCapacity)
@@ -95,10 +101,8 @@ private:
 
         // Free the allocated memory.
         ~ListTableEntries() {
-            while (!mTableEntryList.empty()) {
-                typename List<TYPE *>::iterator it = mTableEntryList.begin();
-                delete[] (*it);
-                mTableEntryList.erase(it);
+            for (size_t i = 0; i < mTableEntryList.size(); ++i) {
+                delete[] mTableEntryList[i];
             }
         }
 
@@ -109,16 +113,10 @@ private:
         void set(const TYPE& value, uint32_t pos) {
             CHECK_LT(pos, mTotalNumTableEntries * mEntryCapacity);
 
-            typename List<TYPE *>::iterator it = mTableEntryList.begin();
-            uint32_t iterations = (pos / (mElementCapacity * mEntryCapacity));
-            while (it != mTableEntryList.end() && iterations > 0) {
-                ++it;
-                --iterations;
-            }
-            CHECK(it != mTableEntryList.end());
-            CHECK_EQ(iterations, 0);
+            uint32_t element = pos / (mElementCapacity * mEntryCapacity);
+            CHECK_LT(element, mTableEntryList.size());
 
-            (*it)[(pos % (mElementCapacity * mEntryCapacity))] = value;
+            mTableEntryList[element][pos % (mElementCapacity * mEntryCapacity)] = value;
         }
 
         // Get the value at the given position by the given value.
@@ -130,16 +128,10 @@ private:
                 return false;
             }
 
-            typename List<TYPE *>::iterator it = mTableEntryList.begin();
-            uint32_t iterations = (pos / (mElementCapacity * mEntryCapacity));
-            while (it != mTableEntryList.end() && iterations > 0) {
-                ++it;
-                --iterations;
-            }
-            CHECK(it != mTableEntryList.end());
-            CHECK_EQ(iterations, 0);
+            uint32_t element = pos / (mElementCapacity * mEntryCapacity);
+            CHECK_LT(element, mTableEntryList.size());
 
-            value = (*it)[(pos % (mElementCapacity * mEntryCapacity))];
+            value = mTableEntryList[element][pos % (mElementCapacity * mEntryCapacity)];
             return true;
         }
 
@@ -173,14 +165,14 @@ private:
             CHECK_EQ(mNumValuesInCurrEntry % mEntryCapacity, 0);
             uint32_t nEntries = mTotalNumTableEntries;
             writer->writeInt32(nEntries);
-            for (typename List<TYPE *>::iterator it = mTableEntryList.begin();
-                it != mTableEntryList.end(); ++it) {
+            for (size_t i = 0; i < mTableEntryList.size(); ++i) {
                 CHECK_GT(nEntries, 0);
                 if (nEntries >= mElementCapacity) {
-                    writer->write(*it, sizeof(TYPE) * mEntryCapacity, mElementCapacity);
+                    writer->write(mTableEntryList[i],
+                            sizeof(TYPE) * mEntryCapacity, mElementCapacity);
                     nEntries -= mElementCapacity;
                 } else {
-                    writer->write(*it, sizeof(TYPE) * mEntryCapacity, nEntries);
+                    writer->write(mTableEntryList[i], sizeof(TYPE) * mEntryCapacity, nEntries);
                     break;
                 }
             }
@@ -195,7 +187,7 @@ private:
         uint32_t         mTotalNumTableEntries;
         uint32_t         mNumValuesInCurrEntry;  // up to mEntryCapacity
         TYPE             *mCurrTableEntriesElement;
-        mutable List<TYPE *>     mTableEntryList;
+        Vector<TYPE *>   mTableEntryList;   // One array per element
 
         DISALLOW_EVIL_CONSTRUCTORS(ListTableEntries);
     };
@@ -226,6 +218,14 @@ private:
 
     List<MediaBuffer *> mChunkSamples;
 
+    // Fragmented file only: samples of the movie fragment being collected
+    List<FragmentSample> mFragmentSamples;
+    int64_t mFragmentStartTimeUs;
+    int64_t mFragmentDecodeTimeTicks;
+    int64_t mStartTimeOffsetTicks;
+
+    uint32_t            mNumSamples;
+    uint32_t            mNumSyncSamples;
     bool                mSamplesHaveSameSize;
     ListTableEntries<uint32_t> *mStszTableEntries;
 
@@ -307,6 +307,12 @@ private:
     bool isTrackMalFormed() const;
     void sendTrackSummary(bool hasMultipleTracks);
 
+    // Fragmented file only
+    status_t addFragmentSample(
+            MediaBuffer *buffer, size_t sampleSize, int64_t timestampUs,
+            int64_t durationTicks, int64_t compositionOffsetTicks, bool isSync);
+    void bufferLastFragment(int64_t lastDurationTicks);
+
     // Write the boxes
     void writeStcoBox(bool use32BitOffset);
     void writeStscBox();
@@ -331,11 +337,254 @@ private:
     void writeAudioFourCCBox();
     void writeVideoFourCCBox();
     void writeStblBox(bool use32BitOffset);
+    void writeEmptySampleTables();
 
     Track(const Track &);
     Track &operator=(const Track &);
 };
 
+// Writes the media data out on its own thread, so that neither the
+// writer thread nor a single track thread waits on the storage. Whatever
+// has been queued while the previous batch was being written goes out
+// next, gathered into as few writev() calls as possible; the media
+// buffers are released once their data is on file. If the thread cannot
+// be started, the data is written directly by add() instead.
+class MPEG4Writer::WriteBehind {
+public:
+    WriteBehind(int fd);
+
+    // Writes out everything queued before returning.
+    ~WriteBehind();
+
+    // Queue size bytes of data. Up to kMaxInlineSize bytes are copied;
+    // longer data must stay valid until written, and the given buffer,
+    // if any, is released then. Blocks while too much is queued.
+    void add(const void *data, size_t size, MediaBuffer *buffer = NULL);
+
+    // Wait until everything queued so far is written.
+    void flush();
+
+    uint32_t numWriteCalls();
+    int64_t numBytesWritten();
+
+private:
+    enum {
+        kMaxInlineSize = 4,                     // Nal length prefixes
+        kMaxIovecs = 1024,                      // UIO_MAXIOV
+        kMaxQueuedBytes = 8 * 1024 * 1024,
+    };
+
+    struct Segment {
+        const uint8_t *mData;   // NULL if held in mInline
+        size_t mSize;
+        MediaBuffer *mBuffer;
+        uint8_t mInline[kMaxInlineSize];
+    };
+
+    int mFd;
+    Mutex mLock;
+    Condition mQueueCondition;      // Signal that data has been queued
+    Condition mWrittenCondition;    // Signal that the queue has been taken over
+                                    // or a batch has been written
+    Vector<Segment> mQueue;
+    size_t mQueuedBytes;
+    bool mWriting;
+    bool mDone;
+    bool mThreadStarted;
+    pthread_t mThread;
+
+    // Guarded by mLock
+    uint32_t mNumWriteCalls;
+    int64_t mNumBytesWritten;
+    struct iovec mIovecs[kMaxIovecs];
+
+    static void *ThreadWrapper(void *me);
+    void threadFunc();
+    void writeBatch(const Vector<Segment> &batch);
+    void writeIovecs(struct iovec *iov, size_t count);
+
+    WriteBehind(const WriteBehind &);
+    WriteBehind &operator=(const WriteBehind &);
+};
+
+MPEG4Writer::WriteBehind::WriteBehind(int fd)
+    : mFd(fd),
+      mQueuedBytes(0),
+      mWriting(false),
+      mDone(false),
+      mThreadStarted(false),
+      mNumWriteCalls(0),
+      mNumBytesWritten(0) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+    int err = pthread_create(&mThread, &attr, ThreadWrapper, this);
+    pthread_attr_destroy(&attr);
+    if (err != 0) {
+        ALOGW("Failed to start write-behind thread (%d), writing directly", err);
+        return;
+    }
+    mThreadStarted = true;
+}
+
+MPEG4Writer::WriteBehind::~WriteBehind() {
+    if (!mThreadStarted) {
+        return;
+    }
+
+    {
+        Mutex::Autolock autoLock(mLock);
+        mDone = true;
+        mQueueCondition.signal();
+    }
+
+    void *dummy;
+    pthread_join(mThread, &dummy);
+    CHECK(mQueue.empty());
+}
+
+void MPEG4Writer::WriteBehind::add(
+        const void *data, size_t size, MediaBuffer *buffer) {
+    Segment segment;
+    if (size <= kMaxInlineSize) {
+        memcpy(segment.mInline, data, size);
+        segment.mData = NULL;
+    } else {
+        segment.mData = (const uint8_t *)data;
+    }
+    segment.mSize = size;
+    segment.mBuffer = buffer;
+
+    if (!mThreadStarted) {
+        struct iovec iov;
+        iov.iov_base = (void *)(segment.mData != NULL
+                ? segment.mData : segment.mInline);
+        iov.iov_len = size;
+        writeIovecs(&iov, 1);
+        if (buffer != NULL) {
+            buffer->release();
+        }
+        return;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+    while (mQueuedBytes >= kMaxQueuedBytes) {
+        mWrittenCondition.wait(mLock);
+    }
+    mQueue.push(segment);
+    mQueuedBytes += size;
+    if (!mWriting) {
+        mQueueCondition.signal();
+    }
+}
+
+void MPEG4Writer::WriteBehind::flush() {
+    Mutex::Autolock autoLock(mLock);
+    while (mWriting || !mQueue.empty()) {
+        mWrittenCondition.wait(mLock);
+    }
+}
+
+uint32_t MPEG4Writer::WriteBehind::numWriteCalls() {
+    Mutex::Autolock autoLock(mLock);
+    return mNumWriteCalls;
+}
+
+int64_t MPEG4Writer::WriteBehind::numBytesWritten() {
+    Mutex::Autolock autoLock(mLock);
+    return mNumBytesWritten;
+}
+
+// static
+void *MPEG4Writer::WriteBehind::ThreadWrapper(void *me) {
+    static_cast<WriteBehind *>(me)->threadFunc();
+    return NULL;
+}
+
+void MPEG4Writer::WriteBehind::threadFunc() {
+    prctl(PR_SET_NAME, (unsigned long)"MPEG4WriteBehind", 0, 0, 0);
+
+    Mutex::Autolock autoLock(mLock);
+    for (;;) {
+        while (!mDone && mQueue.empty()) {
+            mQueueCondition.wait(mLock);
+        }
+        if (mQueue.empty()) {
+            break;
+        }
+
+        // Double buffering: the producers go on queueing while this batch
+        // is being written.
+        Vector<Segment> batch = mQueue;
+        mQueue.clear();
+        mQueuedBytes = 0;
+        mWriting = true;
+        mWrittenCondition.broadcast();
+
+        mLock.unlock();
+        writeBatch(batch);
+        mLock.lock();
+
+        mWriting = false;
+        mWrittenCondition.broadcast();
+    }
+}
+
+void MPEG4Writer::WriteBehind::writeBatch(const Vector<Segment> &batch) {
+    size_t count = 0;
+    for (size_t i = 0; i < batch.size(); ++i) {
+        const Segment &segment = batch[i];
+        mIovecs[count].iov_base = (void *)(segment.mData != NULL
+                ? segment.mData : segment.mInline);
+        mIovecs[count].iov_len = segment.mSize;
+        if (++count == kMaxIovecs) {
+            writeIovecs(mIovecs, count);
+            count = 0;
+        }
+    }
+    if (count > 0) {
+        writeIovecs(mIovecs, count);
+    }
+
+    for (size_t i = 0; i < batch.size(); ++i) {
+        if (batch[i].mBuffer != NULL) {
+            batch[i].mBuffer->release();
+        }
+    }
+}
+
+void MPEG4Writer::WriteBehind::writeIovecs(struct iovec *iov, size_t count) {
+    while (count > 0) {
+        ssize_t n = ::writev(mFd, iov, count);
+        int writeErrno = errno;
+        {
+            Mutex::Autolock autoLock(mLock);
+            ++mNumWriteCalls;
+            if (n > 0) {
+                mNumBytesWritten += n;
+            }
+        }
+        if (n < 0) {
+            if (writeErrno == EINTR) {
+                continue;
+            }
+            ALOGE("Failed to write media data: %s", strerror(writeErrno));
+            return;
+        }
+
+        // Skip over what has been written, and resume a partial write.
+        while (count > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if (count > 0) {
+            iov->iov_base = (uint8_t *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+}
+
 MPEG4Writer::MPEG4Writer(const char *filename)
     : mFd(-1),
       mInitCheck(NO_INIT),
@@ -352,7 +601,13 @@ MPEG4Writer::MPEG4Writer(const char *filename)
       mLatitudex10000(0),
       mLongitudex10000(0),
       mAreGeoTagsAvailable(false),
-      mStartTimeOffsetMs(-1) {
+      mStartTimeOffsetMs(-1),
+      mFragmentDurationUs(0),
+      mFragmentSequenceNumber(0),
+      mMoovBoxWritten(false),
+      mWriteBehind(NULL),
+      mNumWriteCalls(0),
+      mNumBytesWritten(0) {
 
     mFd = open(filename, O_CREAT | O_LARGEFILE | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR);
     if (mFd >= 0) {
@@ -376,7 +631,13 @@ MPEG4Writer::MPEG4Writer(int fd)
       mLatitudex10000(0),
       mLongitudex10000(0),
       mAreGeoTagsAvailable(false),
-      mStartTimeOffsetMs(-1) {
+      mStartTimeOffsetMs(-1),
+      mFragmentDurationUs(0),
+      mFragmentSequenceNumber(0),
+      mMoovBoxWritten(false),
+      mWriteBehind(NULL),
+      mNumWriteCalls(0),
+      mNumBytesWritten(0) {
 }
 
 MPEG4Writer::~MPEG4Writer() {
@@ -400,6 +661,12 @@ status_t MPEG4Writer::dump(
     result.append(buffer);
     snprintf(buffer, SIZE, "     mStarted: %s\n", mStarted? "true": "false");
     result.append(buffer);
+    uint32_t numWriteCalls;
+    int64_t numBytesWritten;
+    getWriteStats(&numWriteCalls, &numBytesWritten);
+    snprintf(buffer, SIZE, "     write calls: %u (%lld bytes)\n",
+            numWriteCalls, numBytesWritten);
+    result.append(buffer);
     ::write(fd, result.string(), result.size());
     for (List<Track *>::iterator it = mTracks.begin();
          it != mTracks.end(); ++it) {
@@ -418,7 +685,7 @@ status_t MPEG4Writer::Track::dump(
     snprintf(buffer, SIZE, "       reached EOS: %s\n",
             mReachedEOS? "true": "false");
     result.append(buffer);
-    snprintf(buffer, SIZE, "       frames encoded : %d\n", mStszTableEntries->count());
+    snprintf(buffer, SIZE, "       frames encoded : %d\n", mNumSamples);
     result.append(buffer);
     snprintf(buffer, SIZE, "       duration encoded : %lld us\n", mTrackDurationUs);
     result.append(buffer);
@@ -582,7 +849,8 @@ status_t MPEG4Writer::start(MetaData *param) {
      * to make the file streamable.
      */
     mStreamableFile =
-        (mMaxFileSizeLimitBytes != 0 &&
+        (!isFragmented() &&
+         mMaxFileSizeLimitBytes != 0 &&
          mMaxFileSizeLimitBytes >= kMinStreamableFileSizeInBytes);
 
     mWriteMoovBoxToMemory = mStreamableFile;
@@ -613,7 +881,12 @@ status_t MPEG4Writer::start(MetaData *param) {
 
     mOffset = mMdatOffset;
     lseek64(mFd, mMdatOffset, SEEK_SET);
-    if (mUse32BitOffset) {
+    if (isFragmented()) {
+        // The movie header is written by the writer thread right before
+        // the first fragment, when the codec specific data is known.
+        mMoovBoxWritten = false;
+        mFragmentSequenceNumber = 0;
+    } else if (mUse32BitOffset) {
         write("????mdat", 8);
     } else {
         write("\x00\x00\x00\x01mdat????????", 16);
@@ -668,6 +941,17 @@ void MPEG4Writer::stopWriterThread() {
 
     void *dummy;
     pthread_join(mThread, &dummy);
+
+    // The file is written directly from here on.
+    mWriteBehind->flush();
+    {
+        Mutex::Autolock autolock(mLock);
+        Mutex::Autolock statsLock(mWriteStatsLock);
+        mNumWriteCalls += mWriteBehind->numWriteCalls();
+        mNumBytesWritten += mWriteBehind->numBytesWritten();
+        delete mWriteBehind;
+        mWriteBehind = NULL;
+    }
     mWriterThreadStarted = false;
     ALOGD("Writer thread stopped");
 }
@@ -777,6 +1061,16 @@ status_t MPEG4Writer::reset() {
         return err;
     }
 
+    // Each fragment is complete once written; there is nothing to fix up.
+    if (isFragmented()) {
+        if (!mMoovBoxWritten) {
+            ALOGW("No movie fragment was written");
+        }
+        CHECK(mBoxes.empty());
+        release();
+        return err;
+    }
+
     // Fix up the size of the 'mdat' chunk.
     if (mUse32BitOffset) {
         lseek64(mFd, mMdatOffset, SEEK_SET);
@@ -870,9 +1164,28 @@ void MPEG4Writer::writeMoovBox(int64_t durationUs) {
         it != mTracks.end(); ++it, ++id) {
         (*it)->writeTrackHeader(mUse32BitOffset);
     }
+    if (isFragmented()) {
+        writeMvexBox();
+    }
     endBox();  // moov
 }
 
+void MPEG4Writer::writeMvexBox() {
+    beginBox("mvex");
+    for (List<Track *>::iterator it = mTracks.begin();
+        it != mTracks.end(); ++it) {
+        beginBox("trex");
+        writeInt32(0);                    // version=0, flags=0
+        writeInt32((*it)->getTrackId());  // track id
+        writeInt32(1);                    // default sample description index
+        writeInt32(0);                    // default sample duration
+        writeInt32(0);                    // default sample size
+        writeInt32(0);                    // default sample flags
+        endBox();  // trex
+    }
+    endBox();  // mvex
+}
+
 void MPEG4Writer::writeFtypBox(MetaData *param) {
     beginBox("ftyp");
 
@@ -887,6 +1200,9 @@ void MPEG4Writer::writeFtypBox(MetaData *param) {
     writeInt32(0);
     writeFourcc("isom");
     writeFourcc("3gp4");
+    if (isFragmented()) {
+        writeFourcc("iso6");  // movie fragments with 'tfdt'
+    }
     endBox();
 }
 
@@ -925,6 +1241,31 @@ status_t MPEG4Writer::setInterleaveDuration(uint32_t durationUs) {
     return OK;
 }
 
+status_t MPEG4Writer::setFragmentDuration(int64_t durationUs) {
+    if (mStarted) {
+        ALOGE("Attempt to change the fragment duration AFTER recording is started");
+        return INVALID_OPERATION;
+    }
+    if (durationUs < 0) {
+        return BAD_VALUE;
+    }
+    mFragmentDurationUs = durationUs;
+    return OK;
+}
+
+void MPEG4Writer::getWriteStats(uint32_t *numWriteCalls, int64_t *numBytesWritten) {
+    Mutex::Autolock autolock(mLock);
+    {
+        Mutex::Autolock statsLock(mWriteStatsLock);
+        *numWriteCalls = mNumWriteCalls;
+        *numBytesWritten = mNumBytesWritten;
+    }
+    if (mWriteBehind != NULL) {
+        *numWriteCalls += mWriteBehind->numWriteCalls();
+        *numBytesWritten += mWriteBehind->numBytesWritten();
+    }
+}
+
 void MPEG4Writer::lock() {
     mLock.lock();
 }
@@ -936,11 +1277,12 @@ void MPEG4Writer::unlock() {
 off64_t MPEG4Writer::addSample_l(MediaBuffer *buffer) {
     off64_t old_offset = mOffset;
 
-    ::write(mFd,
-          (const uint8_t *)buffer->data() + buffer->range_offset(),
-          buffer->range_length());
+    size_t length = buffer->range_length();
+    mOffset += length;
 
-    mOffset += buffer->range_length();
+    mWriteBehind->add(
+          (const uint8_t *)buffer->data() + buffer->range_offset(),
+          length, buffer);
 
     return old_offset;
 }
@@ -964,31 +1306,25 @@ off64_t MPEG4Writer::addLengthPrefixedSample_l(MediaBuffer *buffer) {
 
     size_t length = buffer->range_length();
 
+    uint8_t prefix[4];
     if (mUse4ByteNalLength) {
-        uint8_t x = length >> 24;
-        ::write(mFd, &x, 1);
-        x = (length >> 16) & 0xff;
-        ::write(mFd, &x, 1);
-        x = (length >> 8) & 0xff;
-        ::write(mFd, &x, 1);
-        x = length & 0xff;
-        ::write(mFd, &x, 1);
-
-        ::write(mFd,
-              (const uint8_t *)buffer->data() + buffer->range_offset(),
-              length);
-
+        prefix[0] = length >> 24;
+        prefix[1] = (length >> 16) & 0xff;
+        prefix[2] = (length >> 8) & 0xff;
+        prefix[3] = length & 0xff;
+        mWriteBehind->add(prefix, 4);
         mOffset += length + 4;
     } else {
         CHECK_LT(length, 65536);
 
-        uint8_t x = length >> 8;
-        ::write(mFd, &x, 1);
-        x = length & 0xff;
-        ::write(mFd, &x, 1);
-        ::write(mFd, (const uint8_t *)buffer->data() + buffer->range_offset(), length);
+        prefix[0] = length >> 8;
+        prefix[1] = length & 0xff;
+        mWriteBehind->add(prefix, 2);
         mOffset += length + 2;
     }
+    mWriteBehind->add(
+            (const uint8_t *)buffer->data() + buffer->range_offset(),
+            length, buffer);
 
     return old_offset;
 }
@@ -1021,6 +1357,12 @@ size_t MPEG4Writer::write(
         }
     } else {
         ::write(mFd, ptr, size * nmemb);
+        {
+            // Called both with and without mLock held
+            Mutex::Autolock statsLock(mWriteStatsLock);
+            ++mNumWriteCalls;
+            mNumBytesWritten += bytes;
+        }
         mOffset += bytes;
     }
     return bytes;
@@ -1245,6 +1587,11 @@ MPEG4Writer::Track::Track(
       mTrackId(trackId),
       mTrackDurationUs(0),
       mEstimatedTrackSizeBytes(0),
+      mFragmentStartTimeUs(0),
+      mFragmentDecodeTimeTicks(0),
+      mStartTimeOffsetTicks(-1),
+      mNumSamples(0),
+      mNumSyncSamples(0),
       mSamplesHaveSameSize(true),
       mStszTableEntries(new ListTableEntries<uint32_t>(1000, 1)),
       mStcoTableEntries(new ListTableEntries<uint32_t>(1000, 1)),
@@ -1279,7 +1626,10 @@ void MPEG4Writer::Track::updateTrackSizeEstimate() {
     int64_t stszBoxSizeBytes = mSamplesHaveSameSize? 4: (mStszTableEntries->count() * 4);
 
     mEstimatedTrackSizeBytes = mMdatSizeBytes;  // media data size
-    if (!mOwner->isFileStreamable()) {
+    if (mOwner->isFragmented()) {
+        // Sample duration, size, flags and composition offset in 'trun'
+        mEstimatedTrackSizeBytes += mNumSamples * 16;
+    } else if (!mOwner->isFileStreamable()) {
         // Reserved free space is not large enough to hold
         // all meta data and thus wasted.
         mEstimatedTrackSizeBytes += mStscTableEntries->count() * 12 +  // stsc box size
@@ -1316,7 +1666,8 @@ void MPEG4Writer::Track::addOneSttsTableEntry(
 void MPEG4Writer::Track::addOneCttsTableEntry(
         size_t sampleCount, int32_t duration) {
 
-    if (mIsAudio) {
+    // Movie fragments carry the composition offsets themselves
+    if (mIsAudio || mOwner->isFragmented()) {
         return;
     }
     mCttsTableEntries->add(htonl(sampleCount));
@@ -1443,6 +1794,7 @@ void MPEG4Writer::bufferChunk(const Chunk& chunk) {
 
         if (chunk.mTrack == it->mTrack) {  // Found owner
             it->mChunks.push_back(chunk);
+            it->mGotFirstChunk = true;
             mChunkReadyCondition.signal();
             return;
         }
@@ -1451,10 +1803,15 @@ void MPEG4Writer::bufferChunk(const Chunk& chunk) {
     CHECK(!"Received a chunk for a unknown track");
 }
 
-void MPEG4Writer::writeChunkToFile(Chunk* chunk) {
+void MPEG4Writer::writeChunkToFile(Chunk* chunk, bool allTracksGotFirstChunk) {
     ALOGV("writeChunkToFile: %lld from %s track",
         chunk->mTimeStampUs, chunk->mTrack->isAudio()? "audio": "video");
 
+    if (isFragmented()) {
+        writeMovieFragment(chunk, allTracksGotFirstChunk);
+        return;
+    }
+
     int32_t isFirstSample = true;
     while (!chunk->mSamples.empty()) {
         List<MediaBuffer *>::iterator it = chunk->mSamples.begin();
@@ -1468,19 +1825,137 @@ void MPEG4Writer::writeChunkToFile(Chunk* chunk) {
             isFirstSample = false;
         }
 
-        (*it)->release();
         (*it) = NULL;
         chunk->mSamples.erase(it);
     }
     chunk->mSamples.clear();
 }
 
+void MPEG4Writer::writeMovieFragment(Chunk* chunk, bool allTracksGotFirstChunk) {
+    // The boxes are written directly and patched up in place, after the
+    // samples of the previous fragment.
+    mWriteBehind->flush();
+
+    if (!mMoovBoxWritten) {
+        // Only when stopping: a track without any sample has no codec
+        // specific data, and the file is not going to be playable anyway.
+        if (!allTracksGotFirstChunk) {
+            ALOGW("Drop a fragment of the %s track without movie header",
+                    chunk->mTrack->isAudio()? "audio": "video");
+            while (!chunk->mSamples.empty()) {
+                List<MediaBuffer *>::iterator it = chunk->mSamples.begin();
+                (*it)->release();
+                chunk->mSamples.erase(it);
+            }
+            return;
+        }
+        writeMoovBox(0);
+        mMoovBoxWritten = true;
+    }
+
+    const List<FragmentSample> &samples = chunk->mFragmentSamples;
+    const size_t nSamples = samples.size();
+    CHECK_EQ(nSamples, chunk->mSamples.size());
+
+    enum {
+        kTrunDataOffsetPresent                  = 0x01,
+        kTrunSampleDurationPresent              = 0x100,
+        kTrunSampleSizePresent                  = 0x200,
+        kTrunSampleFlagsPresent                 = 0x400,
+        kTrunSampleCompositionTimeOffsetPresent = 0x800,
+    };
+    static const uint32_t kSyncSampleFlags = 0x02000000;     // depends on no other
+    static const uint32_t kNonSyncSampleFlags = 0x01010000;  // depends on others, non-sync
+
+    uint32_t trunFlags = kTrunDataOffsetPresent | kTrunSampleDurationPresent
+            | kTrunSampleSizePresent | kTrunSampleFlagsPresent;
+    size_t valuesPerSample = 3;
+    uint32_t mdatSize = 8;
+    for (List<FragmentSample>::const_iterator it = samples.begin();
+         it != samples.end(); ++it) {
+        mdatSize += it->mSize;
+        if (it->mCompositionOffsetTicks != 0) {
+            trunFlags |= kTrunSampleCompositionTimeOffsetPresent;
+            valuesPerSample = 4;
+        }
+    }
+
+    // Build the 'trun' table up front so that it goes out with one write.
+    uint32_t *trunEntries = new uint32_t[nSamples * valuesPerSample];
+    uint32_t *entry = trunEntries;
+    for (List<FragmentSample>::const_iterator it = samples.begin();
+         it != samples.end(); ++it) {
+        *entry++ = htonl(it->mDurationTicks);
+        *entry++ = htonl(it->mSize);
+        *entry++ = htonl(it->mIsSync? kSyncSampleFlags: kNonSyncSampleFlags);
+        if (valuesPerSample == 4) {
+            *entry++ = htonl(it->mCompositionOffsetTicks);
+        }
+    }
+
+    const uint32_t trunSize = 20 + nSamples * valuesPerSample * 4;
+    const uint32_t moofSize = 8 + 16 /* mfhd */ + 8 + 24 /* tfhd */ + 20 /* tfdt */ + trunSize;
+    const off64_t moofOffset = mOffset;
+
+    beginBox("moof");
+        beginBox("mfhd");
+        writeInt32(0);                          // version=0, flags=0
+        writeInt32(++mFragmentSequenceNumber);  // sequence number
+        endBox();  // mfhd
+        beginBox("traf");
+            beginBox("tfhd");
+            writeInt32(0x01);                   // version=0, flags=base data offset present
+            writeInt32(chunk->mTrack->getTrackId());
+            writeInt64(moofOffset);             // base data offset
+            endBox();  // tfhd
+            beginBox("tfdt");
+            writeInt32(0x01000000);             // version=1, flags=0
+            writeInt64(chunk->mBaseMediaDecodeTimeTicks);
+            endBox();  // tfdt
+            beginBox("trun");
+            writeInt32(trunFlags);              // version=0
+            writeInt32(nSamples);               // sample count
+            writeInt32(moofSize + 8);           // data offset: past the mdat header
+            write(trunEntries, valuesPerSample * 4, nSamples);
+            endBox();  // trun
+        endBox();  // traf
+    endBox();  // moof
+    CHECK_EQ(mOffset - moofOffset, (off64_t)moofSize);
+    delete[] trunEntries;
+
+    writeInt32(mdatSize);
+    writeFourcc("mdat");
+    while (!chunk->mSamples.empty()) {
+        List<MediaBuffer *>::iterator it = chunk->mSamples.begin();
+
+        if (chunk->mTrack->isAvc()) {
+            addLengthPrefixedSample_l(*it);
+        } else {
+            addSample_l(*it);
+        }
+
+        (*it) = NULL;
+        chunk->mSamples.erase(it);
+    }
+    CHECK_EQ(mOffset - moofOffset, (off64_t)(moofSize + mdatSize));
+}
+
+bool MPEG4Writer::allTracksGotFirstChunk_l() const {
+    for (List<ChunkInfo>::const_iterator it = mChunkInfos.begin();
+         it != mChunkInfos.end(); ++it) {
+        if (!it->mGotFirstChunk) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void MPEG4Writer::writeAllChunks() {
     ALOGV("writeAllChunks");
     size_t outstandingChunks = 0;
     Chunk chunk;
     while (findChunkToWrite(&chunk)) {
-        writeChunkToFile(&chunk);
+        writeChunkToFile(&chunk, allTracksGotFirstChunk_l());
         ++outstandingChunks;
     }
 
@@ -1511,6 +1986,12 @@ bool MPEG4Writer::findChunkToWrite(Chunk *chunk) {
         return false;
     }
 
+    // The first fragment has to wait for the movie header, which cannot be
+    // written before every track has its codec specific data.
+    if (isFragmented() && !mMoovBoxWritten && !mDone && !allTracksGotFirstChunk_l()) {
+        return false;
+    }
+
     if (mIsFirstChunk) {
         mIsFirstChunk = false;
     }
@@ -1552,8 +2033,9 @@ void MPEG4Writer::threadFunc() {
         // Actual write without holding the lock in order to
         // reduce the blocking time for media track threads.
         if (chunkFound) {
+            bool allTracksGotFirstChunk = allTracksGotFirstChunk_l();
             mLock.unlock();
-            writeChunkToFile(&chunk);
+            writeChunkToFile(&chunk, allTracksGotFirstChunk);
             mLock.lock();
         }
     }
@@ -1573,9 +2055,13 @@ status_t MPEG4Writer::startWriterThread() {
         info.mTrack = *it;
         info.mPrevChunkTimestampUs = 0;
         info.mMaxInterChunkDurUs = 0;
+        info.mGotFirstChunk = false;
         mChunkInfos.push_back(info);
     }
 
+    // The writer thread queues onto the write-behind as soon as it runs.
+    mWriteBehind = new WriteBehind(mFd);
+
     pthread_attr_t attr;
     pthread_attr_init(&attr);
     pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
@@ -1987,6 +2473,7 @@ status_t MPEG4Writer::Track::threadEntry() {
     int64_t lastCttsOffsetTimeTicks = -1;  // Timescale based ticks
     int32_t cttsSampleCount = 0;           // Sample count in the current ctts table entry
     uint32_t lastSamplesPerChunk = 0;
+    const bool isFragmented = mOwner->isFragmented();
 
     if (mIsAudio) {
         prctl(PR_SET_NAME, (unsigned long)"AudioTrackEncoding", 0, 0, 0);
@@ -2168,7 +2655,7 @@ status_t MPEG4Writer::Track::threadEntry() {
 #endif
 
 ////////////////////////////////////////////////////////////////////////////////
-        if (mStszTableEntries->count() == 0) {
+        if (mNumSamples == 0) {
             mFirstSampleTimeRealUs = systemTime() / 1000;
             mStartTimestampUs = timestampUs;
             mOwner->setStartTimestampUs(mStartTimestampUs);
@@ -2210,7 +2697,7 @@ status_t MPEG4Writer::Track::threadEntry() {
             currCttsOffsetTimeTicks =
                     (cttsOffsetTimeUs * mTimeScale + 500000LL) / 1000000LL;
             CHECK_LE(currCttsOffsetTimeTicks, 0x0FFFFFFFFLL);
-            if (mStszTableEntries->count() == 0) {
+            if (mNumSamples == 0) {
                 // Force the first ctts table entry to have one single entry
                 // so that we can do adjustment for the initial track start
                 // time offset easily in writeCttsBox().
@@ -2228,7 +2715,7 @@ status_t MPEG4Writer::Track::threadEntry() {
             }
 
             // Update ctts time offset range
-            if (mStszTableEntries->count() == 0) {
+            if (mNumSamples == 0) {
                 mMinCttsOffsetTimeUs = currCttsOffsetTimeTicks;
                 mMaxCttsOffsetTimeUs = currCttsOffsetTimeTicks;
             } else {
@@ -2268,19 +2755,37 @@ status_t MPEG4Writer::Track::threadEntry() {
             return UNKNOWN_ERROR;
         }
 
-        mStszTableEntries->add(htonl(sampleSize));
-        if (mStszTableEntries->count() > 2) {
-
-            // Force the first sample to have its own stts entry so that
-            // we can adjust its value later to maintain the A/V sync.
-            if (mStszTableEntries->count() == 3 || currDurationTicks != lastDurationTicks) {
-                addOneSttsTableEntry(sampleCount, lastDurationTicks);
-                sampleCount = 1;
-            } else {
-                ++sampleCount;
+        if (isFragmented) {
+            // The composition offset of a fragment sample has no bias.
+            int64_t compositionOffsetTicks = 0;
+            if (!mIsAudio) {
+                compositionOffsetTicks = currCttsOffsetTimeTicks -
+                        ((int64_t)kMaxCttsOffsetTimeUs * mTimeScale + 500000LL) / 1000000LL;
+                if (compositionOffsetTicks < 0) {
+                    compositionOffsetTicks = 0;
+                }
+            }
+            err = addFragmentSample(copy, sampleSize, timestampUs,
+                    currDurationTicks, compositionOffsetTicks, isSync != 0);
+            if (err != OK) {
+                break;
             }
+        } else {
+            mStszTableEntries->add(htonl(sampleSize));
+            if (mStszTableEntries->count() > 2) {
+
+                // Force the first sample to have its own stts entry so that
+                // we can adjust its value later to maintain the A/V sync.
+                if (mStszTableEntries->count() == 3 || currDurationTicks != lastDurationTicks) {
+                    addOneSttsTableEntry(sampleCount, lastDurationTicks);
+                    sampleCount = 1;
+                } else {
+                    ++sampleCount;
+                }
 
+            }
         }
+        ++mNumSamples;
         if (mSamplesHaveSameSize) {
             if (mStszTableEntries->count() >= 2 && previousSampleSize != sampleSize) {
                 mSamplesHaveSameSize = false;
@@ -2294,7 +2799,10 @@ status_t MPEG4Writer::Track::threadEntry() {
         lastTimestampUs = timestampUs;
 
         if (isSync != 0) {
-            addOneStssTableEntry(mStszTableEntries->count());
+            ++mNumSyncSamples;
+            if (!isFragmented) {
+                addOneStssTableEntry(mStszTableEntries->count());
+            }
         }
 
         if (mTrackingProgressStatus) {
@@ -2303,6 +2811,9 @@ status_t MPEG4Writer::Track::threadEntry() {
             }
             trackProgressStatus(timestampUs);
         }
+        if (isFragmented) {
+            continue;  // Buffered with its fragment
+        }
         if (!hasMultipleTracks) {
             off64_t offset = mIsAvc? mOwner->addLengthPrefixedSample_l(copy)
                                  : mOwner->addSample_l(copy);
@@ -2314,8 +2825,7 @@ status_t MPEG4Writer::Track::threadEntry() {
             if (count == 0) {
                 addChunkOffset(offset);
             }
-            copy->release();
-            copy = NULL;
+            copy = NULL;  // Released once written
             continue;
         }
 
@@ -2352,38 +2862,42 @@ status_t MPEG4Writer::Track::threadEntry() {
 
     mOwner->trackProgressStatus(mTrackId, -1, err);
 
-    // Last chunk
-    if (!hasMultipleTracks) {
-        addOneStscTableEntry(1, mStszTableEntries->count());
-    } else if (!mChunkSamples.empty()) {
-        addOneStscTableEntry(++nChunks, mChunkSamples.size());
-        bufferChunk(timestampUs);
-    }
-
     // We don't really know how long the last frame lasts, since
     // there is no frame time after it, just repeat the previous
     // frame's duration.
-    if (mStszTableEntries->count() == 1) {
+    if (mNumSamples == 1) {
         lastDurationUs = 0;  // A single sample's duration
         lastDurationTicks = 0;
     } else {
         ++sampleCount;  // Count for the last sample
     }
 
-    if (mStszTableEntries->count() <= 2) {
-        addOneSttsTableEntry(1, lastDurationTicks);
-        if (sampleCount - 1 > 0) {
-            addOneSttsTableEntry(sampleCount - 1, lastDurationTicks);
-        }
+    if (isFragmented) {
+        bufferLastFragment(lastDurationTicks);
     } else {
-        addOneSttsTableEntry(sampleCount, lastDurationTicks);
-    }
+        // Last chunk
+        if (!hasMultipleTracks) {
+            addOneStscTableEntry(1, mStszTableEntries->count());
+        } else if (!mChunkSamples.empty()) {
+            addOneStscTableEntry(++nChunks, mChunkSamples.size());
+            bufferChunk(timestampUs);
+        }
 
-    // The last ctts box may not have been written yet, and this
-    // is to make sure that we write out the last ctts box.
-    if (currCttsOffsetTimeTicks == lastCttsOffsetTimeTicks) {
-        if (cttsSampleCount > 0) {
-            addOneCttsTableEntry(cttsSampleCount, lastCttsOffsetTimeTicks);
+        if (mStszTableEntries->count() <= 2) {
+            addOneSttsTableEntry(1, lastDurationTicks);
+            if (sampleCount - 1 > 0) {
+                addOneSttsTableEntry(sampleCount - 1, lastDurationTicks);
+            }
+        } else {
+            addOneSttsTableEntry(sampleCount, lastDurationTicks);
+        }
+
+        // The last ctts box may not have been written yet, and this
+        // is to make sure that we write out the last ctts box.
+        if (currCttsOffsetTimeTicks == lastCttsOffsetTimeTicks) {
+            if (cttsSampleCount > 0) {
+                addOneCttsTableEntry(cttsSampleCount, lastCttsOffsetTimeTicks);
+            }
         }
     }
 
@@ -2393,7 +2907,7 @@ status_t MPEG4Writer::Track::threadEntry() {
     sendTrackSummary(hasMultipleTracks);
 
     ALOGI("Received total/0-length (%d/%d) buffers and encoded %d frames. - %s",
-            count, nZeroLengthFrames, mStszTableEntries->count(), mIsAudio? "audio": "video");
+            count, nZeroLengthFrames, mNumSamples, mIsAudio? "audio": "video");
     if (mIsAudio) {
         ALOGI("Audio track drift time: %lld us", mOwner->getDriftTimeUs());
     }
@@ -2405,12 +2919,12 @@ status_t MPEG4Writer::Track::threadEntry() {
 }
 
 bool MPEG4Writer::Track::isTrackMalFormed() const {
-    if (mStszTableEntries->count() == 0) {                      // no samples written
+    if (mNumSamples == 0) {                      // no samples written
         ALOGE("The number of recorded samples is 0");
         return true;
     }
 
-    if (!mIsAudio && mStssTableEntries->count() == 0) {  // no sync frames for video
+    if (!mIsAudio && mNumSyncSamples == 0) {  // no sync frames for video
         ALOGE("There are no sync frames for video track");
         return true;
     }
@@ -2441,7 +2955,7 @@ void MPEG4Writer::Track::sendTrackSummary(bool hasMultipleTracks) {
 
     mOwner->notify(MEDIA_RECORDER_TRACK_EVENT_INFO,
                     trackNum | MEDIA_RECORDER_TRACK_INFO_ENCODED_FRAMES,
-                    mStszTableEntries->count());
+                    mNumSamples);
 
     {
         // The system delay time excluding the requested initial delay that
@@ -2539,6 +3053,81 @@ void MPEG4Writer::Track::bufferChunk(int64_t timestampUs) {
     mChunkSamples.clear();
 }
 
+status_t MPEG4Writer::Track::addFragmentSample(
+        MediaBuffer *buffer, size_t sampleSize, int64_t timestampUs,
+        int64_t durationTicks, int64_t compositionOffsetTicks, bool isSync) {
+    if (mIsAudio) {
+        isSync = true;
+    }
+
+    if (!mFragmentSamples.empty()) {
+        // The duration of a sample is only known with the next one.
+        (--mFragmentSamples.end())->mDurationTicks = durationTicks;
+
+        // A video fragment always starts with a sync frame, so that
+        // playback can start from any fragment.
+        if (isSync &&
+            timestampUs - mFragmentStartTimeUs >= mOwner->fragmentDuration()) {
+            if (checkCodecSpecificData() != OK) {
+                buffer->release();
+                return ERROR_MALFORMED;
+            }
+            bufferFragment();
+        }
+    }
+
+    if (mFragmentSamples.empty()) {
+        mFragmentStartTimeUs = timestampUs;
+        mFragmentDecodeTimeTicks = (timestampUs * mTimeScale + 500000LL) / 1000000LL;
+    }
+
+    FragmentSample sample;
+    sample.mSize = sampleSize;
+    sample.mDurationTicks = 0;  // Not known yet
+    sample.mCompositionOffsetTicks = compositionOffsetTicks;
+    sample.mIsSync = isSync;
+    mFragmentSamples.push_back(sample);
+    mChunkSamples.push_back(buffer);
+    return OK;
+}
+
+void MPEG4Writer::Track::bufferFragment() {
+    ALOGV("bufferFragment: %d samples", mFragmentSamples.size());
+
+    if (mStartTimeOffsetTicks < 0) {
+        // Settled with the first fragment, by when all the tracks
+        // have normally received their first sample.
+        mStartTimeOffsetTicks = getStartTimeOffsetScaledTime();
+    }
+
+    Chunk chunk(this, mFragmentStartTimeUs, mChunkSamples);
+    chunk.mFragmentSamples = mFragmentSamples;
+    chunk.mBaseMediaDecodeTimeTicks = mStartTimeOffsetTicks + mFragmentDecodeTimeTicks;
+    mOwner->bufferChunk(chunk);
+    mChunkSamples.clear();
+    mFragmentSamples.clear();
+}
+
+void MPEG4Writer::Track::bufferLastFragment(int64_t lastDurationTicks) {
+    if (mFragmentSamples.empty()) {
+        return;
+    }
+
+    (--mFragmentSamples.end())->mDurationTicks = lastDurationTicks;
+    if (checkCodecSpecificData() == OK) {
+        bufferFragment();
+        return;
+    }
+
+    // Without codec specific data there cannot be a movie header.
+    while (!mChunkSamples.empty()) {
+        List<MediaBuffer *>::iterator it = mChunkSamples.begin();
+        (*it)->release();
+        mChunkSamples.erase(it);
+    }
+    mFragmentSamples.clear();
+}
+
 int64_t MPEG4Writer::Track::getDurationUs() const {
     return mTrackDurationUs;
 }
@@ -2603,6 +3192,12 @@ void MPEG4Writer::Track::writeStblBox(bool use32BitOffset) {
         writeVideoFourCCBox();
     }
     mOwner->endBox();  // stsd
+    if (mOwner->isFragmented()) {
+        // The samples are all described by the movie fragments.
+        writeEmptySampleTables();
+        mOwner->endBox();  // stbl
+        return;
+    }
     writeSttsBox();
     writeCttsBox();
     if (!mIsAudio) {
@@ -2614,6 +3209,26 @@ void MPEG4Writer::Track::writeStblBox(bool use32BitOffset) {
     mOwner->endBox();  // stbl
 }
 
+void MPEG4Writer::Track::writeEmptySampleTables() {
+    mOwner->beginBox("stts");
+    mOwner->writeInt32(0);  // version=0, flags=0
+    mOwner->writeInt32(0);  // entry count
+    mOwner->endBox();  // stts
+    mOwner->beginBox("stsc");
+    mOwner->writeInt32(0);  // version=0, flags=0
+    mOwner->writeInt32(0);  // entry count
+    mOwner->endBox();  // stsc
+    mOwner->beginBox("stsz");
+    mOwner->writeInt32(0);  // version=0, flags=0
+    mOwner->writeInt32(0);  // sample size
+    mOwner->writeInt32(0);  // sample count
+    mOwner->endBox();  // stsz
+    mOwner->beginBox("stco");
+    mOwner->writeInt32(0);  // version=0, flags=0
+    mOwner->writeInt32(0);  // entry count
+    mOwner->endBox();  // stco
+}
+
 void MPEG4Writer::Track::writeVideoFourCCBox() {
     const char *mime;
     bool success = mMeta->findCString(kKeyMIMEType, &mime);
@@ -2795,7 +3410,8 @@ void MPEG4Writer::Track::writeTkhdBox(uint32_t now) {
     mOwner->writeInt32(now);           // modification time
     mOwner->writeInt32(mTrackId);      // track id starts with 1
     mOwner->writeInt32(0);             // reserved
-    int64_t trakDurationUs = getDurationUs();
+    // The duration of a fragmented file is the sum of its fragments.
+    int64_t trakDurationUs = mOwner->isFragmented()? 0: getDurationUs();
     int32_t mvhdTimeScale = mOwner->getTimeScale();
     int32_t tkhdDuration =
         (trakDurationUs * mvhdTimeScale + 5E5) / 1E6;
@@ -2856,7 +3472,7 @@ void MPEG4Writer::Track::writeHdlrBox() {
 }
 
 void MPEG4Writer::Track::writeMdhdBox(uint32_t now) {
-    int64_t trakDurationUs = getDurationUs();
+    int64_t trakDurationUs = mOwner->isFragmented()? 0: getDurationUs();
     mOwner->beginBox("mdhd");
     mOwner->writeInt32(0);             // version=0, flags=0
     mOwner->writeInt32(now);           // creation time
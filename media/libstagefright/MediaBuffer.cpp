@@ -34,6 +34,7 @@ namespace android {
 MediaBuffer::MediaBuffer(void *data, size_t size)
     : mObserver(NULL),
       mNextBuffer(NULL),
+      mNextFreeBuffer(NULL),
       mRefCount(0),
       mData(data),
       mSize(size),
@@ -47,6 +48,7 @@ MediaBuffer::MediaBuffer(void *data, size_t size)
 MediaBuffer::MediaBuffer(size_t size)
     : mObserver(NULL),
       mNextBuffer(NULL),
+      mNextFreeBuffer(NULL),
       mRefCount(0),
       mData(malloc(size)),
       mSize(size),
@@ -60,6 +62,7 @@ MediaBuffer::MediaBuffer(size_t size)
 MediaBuffer::MediaBuffer(const sp<GraphicBuffer>& graphicBuffer)
     : mObserver(NULL),
       mNextBuffer(NULL),
+      mNextFreeBuffer(NULL),
       mRefCount(0),
       mData(NULL),
       mSize(1),
@@ -74,6 +77,7 @@ MediaBuffer::MediaBuffer(const sp<GraphicBuffer>& graphicBuffer)
 MediaBuffer::MediaBuffer(const sp<ABuffer> &buffer)
     : mObserver(NULL),
       mNextBuffer(NULL),
+      mNextFreeBuffer(NULL),
       mRefCount(0),
       mData(buffer->data()),
       mSize(buffer->size()),
@@ -17,6 +17,11 @@
 #define LOG_TAG "MediaBufferGroup"
 #include <utils/Log.h>
 
+#include <stdlib.h>
+#include <string.h>
+
+#include <cutils/atomic.h>
+
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/MediaBuffer.h>
 #include <media/stagefright/MediaBufferGroup.h>
@@ -25,7 +30,10 @@ namespace android {
 
 MediaBufferGroup::MediaBufferGroup()
     : mFirstBuffer(NULL),
-      mLastBuffer(NULL) {
+      mLastBuffer(NULL),
+      mReturnedBuffers(NULL),
+      mFreeClassMask(0) {
+    memset(mFreeBuffers, 0, sizeof(mFreeBuffers));
 }
 
 MediaBufferGroup::~MediaBufferGroup() {
@@ -53,34 +61,182 @@ void MediaBufferGroup::add_buffer(MediaBuffer *buffer) {
     }
 
     mLastBuffer = buffer;
+
+    // A buffer that is still referenced joins the free lists when it is
+    // returned to us.
+    if (buffer->refcount() == 0) {
+        addFreeBuffer_l(buffer);
+    }
+}
+
+status_t MediaBufferGroup::acquire_buffer(
+        MediaBuffer **out, bool nonBlocking, size_t requestedSize) {
+    return acquire(out, nonBlocking ? 0 : -1, requestedSize);
 }
 
-status_t MediaBufferGroup::acquire_buffer(MediaBuffer **out) {
+status_t MediaBufferGroup::acquire_buffer_timeout(
+        MediaBuffer **out, int64_t timeoutUs, size_t requestedSize) {
+    status_t err = acquire(out, timeoutUs > 0 ? timeoutUs * 1000ll : 0, requestedSize);
+
+    // acquire() tells a poll that found nothing from a timeout
+    return err == WOULD_BLOCK ? TIMED_OUT : err;
+}
+
+status_t MediaBufferGroup::acquire(
+        MediaBuffer **out, int64_t timeoutNs, size_t requestedSize) {
     Mutex::Autolock autoLock(mLock);
 
+    nsecs_t deadline = timeoutNs > 0 ? systemTime() + timeoutNs : 0;
+    bool timedOut = false;
     for (;;) {
-        for (MediaBuffer *buffer = mFirstBuffer;
-             buffer != NULL; buffer = buffer->nextBuffer()) {
-            if (buffer->refcount() == 0) {
-                buffer->add_ref();
-                buffer->reset();
-
-                *out = buffer;
-                goto exit;
+        takeReturnedBuffers_l();
+
+        MediaBuffer *buffer = removeFreeBuffer_l(requestedSize);
+        if (buffer == NULL && requestedSize > 0) {
+            buffer = removeGrowableBuffer_l();
+            if (buffer != NULL) {
+                // Grow by at least half the current size so that a stream
+                // of slowly growing access units does not reallocate each time.
+                size_t size = buffer->mSize + buffer->mSize / 2;
+                if (size < requestedSize) {
+                    size = requestedSize;
+                }
+                void *data = malloc(size);
+                if (data == NULL) {
+                    addFreeBuffer_l(buffer);
+                    return NO_MEMORY;
+                }
+                free(buffer->mData);
+                buffer->mData = data;
+                buffer->mSize = size;
             }
         }
 
-        // All buffers are in use. Block until one of them is returned to us.
-        mCondition.wait(mLock);
+        if (buffer != NULL) {
+            buffer->add_ref();
+            buffer->reset();
+
+            *out = buffer;
+            return OK;
+        }
+
+        // All buffers are in use, or none of the free ones is large enough.
+        // Block until one of them is returned to us.  release() signals
+        // with mLock held whenever it pushes onto an empty returned list,
+        // and we emptied that list above, so the signal cannot get lost.
+        if (timeoutNs < 0) {
+            mCondition.wait(mLock);
+            continue;
+        }
+        if (timedOut || timeoutNs == 0) {
+            return timeoutNs == 0 ? WOULD_BLOCK : TIMED_OUT;
+        }
+        nsecs_t remaining = deadline - systemTime();
+        // Look once more after the timeout, a buffer may have been
+        // returned just before it.
+        timedOut = remaining <= 0
+                || mCondition.waitRelative(mLock, remaining) == TIMED_OUT;
     }
+}
 
-exit:
-    return OK;
+void MediaBufferGroup::signalBufferReturned(MediaBuffer *buffer) {
+    MediaBuffer *head;
+    do {
+        head = mReturnedBuffers;
+        buffer->mNextFreeBuffer = head;
+    } while (android_atomic_release_cas(
+            (int32_t) head, (int32_t) buffer,
+            (volatile int32_t *) &mReturnedBuffers) != 0);
+
+    if (head == NULL) {
+        // An acquirer may be waiting.  It empties the returned list with
+        // mLock held before it waits, so this broadcast cannot get lost.
+        // Waiters may want different sizes, so wake all of them.
+        Mutex::Autolock autoLock(mLock);
+        mCondition.broadcast();
+    }
 }
 
-void MediaBufferGroup::signalBufferReturned(MediaBuffer *) {
-    Mutex::Autolock autoLock(mLock);
-    mCondition.signal();
+void MediaBufferGroup::takeReturnedBuffers_l() {
+    MediaBuffer *head;
+    do {
+        head = mReturnedBuffers;
+        if (head == NULL) {
+            return;
+        }
+    } while (android_atomic_acquire_cas(
+            (int32_t) head, 0, (volatile int32_t *) &mReturnedBuffers) != 0);
+
+    while (head != NULL) {
+        MediaBuffer *next = head->mNextFreeBuffer;
+        addFreeBuffer_l(head);
+        head = next;
+    }
+}
+
+// static
+size_t MediaBufferGroup::SizeClass(size_t size) {
+    return size == 0 ? 0 : 31 - __builtin_clz(size);
+}
+
+void MediaBufferGroup::addFreeBuffer_l(MediaBuffer *buffer) {
+    size_t sizeClass = SizeClass(buffer->mSize);
+    buffer->mNextFreeBuffer = mFreeBuffers[sizeClass];
+    mFreeBuffers[sizeClass] = buffer;
+    mFreeClassMask |= 1u << sizeClass;
+}
+
+MediaBuffer *MediaBufferGroup::removeFreeBuffer_l(size_t requestedSize) {
+    uint32_t mask = mFreeClassMask;
+    if (requestedSize > 0) {
+        // Only some of the buffers in the class of requestedSize may be
+        // large enough, all of those in the classes above it are.
+        size_t sizeClass = SizeClass(requestedSize);
+        for (MediaBuffer **link = &mFreeBuffers[sizeClass];
+                *link != NULL; link = &(*link)->mNextFreeBuffer) {
+            MediaBuffer *buffer = *link;
+            if (buffer->mSize >= requestedSize) {
+                *link = buffer->mNextFreeBuffer;
+                if (mFreeBuffers[sizeClass] == NULL) {
+                    mFreeClassMask &= ~(1u << sizeClass);
+                }
+                return buffer;
+            }
+        }
+        mask &= ~((2u << sizeClass) - 1);
+    }
+
+    if (mask == 0) {
+        return NULL;
+    }
+
+    // Hand out the smallest buffer that fits, keeping larger ones for
+    // larger requests.
+    size_t sizeClass = __builtin_ctz(mask);
+    MediaBuffer *buffer = mFreeBuffers[sizeClass];
+    mFreeBuffers[sizeClass] = buffer->mNextFreeBuffer;
+    if (mFreeBuffers[sizeClass] == NULL) {
+        mFreeClassMask &= ~(1u << sizeClass);
+    }
+    return buffer;
+}
+
+MediaBuffer *MediaBufferGroup::removeGrowableBuffer_l() {
+    // Grow the largest free buffer, it is the one closest to the size needed.
+    for (int sizeClass = kNumSizeClasses - 1; sizeClass >= 0; --sizeClass) {
+        for (MediaBuffer **link = &mFreeBuffers[sizeClass];
+                *link != NULL; link = &(*link)->mNextFreeBuffer) {
+            MediaBuffer *buffer = *link;
+            if (buffer->mOwnsData && buffer->mGraphicBuffer == NULL) {
+                *link = buffer->mNextFreeBuffer;
+                if (mFreeBuffers[sizeClass] == NULL) {
+                    mFreeClassMask &= ~(1u << sizeClass);
+                }
+                return buffer;
+            }
+        }
+    }
+    return NULL;
 }
 
 }  // namespace android
@@ -26,8 +26,17 @@
 #include <media/stagefright/OMXCodec.h>
 #include <utils/threads.h>
 
+#include <cutils/properties.h>
 #include <libexpat/expat.h>
 
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
 #ifdef QCOM_HARDWARE
 #include "include/QCUtilityClass.h"
 #endif
@@ -36,6 +45,361 @@ namespace android {
 
 static Mutex sInitMutex;
 
+static const char *kCodecsXmlPath = "/etc/media_codecs.xml";
+
+// Written by whichever process first parses the xml file and has write
+// access here (mediaserver), mapped read-only by every other one.
+static const char *kCodecsCachePath = "/data/misc/media/media_codecs.cache";
+
+static const uint32_t kCacheMagic = 0x4d434c43;  // 'MCLC'
+
+// Bump whenever the layout below or the set of codecs added in code changes.
+static const uint32_t kCacheVersion = 1;
+
+static const size_t kMaxCacheSize = 1024 * 1024;
+static const uint32_t kMaxCachedCodecs = 4096;
+
+/*
+ * Compiled form of the codec list, used both for the cache file and for the
+ * heap copy made when the cache cannot be used. All offsets are relative to
+ * the start of the header and 4-byte aligned, names are offsets into the
+ * string area.
+ *
+ * Type, quirk and codec names are looked up through open-addressed hash
+ * tables. For each type the indices of the decoders and of the encoders
+ * supporting it are stored in ascending order, so that findCodecByType()
+ * does not have to walk all codecs.
+ */
+struct CodecCacheTable {
+    uint32_t mSlotsOffset;      // CodecCacheSlot[mNumSlots]
+    uint32_t mNumSlots;         // power of two
+};
+
+struct CodecCacheSlot {
+    uint32_t mHash;
+    uint32_t mIndex;            // entry index + 1, 0 if the slot is empty
+};
+
+struct CodecCacheCodec {
+    uint32_t mName;
+    uint32_t mIsEncoder;
+    uint32_t mTypes;
+    uint32_t mQuirks;
+};
+
+struct CodecCacheType {
+    uint32_t mName;
+    uint32_t mBit;
+    uint32_t mMatches[2];       // first index into the match array,
+    uint32_t mNumMatches[2];    // indexed by "is encoder"
+};
+
+struct CodecCacheQuirk {
+    uint32_t mName;
+    uint32_t mBit;
+};
+
+struct CodecCacheKey {
+    int64_t mSourceMTime;
+    int64_t mSourceSize;
+    uint32_t mBuildHash;
+};
+
+struct CodecCacheHeader {
+    uint32_t mMagic;
+    uint32_t mVersion;
+    uint32_t mSize;
+    uint32_t mChecksum;         // crc32 of everything after the header
+    CodecCacheKey mKey;
+
+    uint32_t mNumCodecs;
+    uint32_t mNumTypes;
+    uint32_t mNumQuirks;
+    uint32_t mNumMatches;
+
+    uint32_t mCodecsOffset;     // CodecCacheCodec[mNumCodecs]
+    uint32_t mTypesOffset;      // CodecCacheType[mNumTypes], sorted by name
+    uint32_t mQuirksOffset;     // CodecCacheQuirk[mNumQuirks]
+    uint32_t mMatchesOffset;    // uint32_t[mNumMatches]
+
+    CodecCacheTable mCodecTable;
+    CodecCacheTable mTypeTable;
+    CodecCacheTable mQuirkTable;
+
+    uint32_t mStringsOffset;
+    uint32_t mStringsSize;
+};
+
+static uint32_t HashName(const char *name) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    while (*name != '\0') {
+        hash = (hash ^ (uint8_t)*name++) * 16777619u;
+    }
+    return hash;
+}
+
+template<typename T>
+static inline const T *CacheAt(const uint8_t *data, uint32_t offset) {
+    return reinterpret_cast<const T *>(data + offset);
+}
+
+static inline const CodecCacheHeader *CacheHeader(const uint8_t *data) {
+    return CacheAt<CodecCacheHeader>(data, 0);
+}
+
+static inline const char *CacheString(const uint8_t *data, uint32_t name) {
+    return CacheAt<char>(data, CacheHeader(data)->mStringsOffset + name);
+}
+
+// Returns the index of the entry called "name" among the "entrySize" byte
+// entries at "entriesOffset", all of which start with their name.
+static ssize_t CacheLookup(
+        const uint8_t *data, const CodecCacheTable &table,
+        uint32_t entriesOffset, size_t entrySize, const char *name) {
+    const CodecCacheSlot *slots =
+        CacheAt<CodecCacheSlot>(data, table.mSlotsOffset);
+
+    uint32_t hash = HashName(name);
+    uint32_t mask = table.mNumSlots - 1;
+
+    for (uint32_t i = 0; i < table.mNumSlots; ++i) {
+        const CodecCacheSlot &slot = slots[(hash + i) & mask];
+
+        if (slot.mIndex == 0) {
+            break;
+        }
+
+        if (slot.mHash == hash) {
+            uint32_t index = slot.mIndex - 1;
+            uint32_t entryName = *CacheAt<uint32_t>(
+                    data, entriesOffset + index * entrySize);
+
+            if (!strcmp(CacheString(data, entryName), name)) {
+                return index;
+            }
+        }
+    }
+
+    return -ENOENT;
+}
+
+static void GetCacheKey(const struct stat &st, CodecCacheKey *key) {
+    memset(key, 0, sizeof(*key));
+
+    key->mSourceMTime = (int64_t)st.st_mtime;
+    key->mSourceSize = (int64_t)st.st_size;
+
+    // System images are frequently built with fixed timestamps, so an update
+    // of the xml file is not always visible in its mtime.
+    char fingerprint[PROPERTY_VALUE_MAX];
+    property_get("ro.build.fingerprint", fingerprint, "");
+    key->mBuildHash = HashName(fingerprint);
+}
+
+static bool CacheRangeOK(
+        size_t size, uint32_t offset, uint32_t count, size_t entrySize) {
+    return offset >= sizeof(CodecCacheHeader)
+        && (offset & 3) == 0
+        && offset <= size
+        && count <= (size - offset) / entrySize;
+}
+
+static bool CacheTableOK(
+        const uint8_t *data, size_t size,
+        const CodecCacheTable &table, uint32_t numEntries) {
+    if (table.mNumSlots == 0
+            || (table.mNumSlots & (table.mNumSlots - 1)) != 0
+            || !CacheRangeOK(
+                size, table.mSlotsOffset, table.mNumSlots,
+                sizeof(CodecCacheSlot))) {
+        return false;
+    }
+
+    const CodecCacheSlot *slots =
+        CacheAt<CodecCacheSlot>(data, table.mSlotsOffset);
+
+    for (uint32_t i = 0; i < table.mNumSlots; ++i) {
+        if (slots[i].mIndex > numEntries) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// The cache file is not trusted any further than this.
+static bool CacheIsValid(
+        const uint8_t *data, size_t size, const CodecCacheKey &key) {
+    if (size < sizeof(CodecCacheHeader)) {
+        return false;
+    }
+
+    const CodecCacheHeader *header = CacheHeader(data);
+
+    if (header->mMagic != kCacheMagic
+            || header->mVersion != kCacheVersion
+            || header->mSize != size
+            || header->mKey.mSourceMTime != key.mSourceMTime
+            || header->mKey.mSourceSize != key.mSourceSize
+            || header->mKey.mBuildHash != key.mBuildHash) {
+        return false;
+    }
+
+    if (header->mChecksum != crc32(
+                0, data + sizeof(CodecCacheHeader),
+                size - sizeof(CodecCacheHeader))) {
+        ALOGW("codec list cache is corrupt");
+        return false;
+    }
+
+    if (header->mNumCodecs > kMaxCachedCodecs
+            || header->mNumTypes > 32
+            || header->mNumQuirks > 32
+            || !CacheRangeOK(
+                size, header->mCodecsOffset, header->mNumCodecs,
+                sizeof(CodecCacheCodec))
+            || !CacheRangeOK(
+                size, header->mTypesOffset, header->mNumTypes,
+                sizeof(CodecCacheType))
+            || !CacheRangeOK(
+                size, header->mQuirksOffset, header->mNumQuirks,
+                sizeof(CodecCacheQuirk))
+            || !CacheRangeOK(
+                size, header->mMatchesOffset, header->mNumMatches,
+                sizeof(uint32_t))
+            || !CacheTableOK(
+                data, size, header->mCodecTable, header->mNumCodecs)
+            || !CacheTableOK(
+                data, size, header->mTypeTable, header->mNumTypes)
+            || !CacheTableOK(
+                data, size, header->mQuirkTable, header->mNumQuirks)
+            || header->mStringsSize == 0
+            || !CacheRangeOK(
+                size, header->mStringsOffset, header->mStringsSize, 1)
+            || data[header->mStringsOffset + header->mStringsSize - 1]
+                != '\0') {
+        return false;
+    }
+
+    uint32_t stringsSize = header->mStringsSize;
+
+    const CodecCacheCodec *codecs =
+        CacheAt<CodecCacheCodec>(data, header->mCodecsOffset);
+    for (uint32_t i = 0; i < header->mNumCodecs; ++i) {
+        if (codecs[i].mName >= stringsSize || codecs[i].mIsEncoder > 1) {
+            return false;
+        }
+    }
+
+    const CodecCacheType *types =
+        CacheAt<CodecCacheType>(data, header->mTypesOffset);
+    for (uint32_t i = 0; i < header->mNumTypes; ++i) {
+        if (types[i].mName >= stringsSize || types[i].mBit >= 32) {
+            return false;
+        }
+
+        for (size_t j = 0; j < 2; ++j) {
+            if (types[i].mMatches[j] > header->mNumMatches
+                    || types[i].mNumMatches[j]
+                        > header->mNumMatches - types[i].mMatches[j]) {
+                return false;
+            }
+        }
+    }
+
+    const CodecCacheQuirk *quirks =
+        CacheAt<CodecCacheQuirk>(data, header->mQuirksOffset);
+    for (uint32_t i = 0; i < header->mNumQuirks; ++i) {
+        if (quirks[i].mName >= stringsSize || quirks[i].mBit >= 32) {
+            return false;
+        }
+    }
+
+    const uint32_t *matches = CacheAt<uint32_t>(data, header->mMatchesOffset);
+    for (uint32_t i = 0; i < header->mNumMatches; ++i) {
+        if (matches[i] >= header->mNumCodecs) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool MapCache(
+        const CodecCacheKey &key, const uint8_t **data, size_t *size) {
+    int fd = open(kCodecsCachePath, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0
+            || st.st_size < (off_t)sizeof(CodecCacheHeader)
+            || st.st_size > (off_t)kMaxCacheSize) {
+        close(fd);
+        return false;
+    }
+
+    // The cache is only ever replaced by rename(), never rewritten in place,
+    // so the mapping stays intact while another process updates it.
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (base == MAP_FAILED) {
+        ALOGW("mmap of codec list cache failed (%s)", strerror(errno));
+        return false;
+    }
+
+    if (!CacheIsValid((const uint8_t *)base, st.st_size, key)) {
+        ALOGI("codec list cache is out of date");
+        munmap(base, st.st_size);
+        return false;
+    }
+
+    *data = (const uint8_t *)base;
+    *size = st.st_size;
+
+    return true;
+}
+
+static bool WriteCache(const uint8_t *data, size_t size) {
+    char tmpPath[PATH_MAX];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.%d", kCodecsCachePath, getpid());
+
+    int fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        // Expected in processes that may not write here.
+        ALOGV("unable to create %s (%s)", tmpPath, strerror(errno));
+        return false;
+    }
+
+    fchmod(fd, 0644);
+
+    size_t offset = 0;
+    while (offset < size) {
+        ssize_t n = write(fd, data + offset, size - offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        offset += n;
+    }
+
+    bool ok = offset == size && fsync(fd) == 0;
+    close(fd);
+
+    if (!ok || rename(tmpPath, kCodecsCachePath) != 0) {
+        ALOGW("unable to write codec list cache (%s)", strerror(errno));
+        unlink(tmpPath);
+        return false;
+    }
+
+    return true;
+}
+
 // static
 MediaCodecList *MediaCodecList::sCodecList;
 
@@ -51,8 +415,26 @@ const MediaCodecList *MediaCodecList::getInstance() {
 }
 
 MediaCodecList::MediaCodecList()
-    : mInitCheck(NO_INIT) {
-    FILE *file = fopen("/etc/media_codecs.xml", "r");
+    : mInitCheck(NO_INIT),
+      mData(NULL),
+      mDataSize(0),
+      mDataIsMapped(false) {
+    struct stat st;
+    if (stat(kCodecsXmlPath, &st) != 0) {
+        ALOGW("unable to open media codecs configuration xml file.");
+        return;
+    }
+
+    CodecCacheKey key;
+    GetCacheKey(st, &key);
+
+    if (MapCache(key, &mData, &mDataSize)) {
+        mDataIsMapped = true;
+        mInitCheck = OK;
+        return;
+    }
+
+    FILE *file = fopen(kCodecsXmlPath, "r");
 
     if (file == NULL) {
         ALOGW("unable to open media codecs configuration xml file.");
@@ -99,9 +481,47 @@ MediaCodecList::MediaCodecList()
 
     fclose(file);
     file = NULL;
+
+    if (mInitCheck != OK) {
+        return;
+    }
+
+    uint8_t *data;
+    size_t size;
+    mInitCheck = compile(&data, &size);
+
+    mCodecInfos.clear();
+    mCodecQuirks.clear();
+    mTypes.clear();
+
+    if (mInitCheck != OK) {
+        return;
+    }
+
+    CodecCacheHeader *header = (CodecCacheHeader *)data;
+    header->mKey = key;
+    header->mChecksum = crc32(
+            0, data + sizeof(CodecCacheHeader),
+            size - sizeof(CodecCacheHeader));
+
+    // Once written, switch to the file so that this process shares the
+    // same pages as all the others.
+    if (WriteCache(data, size) && MapCache(key, &mData, &mDataSize)) {
+        mDataIsMapped = true;
+        free(data);
+    } else {
+        mData = data;
+        mDataSize = size;
+    }
 }
 
 MediaCodecList::~MediaCodecList() {
+    if (mDataIsMapped) {
+        munmap(const_cast<uint8_t *>(mData), mDataSize);
+    } else {
+        free(const_cast<uint8_t *>(mData));
+    }
+    mData = NULL;
 }
 
 status_t MediaCodecList::initCheck() const {
@@ -422,75 +842,276 @@ void MediaCodecList::addType(const char *name) {
     info->mTypes |= 1ul << bit;
 }
 
+static size_t CacheTableSize(size_t numEntries) {
+    // At most half full, which also guarantees an empty slot.
+    size_t numSlots = 1;
+    while (numSlots < 2 * numEntries) {
+        numSlots <<= 1;
+    }
+    return numSlots;
+}
+
+static void CacheTableAdd(
+        CodecCacheSlot *slots, size_t numSlots,
+        const char *name, uint32_t index) {
+    uint32_t hash = HashName(name);
+    size_t i = hash & (numSlots - 1);
+
+    while (slots[i].mIndex != 0) {
+        i = (i + 1) & (numSlots - 1);
+    }
+
+    slots[i].mHash = hash;
+    slots[i].mIndex = index + 1;
+}
+
+static uint32_t CacheAddString(
+        uint8_t *strings, uint32_t *stringsSize, const char *s) {
+    uint32_t offset = *stringsSize;
+    size_t len = strlen(s) + 1;
+
+    memcpy(strings + offset, s, len);
+    *stringsSize += len;
+
+    return offset;
+}
+
+status_t MediaCodecList::compile(uint8_t **data, size_t *size) const {
+    size_t numCodecs = mCodecInfos.size();
+    size_t numTypes = mTypes.size();
+    size_t numQuirks = mCodecQuirks.size();
+
+    if (numCodecs > kMaxCachedCodecs) {
+        ALOGE("too many codecs in configuration.");
+        return ERROR_MALFORMED;
+    }
+
+    size_t numMatches = 0;
+    size_t stringsSize = 0;
+
+    for (size_t i = 0; i < numCodecs; ++i) {
+        const CodecInfo &info = mCodecInfos.itemAt(i);
+
+        stringsSize += info.mName.size() + 1;
+        numMatches += __builtin_popcount(info.mTypes);
+    }
+
+    for (size_t i = 0; i < numTypes; ++i) {
+        stringsSize += mTypes.keyAt(i).size() + 1;
+    }
+
+    for (size_t i = 0; i < numQuirks; ++i) {
+        stringsSize += mCodecQuirks.keyAt(i).size() + 1;
+    }
+
+    size_t numCodecSlots = CacheTableSize(numCodecs);
+    size_t numTypeSlots = CacheTableSize(numTypes);
+    size_t numQuirkSlots = CacheTableSize(numQuirks);
+
+    CodecCacheHeader header;
+    memset(&header, 0, sizeof(header));
+
+    header.mMagic = kCacheMagic;
+    header.mVersion = kCacheVersion;
+    header.mNumCodecs = numCodecs;
+    header.mNumTypes = numTypes;
+    header.mNumQuirks = numQuirks;
+    header.mNumMatches = numMatches;
+
+    size_t offset = sizeof(CodecCacheHeader);
+
+    header.mCodecsOffset = offset;
+    offset += numCodecs * sizeof(CodecCacheCodec);
+    header.mTypesOffset = offset;
+    offset += numTypes * sizeof(CodecCacheType);
+    header.mQuirksOffset = offset;
+    offset += numQuirks * sizeof(CodecCacheQuirk);
+    header.mMatchesOffset = offset;
+    offset += numMatches * sizeof(uint32_t);
+
+    header.mCodecTable.mSlotsOffset = offset;
+    header.mCodecTable.mNumSlots = numCodecSlots;
+    offset += numCodecSlots * sizeof(CodecCacheSlot);
+    header.mTypeTable.mSlotsOffset = offset;
+    header.mTypeTable.mNumSlots = numTypeSlots;
+    offset += numTypeSlots * sizeof(CodecCacheSlot);
+    header.mQuirkTable.mSlotsOffset = offset;
+    header.mQuirkTable.mNumSlots = numQuirkSlots;
+    offset += numQuirkSlots * sizeof(CodecCacheSlot);
+
+    // Starts with an empty string so that the area is never empty.
+    header.mStringsOffset = offset;
+    header.mStringsSize = 1 + stringsSize;
+    offset += (header.mStringsSize + 3) & ~3;
+
+    if (offset > kMaxCacheSize) {
+        ALOGE("codec configuration is too large.");
+        return ERROR_MALFORMED;
+    }
+
+    header.mSize = offset;
+
+    uint8_t *blob = (uint8_t *)calloc(1, offset);
+    if (blob == NULL) {
+        return NO_MEMORY;
+    }
+
+    memcpy(blob, &header, sizeof(header));
+
+    CodecCacheCodec *codecs = (CodecCacheCodec *)(blob + header.mCodecsOffset);
+    CodecCacheType *types = (CodecCacheType *)(blob + header.mTypesOffset);
+    CodecCacheQuirk *quirks = (CodecCacheQuirk *)(blob + header.mQuirksOffset);
+    uint32_t *matches = (uint32_t *)(blob + header.mMatchesOffset);
+    uint8_t *strings = blob + header.mStringsOffset;
+
+    uint32_t stringsUsed = 1;
+
+    for (size_t i = 0; i < numCodecs; ++i) {
+        const CodecInfo &info = mCodecInfos.itemAt(i);
+
+        codecs[i].mName =
+            CacheAddString(strings, &stringsUsed, info.mName.c_str());
+        codecs[i].mIsEncoder = info.mIsEncoder;
+        codecs[i].mTypes = info.mTypes;
+        codecs[i].mQuirks = info.mQuirks;
+
+        CacheTableAdd(
+                (CodecCacheSlot *)(blob + header.mCodecTable.mSlotsOffset),
+                numCodecSlots, info.mName.c_str(), i);
+    }
+
+    size_t matchesUsed = 0;
+
+    for (size_t i = 0; i < numTypes; ++i) {
+        const char *name = mTypes.keyAt(i).c_str();
+        uint32_t bit = mTypes.valueAt(i);
+
+        types[i].mName = CacheAddString(strings, &stringsUsed, name);
+        types[i].mBit = bit;
+
+        for (size_t encoder = 0; encoder < 2; ++encoder) {
+            types[i].mMatches[encoder] = matchesUsed;
+
+            for (size_t j = 0; j < numCodecs; ++j) {
+                const CodecInfo &info = mCodecInfos.itemAt(j);
+
+                if (info.mIsEncoder == (encoder != 0)
+                        && (info.mTypes & (1ul << bit))) {
+                    matches[matchesUsed++] = j;
+                }
+            }
+
+            types[i].mNumMatches[encoder] =
+                matchesUsed - types[i].mMatches[encoder];
+        }
+
+        CacheTableAdd(
+                (CodecCacheSlot *)(blob + header.mTypeTable.mSlotsOffset),
+                numTypeSlots, name, i);
+    }
+
+    for (size_t i = 0; i < numQuirks; ++i) {
+        const char *name = mCodecQuirks.keyAt(i).c_str();
+
+        quirks[i].mName = CacheAddString(strings, &stringsUsed, name);
+        quirks[i].mBit = mCodecQuirks.valueAt(i);
+
+        CacheTableAdd(
+                (CodecCacheSlot *)(blob + header.mQuirkTable.mSlotsOffset),
+                numQuirkSlots, name, i);
+    }
+
+    CHECK_EQ(matchesUsed, numMatches);
+    CHECK_EQ(stringsUsed, header.mStringsSize);
+
+    *data = blob;
+    *size = offset;
+
+    return OK;
+}
+
 ssize_t MediaCodecList::findCodecByType(
         const char *type, bool encoder, size_t startIndex) const {
-    ssize_t typeIndex = mTypes.indexOfKey(type);
+    const CodecCacheHeader *header = CacheHeader(mData);
+
+    ssize_t typeIndex = CacheLookup(
+            mData, header->mTypeTable,
+            header->mTypesOffset, sizeof(CodecCacheType), type);
 
     if (typeIndex < 0) {
         return -ENOENT;
     }
 
-    uint32_t typeMask = 1ul << mTypes.valueAt(typeIndex);
+    const CodecCacheType &info =
+        CacheAt<CodecCacheType>(mData, header->mTypesOffset)[typeIndex];
 
-    while (startIndex < mCodecInfos.size()) {
-        const CodecInfo &info = mCodecInfos.itemAt(startIndex);
+    const uint32_t *matches = CacheAt<uint32_t>(mData, header->mMatchesOffset)
+        + info.mMatches[encoder];
 
-        if (info.mIsEncoder == encoder && (info.mTypes & typeMask)) {
-            return startIndex;
+    for (size_t i = 0; i < info.mNumMatches[encoder]; ++i) {
+        if (matches[i] >= startIndex) {
+            return matches[i];
         }
-
-        ++startIndex;
     }
 
     return -ENOENT;
 }
 
 ssize_t MediaCodecList::findCodecByName(const char *name) const {
-    for (size_t i = 0; i < mCodecInfos.size(); ++i) {
-        const CodecInfo &info = mCodecInfos.itemAt(i);
+    const CodecCacheHeader *header = CacheHeader(mData);
 
-        if (info.mName == name) {
-            return i;
-        }
-    }
-
-    return -ENOENT;
+    return CacheLookup(
+            mData, header->mCodecTable,
+            header->mCodecsOffset, sizeof(CodecCacheCodec), name);
 }
 
 size_t MediaCodecList::countCodecs() const {
-    return mCodecInfos.size();
+    return CacheHeader(mData)->mNumCodecs;
 }
 
 const char *MediaCodecList::getCodecName(size_t index) const {
-    if (index >= mCodecInfos.size()) {
+    if (index >= countCodecs()) {
         return NULL;
     }
 
-    const CodecInfo &info = mCodecInfos.itemAt(index);
-    return info.mName.c_str();
+    const CodecCacheCodec &info = CacheAt<CodecCacheCodec>(
+            mData, CacheHeader(mData)->mCodecsOffset)[index];
+    return CacheString(mData, info.mName);
 }
 
 bool MediaCodecList::isEncoder(size_t index) const {
-    if (index >= mCodecInfos.size()) {
-        return NULL;
+    if (index >= countCodecs()) {
+        return false;
     }
 
-    const CodecInfo &info = mCodecInfos.itemAt(index);
+    const CodecCacheCodec &info = CacheAt<CodecCacheCodec>(
+            mData, CacheHeader(mData)->mCodecsOffset)[index];
     return info.mIsEncoder;
 }
 
 bool MediaCodecList::codecHasQuirk(
         size_t index, const char *quirkName) const {
-    if (index >= mCodecInfos.size()) {
-        return NULL;
+    if (index >= countCodecs()) {
+        return false;
     }
 
-    const CodecInfo &info = mCodecInfos.itemAt(index);
+    const CodecCacheHeader *header = CacheHeader(mData);
+
+    const CodecCacheCodec &info =
+        CacheAt<CodecCacheCodec>(mData, header->mCodecsOffset)[index];
 
     if (info.mQuirks != 0) {
-        ssize_t index = mCodecQuirks.indexOfKey(quirkName);
-        if (index >= 0 && info.mQuirks & (1ul << mCodecQuirks.valueAt(index))) {
-            return true;
+        ssize_t quirkIndex = CacheLookup(
+                mData, header->mQuirkTable,
+                header->mQuirksOffset, sizeof(CodecCacheQuirk), quirkName);
+
+        if (quirkIndex >= 0) {
+            const CodecCacheQuirk &quirk = CacheAt<CodecCacheQuirk>(
+                    mData, header->mQuirksOffset)[quirkIndex];
+
+            if (info.mQuirks & (1ul << quirk.mBit)) {
+                return true;
+            }
         }
     }
 
@@ -501,17 +1122,23 @@ status_t MediaCodecList::getSupportedTypes(
         size_t index, Vector<AString> *types) const {
     types->clear();
 
-    if (index >= mCodecInfos.size()) {
+    if (index >= countCodecs()) {
         return -ERANGE;
     }
 
-    const CodecInfo &info = mCodecInfos.itemAt(index);
+    const CodecCacheHeader *header = CacheHeader(mData);
+
+    const CodecCacheCodec &info =
+        CacheAt<CodecCacheCodec>(mData, header->mCodecsOffset)[index];
+
+    const CodecCacheType *cachedTypes =
+        CacheAt<CodecCacheType>(mData, header->mTypesOffset);
 
-    for (size_t i = 0; i < mTypes.size(); ++i) {
-        uint32_t typeMask = 1ul << mTypes.valueAt(i);
+    for (size_t i = 0; i < header->mNumTypes; ++i) {
+        uint32_t typeMask = 1ul << cachedTypes[i].mBit;
 
         if (info.mTypes & typeMask) {
-            types->push(mTypes.keyAt(i));
+            types->push(AString(CacheString(mData, cachedTypes[i].mName)));
         }
     }
 
@@ -526,11 +1153,12 @@ status_t MediaCodecList::getCodecCapabilities(
     profileLevels->clear();
     colorFormats->clear();
 
-    if (index >= mCodecInfos.size()) {
+    if (index >= countCodecs()) {
         return -ERANGE;
     }
 
-    const CodecInfo &info = mCodecInfos.itemAt(index);
+    const CodecCacheCodec &info = CacheAt<CodecCacheCodec>(
+            mData, CacheHeader(mData)->mCodecsOffset)[index];
 
     OMXClient client;
     status_t err = client.connect();
@@ -541,7 +1169,7 @@ status_t MediaCodecList::getCodecCapabilities(
     CodecCapabilities caps;
     err = QueryCodec(
             client.interface(),
-            info.mName.c_str(), type, info.mIsEncoder, &caps);
+            CacheString(mData, info.mName), type, info.mIsEncoder, &caps);
 
     if (err != OK) {
         return err;
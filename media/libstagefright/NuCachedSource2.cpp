@@ -35,45 +35,59 @@ struct PageCache {
     struct Page {
         void *mData;
         size_t mSize;
+        off64_t mOffset;    // A multiple of the page size
+        uint32_t mLastUse;  // For the least recently used eviction
+        bool mPinned;
     };
 
     Page *acquirePage();
     void releasePage(Page *page);
 
-    void appendPage(Page *page);
-    size_t releaseFromStart(size_t maxBytes);
+    // Returns the page for the given offset, which may end before it.
+    Page *findPage(off64_t offset) const;
+    void insertPage(Page *page);
+    void growPage(Page *page, size_t size);
 
-    size_t totalSize() const {
-        return mTotalSize;
-    }
+    // Returns how many bytes from "offset" on are cached without a gap,
+    // up to maxSize.
+    size_t contiguousSize(off64_t offset, size_t maxSize) const;
+
+    void copy(off64_t offset, void *data, size_t size);
+
+    void setPinned(off64_t offset, size_t size, bool pinned);
 
-    void copy(size_t from, void *data, size_t size);
+    // Releases the least recently used pages that are neither pinned nor
+    // within [keepStart, keepEnd), until at most maxBytes of those remain.
+    void evict(off64_t keepStart, off64_t keepEnd, size_t maxBytes);
 
 private:
     size_t mPageSize;
-    size_t mTotalSize;
+    uint32_t mUseCount;
 
-    List<Page *> mActivePages;
+    KeyedVector<off64_t, Page *> mActivePages;  // By offset
     List<Page *> mFreePages;
 
-    void freePages(List<Page *> *list);
+    static bool isRetained(const Page *page, off64_t keepStart, off64_t keepEnd) {
+        return !page->mPinned
+            && (page->mOffset + (off64_t)page->mSize <= keepStart
+                || page->mOffset >= keepEnd);
+    }
 
     DISALLOW_EVIL_CONSTRUCTORS(PageCache);
 };
 
 PageCache::PageCache(size_t pageSize)
     : mPageSize(pageSize),
-      mTotalSize(0) {
+      mUseCount(0) {
 }
 
 PageCache::~PageCache() {
-    freePages(&mActivePages);
-    freePages(&mFreePages);
-}
+    for (size_t i = 0; i < mActivePages.size(); ++i) {
+        releasePage(mActivePages.valueAt(i));
+    }
 
-void PageCache::freePages(List<Page *> *list) {
-    List<Page *>::iterator it = list->begin();
-    while (it != list->end()) {
+    List<Page *>::iterator it = mFreePages.begin();
+    while (it != mFreePages.end()) {
         Page *page = *it;
 
         free(page->mData);
@@ -105,73 +119,116 @@ void PageCache::releasePage(Page *page) {
     mFreePages.push_back(page);
 }
 
-void PageCache::appendPage(Page *page) {
-    mTotalSize += page->mSize;
-    mActivePages.push_back(page);
+PageCache::Page *PageCache::findPage(off64_t offset) const {
+    ssize_t index = mActivePages.indexOfKey(offset - offset % mPageSize);
+    return index < 0 ? NULL : mActivePages.valueAt(index);
 }
 
-size_t PageCache::releaseFromStart(size_t maxBytes) {
-    size_t bytesReleased = 0;
+void PageCache::insertPage(Page *page) {
+    CHECK_EQ(page->mOffset % mPageSize, 0);
+    CHECK_LT(mActivePages.indexOfKey(page->mOffset), 0);
 
-    while (maxBytes > 0 && !mActivePages.empty()) {
-        List<Page *>::iterator it = mActivePages.begin();
+    page->mLastUse = ++mUseCount;
+    mActivePages.add(page->mOffset, page);
+}
 
-        Page *page = *it;
+void PageCache::growPage(Page *page, size_t size) {
+    CHECK_LE(page->mSize + size, mPageSize);
+
+    page->mSize += size;
+}
 
-        if (maxBytes < page->mSize) {
+size_t PageCache::contiguousSize(off64_t offset, size_t maxSize) const {
+    ssize_t index = mActivePages.indexOfKey(offset - offset % mPageSize);
+    if (index < 0) {
+        return 0;
+    }
+
+    size_t size = 0;
+    off64_t pos = offset;
+    while (size < maxSize && index < (ssize_t)mActivePages.size()) {
+        const Page *page = mActivePages.valueAt(index);
+        off64_t end = page->mOffset + page->mSize;
+        if (page->mOffset > pos || end <= pos) {
             break;
         }
 
-        mActivePages.erase(it);
-
-        maxBytes -= page->mSize;
-        bytesReleased += page->mSize;
+        size += end - pos;
+        pos = end;
 
-        releasePage(page);
+        if (page->mSize < mPageSize) {
+            // Only partially fetched
+            break;
+        }
+        ++index;
     }
 
-    mTotalSize -= bytesReleased;
-    return bytesReleased;
+    return size < maxSize ? size : maxSize;
 }
 
-void PageCache::copy(size_t from, void *data, size_t size) {
-    ALOGV("copy from %d size %d", from, size);
+void PageCache::copy(off64_t offset, void *data, size_t size) {
+    ALOGV("copy from %lld size %d", offset, size);
 
     if (size == 0) {
         return;
     }
 
-    CHECK_LE(from + size, mTotalSize);
-
-    size_t offset = 0;
-    List<Page *>::iterator it = mActivePages.begin();
-    while (from >= offset + (*it)->mSize) {
-        offset += (*it)->mSize;
-        ++it;
-    }
-
-    size_t delta = from - offset;
-    size_t avail = (*it)->mSize - delta;
-
-    if (avail >= size) {
-        memcpy(data, (const uint8_t *)(*it)->mData + delta, size);
-        return;
-    }
-
-    memcpy(data, (const uint8_t *)(*it)->mData + delta, avail);
-    ++it;
-    data = (uint8_t *)data + avail;
-    size -= avail;
+    CHECK_EQ(contiguousSize(offset, size), size);
 
+    ssize_t index = mActivePages.indexOfKey(offset - offset % mPageSize);
     while (size > 0) {
-        size_t copy = (*it)->mSize;
+        Page *page = mActivePages.valueAt(index++);
+        page->mLastUse = ++mUseCount;
+
+        size_t delta = offset - page->mOffset;
+        size_t copy = page->mSize - delta;
         if (copy > size) {
             copy = size;
         }
-        memcpy(data, (*it)->mData, copy);
+        memcpy(data, (const uint8_t *)page->mData + delta, copy);
         data = (uint8_t *)data + copy;
+        offset += copy;
         size -= copy;
-        ++it;
+    }
+}
+
+void PageCache::setPinned(off64_t offset, size_t size, bool pinned) {
+    for (size_t i = 0; i < mActivePages.size(); ++i) {
+        Page *page = mActivePages.editValueAt(i);
+        if (page->mOffset < offset + (off64_t)size
+                && page->mOffset + (off64_t)mPageSize > offset) {
+            page->mPinned = pinned;
+        }
+    }
+}
+
+void PageCache::evict(off64_t keepStart, off64_t keepEnd, size_t maxBytes) {
+    size_t retainedBytes = 0;
+    for (size_t i = 0; i < mActivePages.size(); ++i) {
+        const Page *page = mActivePages.valueAt(i);
+        if (isRetained(page, keepStart, keepEnd)) {
+            retainedBytes += page->mSize;
+        }
+    }
+
+    while (retainedBytes > maxBytes) {
+        ssize_t lru = -1;
+        for (size_t i = 0; i < mActivePages.size(); ++i) {
+            const Page *page = mActivePages.valueAt(i);
+            if (isRetained(page, keepStart, keepEnd)
+                    && (lru < 0 || (int32_t)(page->mLastUse
+                            - mActivePages.valueAt(lru)->mLastUse) < 0)) {
+                lru = i;
+            }
+        }
+        CHECK_GE(lru, 0);
+
+        Page *page = mActivePages.valueAt(lru);
+        mActivePages.removeItemsAt(lru);
+
+        ALOGV("evicting the page at %lld", page->mOffset);
+        retainedBytes -= page->mSize;
+        releasePage(page);
     }
 }
 
@@ -196,7 +253,9 @@ NuCachedSource2::NuCachedSource2(
       mLowwaterThresholdBytes(kDefaultLowWaterThreshold),
       mKeepAliveIntervalUs(kDefaultKeepAliveIntervalUs),
       mDisconnectAtHighwatermark(disconnectAtHighwatermark),
-      mForceStop(false) {
+      mForceStop(false),
+      mPinnedBytes(0),
+      mPrefetching(false) {
     // We are NOT going to support disconnect-at-highwatermark indefinitely
     // and we are not guaranteeing support for client-specified cache
     // parameters. Both of these are temporary measures to solve a specific
@@ -292,10 +351,12 @@ void NuCachedSource2::fetchInternal() {
     ALOGV("fetchInternal");
 
     bool reconnect = false;
+    off64_t offset;
 
     {
         Mutex::Autolock autoLock(mLock);
         CHECK(mFinalStatus == OK || mNumRetriesLeft > 0);
+        offset = windowEnd_l();
 
         if (mFinalStatus != OK) {
             --mNumRetriesLeft;
@@ -309,8 +370,7 @@ void NuCachedSource2::fetchInternal() {
     }
 
     if (reconnect) {
-        status_t err =
-            mSource->reconnectAtOffset(mCacheOffset + mCache->totalSize());
+        status_t err = mSource->reconnectAtOffset(offset);
 
         Mutex::Autolock autoLock(mLock);
 
@@ -327,10 +387,7 @@ void NuCachedSource2::fetchInternal() {
         }
     }
 
-    PageCache::Page *page = mCache->acquirePage();
-
-    ssize_t n = mSource->readAt(
-            mCacheOffset + mCache->totalSize(), page->mData, kPageSize);
+    ssize_t n = readIntoCache(offset);
 
     Mutex::Autolock autoLock(mLock);
 
@@ -346,29 +403,112 @@ void NuCachedSource2::fetchInternal() {
         }
 
         ALOGE("source returned error %ld, %d retries left", n, mNumRetriesLeft);
-        mCache->releasePage(page);
     } else if (n == 0) {
         ALOGI("ERROR_END_OF_STREAM");
 
         mNumRetriesLeft = 0;
         mFinalStatus = ERROR_END_OF_STREAM;
-
-        mCache->releasePage(page);
     } else {
         if (mFinalStatus != OK) {
             ALOGI("retrying a previously failed read succeeded.");
         }
         mNumRetriesLeft = kMaxNumRetries;
         mFinalStatus = OK;
+    }
+}
+
+// Reads from the source into the page for "offset", which must be where
+// the cached data of that page ends, and returns the number of bytes read.
+ssize_t NuCachedSource2::readIntoCache(off64_t offset) {
+    PageCache::Page *page;
+    bool isNewPage;
+
+    {
+        Mutex::Autolock autoLock(mLock);
+        page = mCache->findPage(offset);
+        isNewPage = (page == NULL);
+        if (isNewPage) {
+            page = mCache->acquirePage();
+            page->mOffset = offset - offset % kPageSize;
+        }
+        CHECK_EQ(page->mOffset + (off64_t)page->mSize, offset);
+    }
+
+    // Pages are only added and evicted on this thread, so the page stays
+    // put; readers only copy the part of it that was cached before.
+    ssize_t n = mSource->readAt(
+            offset, (uint8_t *)page->mData + page->mSize, kPageSize - page->mSize);
+
+    Mutex::Autolock autoLock(mLock);
 
+    if (n <= 0) {
+        if (isNewPage) {
+            mCache->releasePage(page);
+        }
+        return n;
+    }
+
+    if (isNewPage) {
         page->mSize = n;
-        mCache->appendPage(page);
+        page->mPinned = isPinned_l(page->mOffset, kPageSize);
+        mCache->insertPage(page);
+    } else {
+        mCache->growPage(page, n);
     }
+    mCache->evict(mCacheOffset, windowEnd_l(), kMaxRetainedBytes);
+
+    return n;
+}
+
+// Fetches the next page of the first hinted range, unless the reader is
+// about to run out of data.  Returns false if there was nothing to do.
+bool NuCachedSource2::prefetchIfNecessary() {
+    off64_t offset;
+
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        if (mPrefetchRanges.empty()) {
+            return false;
+        }
+
+        // Finish a range once started: the source reconnects on every
+        // switch between it and the window.
+        if (!mPrefetching && mFetching
+                && windowEnd_l() - mLastAccessPos < kPrefetchMarginBytes) {
+            return false;
+        }
+
+        List<Range>::iterator it = mPrefetchRanges.begin();
+        size_t cached = mCache->contiguousSize(it->mOffset, it->mSize);
+        if (cached == it->mSize) {
+            mPrefetchRanges.erase(it);
+            mPrefetching = false;
+            return true;
+        }
+        offset = it->mOffset + cached;
+    }
+
+    ssize_t n = readIntoCache(offset);
+
+    Mutex::Autolock autoLock(mLock);
+
+    mPrefetching = (n > 0);
+    if (n <= 0) {
+        ALOGW("prefetching at %lld stopped: %ld", offset, n);
+        mPrefetchRanges.erase(mPrefetchRanges.begin());
+    }
+    return true;
 }
 
 void NuCachedSource2::onFetch() {
     ALOGV("onFetch");
 
+    if (prefetchIfNecessary()) {
+        (new AMessage(kWhatFetchMore, mReflector->id()))->post();
+        return;
+    }
+
     if (mFinalStatus != OK && mNumRetriesLeft == 0) {
         ALOGV("EOS reached, done prefetching for now");
         mFetching = false;
@@ -389,7 +529,13 @@ void NuCachedSource2::onFetch() {
 
         mLastFetchTimeUs = ALooper::GetNowUs();
 
-        if (mFetching && mCache->totalSize() >= mHighwaterThresholdBytes) {
+        size_t windowSize;
+        {
+            Mutex::Autolock autoLock(mLock);
+            windowSize = windowEnd_l() - mCacheOffset;
+        }
+
+        if (mFetching && windowSize >= mHighwaterThresholdBytes) {
             ALOGI("Cache full, done prefetching for now");
             mFetching = false;
 
@@ -462,13 +608,15 @@ void NuCachedSource2::restartPrefetcherIfNecessary_l(
         return;
     }
 
+    off64_t windowEnd = windowEnd_l();
     if (!ignoreLowWaterThreshold && !force
-            && mCacheOffset + mCache->totalSize() - mLastAccessPos
-                >= mLowwaterThresholdBytes) {
+            && windowEnd - mLastAccessPos >= mLowwaterThresholdBytes) {
         return;
     }
 
-    size_t maxBytes = mLastAccessPos - mCacheOffset;
+    // Never past the window: that takes a seek.
+    off64_t newOffset = mLastAccessPos < windowEnd ? mLastAccessPos : windowEnd;
+    size_t maxBytes = newOffset > mCacheOffset ? newOffset - mCacheOffset : 0;
 
     if (!force) {
         if (maxBytes < kGrayArea) {
@@ -478,10 +626,10 @@ void NuCachedSource2::restartPrefetcherIfNecessary_l(
         maxBytes -= kGrayArea;
     }
 
-    size_t actualBytes = mCache->releaseFromStart(maxBytes);
-    mCacheOffset += actualBytes;
+    // The pages left behind stay cached until evicted.
+    mCacheOffset += maxBytes - maxBytes % kPageSize;
 
-    ALOGI("restarting prefetcher, totalSize = %d", mCache->totalSize());
+    ALOGI("restarting prefetcher, totalSize = %lld", windowEnd - mCacheOffset);
     mFetching = true;
 }
 
@@ -498,13 +646,15 @@ ssize_t NuCachedSource2::readAt(off64_t offset, void *data, size_t size) {
     Mutex::Autolock autoLock(mLock);
 
     // If the request can be completely satisfied from the cache, do so.
+    // Only reads within the window tell where the reader is at; the other
+    // cached ranges are typically an index consulted along the way.
 
-    if (offset >= mCacheOffset
-            && offset + size <= mCacheOffset + mCache->totalSize()) {
-        size_t delta = offset - mCacheOffset;
-        mCache->copy(delta, data, size);
+    if (mCache->contiguousSize(offset, size) == size) {
+        mCache->copy(offset, data, size);
 
-        mLastAccessPos = offset + size;
+        if (offset >= mCacheOffset && offset <= windowEnd_l()) {
+            mLastAccessPos = offset + size;
+        }
 
         return size;
     }
@@ -535,7 +685,7 @@ ssize_t NuCachedSource2::readAt(off64_t offset, void *data, size_t size) {
 
 size_t NuCachedSource2::cachedSize() {
     Mutex::Autolock autoLock(mLock);
-    return mCacheOffset + mCache->totalSize();
+    return windowEnd_l();
 }
 
 size_t NuCachedSource2::approxDataRemaining(status_t *finalStatus) const {
@@ -551,7 +701,7 @@ size_t NuCachedSource2::approxDataRemaining_l(status_t *finalStatus) const {
         *finalStatus = OK;
     }
 
-    off64_t lastBytePosCached = mCacheOffset + mCache->totalSize();
+    off64_t lastBytePosCached = windowEnd_l();
     if (mLastAccessPos < lastBytePosCached) {
         return lastBytePosCached - mLastAccessPos;
     }
@@ -572,8 +722,14 @@ ssize_t NuCachedSource2::readInternal(off64_t offset, void *data, size_t size) {
                 true); // force
     }
 
-    if (offset < mCacheOffset
-            || offset >= (off64_t)(mCacheOffset + mCache->totalSize())) {
+    size_t cached = mCache->contiguousSize(offset, size);
+    if (cached == size) {
+        mCache->copy(offset, data, size);
+
+        return size;
+    }
+
+    if (offset < mCacheOffset || offset >= windowEnd_l()) {
         static const off64_t kPadding = 0; //256 * 1024;
 
         // In the presence of multiple decoded streams, once of them will
@@ -585,28 +741,14 @@ ssize_t NuCachedSource2::readInternal(off64_t offset, void *data, size_t size) {
         seekInternal_l(seekOffset);
     }
 
-    size_t delta = offset - mCacheOffset;
-
     if (mFinalStatus != OK && mNumRetriesLeft == 0) {
-        if (delta >= mCache->totalSize()) {
+        if (cached == 0) {
             return mFinalStatus;
         }
 
-        size_t avail = mCache->totalSize() - delta;
-
-        if (avail > size) {
-            avail = size;
-        }
-
-        mCache->copy(delta, data, avail);
+        mCache->copy(offset, data, cached);
 
-        return avail;
-    }
-
-    if (offset + size <= mCacheOffset + mCache->totalSize()) {
-        mCache->copy(delta, data, size);
-
-        return size;
+        return cached;
     }
 
     ALOGV("deferring read");
@@ -617,17 +759,15 @@ ssize_t NuCachedSource2::readInternal(off64_t offset, void *data, size_t size) {
 status_t NuCachedSource2::seekInternal_l(off64_t offset) {
     mLastAccessPos = offset;
 
-    if (offset >= mCacheOffset
-            && offset <= (off64_t)(mCacheOffset + mCache->totalSize())) {
+    if (offset >= mCacheOffset && offset <= windowEnd_l()) {
         return OK;
     }
 
     ALOGI("new range: offset= %lld", offset);
 
-    mCacheOffset = offset;
-
-    size_t totalSize = mCache->totalSize();
-    CHECK_EQ(mCache->releaseFromStart(totalSize), totalSize);
+    // The previous window stays cached until evicted, and the new one
+    // takes in whatever is cached from its start on.
+    mCacheOffset = offset - offset % kPageSize;
 
     if(mFinalStatus < 0) {
          mForceReconnect = true;
@@ -663,6 +803,112 @@ String8 NuCachedSource2::getMIMEType() const {
     return mSource->getMIMEType();
 }
 
+void NuCachedSource2::hintRange(off64_t offset, size_t size, bool pin) {
+    Mutex::Autolock autoSerializer(mSerializer);
+
+    ALOGV("hintRange offset %lld, size %d, pin %d", offset, size, pin);
+
+    Range range;
+    pageAlignRange(offset, size, &range);
+
+    Mutex::Autolock autoLock(mLock);
+
+    if (pin) {
+        if (mPinnedBytes + range.mSize > kMaxPinnedBytes) {
+            ALOGI("Not pinning %d bytes at %lld, too many pinned already",
+                 size, offset);
+            pin = false;
+        } else {
+            mPinnedRanges.push_back(range);
+            mPinnedBytes += range.mSize;
+            mCache->setPinned(range.mOffset, range.mSize, true);
+        }
+    }
+
+    if (mCache->contiguousSize(range.mOffset, range.mSize) == range.mSize) {
+        return;
+    }
+
+    if (pin) {
+        // Fetched alongside the window, when there is time for it.
+        mPrefetchRanges.push_back(range);
+    } else if (offset < mCacheOffset || offset > windowEnd_l()) {
+        // To be read next: start fetching it right away.
+        seekInternal_l(offset);
+    }
+}
+
+void NuCachedSource2::releaseRange(off64_t offset, size_t size) {
+    Mutex::Autolock autoSerializer(mSerializer);
+
+    ALOGV("releaseRange offset %lld, size %d", offset, size);
+
+    Range range;
+    pageAlignRange(offset, size, &range);
+
+    Mutex::Autolock autoLock(mLock);
+
+    List<Range>::iterator it = mPinnedRanges.begin();
+    while (it != mPinnedRanges.end()
+            && (it->mOffset != range.mOffset || it->mSize != range.mSize)) {
+        ++it;
+    }
+    if (it == mPinnedRanges.end()) {
+        // Not pinned in the first place, e.g. over the limit.
+        return;
+    }
+    mPinnedRanges.erase(it);
+    mPinnedBytes -= range.mSize;
+
+    // Neighbouring ranges may share a page with this one.
+    mCache->setPinned(range.mOffset, range.mSize, false);
+    for (it = mPinnedRanges.begin(); it != mPinnedRanges.end(); ++it) {
+        mCache->setPinned(it->mOffset, it->mSize, true);
+    }
+
+    for (it = mPrefetchRanges.begin(); it != mPrefetchRanges.end(); ++it) {
+        if (it->mOffset == range.mOffset && it->mSize == range.mSize) {
+            if (it == mPrefetchRanges.begin()) {
+                mPrefetching = false;
+            }
+            mPrefetchRanges.erase(it);
+            break;
+        }
+    }
+}
+
+// Rounds the range out to whole pages, which are what the cache reads, but
+// not past the end of the source.
+void NuCachedSource2::pageAlignRange(off64_t offset, size_t size, Range *range) {
+    off64_t end = offset + size;
+    if (end % kPageSize != 0) {
+        end += kPageSize - end % kPageSize;
+    }
+
+    off64_t sourceSize;
+    if (mSource->getSize(&sourceSize) == OK && end > sourceSize) {
+        end = sourceSize;
+    }
+
+    range->mOffset = offset - offset % kPageSize;
+    range->mSize = end > range->mOffset ? end - range->mOffset : 0;
+}
+
+off64_t NuCachedSource2::windowEnd_l() const {
+    return mCacheOffset + mCache->contiguousSize(mCacheOffset, ~(size_t)0);
+}
+
+bool NuCachedSource2::isPinned_l(off64_t offset, size_t size) const {
+    for (List<Range>::const_iterator it = mPinnedRanges.begin();
+         it != mPinnedRanges.end(); ++it) {
+        if (it->mOffset < offset + (off64_t)size
+                && it->mOffset + (off64_t)it->mSize > offset) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void NuCachedSource2::updateCacheParamsFromSystemProperty() {
     char value[PROPERTY_VALUE_MAX];
     if (!property_get("media.stagefright.cache-params", value, NULL)) {
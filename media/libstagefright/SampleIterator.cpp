@@ -30,6 +30,10 @@
 
 namespace android {
 
+// Seeks up to this many samples ahead walk the time-to-sample table,
+// farther ones look the entry up in SampleTable's checkpoints.
+static const uint32_t kMaxTimeToSampleWalk = 64;
+
 SampleIterator::SampleIterator(SampleTable *table)
     : mTable(table),
       mInitialized(false),
@@ -124,10 +128,14 @@ status_t SampleIterator::seekTo(uint32_t sampleIndex) {
     }
 
     mCurrentSampleSize = mCurrentChunkSampleSizes[chunkRelativeSampleIndex];
-    if (sampleIndex < mTTSSampleIndex) {
-        mTimeToSampleIndex = 0;
-        mTTSSampleIndex = 0;
-        mTTSSampleTime = 0;
+    if (sampleIndex < mTTSSampleIndex
+            || sampleIndex - mTTSSampleIndex >= mTTSCount + kMaxTimeToSampleWalk) {
+        // Jump to the time-to-sample entry of the sample instead of walking
+        // there, findSampleTime() loads it.
+        uint32_t entry;
+        mTable->findTimeToSampleEntry(
+                sampleIndex, &entry, &mTTSSampleIndex, &mTTSSampleTime);
+        mTimeToSampleIndex = entry;
         mTTSCount = 0;
         mTTSDuration = 0;
     }
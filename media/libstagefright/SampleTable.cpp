@@ -40,8 +40,20 @@ const uint32_t SampleTable::kSampleSizeTypeCompact = FOURCC('s', 't', 'z', '2');
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Every kTimeToSampleCheckpointInterval-th time-to-sample entry and every
+// kCompositionCheckpointInterval-th composition offset entry is checkpointed,
+// which bounds the walk to find any sample to that many entries.
+static const uint32_t kTimeToSampleCheckpointInterval = 64;
+static const uint32_t kCompositionCheckpointInterval = 64;
+
+// findSampleAtTime() looks for the sample among those decoded within the
+// spread of the composition offsets around the requested time, unless that
+// window holds more than this many samples.
+static const uint32_t kMaxSamplesToSearch = 8192;
+
 struct SampleTable::CompositionDeltaLookup {
     CompositionDeltaLookup();
+    ~CompositionDeltaLookup();
 
     void setEntries(
             const uint32_t *deltaEntries, size_t numDeltaEntries);
@@ -54,6 +66,10 @@ private:
     const uint32_t *mDeltaEntries;
     size_t mNumDeltaEntries;
 
+    // The first sample of every kCompositionCheckpointInterval-th entry.
+    uint32_t *mCheckpoints;
+    size_t mNumCheckpoints;
+
     size_t mCurrentDeltaEntry;
     size_t mCurrentEntrySampleIndex;
 
@@ -63,10 +79,17 @@ private:
 SampleTable::CompositionDeltaLookup::CompositionDeltaLookup()
     : mDeltaEntries(NULL),
       mNumDeltaEntries(0),
+      mCheckpoints(NULL),
+      mNumCheckpoints(0),
       mCurrentDeltaEntry(0),
       mCurrentEntrySampleIndex(0) {
 }
 
+SampleTable::CompositionDeltaLookup::~CompositionDeltaLookup() {
+    delete[] mCheckpoints;
+    mCheckpoints = NULL;
+}
+
 void SampleTable::CompositionDeltaLookup::setEntries(
         const uint32_t *deltaEntries, size_t numDeltaEntries) {
     Mutex::Autolock autolock(mLock);
@@ -75,6 +98,19 @@ void SampleTable::CompositionDeltaLookup::setEntries(
     mNumDeltaEntries = numDeltaEntries;
     mCurrentDeltaEntry = 0;
     mCurrentEntrySampleIndex = 0;
+
+    delete[] mCheckpoints;
+    mNumCheckpoints = (numDeltaEntries + kCompositionCheckpointInterval - 1)
+            / kCompositionCheckpointInterval;
+    mCheckpoints = new uint32_t[mNumCheckpoints];
+
+    uint32_t sampleIndex = 0;
+    for (size_t i = 0; i < numDeltaEntries; ++i) {
+        if (i % kCompositionCheckpointInterval == 0) {
+            mCheckpoints[i / kCompositionCheckpointInterval] = sampleIndex;
+        }
+        sampleIndex += deltaEntries[2 * i];
+    }
 }
 
 uint32_t SampleTable::CompositionDeltaLookup::getCompositionTimeOffset(
@@ -85,9 +121,27 @@ uint32_t SampleTable::CompositionDeltaLookup::getCompositionTimeOffset(
         return 0;
     }
 
-    if (sampleIndex < mCurrentEntrySampleIndex) {
-        mCurrentDeltaEntry = 0;
-        mCurrentEntrySampleIndex = 0;
+    size_t nextCheckpoint =
+        mCurrentDeltaEntry / kCompositionCheckpointInterval + 1;
+
+    if (sampleIndex < mCurrentEntrySampleIndex
+            || (nextCheckpoint < mNumCheckpoints
+                && mCheckpoints[nextCheckpoint] <= sampleIndex)) {
+        // Not within walking distance, restart from the last checkpoint
+        // at or before the sample.
+        size_t left = 0;
+        size_t right = mNumCheckpoints;
+        while (right - left > 1) {
+            size_t center = left + (right - left) / 2;
+            if (mCheckpoints[center] <= sampleIndex) {
+                left = center;
+            } else {
+                right = center;
+            }
+        }
+
+        mCurrentDeltaEntry = left * kCompositionCheckpointInterval;
+        mCurrentEntrySampleIndex = mCheckpoints[left];
     }
 
     while (mCurrentDeltaEntry < mNumDeltaEntries) {
@@ -118,10 +172,15 @@ SampleTable::SampleTable(const sp<DataSource> &source)
       mNumSampleSizes(0),
       mTimeToSampleCount(0),
       mTimeToSample(NULL),
+      mTimeToSampleCheckpoints(NULL),
+      mNumTimeToSampleCheckpoints(0),
+      mNumTimedSamples(0),
       mSampleTimeEntries(NULL),
       mCompositionTimeDeltaEntries(NULL),
       mNumCompositionTimeDeltaEntries(0),
       mCompositionDeltaLookup(new CompositionDeltaLookup),
+      mMinCompositionTimeOffset(0),
+      mMaxCompositionTimeOffset(0),
       mSyncSampleOffset(-1),
       mNumSyncSamples(0),
       mSyncSamples(NULL),
@@ -146,6 +205,9 @@ SampleTable::~SampleTable() {
     delete[] mSampleTimeEntries;
     mSampleTimeEntries = NULL;
 
+    delete[] mTimeToSampleCheckpoints;
+    mTimeToSampleCheckpoints = NULL;
+
     delete[] mTimeToSample;
     mTimeToSample = NULL;
 
@@ -342,6 +404,31 @@ status_t SampleTable::setTimeToSampleParams(
         mTimeToSample[i] = ntohl(mTimeToSample[i]);
     }
 
+    mNumTimeToSampleCheckpoints =
+        (mTimeToSampleCount + kTimeToSampleCheckpointInterval - 1)
+            / kTimeToSampleCheckpointInterval;
+    mTimeToSampleCheckpoints =
+        new TimeToSampleCheckpoint[mNumTimeToSampleCheckpoints];
+
+    uint64_t sampleIndex = 0;
+    uint64_t sampleTime = 0;
+    for (uint32_t i = 0; i < mTimeToSampleCount; ++i) {
+        if (i % kTimeToSampleCheckpointInterval == 0) {
+            TimeToSampleCheckpoint *checkpoint =
+                &mTimeToSampleCheckpoints[i / kTimeToSampleCheckpointInterval];
+            checkpoint->mSampleIndex = sampleIndex;
+            checkpoint->mTime = sampleTime;
+        }
+
+        sampleIndex += mTimeToSample[2 * i];
+        sampleTime += (uint64_t)mTimeToSample[2 * i] * mTimeToSample[2 * i + 1];
+
+        if (sampleIndex > 0xffffffffull) {
+            return ERROR_MALFORMED;
+        }
+    }
+    mNumTimedSamples = sampleIndex;
+
     return OK;
 }
 
@@ -388,6 +475,18 @@ status_t SampleTable::setCompositionTimeToSampleParams(
         mCompositionTimeDeltaEntries[i] = ntohl(mCompositionTimeDeltaEntries[i]);
     }
 
+    // Offsets are signed in version 1, and read as such by SampleIterator.
+    // Samples beyond the table have no offset, so the range includes 0.
+    for (size_t i = 0; i < numEntries; ++i) {
+        int32_t offset = (int32_t)mCompositionTimeDeltaEntries[2 * i + 1];
+        if (offset < mMinCompositionTimeOffset) {
+            mMinCompositionTimeOffset = offset;
+        }
+        if (offset > mMaxCompositionTimeOffset) {
+            mMaxCompositionTimeOffset = offset;
+        }
+    }
+
     mCompositionDeltaLookup->setEntries(
             mCompositionTimeDeltaEntries, mNumCompositionTimeDeltaEntries);
 
@@ -479,6 +578,238 @@ int SampleTable::CompareIncreasingTime(const void *_a, const void *_b) {
     return 0;
 }
 
+void SampleTable::findTimeToSampleEntry(
+        uint32_t sampleIndex, uint32_t *entry,
+        uint32_t *entrySampleIndex, uint64_t *entryTime) const {
+    *entry = 0;
+    *entrySampleIndex = 0;
+    *entryTime = 0;
+
+    if (mNumTimeToSampleCheckpoints == 0) {
+        return;
+    }
+
+    uint32_t left = 0;
+    uint32_t right = mNumTimeToSampleCheckpoints;
+    while (right - left > 1) {
+        uint32_t center = left + (right - left) / 2;
+        if (mTimeToSampleCheckpoints[center].mSampleIndex <= sampleIndex) {
+            left = center;
+        } else {
+            right = center;
+        }
+    }
+
+    uint32_t i = left * kTimeToSampleCheckpointInterval;
+    uint32_t firstSampleIndex = mTimeToSampleCheckpoints[left].mSampleIndex;
+    uint64_t time = mTimeToSampleCheckpoints[left].mTime;
+
+    while (i + 1 < mTimeToSampleCount
+            && sampleIndex >= firstSampleIndex + mTimeToSample[2 * i]) {
+        firstSampleIndex += mTimeToSample[2 * i];
+        time += (uint64_t)mTimeToSample[2 * i] * mTimeToSample[2 * i + 1];
+        ++i;
+    }
+
+    *entry = i;
+    *entrySampleIndex = firstSampleIndex;
+    *entryTime = time;
+}
+
+uint64_t SampleTable::getDecodeTime(uint32_t sampleIndex) const {
+    uint32_t entry;
+    uint32_t entrySampleIndex;
+    uint64_t entryTime;
+    findTimeToSampleEntry(sampleIndex, &entry, &entrySampleIndex, &entryTime);
+
+    if (mTimeToSampleCount == 0) {
+        return 0;
+    }
+
+    return entryTime
+        + (uint64_t)mTimeToSample[2 * entry + 1] * (sampleIndex - entrySampleIndex);
+}
+
+uint32_t SampleTable::findFirstSampleDecodedAt(int64_t time) const {
+    if (time <= 0 || mNumTimeToSampleCheckpoints == 0) {
+        return 0;
+    }
+
+    // The first checkpoint is at time 0, before "time".
+    uint32_t left = 0;
+    uint32_t right = mNumTimeToSampleCheckpoints;
+    while (right - left > 1) {
+        uint32_t center = left + (right - left) / 2;
+        if ((int64_t)mTimeToSampleCheckpoints[center].mTime < time) {
+            left = center;
+        } else {
+            right = center;
+        }
+    }
+
+    uint32_t firstSampleIndex = mTimeToSampleCheckpoints[left].mSampleIndex;
+    uint64_t entryTime = mTimeToSampleCheckpoints[left].mTime;
+
+    for (uint32_t i = left * kTimeToSampleCheckpointInterval;
+            i < mTimeToSampleCount; ++i) {
+        uint32_t count = mTimeToSample[2 * i];
+        uint32_t delta = mTimeToSample[2 * i + 1];
+
+        if ((int64_t)entryTime >= time) {
+            return firstSampleIndex;
+        }
+
+        if (delta > 0) {
+            uint64_t n = (time - entryTime + delta - 1) / delta;
+            if (n < count) {
+                return firstSampleIndex + n;
+            }
+        }
+
+        firstSampleIndex += count;
+        entryTime += (uint64_t)count * delta;
+    }
+
+    return mNumTimedSamples;
+}
+
+status_t SampleTable::getSampleTime(uint32_t sampleIndex, uint64_t *time) {
+    if (sampleIndex >= mNumTimedSamples) {
+        return ERROR_OUT_OF_RANGE;
+    }
+
+    *time = getDecodeTime(sampleIndex);
+    *time += (int32_t)getCompositionTimeOffset(sampleIndex);
+
+    return OK;
+}
+
+// Samples are presented no earlier than mMinCompositionTimeOffset and no later
+// than mMaxCompositionTimeOffset after they are decoded, so only a window of
+// samples, typically a few frames around a group of pictures, can be presented
+// around req_time.  Returns ERROR_UNSUPPORTED if that window is too large.
+status_t SampleTable::findSampleAtTimeInWindow(
+        uint64_t req_time, uint32_t *sample_index, uint32_t flags) {
+    uint32_t numSamples = mNumTimedSamples < mNumSampleSizes
+        ? mNumTimedSamples : mNumSampleSizes;
+
+    if (numSamples == 0) {
+        return ERROR_OUT_OF_RANGE;
+    }
+
+    int64_t time = req_time;
+    int64_t minOffset = mMinCompositionTimeOffset;
+    int64_t maxOffset = mMaxCompositionTimeOffset;
+
+    // Some sample decoded before "time - maxOffset" is presented before
+    // "time", and after every sample decoded before "first".
+    uint32_t first = 0;
+    uint32_t decodedLater = findFirstSampleDecodedAt(time - maxOffset);
+    if (decodedLater > 0) {
+        uint32_t before = (decodedLater < numSamples ? decodedLater : numSamples) - 1;
+        first = findFirstSampleDecodedAt(getDecodeTime(before) + minOffset - maxOffset);
+    }
+
+    // Some sample decoded at or after "time - minOffset" is presented at or
+    // after "time", and before every sample decoded at or after "end".
+    uint32_t end = numSamples;
+    uint32_t after = findFirstSampleDecodedAt(time - minOffset);
+    if (after < numSamples) {
+        end = findFirstSampleDecodedAt(getDecodeTime(after) + maxOffset - minOffset + 1);
+        if (end > numSamples) {
+            end = numSamples;
+        }
+    }
+
+    if (first >= end || end - first > kMaxSamplesToSearch) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    // The samples presented closest at, before and after req_time, and the
+    // first and last samples presented in the window, which are the first
+    // and last of the track if nothing is presented before or after req_time.
+    bool hasAtOrBefore = false, hasBefore = false, hasAtOrAfter = false;
+    uint32_t atOrBefore = 0, before = 0, atOrAfter = 0, earliest = 0, latest = 0;
+    int64_t atOrBeforeTime = 0, beforeTime = 0, atOrAfterTime = 0;
+    int64_t earliestTime = 0, latestTime = 0;
+
+    uint32_t entry;
+    uint32_t entrySampleIndex;
+    uint64_t entryTime;
+    findTimeToSampleEntry(first, &entry, &entrySampleIndex, &entryTime);
+
+    for (uint32_t i = first; i < end; ++i) {
+        while (entry + 1 < mTimeToSampleCount
+                && i >= entrySampleIndex + mTimeToSample[2 * entry]) {
+            entrySampleIndex += mTimeToSample[2 * entry];
+            entryTime += (uint64_t)mTimeToSample[2 * entry] * mTimeToSample[2 * entry + 1];
+            ++entry;
+        }
+
+        int64_t t = entryTime
+            + (uint64_t)mTimeToSample[2 * entry + 1] * (i - entrySampleIndex);
+        t += (int32_t)getCompositionTimeOffset(i);
+
+        if (i == first || t < earliestTime) {
+            earliest = i;
+            earliestTime = t;
+        }
+        if (i == first || t > latestTime) {
+            latest = i;
+            latestTime = t;
+        }
+
+        if (t <= time && (!hasAtOrBefore || t > atOrBeforeTime)) {
+            hasAtOrBefore = true;
+            atOrBefore = i;
+            atOrBeforeTime = t;
+        }
+        if (t < time && (!hasBefore || t > beforeTime)) {
+            hasBefore = true;
+            before = i;
+            beforeTime = t;
+        }
+        if (t >= time && (!hasAtOrAfter || t < atOrAfterTime)) {
+            hasAtOrAfter = true;
+            atOrAfter = i;
+            atOrAfterTime = t;
+        }
+    }
+
+    switch (flags) {
+        case kFlagBefore:
+        {
+            *sample_index = hasAtOrBefore ? atOrBefore : earliest;
+            break;
+        }
+
+        case kFlagAfter:
+        {
+            if (!hasAtOrAfter) {
+                return ERROR_OUT_OF_RANGE;
+            }
+            *sample_index = atOrAfter;
+            break;
+        }
+
+        default:
+        {
+            CHECK(flags == kFlagClosest);
+
+            if (!hasAtOrAfter) {
+                *sample_index = latest;
+            } else if (hasBefore && atOrAfterTime - time > time - beforeTime) {
+                *sample_index = before;
+            } else {
+                *sample_index = atOrAfter;
+            }
+            break;
+        }
+    }
+
+    return OK;
+}
+
 void SampleTable::buildSampleEntriesTable() {
     Mutex::Autolock autoLock(mLock);
 
@@ -503,7 +834,7 @@ void SampleTable::buildSampleEntriesTable() {
 
                 mSampleTimeEntries[sampleIndex].mSampleIndex = sampleIndex;
 
-                uint32_t compTimeDelta =
+                int32_t compTimeDelta =
                     mCompositionDeltaLookup->getCompositionTimeOffset(
                             sampleIndex);
 
@@ -522,6 +853,11 @@ void SampleTable::buildSampleEntriesTable() {
 
 status_t SampleTable::findSampleAtTime(
         uint64_t req_time, uint32_t *sample_index, uint32_t flags) {
+    status_t err = findSampleAtTimeInWindow(req_time, sample_index, flags);
+    if (err != ERROR_UNSUPPORTED) {
+        return err;
+    }
+
     buildSampleEntriesTable();
 
     uint32_t left = 0;
@@ -654,26 +990,22 @@ status_t SampleTable::findSyncSampleNear(
 
         // our sample lies between sync samples x and y.
 
-        status_t err = mSampleIterator->seekTo(start_sample_index);
+        uint64_t sample_time, x_time, y_time;
+        status_t err = getSampleTime(start_sample_index, &sample_time);
         if (err != OK) {
             return err;
         }
 
-        uint32_t sample_time = mSampleIterator->getSampleTime();
-
-        err = mSampleIterator->seekTo(x);
+        err = getSampleTime(x, &x_time);
         if (err != OK) {
             return err;
         }
-        uint64_t x_time = mSampleIterator->getSampleTime();
 
-        err = mSampleIterator->seekTo(y);
+        err = getSampleTime(y, &y_time);
         if (err != OK) {
             return err;
         }
 
-        uint64_t y_time = mSampleIterator->getSampleTime();
-
         if (abs_difference(x_time, sample_time)
                 > abs_difference(y_time, sample_time)) {
             // Pick the sync sample closest (timewise) to the start-sample.
@@ -22,6 +22,7 @@
 
 #include <media/stagefright/foundation/ABitReader.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/bytescan.h>
 #include <media/stagefright/MediaDefs.h>
 #include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/MetaData.h>
@@ -166,27 +167,18 @@ status_t getNextNALUnit(
 
     size_t startOffset = offset;
 
-    for (;;) {
-        while (offset < size && data[offset] != 0x01) {
-            ++offset;
-        }
-
-        if (offset == size) {
-            if (startCodeFollows) {
-                offset = size + 2;
-                break;
-            }
+    // The byte before startOffset is 0x01, so the next start code cannot
+    // begin before it.
+    offset = startOffset + findStartCodePrefix(
+            &data[startOffset], size - startOffset);
 
-            return -EAGAIN;
-        }
-
-        if (data[offset - 1] == 0x00 && data[offset - 2] == 0x00) {
-            break;
-        }
-
-        ++offset;
+    if (offset == size && !startCodeFollows) {
+        return -EAGAIN;
     }
 
+    // Point offset at the 0x01 of the next start code.
+    offset += 2;
+
     size_t endOffset = offset - 2;
     while (endOffset > startOffset + 1 && data[endOffset - 1] == 0x00) {
         --endOffset;
@@ -15,7 +15,9 @@ LOCAL_SRC_FILES := \
     src/residual.cpp \
     src/sad.cpp \
     src/sad_halfpel.cpp \
+    src/sad_simd.cpp \
     src/slice.cpp \
+    src/thread_pool.cpp \
     src/vlc_encode.cpp
 
 
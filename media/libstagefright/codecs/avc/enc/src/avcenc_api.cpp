@@ -82,6 +82,8 @@ OSCL_EXPORT_REF AVCEnc_Status PVAVCEncInitialize(AVCHandle *avcHandle, AVCEncPar
 
     encvid->avcHandle = avcHandle;
 
+    encvid->threadPool = NULL;
+
     encvid->common = (AVCCommonObj*) avcHandle->CBAVC_Malloc(userData, sizeof(AVCCommonObj), DEFAULT_ATTR);
     if (encvid->common == NULL)
     {
@@ -222,6 +224,29 @@ OSCL_EXPORT_REF AVCEnc_Status PVAVCEncInitialize(AVCHandle *avcHandle, AVCEncPar
     encvid->functionPointer->SAD_MB_HalfPel[1] = &AVCSAD_MB_HalfPel_Cxh;
     encvid->functionPointer->SAD_MB_HalfPel[2] = &AVCSAD_MB_HalfPel_Cyh;
     encvid->functionPointer->SAD_MB_HalfPel[3] = &AVCSAD_MB_HalfPel_Cxhyh;
+    encvid->functionPointer->SATD_MB = &SATD_MB;
+    encvid->functionPointer->GenerateQuartPelPred = &GenerateQuartPelPred;
+#ifdef AVCENC_SIMD
+    if (AVCEncSIMDSupported())
+    {
+        encvid->functionPointer->SAD_Macroblock = &AVCSAD_Macroblock_SIMD;
+        encvid->functionPointer->SAD_MB_HalfPel[1] = &AVCSAD_MB_HalfPel_SIMDxh;
+        encvid->functionPointer->SAD_MB_HalfPel[2] = &AVCSAD_MB_HalfPel_SIMDyh;
+        encvid->functionPointer->SAD_MB_HalfPel[3] = &AVCSAD_MB_HalfPel_SIMDxhyh;
+        encvid->functionPointer->SATD_MB = &SATD_MB_SIMD;
+        encvid->functionPointer->GenerateQuartPelPred = &GenerateQuartPelPred_SIMD;
+    }
+#endif
+
+    /* start the worker threads, or else do everything in the calling thread */
+    if (encParam->num_threads > 1)
+    {
+        status = InitThreadPool(avcHandle, AVC_MIN(encParam->num_threads, AVC_MAX_THREADS));
+        if (status != AVCENC_SUCCESS)
+        {
+            CleanThreadPool(avcHandle);
+        }
+    }
 
     /* initialize timing control */
     encvid->modTimeRef = 0;     /* ALWAYS ASSUME THAT TIMESTAMP START FROM 0 !!!*/
@@ -437,6 +462,7 @@ OSCL_EXPORT_REF AVCEnc_Status PVAVCEncodeNAL(AVCHandle *avcHandle, unsigned char
         case AVCEnc_Encoding_Frame:
             /* initialized the structure */
             BitstreamEncInit(bitstream, buffer, *buf_nal_size, encvid->overrunBuffer, encvid->oBSize);
+
             BitstreamWriteBits(bitstream, 8, (video->nal_ref_idc << 5) | (video->nal_unit_type));
 
             /* Re-order the reference list according to the ref_pic_list_reordering() */
@@ -596,6 +622,8 @@ OSCL_EXPORT_REF void    PVAVCCleanUpEncoder(AVCHandle *avcHandle)
 
     if (encvid != NULL)
     {
+        CleanThreadPool(avcHandle);
+
         CleanMotionSearchModule(avcHandle);
 
         CleanupRateControlModule(avcHandle);
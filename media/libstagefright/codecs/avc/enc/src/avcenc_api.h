@@ -158,6 +158,10 @@ typedef struct tagAVCEncParam
 
     AVCFlag use_overrun_buffer;  /* do not throw away the frame if output buffer is not big enough.
                                     copy excess bits to the overrun buffer */
+
+    int num_threads;    /* number of threads including the calling one. Motion estimation runs
+                        over the MB rows in parallel. 0 or 1 to do everything in the calling
+                        thread, as is done if the threads cannot be started. */
 } AVCEncParams;
 
 
@@ -31,6 +31,8 @@ and necessary type defitionitions and enumerations.
 #include "avcenc_api.h"
 #endif
 
+#include <pthread.h>
+
 typedef float OsclFloat;
 
 /* Definition for the structures below */
@@ -86,6 +88,8 @@ typedef float OsclFloat;
 
 #define DEFAULT_OVERRUN_BUFFER_SIZE 1000
 
+#define AVC_MAX_THREADS 8 /* maximum number of threads, including the calling one */
+
 // associated with the above cost model
 const uint8 COEFF_COST[2][16] =
 {
@@ -336,6 +340,8 @@ typedef struct tagAVCEncFuncPtr
 
     int (*SAD_MB_HalfPel[4])(uint8*, uint8*, int, void *);
     int (*SAD_Macroblock)(uint8 *ref, uint8 *blk, int dmin_lx, void *extra_info);
+    int (*SATD_MB)(uint8 *cand, uint8 *cur, int dmin);
+    void (*GenerateQuartPelPred)(uint8 **bilin_base, uint8 *qpel_cand, int hpel_pos);
 
 } AVCEncFuncPtr;
 
@@ -463,9 +469,67 @@ typedef struct tagEncObject
     /* Application control data */
     AVCHandle *avcHandle;
 
+    /* worker threads, NULL when everything is done in the calling thread */
+    struct tagEncThreadPool *threadPool;
 
 } AVCEncObject;
 
+/**
+This structure is the private state of one thread of the thread pool. The thread runs
+motion estimation on copies of the encoder and common objects, which share the picture,
+the macroblock array and the motion vectors with the originals but have their own
+scratch memory and current macroblock state.
+@publishedAll
+*/
+typedef struct tagEncThread
+{
+    AVCEncObject    encvid;
+    AVCCommonObj    video;
+    AVCRateControl  rateCtrl;
+    AVCSliceHeader  sliceHdr;
+
+    struct tagEncThreadPool *pool;  /* pool the thread belongs to */
+
+    /* motion estimation statistics of the macroblocks done by this thread */
+    int     numIntraSearch;
+    int     totalSAD;
+
+} AVCEncThread;
+
+/**
+This structure is the thread pool of the encoder. Motion estimation hands out rows of
+macroblocks, a row may only get to a macroblock once the row above is two macroblocks
+ahead so that every motion vector candidate is the same as in raster scan order. All
+fields below mutex are protected by it.
+@publishedAll
+*/
+typedef struct tagEncThreadPool
+{
+    pthread_t   threads[AVC_MAX_THREADS];
+    int         numThreads;     /* number of worker threads */
+
+    /* one for each worker thread */
+    AVCEncThread *context[AVC_MAX_THREADS];
+
+    pthread_mutex_t mutex;
+    pthread_cond_t  start;      /* a job is available or the pool is going away */
+    pthread_cond_t  done;       /* all worker threads finished the job */
+    pthread_cond_t  progress;   /* a row of motion estimation has advanced */
+
+    int         quit;
+    uint        jobId;          /* incremented for every motion estimation pass */
+    int         running;        /* number of worker threads still on the job */
+
+    /* per pass */
+    int         startRowParity; /* first column of row 0, incr_i of 2 alternates it per row */
+    int         incr_i;
+    int         type_pred;
+    int         nextRow;
+    int         *rowDone;       /* number of columns of each row done */
+    int         numWaiting;     /* number of threads waiting for progress */
+
+} AVCEncThreadPool;
+
 
 #endif /*AVCENC_INT_H_INCLUDED*/
 
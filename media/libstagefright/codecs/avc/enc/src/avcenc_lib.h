@@ -504,6 +504,21 @@ extern "C"
     */
     void AVCMotionEstimation(AVCEncObject *encvid);
 
+    /**
+    This function performs motion estimation of one macroblock for AVCMotionEstimation.
+    The macroblocks of a pass may be done in any order in which the left, top-left, top and
+    top-right neighbors of a macroblock are done before it and the bottom one after it.
+    \param "encvid" "Pointer to AVCEncObject."
+    \param "i"      "Horizontal position of the macroblock in MB unit."
+    \param "j"      "Vertical position of the macroblock in MB unit."
+    \param "type_pred" "Type of candidate selection of the pass."
+    \param "NumIntraSearch" "Number of MBs to be intra searched, to be incremented."
+    \param "totalSAD" "Sum of the MAD of the MBs, to be incremented."
+    \return "void"
+    */
+    void AVCMBMotionEstimation(AVCEncObject *encvid, int i, int j, int type_pred,
+                               int *NumIntraSearch, int *totalSAD);
+
     /**
     This function performs repetitive edge padding to the reference picture by adding 16 pixels
     around the luma and 8 pixels around the chromas.
@@ -805,6 +820,28 @@ extern "C"
     int AVCSAD_MB_HalfPel_Cxh(uint8 *ref, uint8 *blk, int dmin_lx, void *extra_info);
     int AVCSAD_Macroblock_C(uint8 *ref, uint8 *blk, int dmin_lx, void *extra_info);
 
+    /*------------- sad_simd.c ----------------------*/
+
+#if defined(__SSE2__)
+#define AVCENC_SIMD
+#endif
+
+#ifdef AVCENC_SIMD
+    /**
+    This function checks whether the CPU we run on can execute the SSE2
+    versions of the SAD and sub-pel functions below.
+    \return "1 if the SIMD functions can be used, 0 otherwise."
+    */
+    int AVCEncSIMDSupported(void);
+
+    int AVCSAD_MB_HalfPel_SIMDxhyh(uint8 *ref, uint8 *blk, int dmin_lx, void *extra_info);
+    int AVCSAD_MB_HalfPel_SIMDyh(uint8 *ref, uint8 *blk, int dmin_lx, void *extra_info);
+    int AVCSAD_MB_HalfPel_SIMDxh(uint8 *ref, uint8 *blk, int dmin_lx, void *extra_info);
+    int AVCSAD_Macroblock_SIMD(uint8 *ref, uint8 *blk, int dmin_lx, void *extra_info);
+    int SATD_MB_SIMD(uint8 *cand, uint8 *cur, int dmin);
+    void GenerateQuartPelPred_SIMD(uint8 **bilin_base, uint8 *qpel_cand, int hpel_pos);
+#endif
+
 #ifdef HTFM /*  3/2/1, Hypothesis Testing Fast Matching */
     int AVCSAD_MB_HP_HTFM_Collectxhyh(uint8 *ref, uint8 *blk, int dmin_x, void *extra_info);
     int AVCSAD_MB_HP_HTFM_Collectyh(uint8 *ref, uint8 *blk, int dmin_x, void *extra_info);
@@ -922,6 +959,38 @@ extern "C"
     */
     AVCEnc_Status EncodeIntra4x4Mode(AVCCommonObj *video, AVCMacroblock *currMB, AVCEncBitstream *stream);
 
+    /*------------- thread_pool.c -------------------------*/
+
+    /**
+    This function starts the worker threads and allocates their private memory. On failure
+    the pool is left partially set up for CleanThreadPool to undo.
+    \param "avcHandle" "Pointer to AVCHandle."
+    \param "numThreads" "Number of threads including the calling one, at least 2."
+    \return "AVCENC_SUCCESS for success, AVCENC_MEMORY_FAIL or AVCENC_FAIL otherwise."
+    */
+    AVCEnc_Status InitThreadPool(AVCHandle *avcHandle, int numThreads);
+
+    /**
+    This function stops the worker threads and frees the memory allocated in InitThreadPool.
+    \param "avcHandle" "Pointer to AVCHandle."
+    \return "void"
+    */
+    void CleanThreadPool(AVCHandle *avcHandle);
+
+    /**
+    This function performs one pass of AVCMotionEstimation with all threads working on rows
+    of macroblocks in a wavefront. The result is the same as the one of the raster scan loop.
+    \param "encvid" "Pointer to AVCEncObject."
+    \param "start_i" "First column of row 0, toggled per row if incr_i is 2."
+    \param "incr_i" "1 for every macroblock, 2 for the checkerboard of scene change detection."
+    \param "type_pred" "Type of candidate selection of the pass."
+    \param "NumIntraSearch" "Number of MBs to be intra searched, to be incremented."
+    \param "totalSAD" "Sum of the MAD of the MBs, to be incremented."
+    \return "void"
+    */
+    void AVCThreadMotionEstimation(AVCEncObject *encvid, int start_i, int incr_i, int type_pred,
+                                   int *NumIntraSearch, int *totalSAD);
+
     /*------------- vlc_encode.c -----------------------*/
     /**
     This function encodes and writes a value into an Exp-Golomb codeword.
@@ -51,8 +51,8 @@ bool IntraDecisionABE(AVCEncObject *encvid, int min_cost, uint8 *curL, int picPi
         SBE = 0;
         /* top neighbor */
         topL = curL - picPitch;
-        /* left neighbor */
-        leftL = curL - 1;
+        /* left neighbor, one row up since it is advanced before the first use */
+        leftL = curL - 1 - picPitch;
         orgY_2 = orgY - orgPitch;
 
         for (j = 0; j < 16; j++)
@@ -68,8 +68,8 @@ bool IntraDecisionABE(AVCEncObject *encvid, int min_cost, uint8 *curL, int picPi
         topL = video->currPic->Scb + offset;
         orgY_2 = currInput->YCbCr[1] + offset + (y_pos >> 2) * (orgPitch - picPitch);
 
-        leftL = topL - 1;
         topL -= (picPitch >> 1);
+        leftL = topL - 1;
         orgY_3 = orgY_2 - (orgPitch >> 1);
         for (j = 0; j < 8; j++)
         {
@@ -82,8 +82,8 @@ bool IntraDecisionABE(AVCEncObject *encvid, int min_cost, uint8 *curL, int picPi
         topL = video->currPic->Scr + offset;
         orgY_2 = currInput->YCbCr[2] + offset + (y_pos >> 2) * (orgPitch - picPitch);
 
-        leftL = topL - 1;
         topL -= (picPitch >> 1);
+        leftL = topL - 1;
         orgY_3 = orgY_2 - (orgPitch >> 1);
         for (j = 0; j < 8; j++)
         {
@@ -238,39 +238,26 @@ void AVCMotionEstimation(AVCEncObject *encvid)
 {
     AVCCommonObj *video = encvid->common;
     int slice_type = video->slice_type;
-    AVCFrameIO *currInput = encvid->currInput;
     AVCPictureData *refPic = video->RefPicList0[0];
-    int i, j, k;
+    int i, j;
     int mbwidth = video->PicWidthInMbs;
     int mbheight = video->PicHeightInMbs;
     int totalMB = video->PicSizeInMbs;
-    int pitch = currInput->pitch;
-    AVCMacroblock *currMB, *mblock = video->mblock;
-    AVCMV *mot_mb_16x16, *mot16x16 = encvid->mot16x16;
-    // AVCMV *mot_mb_16x8, *mot_mb_8x16, *mot_mb_8x8, etc;
+    AVCMacroblock *mblock = video->mblock;
     AVCRateControl *rateCtrl = encvid->rateCtrl;
     uint8 *intraSearch = encvid->intraSearch;
-    uint FS_en = encvid->fullsearch_enable;
 
     int NumIntraSearch, start_i, numLoop, incr_i;
-    int mbnum, offset;
-    uint8 *cur, *best_cand[5];
     int totalSAD = 0;   /* average SAD for rate control */
     int type_pred;
-    int abe_cost;
 
 #ifdef HTFM
     /***** HYPOTHESIS TESTING ********/  /* 2/28/01 */
     int collect = 0;
-    HTFM_Stat htfm_stat;
     double newvar[16];
     double exp_lamda[15];
     /*********************************/
 #endif
-    int hp_guess = 0;
-    uint32 mv_uint32;
-
-    offset = 0;
 
     if (slice_type == AVC_I_SLICE)
     {
@@ -309,7 +296,7 @@ void AVCMotionEstimation(AVCEncObject *encvid)
     encvid->sad_extra_info = NULL;
 #ifdef HTFM
     /***** HYPOTHESIS TESTING ********/
-    InitHTFM(video, &htfm_stat, newvar, &collect);
+    InitHTFM(video, &(encvid->htfm_stat), newvar, &collect);
     /*********************************/
 #endif
 
@@ -336,94 +323,24 @@ void AVCMotionEstimation(AVCEncObject *encvid)
     NumIntraSearch = 0; // to be intra searched in the encoding loop.
     while (numLoop--)
     {
-        for (j = 0; j < mbheight; j++)
+        if (encvid->threadPool != NULL)
         {
-            if (incr_i > 1)
-                start_i = (start_i == 0 ? 1 : 0) ; /* toggle 0 and 1 */
-
-            offset = pitch * (j << 4) + (start_i << 4);
-
-            mbnum = j * mbwidth + start_i;
-
-            for (i = start_i; i < mbwidth; i += incr_i)
+            AVCThreadMotionEstimation(encvid, (incr_i > 1 ? !start_i : 0), incr_i, type_pred,
+                                      &NumIntraSearch, &totalSAD);
+        }
+        else
+        {
+            for (j = 0; j < mbheight; j++)
             {
-                video->mbNum = mbnum;
-                video->currMB = currMB = mblock + mbnum;
-                mot_mb_16x16 = mot16x16 + mbnum;
-
-                cur = currInput->YCbCr[0] + offset;
+                if (incr_i > 1)
+                    start_i = (start_i == 0 ? 1 : 0) ; /* toggle 0 and 1 */
 
-                if (currMB->mb_intra == 0) /* for INTER mode */
+                for (i = start_i; i < mbwidth; i += incr_i)
                 {
-#if defined(HTFM)
-                    HTFMPrepareCurMB_AVC(encvid, &htfm_stat, cur, pitch);
-#else
-                    AVCPrepareCurMB(encvid, cur, pitch);
-#endif
-                    /************************************************************/
-                    /******** full-pel 1MV search **********************/
-
-                    AVCMBMotionSearch(encvid, cur, best_cand, i << 4, j << 4, type_pred,
-                                      FS_en, &hp_guess);
-
-                    abe_cost = encvid->min_cost[mbnum] = mot_mb_16x16->sad;
-
-                    /* set mbMode and MVs */
-                    currMB->mbMode = AVC_P16;
-                    currMB->MBPartPredMode[0][0] = AVC_Pred_L0;
-                    mv_uint32 = ((mot_mb_16x16->y) << 16) | ((mot_mb_16x16->x) & 0xffff);
-                    for (k = 0; k < 32; k += 2)
-                    {
-                        currMB->mvL0[k>>1] = mv_uint32;
-                    }
-
-                    /* make a decision whether it should be tested for intra or not */
-                    if (i != mbwidth - 1 && j != mbheight - 1 && i != 0 && j != 0)
-                    {
-                        if (false == IntraDecisionABE(&abe_cost, cur, pitch, true))
-                        {
-                            intraSearch[mbnum] = 0;
-                        }
-                        else
-                        {
-                            NumIntraSearch++;
-                            rateCtrl->MADofMB[mbnum] = abe_cost;
-                        }
-                    }
-                    else // boundary MBs, always do intra search
-                    {
-                        NumIntraSearch++;
-                    }
-
-                    totalSAD += (int) rateCtrl->MADofMB[mbnum];//mot_mb_16x16->sad;
-                }
-                else    /* INTRA update, use for prediction */
-                {
-                    mot_mb_16x16[0].x = mot_mb_16x16[0].y = 0;
-
-                    /* reset all other MVs to zero */
-                    /* mot_mb_16x8, mot_mb_8x16, mot_mb_8x8, etc. */
-                    abe_cost = encvid->min_cost[mbnum] = 0x7FFFFFFF;  /* max value for int */
-
-                    if (i != mbwidth - 1 && j != mbheight - 1 && i != 0 && j != 0)
-                    {
-                        IntraDecisionABE(&abe_cost, cur, pitch, false);
-
-                        rateCtrl->MADofMB[mbnum] = abe_cost;
-                        totalSAD += abe_cost;
-                    }
-
-                    NumIntraSearch++ ;
-                    /* cannot do I16 prediction here because it needs full decoding. */
-                    // intraSearch[mbnum] = 1;
-
-                }
-
-                mbnum += incr_i;
-                offset += (incr_i << 4);
-
-            } /* for i */
-        } /* for j */
+                    AVCMBMotionEstimation(encvid, i, j, type_pred, &NumIntraSearch, &totalSAD);
+                } /* for i */
+            } /* for j */
+        }
 
         /* since we cannot do intra/inter decision here, the SCD has to be
         based on other criteria such as motion vectors coherency or the SAD */
@@ -464,7 +381,7 @@ void AVCMotionEstimation(AVCEncObject *encvid)
     if (collect)
     {
         collect = 0;
-        UpdateHTFM(encvid, newvar, exp_lamda, &htfm_stat);
+        UpdateHTFM(encvid, newvar, exp_lamda, &(encvid->htfm_stat));
     }
     /*********************************/
 #endif
@@ -472,6 +389,101 @@ void AVCMotionEstimation(AVCEncObject *encvid)
     return ;
 }
 
+void AVCMBMotionEstimation(AVCEncObject *encvid, int i, int j, int type_pred,
+                           int *NumIntraSearch, int *totalSAD)
+{
+    AVCCommonObj *video = encvid->common;
+    AVCFrameIO *currInput = encvid->currInput;
+    int k;
+    int mbwidth = video->PicWidthInMbs;
+    int mbheight = video->PicHeightInMbs;
+    int pitch = currInput->pitch;
+    AVCMacroblock *currMB;
+    AVCMV *mot_mb_16x16;
+    AVCRateControl *rateCtrl = encvid->rateCtrl;
+    uint8 *intraSearch = encvid->intraSearch;
+    uint FS_en = encvid->fullsearch_enable;
+    int mbnum = j * mbwidth + i;
+    uint8 *cur, *best_cand[5];
+    int abe_cost;
+    int hp_guess = 0;
+    uint32 mv_uint32;
+
+    video->mbNum = mbnum;
+    video->currMB = currMB = video->mblock + mbnum;
+    mot_mb_16x16 = encvid->mot16x16 + mbnum;
+
+    cur = currInput->YCbCr[0] + pitch * (j << 4) + (i << 4);
+
+    if (currMB->mb_intra == 0) /* for INTER mode */
+    {
+#if defined(HTFM)
+        HTFMPrepareCurMB_AVC(encvid, &(encvid->htfm_stat), cur, pitch);
+#else
+        AVCPrepareCurMB(encvid, cur, pitch);
+#endif
+        /************************************************************/
+        /******** full-pel 1MV search **********************/
+
+        AVCMBMotionSearch(encvid, cur, best_cand, i << 4, j << 4, type_pred,
+                          FS_en, &hp_guess);
+
+        abe_cost = encvid->min_cost[mbnum] = mot_mb_16x16->sad;
+
+        /* set mbMode and MVs */
+        currMB->mbMode = AVC_P16;
+        currMB->MBPartPredMode[0][0] = AVC_Pred_L0;
+        mv_uint32 = ((mot_mb_16x16->y) << 16) | ((mot_mb_16x16->x) & 0xffff);
+        for (k = 0; k < 32; k += 2)
+        {
+            currMB->mvL0[k>>1] = mv_uint32;
+        }
+
+        /* make a decision whether it should be tested for intra or not */
+        if (i != mbwidth - 1 && j != mbheight - 1 && i != 0 && j != 0)
+        {
+            if (false == IntraDecisionABE(&abe_cost, cur, pitch, true))
+            {
+                intraSearch[mbnum] = 0;
+            }
+            else
+            {
+                (*NumIntraSearch)++;
+                rateCtrl->MADofMB[mbnum] = abe_cost;
+            }
+        }
+        else // boundary MBs, always do intra search
+        {
+            (*NumIntraSearch)++;
+        }
+
+        *totalSAD += (int) rateCtrl->MADofMB[mbnum];//mot_mb_16x16->sad;
+    }
+    else    /* INTRA update, use for prediction */
+    {
+        mot_mb_16x16[0].x = mot_mb_16x16[0].y = 0;
+
+        /* reset all other MVs to zero */
+        /* mot_mb_16x8, mot_mb_8x16, mot_mb_8x8, etc. */
+        abe_cost = encvid->min_cost[mbnum] = 0x7FFFFFFF;  /* max value for int */
+
+        if (i != mbwidth - 1 && j != mbheight - 1 && i != 0 && j != 0)
+        {
+            IntraDecisionABE(&abe_cost, cur, pitch, false);
+
+            rateCtrl->MADofMB[mbnum] = abe_cost;
+            *totalSAD += abe_cost;
+        }
+
+        (*NumIntraSearch)++ ;
+        /* cannot do I16 prediction here because it needs full decoding. */
+        // intraSearch[mbnum] = 1;
+
+    }
+
+    return ;
+}
+
 /*=====================================================================
     Function:   PaddingEdge
     Date:       09/16/2000
@@ -0,0 +1,274 @@
+/* ------------------------------------------------------------------
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+/* consist of
+int AVCSAD_Macroblock_SIMD(uint8 *ref,uint8 *blk,int dmin_lx,void *extra_info)
+int AVCSAD_MB_HalfPel_SIMDxhyh(uint8 *ref,uint8 *blk,int dmin_rx,void *extra_info)
+int AVCSAD_MB_HalfPel_SIMDyh(uint8 *ref,uint8 *blk,int dmin_rx,void *extra_info)
+int AVCSAD_MB_HalfPel_SIMDxh(uint8 *ref,uint8 *blk,int dmin_rx,void *extra_info)
+int SATD_MB_SIMD(uint8 *cand,uint8 *cur,int dmin)
+void GenerateQuartPelPred_SIMD(uint8 **bilin_base,uint8 *qpel_cand,int hpel_pos)
+int AVCEncSIMDSupported(void)
+
+SSE2 versions of the C functions in sad.cpp, sad_halfpel.cpp and
+findhalfpel.cpp. Each one returns exactly what its C counterpart returns,
+including the partial SAD after the row that first exceeds dmin, so that the
+choice between them does not change the bitstream.
+*/
+
+#include "avcenc_lib.h"
+
+#ifdef AVCENC_SIMD
+
+#include <emmintrin.h>
+#if !defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+/* (a + b + c + d + 2) >> 2 for each of 16 pixels */
+static inline __m128i avg4(__m128i a, __m128i b, __m128i c, __m128i d)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16(2);
+    __m128i lo, hi;
+
+    lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+    hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+    lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(c, zero));
+    hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(c, zero));
+    lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(d, zero));
+    hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(d, zero));
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+
+    return _mm_packus_epi16(lo, hi);
+}
+
+/* SAD of one 16-pixel row */
+static inline int sad_row(__m128i ref, __m128i blk)
+{
+    __m128i s = _mm_sad_epu8(ref, blk);
+
+    return _mm_cvtsi128_si32(s) + _mm_extract_epi16(s, 4);
+}
+
+#define LOAD16(p)           _mm_loadu_si128((const __m128i*)(p))
+#define AVG2(a, b)          _mm_avg_epu8(a, b)
+#define STORE16(p, x)       _mm_storeu_si128((__m128i*)(p), x)
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+int AVCEncSIMDSupported(void)
+{
+#if defined(__x86_64__)
+    return 1;
+#else
+    unsigned int eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    {
+        return 0;
+    }
+
+    return (edx & bit_SSE2) ? 1 : 0;
+#endif
+}
+
+int AVCSAD_Macroblock_SIMD(uint8 *ref, uint8 *blk, int dmin_lx, void *extra_info)
+{
+    int dmin = (uint32)dmin_lx >> 16;
+    int lx = dmin_lx & 0xFFFF;
+    int sad = 0;
+    int i;
+
+    (void)(extra_info);
+
+    for (i = 0; i < 16; i++)
+    {
+        sad += sad_row(LOAD16(ref), LOAD16(blk));
+
+        if (sad > dmin)
+            return sad;
+
+        ref += lx;
+        blk += 16;
+    }
+
+    return sad;
+}
+
+int AVCSAD_MB_HalfPel_SIMDxhyh(uint8 *ref, uint8 *blk, int dmin_rx, void *extra_info)
+{
+    int dmin = (uint32)dmin_rx >> 16;
+    int rx = dmin_rx & 0xFFFF;
+    int sad = 0;
+    int i;
+    __m128i p1, p2, p3, p4;
+
+    (void)(extra_info);
+
+    p3 = LOAD16(ref);
+    p4 = LOAD16(ref + 1);
+
+    for (i = 0; i < 16; i++)
+    {
+        p1 = p3;
+        p2 = p4;
+        ref += rx;
+        p3 = LOAD16(ref);
+        p4 = LOAD16(ref + 1);
+
+        sad += sad_row(avg4(p1, p2, p3, p4), LOAD16(blk));
+
+        if (sad > dmin)
+            return sad;
+
+        blk += 16;
+    }
+
+    return sad;
+}
+
+int AVCSAD_MB_HalfPel_SIMDyh(uint8 *ref, uint8 *blk, int dmin_rx, void *extra_info)
+{
+    int dmin = (uint32)dmin_rx >> 16;
+    int rx = dmin_rx & 0xFFFF;
+    int sad = 0;
+    int i;
+    __m128i p1, p2;
+
+    (void)(extra_info);
+
+    p2 = LOAD16(ref);
+
+    for (i = 0; i < 16; i++)
+    {
+        p1 = p2;
+        ref += rx;
+        p2 = LOAD16(ref);
+
+        sad += sad_row(AVG2(p1, p2), LOAD16(blk));
+
+        if (sad > dmin)
+            return sad;
+
+        blk += 16;
+    }
+
+    return sad;
+}
+
+int AVCSAD_MB_HalfPel_SIMDxh(uint8 *ref, uint8 *blk, int dmin_rx, void *extra_info)
+{
+    int dmin = (uint32)dmin_rx >> 16;
+    int rx = dmin_rx & 0xFFFF;
+    int sad = 0;
+    int i;
+
+    (void)(extra_info);
+
+    for (i = 0; i < 16; i++)
+    {
+        sad += sad_row(AVG2(LOAD16(ref), LOAD16(ref + 1)), LOAD16(blk));
+
+        if (sad > dmin)
+            return sad;
+
+        ref += rx;
+        blk += 16;
+    }
+
+    return sad;
+}
+
+/* assuming cand always has a pitch of 24 */
+int SATD_MB_SIMD(uint8 *cand, uint8 *cur, int dmin)
+{
+    return AVCSAD_Macroblock_SIMD(cand, cur, (dmin << 16) | 24, NULL);
+}
+
+void GenerateQuartPelPred_SIMD(uint8 **bilin_base, uint8 *qpel_cand, int hpel_pos)
+{
+    int j;
+    uint8 *c1 = qpel_cand;
+    uint8 *tl = bilin_base[0];
+    uint8 *tr = bilin_base[1];
+    uint8 *bl = bilin_base[2];
+    uint8 *br = bilin_base[3];
+    __m128i a, b, c, d, e;
+
+    /* same candidates as GenerateQuartPelPred(), 16 pixels of a row at a
+       time; the candidate arrays and the bilinear bases have a pitch of 24 */
+    if (!(hpel_pos&1)) // diamond pattern
+    {
+        for (j = 0; j < 16; j++)
+        {
+            a = LOAD16(tr);
+            d = LOAD16(tr + 24);
+            b = LOAD16(bl + 1);
+            c = LOAD16(br);
+            e = LOAD16(bl);
+
+            STORE16(c1, AVG2(c, a));
+            STORE16(c1 + 384, AVG2(b, a));
+            STORE16(c1 + 384 * 2, AVG2(b, c));
+            STORE16(c1 + 384 * 3, AVG2(b, d));
+            STORE16(c1 + 384 * 4, AVG2(c, d));
+            STORE16(c1 + 384 * 5, AVG2(e, d));
+            STORE16(c1 + 384 * 6, AVG2(e, c));
+            STORE16(c1 + 384 * 7, AVG2(e, a));
+
+            tr += 24;
+            bl += 24;
+            br += 24;
+            c1 += 24;
+        }
+    }
+    else // star pattern
+    {
+        for (j = 0; j < 16; j++)
+        {
+            a = LOAD16(br);
+
+            STORE16(c1, AVG2(a, LOAD16(tr)));
+            STORE16(c1 + 384, AVG2(a, LOAD16(tl + 1)));
+            STORE16(c1 + 384 * 2, AVG2(a, LOAD16(bl + 1)));
+            STORE16(c1 + 384 * 3, AVG2(a, LOAD16(tl + 25)));
+            STORE16(c1 + 384 * 4, AVG2(a, LOAD16(tr + 24)));
+            STORE16(c1 + 384 * 5, AVG2(a, LOAD16(tl + 24)));
+            STORE16(c1 + 384 * 6, AVG2(a, LOAD16(bl)));
+            STORE16(c1 + 384 * 7, AVG2(a, LOAD16(tl)));
+
+            tl += 24;
+            tr += 24;
+            bl += 24;
+            br += 24;
+            c1 += 24;
+        }
+    }
+
+    return ;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AVCENC_SIMD */
@@ -0,0 +1,319 @@
+/* ------------------------------------------------------------------
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+/* consist of
+AVCEnc_Status InitThreadPool(AVCHandle *avcHandle, int numThreads)
+void CleanThreadPool(AVCHandle *avcHandle)
+void AVCThreadMotionEstimation(AVCEncObject *encvid, int start_i, int incr_i, int type_pred,
+                               int *NumIntraSearch, int *totalSAD)
+
+Worker threads of the encoder. A picture cannot be started before the previous one
+is reconstructed since it is the reference of the motion search, so the threads work
+inside a picture, on rows of macroblocks for the motion estimation.
+*/
+
+#include "avcenc_lib.h"
+
+static void CopyEncObject(AVCEncThread *ctx, AVCEncObject *encvid);
+static void MotionEstimationRows(AVCEncThreadPool *pool, AVCEncObject *encvid,
+                                 int *NumIntraSearch, int *totalSAD);
+static void *WorkerThread(void *arg);
+
+/* ======================================================================== */
+/*  Function : InitThreadPool()                                             */
+/*  Date     : 11/12/2012                                                   */
+/*  Purpose  : Start numThreads - 1 worker threads and allocate their      */
+/*              contexts, the calling thread works on the encoder object.   */
+/*  In/out   :                                                              */
+/*  Return   : AVCENC_SUCCESS for success.                                  */
+/*  Modified :                                                              */
+/* ======================================================================== */
+AVCEnc_Status InitThreadPool(AVCHandle *avcHandle, int numThreads)
+{
+    AVCEncObject *encvid = (AVCEncObject*) avcHandle->AVCObject;
+    AVCCommonObj *video = encvid->common;
+    void *userData = avcHandle->userData;
+    AVCEncThreadPool *pool;
+    AVCEncThread *ctx;
+    int i;
+
+    pool = (AVCEncThreadPool*) avcHandle->CBAVC_Malloc(userData, sizeof(AVCEncThreadPool), DEFAULT_ATTR);
+    if (pool == NULL)
+    {
+        return AVCENC_MEMORY_FAIL;
+    }
+    memset(pool, 0, sizeof(AVCEncThreadPool));
+    encvid->threadPool = pool;
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pthread_cond_init(&pool->progress, NULL);
+
+    pool->rowDone = (int*) avcHandle->CBAVC_Malloc(userData, sizeof(int) * video->PicHeightInMbs, DEFAULT_ATTR);
+    if (pool->rowDone == NULL)
+    {
+        return AVCENC_MEMORY_FAIL;
+    }
+
+    for (i = 0; i < numThreads - 1; i++)
+    {
+        ctx = (AVCEncThread*) avcHandle->CBAVC_Malloc(userData, sizeof(AVCEncThread), DEFAULT_ATTR);
+        if (ctx == NULL)
+        {
+            return AVCENC_MEMORY_FAIL;
+        }
+        memset(ctx, 0, sizeof(AVCEncThread));
+        ctx->pool = pool;
+        pool->context[i] = ctx;
+
+        if (pthread_create(&pool->threads[i], NULL, &WorkerThread, pool->context[i]))
+        {
+            return AVCENC_FAIL;
+        }
+        pool->numThreads++;
+    }
+
+    return AVCENC_SUCCESS;
+}
+
+/* ======================================================================== */
+/*  Function : CleanThreadPool()                                            */
+/*  Date     : 11/12/2012                                                   */
+/*  Purpose  : Stop the worker threads and free the memory allocated in     */
+/*              InitThreadPool.                                             */
+/*  In/out   :                                                              */
+/*  Return   :                                                              */
+/*  Modified :                                                              */
+/* ======================================================================== */
+void CleanThreadPool(AVCHandle *avcHandle)
+{
+    AVCEncObject *encvid = (AVCEncObject*) avcHandle->AVCObject;
+    AVCEncThreadPool *pool = encvid->threadPool;
+    void *userData = avcHandle->userData;
+    int i;
+
+    if (pool == NULL)
+    {
+        return ;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (i = 0; i < pool->numThreads; i++)
+    {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->progress);
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->mutex);
+
+    for (i = 0; i < AVC_MAX_THREADS; i++)
+    {
+        if (pool->context[i] != NULL)
+        {
+            avcHandle->CBAVC_Free(userData, pool->context[i]);
+        }
+    }
+
+    if (pool->rowDone)
+    {
+        avcHandle->CBAVC_Free(userData, pool->rowDone);
+    }
+
+    avcHandle->CBAVC_Free(userData, pool);
+    encvid->threadPool = NULL;
+
+    return ;
+}
+
+/* ======================================================================== */
+/*  Function : AVCThreadMotionEstimation()                                  */
+/*  Date     : 11/12/2012                                                   */
+/*  Purpose  : One pass of the motion estimation loop over all rows with    */
+/*              the worker threads, the calling thread takes rows as well.  */
+/*  In/out   :                                                              */
+/*  Return   :                                                              */
+/*  Modified :  NumIntraSearch and totalSAD are incremented.                */
+/* ======================================================================== */
+void AVCThreadMotionEstimation(AVCEncObject *encvid, int start_i, int incr_i, int type_pred,
+                               int *NumIntraSearch, int *totalSAD)
+{
+    AVCEncThreadPool *pool = encvid->threadPool;
+    int i;
+
+    pthread_mutex_lock(&pool->mutex);
+
+    for (i = 0; i < pool->numThreads; i++)
+    {
+        CopyEncObject(pool->context[i], encvid);
+    }
+
+    memset(pool->rowDone, 0, sizeof(int) * encvid->common->PicHeightInMbs);
+    pool->startRowParity = start_i;
+    pool->incr_i = incr_i;
+    pool->type_pred = type_pred;
+    pool->nextRow = 0;
+
+    pool->jobId++;
+    pool->running = pool->numThreads;
+    pthread_cond_broadcast(&pool->start);
+
+    pthread_mutex_unlock(&pool->mutex);
+
+    MotionEstimationRows(pool, encvid, NumIntraSearch, totalSAD);
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->running)
+    {
+        pthread_cond_wait(&pool->done, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (i = 0; i < pool->numThreads; i++)
+    {
+        *NumIntraSearch += pool->context[i]->numIntraSearch;
+        *totalSAD += pool->context[i]->totalSAD;
+    }
+
+    return ;
+}
+
+/* make the context a copy of the encoder object with its own scratch memory */
+static void CopyEncObject(AVCEncThread *ctx, AVCEncObject *encvid)
+{
+    uint8 *subpel_pred = (uint8*) ctx->encvid.subpel_pred;
+    uint8 *base = (uint8*) encvid->subpel_pred;
+    int i, j;
+
+    memcpy(&ctx->encvid, encvid, sizeof(AVCEncObject));
+    memcpy(&ctx->video, encvid->common, sizeof(AVCCommonObj));
+    memcpy(&ctx->rateCtrl, encvid->rateCtrl, sizeof(AVCRateControl));
+    memcpy(&ctx->sliceHdr, encvid->common->sliceHdr, sizeof(AVCSliceHeader));
+
+    ctx->encvid.common = &ctx->video;
+    ctx->encvid.rateCtrl = &ctx->rateCtrl;
+    ctx->video.sliceHdr = &ctx->sliceHdr;
+
+    /* the sub-pel candidates point to subpel_pred */
+    for (i = 0; i < 9; i++)
+    {
+        ctx->encvid.hpel_cand[i] = subpel_pred + (encvid->hpel_cand[i] - base);
+        for (j = 0; j < 4; j++)
+        {
+            ctx->encvid.bilin_base[i][j] = subpel_pred + (encvid->bilin_base[i][j] - base);
+        }
+    }
+
+    ctx->numIntraSearch = 0;
+    ctx->totalSAD = 0;
+
+    return ;
+}
+
+/* take rows until there is none left, a MB waits for the row above to be done up to
+the MB above-right. The wait is under the mutex, only the MB itself is outside. */
+static void MotionEstimationRows(AVCEncThreadPool *pool, AVCEncObject *encvid,
+                                 int *NumIntraSearch, int *totalSAD)
+{
+    AVCCommonObj *video = encvid->common;
+    int mbwidth = video->PicWidthInMbs;
+    int mbheight = video->PicHeightInMbs;
+    int incr_i = pool->incr_i;
+    int type_pred = pool->type_pred;
+    int i, j, need;
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->nextRow < mbheight)
+    {
+        j = pool->nextRow++;
+
+        /* same columns as the raster scan loop */
+        i = (incr_i > 1) ? ((pool->startRowParity + j) & 1) : 0;
+
+        for (; i < mbwidth; i += incr_i)
+        {
+            if (j > 0)
+            {
+                need = AVC_MIN(i + 2, mbwidth);
+                while (pool->rowDone[j - 1] < need)
+                {
+                    pool->numWaiting++;
+                    pthread_cond_wait(&pool->progress, &pool->mutex);
+                    pool->numWaiting--;
+                }
+            }
+            pthread_mutex_unlock(&pool->mutex);
+
+            AVCMBMotionEstimation(encvid, i, j, type_pred, NumIntraSearch, totalSAD);
+
+            pthread_mutex_lock(&pool->mutex);
+            pool->rowDone[j] = i + 1;
+            if (pool->numWaiting)
+            {
+                pthread_cond_broadcast(&pool->progress);
+            }
+        }
+
+        pool->rowDone[j] = mbwidth;
+        if (pool->numWaiting)
+        {
+            pthread_cond_broadcast(&pool->progress);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return ;
+}
+
+static void *WorkerThread(void *arg)
+{
+    AVCEncThread *ctx = (AVCEncThread*) arg;
+    AVCEncThreadPool *pool = ctx->pool;
+    uint jobId = 0;
+
+    pthread_mutex_lock(&pool->mutex);
+    while (1)
+    {
+        while (!pool->quit && pool->jobId == jobId)
+        {
+            pthread_cond_wait(&pool->start, &pool->mutex);
+        }
+        if (pool->quit)
+        {
+            break;
+        }
+        jobId = pool->jobId;
+
+        pthread_mutex_unlock(&pool->mutex);
+        MotionEstimationRows(pool, &ctx->encvid, &ctx->numIntraSearch, &ctx->totalSAD);
+        pthread_mutex_lock(&pool->mutex);
+
+        if (--pool->running == 0)
+        {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return NULL;
+}
@@ -17,6 +17,7 @@ LOCAL_SRC_FILES := \
     src/motion_comp.cpp \
     src/sad.cpp \
     src/sad_halfpel.cpp \
+    src/sad_simd.cpp \
     src/vlc_encode.cpp \
     src/vop.cpp
 
@@ -558,6 +558,10 @@ void InitHTFM(VideoEncData *video, HTFM_Stat *htfm_stat, double *newvar, Int *co
         }
 //      video->functionPointer->SAD_MB_PADDING = &SAD_MB_PADDING_HTFM_Collect;
         video->functionPointer->SAD_Macroblock = &SAD_MB_HTFM_Collect;
+#ifdef M4VENC_SIMD
+        if (M4VEncSIMDSupported())
+            video->functionPointer->SAD_Macroblock = &SAD_MB_HTFM_Collect_SIMD;
+#endif
         video->functionPointer->SAD_MB_HalfPel[0] = NULL;
         video->functionPointer->SAD_MB_HalfPel[1] = &SAD_MB_HP_HTFM_Collectxh;
         video->functionPointer->SAD_MB_HalfPel[2] = &SAD_MB_HP_HTFM_Collectyh;
@@ -570,6 +574,10 @@ void InitHTFM(VideoEncData *video, HTFM_Stat *htfm_stat, double *newvar, Int *co
     {
 //      video->functionPointer->SAD_MB_PADDING = &SAD_MB_PADDING_HTFM;
         video->functionPointer->SAD_Macroblock = &SAD_MB_HTFM;
+#ifdef M4VENC_SIMD
+        if (M4VEncSIMDSupported())
+            video->functionPointer->SAD_Macroblock = &SAD_MB_HTFM_SIMD;
+#endif
         video->functionPointer->SAD_MB_HalfPel[0] = NULL;
         video->functionPointer->SAD_MB_HalfPel[1] = &SAD_MB_HP_HTFMxh;
         video->functionPointer->SAD_MB_HalfPel[2] = &SAD_MB_HP_HTFMyh;
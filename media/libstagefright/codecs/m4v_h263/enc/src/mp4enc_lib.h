@@ -166,6 +166,17 @@ extern "C"
     Int SAD_MB_HTFM_Collect(UChar *ref, UChar *blk, Int dmin_lx, void *extra_info);
     Int SAD_MB_HTFM(UChar *ref, UChar *blk, Int dmin_lx, void *extra_info);
 #endif
+
+    /* defined in sad_simd.c */
+#if defined(HTFM) && defined(__SSE2__)
+#define M4VENC_SIMD
+#endif
+
+#ifdef M4VENC_SIMD
+    Int M4VEncSIMDSupported(void); /* 1 if the CPU can run the functions below */
+    Int SAD_MB_HTFM_Collect_SIMD(UChar *ref, UChar *blk, Int dmin_lx, void *extra_info);
+    Int SAD_MB_HTFM_SIMD(UChar *ref, UChar *blk, Int dmin_lx, void *extra_info);
+#endif
     /* on-the-fly padding */
     Int SAD_Blk_PADDING(UChar *ref, UChar *cur, Int dmin, Int lx, void *extra_info);
     Int SAD_MB_PADDING(UChar *ref, UChar *cur, Int dmin, Int lx, void *extra_info);
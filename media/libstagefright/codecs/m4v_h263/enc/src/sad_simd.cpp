@@ -0,0 +1,153 @@
+/* ------------------------------------------------------------------
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+/* consist of
+Int SAD_MB_HTFM_Collect_SIMD(UChar *ref,UChar *blk,Int dmin_lx,void *extra_info)
+Int SAD_MB_HTFM_SIMD(UChar *ref,UChar *blk,Int dmin_lx,void *extra_info)
+Int M4VEncSIMDSupported(void)
+
+SSE2 versions of the HTFM functions in sad.cpp. Each one returns exactly
+what its C counterpart returns, including the partial SAD at the point where
+the C loop drops out, so that the choice between them does not change the
+bitstream.
+*/
+
+#include "mp4def.h"
+#include "mp4lib_int.h"
+#include "mp4enc_lib.h"
+
+#ifdef M4VENC_SIMD
+
+#include <emmintrin.h>
+#if !defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+/* pixels 0, 4, 8 and 12 of four rows lx4 apart, in HTFMPrepareCurMB() order.
+   The last row is loaded from p - 3 so that no byte past p[12] is read. */
+static inline __m128i htfm_gather(UChar *p, Int lx4)
+{
+    const __m128i mask = _mm_set1_epi32(0xFF);
+    __m128i r0, r1, r2, r3;
+
+    r0 = _mm_and_si128(_mm_loadu_si128((const __m128i*)p), mask);
+    r1 = _mm_and_si128(_mm_loadu_si128((const __m128i*)(p + lx4)), mask);
+    r2 = _mm_and_si128(_mm_loadu_si128((const __m128i*)(p + 2 * lx4)), mask);
+    r3 = _mm_srli_epi32(_mm_loadu_si128((const __m128i*)(p + 3 * lx4 - 3)), 24);
+
+    return _mm_packus_epi16(_mm_packs_epi32(r0, r1), _mm_packs_epi32(r2, r3));
+}
+
+/* SAD of 16 pixels */
+static inline Int sad_row(__m128i ref, __m128i blk)
+{
+    __m128i s = _mm_sad_epu8(ref, blk);
+
+    return _mm_cvtsi128_si32(s) + _mm_extract_epi16(s, 4);
+}
+
+#define LOAD16(p)           _mm_loadu_si128((const __m128i*)(p))
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    Int M4VEncSIMDSupported(void)
+    {
+#if defined(__x86_64__)
+        return 1;
+#else
+        unsigned int eax, ebx, ecx, edx;
+
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        {
+            return 0;
+        }
+
+        return (edx & bit_SSE2) ? 1 : 0;
+#endif
+    }
+
+    Int SAD_MB_HTFM_Collect_SIMD(UChar *ref, UChar *blk, Int dmin_lx, void *extra_info)
+    {
+        Int i;
+        Int sad = 0;
+        Int lx4 = (dmin_lx << 2) & 0x3FFFC;
+        Int saddata[16];
+        Int difmad;
+        HTFM_Stat *htfm_stat = (HTFM_Stat*) extra_info;
+        Int *abs_dif_mad_avg = &(htfm_stat->abs_dif_mad_avg);
+        UInt *countbreak = &(htfm_stat->countbreak);
+        Int *offsetRef = htfm_stat->offsetRef;
+
+        for (i = 0; i < 16; i++)
+        {
+            sad += sad_row(htfm_gather(ref + offsetRef[i], lx4), LOAD16(blk));
+            blk += 16;
+
+            saddata[i] = sad;
+
+            if (i > 0)
+            {
+                if ((ULong)sad > ((ULong)dmin_lx >> 16))
+                {
+                    difmad = saddata[0] - ((saddata[1] + 1) >> 1);
+                    (*abs_dif_mad_avg) += ((difmad > 0) ? difmad : -difmad);
+                    (*countbreak)++;
+                    return sad;
+                }
+            }
+        }
+
+        difmad = saddata[0] - ((saddata[1] + 1) >> 1);
+        (*abs_dif_mad_avg) += ((difmad > 0) ? difmad : -difmad);
+        (*countbreak)++;
+        return sad;
+    }
+
+    Int SAD_MB_HTFM_SIMD(UChar *ref, UChar *blk, Int dmin_lx, void *extra_info)
+    {
+        Int i;
+        Int sad = 0;
+        Int lx4 = (dmin_lx << 2) & 0x3FFFC;
+        Int sadstar = 0, madstar;
+        Int *nrmlz_th = (Int*) extra_info;
+        Int *offsetRef = (Int*) extra_info + 32;
+
+        madstar = (ULong)dmin_lx >> 20;
+
+        for (i = 0; i < 16; i++)
+        {
+            sad += sad_row(htfm_gather(ref + offsetRef[i], lx4), LOAD16(blk));
+            blk += 16;
+
+            sadstar += madstar;
+            if (((ULong)sad <= ((ULong)dmin_lx >> 16)) && (sad <= (sadstar - *nrmlz_th++)))
+                ;
+            else
+                return 65536;
+        }
+
+        return sad;
+    }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* M4VENC_SIMD */
@@ -161,10 +161,22 @@ void SoftAVC::initPorts() {
 
 status_t SoftAVC::initDecoder() {
     // Force decoder to output buffers in display order.
-    if (H264SwDecInit(&mHandle, 0) == H264SWDEC_OK) {
-        return OK;
+    if (H264SwDecInit(&mHandle, 0) != H264SWDEC_OK) {
+        return UNKNOWN_ERROR;
     }
-    return UNKNOWN_ERROR;
+
+    // Deblocking runs on the other cores, one row behind the decoding.
+    // It is about a third of the decoding work, more threads do not help.
+    int numThreads = GetCPUCoreCount() - 1;
+    if (numThreads > kMaxDeblockingThreads) {
+        numThreads = kMaxDeblockingThreads;
+    }
+    if (numThreads > 0
+            && H264SwDecSetNumThreads(mHandle, numThreads) != H264SWDEC_OK) {
+        ALOGW("Unable to start %d deblocking threads", numThreads);
+    }
+
+    return OK;
 }
 
 OMX_ERRORTYPE SoftAVC::internalGetParameter(
@@ -53,6 +53,7 @@ private:
         kOutputPortIndex  = 1,
         kNumInputBuffers  = 8,
         kNumOutputBuffers = 2,
+        kMaxDeblockingThreads = 2,
     };
 
     enum EOSStatus {
@@ -18,6 +18,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 /*------------------------------------------------------------------------------
     Module defines
@@ -37,6 +38,8 @@
 const char tagName[256] = "$Name: FIRST_ANDROID_COPYRIGHT $";
 
 void WriteOutput(char *filename, u8 *data, u32 picSize);
+void CompareOutput(u8 *data, u32 picSize);
+u32 TimeMs(void);
 u32 NextPacket(u8 **pStrm);
 u32 CropPicture(u8 *pOutImage, u8 *pInImage,
     u32 picWidth, u32 picHeight, CropParams *pCropParams);
@@ -47,6 +50,13 @@ u32 packetize = 0;
 u32 nalUnitStream = 0;
 FILE *foutput = NULL;
 
+/* Global variables for comparing output against a reference decode */
+FILE *freference = NULL;
+u8 *refImage = NULL;
+u32 refImageSize = 0;
+u32 numOutputPics = 0;
+u32 numMismatches = 0;
+
 #ifdef SOC_DESIGNER
 
 // Initialisation function defined in InitCache.s
@@ -102,6 +112,8 @@ int main(int argc, char **argv)
     u32 numErrors = 0;
     u32 cropDisplay = 0;
     u32 disableOutputReordering = 0;
+    u32 numThreads = 0;
+    u32 startTime, decodeTime;
 
     FILE *finput;
 
@@ -123,7 +135,8 @@ int main(int argc, char **argv)
     if (argc < 2)
     {
         DEBUG((
-            "Usage: %s [-Nn] [-Ooutfile] [-P] [-U] [-C] [-R] [-T] file.h264\n",
+            "Usage: %s [-Nn] [-Ooutfile] [-Vreffile] [-Jn] [-P] [-U] [-C] [-R] [-T] "
+            "file.h264\n",
             argv[0]));
         DEBUG(("\t-Nn forces decoding to stop after n pictures\n"));
 #if defined(_NO_OUT)
@@ -132,6 +145,9 @@ int main(int argc, char **argv)
         DEBUG(("\t-Ooutfile write output to \"outfile\" (default out_wxxxhyyy.yuv)\n"));
         DEBUG(("\t-Onone does not write output\n"));
 #endif
+        DEBUG(("\t-Vreffile compare output to \"reffile\", e.g. output of a "
+               "single threaded run\n"));
+        DEBUG(("\t-Jn use n deblocking filter threads (default 0)\n"));
         DEBUG(("\t-P packet-by-packet mode\n"));
         DEBUG(("\t-U NAL unit stream mode\n"));
         DEBUG(("\t-C display cropped image (default decoded image)\n"));
@@ -151,6 +167,19 @@ int main(int argc, char **argv)
         {
             strcpy(outFileName, argv[i]+2);
         }
+        else if ( strncmp(argv[i], "-V", 2) == 0 )
+        {
+            freference = fopen(argv[i]+2, "rb");
+            if (freference == NULL)
+            {
+                DEBUG(("UNABLE TO OPEN REFERENCE FILE\n"));
+                return -1;
+            }
+        }
+        else if ( strncmp(argv[i], "-J", 2) == 0 )
+        {
+            numThreads = (u32)atoi(argv[i]+2);
+        }
         else if ( strcmp(argv[i], "-P") == 0 )
         {
             packetize = 1;
@@ -204,6 +233,15 @@ int main(int argc, char **argv)
         return -1;
     }
 
+    ret = H264SwDecSetNumThreads(decInst, numThreads);
+    if (ret != H264SWDEC_OK)
+    {
+        DEBUG(("UNABLE TO START %d DECODER THREADS\n", numThreads));
+        H264SwDecRelease(decInst);
+        free(byteStrmStart);
+        return -1;
+    }
+
     /* initialize H264SwDecDecode() input structure */
     streamStop = byteStrmStart + strmLen;
     decInput.pStream = byteStrmStart;
@@ -216,6 +254,7 @@ int main(int argc, char **argv)
         decInput.dataLen = tmp;
 
     picDecodeNumber = picDisplayNumber = 1;
+    startTime = TimeMs();
     /* main decoding loop */
     do
     {
@@ -408,12 +447,28 @@ int main(int argc, char **argv)
         }
     }
 
+    decodeTime = TimeMs() - startTime;
+
     /* release decoder instance */
     H264SwDecRelease(decInst);
 
     if (foutput)
         fclose(foutput);
 
+    if (freference)
+    {
+        DEBUG(("%d of %d pictures differ from reference\n",
+            numMismatches, numOutputPics));
+        fclose(freference);
+        free(refImage);
+    }
+
+    /* decoding speed, includes output writing unless -Onone is given */
+    DEBUG(("%d pictures in %d ms with %d threads, %d.%d fps\n",
+        picDecodeNumber - 1, decodeTime, numThreads,
+        decodeTime ? (picDecodeNumber - 1) * 1000 / decodeTime : 0,
+        decodeTime ? (picDecodeNumber - 1) * 10000 / decodeTime % 10 : 0));
+
     /* free allocated buffers */
     free(byteStrmStart);
     free(tmpImage);
@@ -421,7 +476,7 @@ int main(int argc, char **argv)
     DEBUG(("Output file: %s\n", outFileName));
 
     DEBUG(("DECODING DONE\n"));
-    if (numErrors || picDecodeNumber == 1)
+    if (numErrors || numMismatches || picDecodeNumber == 1)
     {
         DEBUG(("ERRORS FOUND\n"));
         return 1;
@@ -462,6 +517,61 @@ void WriteOutput(char *filename, u8 *data, u32 picSize)
 
     if (foutput && data)
         fwrite(data, 1, picSize, foutput);
+
+    if (freference && data)
+        CompareOutput(data, picSize);
+}
+
+/*------------------------------------------------------------------------------
+
+    Function name:  CompareOutput
+
+    Purpose:
+        Compare picture pointed by data to the next picture of the reference
+        file. Counts differing pictures in global numMismatches.
+
+------------------------------------------------------------------------------*/
+void CompareOutput(u8 *data, u32 picSize)
+{
+
+    numOutputPics++;
+
+    if (refImageSize < picSize)
+    {
+        free(refImage);
+        refImage = (u8 *)malloc(picSize);
+        refImageSize = refImage ? picSize : 0;
+        if (refImage == NULL)
+        {
+            DEBUG(("UNABLE TO ALLOCATE MEMORY\n"));
+            exit(100);
+        }
+    }
+
+    if (fread(refImage, 1, picSize, freference) != picSize ||
+        memcmp(refImage, data, picSize) != 0)
+    {
+        DEBUG(("PICTURE %d DIFFERS FROM REFERENCE\n", numOutputPics));
+        numMismatches++;
+    }
+}
+
+/*------------------------------------------------------------------------------
+
+    Function name:  TimeMs
+
+    Purpose:
+        Return monotonic time in milliseconds.
+
+------------------------------------------------------------------------------*/
+u32 TimeMs(void)
+{
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (u32)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
 }
 
 /*------------------------------------------------------------------------------
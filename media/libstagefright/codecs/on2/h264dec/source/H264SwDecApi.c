@@ -24,6 +24,7 @@
      4. Local function prototypes
      5. Functions
           H264SwDecInit
+          H264SwDecSetNumThreads
           H264SwDecGetInfo
           H264SwDecRelease
           H264SwDecDecode
@@ -175,6 +176,74 @@ H264SwDecRet H264SwDecInit(H264SwDecInst *decInst, u32 noOutputReordering)
 
 }
 
+/*------------------------------------------------------------------------------
+
+    Function: H264SwDecSetNumThreads()
+
+        Functional description:
+            Set number of worker threads used for deblocking filtering.
+            Filtering of each macroblock row is started as soon as the row
+            below it has been decoded and runs in parallel with decoding of
+            the rest of the picture. Output is identical to the single
+            threaded decoder. Shall be called between pictures, preferably
+            right after H264SwDecInit.
+
+        Inputs:
+            decInst     decoder instance
+            numThreads  number of worker threads, 0 (default) filters each
+                        picture in the calling thread after it is decoded
+
+        Outputs:
+            none
+
+        Returns:
+            H264SWDEC_OK            success
+            H264SWDEC_PARAM_ERR     invalid parameters or picture decoding
+                                    in progress
+            H264SWDEC_NOT_INITIALIZED   decoder instance not initialized yet
+            H264SWDEC_MEMFAIL       thread creation failed
+
+------------------------------------------------------------------------------*/
+
+H264SwDecRet H264SwDecSetNumThreads(H264SwDecInst decInst, u32 numThreads)
+{
+
+    decContainer_t *pDecCont;
+
+    DEC_API_TRC("H264SwDecSetNumThreads#");
+
+    if (decInst == NULL)
+    {
+        DEC_API_TRC("H264SwDecSetNumThreads# ERROR: decInst == NULL");
+        return(H264SWDEC_PARAM_ERR);
+    }
+
+    pDecCont = (decContainer_t*)decInst;
+
+    if (pDecCont->decStat == UNINITIALIZED)
+    {
+        DEC_API_TRC("H264SwDecSetNumThreads# ERROR: Decoder not initialized");
+        return(H264SWDEC_NOT_INITIALIZED);
+    }
+
+    if (pDecCont->storage.picStarted)
+    {
+        DEC_API_TRC("H264SwDecSetNumThreads# ERROR: Picture in progress");
+        return(H264SWDEC_PARAM_ERR);
+    }
+
+    if (h264bsdSetNumThreads(&pDecCont->storage, numThreads) != HANTRO_OK)
+    {
+        DEC_API_TRC("H264SwDecSetNumThreads# ERROR: Thread creation failed");
+        return(H264SWDEC_MEMFAIL);
+    }
+
+    DEC_API_TRC("H264SwDecSetNumThreads# OK");
+
+    return(H264SWDEC_OK);
+
+}
+
 /*------------------------------------------------------------------------------
 
     Function: H264SwDecGetInfo()
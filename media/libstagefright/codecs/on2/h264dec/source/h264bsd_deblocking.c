@@ -24,6 +24,7 @@
      4. Local function prototypes
      5. Functions
           h264bsdFilterPicture
+          h264bsdFilterMbs
           FilterVerLumaEdge
           FilterHorLumaEdge
           FilterHorLuma
@@ -570,16 +571,59 @@ u32 EdgeBoundaryStrengthLeft(mbStorage_t *mb1, mbStorage_t *mb2)
           none
 
 ------------------------------------------------------------------------------*/
-#ifndef H264DEC_OMXDL
+
 void h264bsdFilterPicture(
   image_t *image,
   mbStorage_t *mb)
 {
 
+/* Code */
+
+    ASSERT(image);
+
+    h264bsdFilterMbs(image, mb, 0, image->width * image->height);
+
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: h264bsdFilterMbs
+
+        Functional description:
+          Perform deblocking filtering for macroblocks firstMb ... endMb-1
+          of a picture in raster scan order. Filtering a macroblock modifies
+          pixels of the macroblocks on the left and above, hence the result
+          equals to h264bsdFilterPicture only if the macroblocks are filtered
+          in the same order with respect to their neighbours: the row above
+          has to be filtered up to and including the macroblock above-right
+          before a macroblock is filtered.
+
+        Inputs:
+          image         pointer to image to be filtered
+          mb            pointer to macroblock data structure of the top-left
+                        macroblock of the picture
+          firstMb       address of the first macroblock to be filtered
+          endMb         address following the last macroblock to be filtered
+
+        Outputs:
+          image         filtered image stored here
+
+        Returns:
+          none
+
+------------------------------------------------------------------------------*/
+#ifndef H264DEC_OMXDL
+void h264bsdFilterMbs(
+  image_t *image,
+  mbStorage_t *mb,
+  u32 firstMb,
+  u32 endMb)
+{
+
 /* Variables */
 
     u32 flags;
-    u32 picSizeInMbs, mbRow, mbCol;
+    u32 picSizeInMbs, mbRow, mbCol, mbNum;
     u32 picWidthInMbs;
     u8 *data;
     mbStorage_t *pMb;
@@ -593,14 +637,17 @@ void h264bsdFilterPicture(
     ASSERT(image->data);
     ASSERT(image->width);
     ASSERT(image->height);
+    ASSERT(endMb <= image->width * image->height);
 
     picWidthInMbs = image->width;
     data = image->data;
     picSizeInMbs = picWidthInMbs * image->height;
 
-    pMb = mb;
+    pMb = mb + firstMb;
+    mbRow = firstMb / picWidthInMbs;
+    mbCol = firstMb % picWidthInMbs;
 
-    for (mbRow = 0, mbCol = 0; mbRow < image->height; pMb++)
+    for (mbNum = firstMb; mbNum < endMb; mbNum++, pMb++)
     {
         flags = GetMbFilteringFlags(pMb);
 
@@ -1739,39 +1786,22 @@ void FilterChroma(
 
 /*------------------------------------------------------------------------------
 
-    Function: h264bsdFilterPicture
-
-        Functional description:
-          Perform deblocking filtering for a picture. Filter does not copy
-          the original picture anywhere but filtering is performed directly
-          on the original image. Parameters controlling the filtering process
-          are computed based on information in macroblock structures of the
-          filtered macroblock, macroblock above and macroblock on the left of
-          the filtered one.
-
-        Inputs:
-          image         pointer to image to be filtered
-          mb            pointer to macroblock data structure of the top-left
-                        macroblock of the picture
-
-        Outputs:
-          image         filtered image stored here
-
-        Returns:
-          none
+    Function: h264bsdFilterMbs
 
 ------------------------------------------------------------------------------*/
 
 /*lint --e{550} Symbol not accessed */
-void h264bsdFilterPicture(
+void h264bsdFilterMbs(
   image_t *image,
-  mbStorage_t *mb)
+  mbStorage_t *mb,
+  u32 firstMb,
+  u32 endMb)
 {
 
 /* Variables */
 
     u32 flags;
-    u32 picSizeInMbs, mbRow, mbCol;
+    u32 picSizeInMbs, mbRow, mbCol, mbNum;
     u32 picWidthInMbs;
     u8 *data;
     mbStorage_t *pMb;
@@ -1789,14 +1819,17 @@ void h264bsdFilterPicture(
     ASSERT(image->data);
     ASSERT(image->width);
     ASSERT(image->height);
+    ASSERT(endMb <= image->width * image->height);
 
     picWidthInMbs = image->width;
     data = image->data;
     picSizeInMbs = picWidthInMbs * image->height;
 
-    pMb = mb;
+    pMb = mb + firstMb;
+    mbRow = firstMb / picWidthInMbs;
+    mbCol = firstMb % picWidthInMbs;
 
-    for (mbRow = 0, mbCol = 0; mbRow < image->height; pMb++)
+    for (mbNum = firstMb; mbNum < endMb; mbNum++, pMb++)
     {
         flags = GetMbFilteringFlags(pMb);
 
@@ -52,5 +52,11 @@ void h264bsdFilterPicture(
   image_t *image,
   mbStorage_t *mb);
 
+void h264bsdFilterMbs(
+  image_t *image,
+  mbStorage_t *mb,
+  u32 firstMb,
+  u32 endMb);
+
 #endif /* #ifdef H264SWDEC_DEBLOCKING_H */
 
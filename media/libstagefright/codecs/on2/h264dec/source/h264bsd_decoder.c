@@ -24,6 +24,7 @@
      4. Local function prototypes
      5. Functions
           h264bsdInit
+          h264bsdSetNumThreads
           h264bsdDecode
           h264bsdShutdown
           h264bsdCurrentImage
@@ -54,6 +55,7 @@
 #include "h264bsd_dpb.h"
 #include "h264bsd_deblocking.h"
 #include "h264bsd_conceal.h"
+#include "h264bsd_filter_pool.h"
 
 /*------------------------------------------------------------------------------
     2. External compiler flags
@@ -111,6 +113,45 @@ u32 h264bsdInit(storage_t *pStorage, u32 noOutputReordering)
     return HANTRO_OK;
 }
 
+/*------------------------------------------------------------------------------
+
+    Function name: h264bsdSetNumThreads
+
+        Functional description:
+            Set number of threads performing deblocking filtering in
+            parallel with decoding. Replaces the previous thread pool, hence
+            must not be called while a picture is being decoded.
+
+        Inputs:
+            pStorage    pointer to storage structure
+            numThreads  number of worker threads, 0 to filter each picture in
+                        the decoding thread after it has been decoded
+
+        Outputs:
+            none
+
+        Returns:
+            HANTRO_OK   success
+            HANTRO_NOK  picture decoding in progress or thread creation failed
+
+------------------------------------------------------------------------------*/
+
+u32 h264bsdSetNumThreads(storage_t *pStorage, u32 numThreads)
+{
+
+/* Code */
+
+    ASSERT(pStorage);
+
+    if (pStorage->picStarted)
+        return(HANTRO_NOK);
+
+    h264bsdFilterPoolRelease(&pStorage->filterPool);
+
+    return(h264bsdFilterPoolInit(&pStorage->filterPool, numThreads));
+
+}
+
 /*------------------------------------------------------------------------------
 
     Function: h264bsdDecode
@@ -238,6 +279,8 @@ u32 h264bsdDecode(storage_t *pStorage, u8 *byteStrm, u32 len, u32 picId,
                 return (H264BSD_ERROR);
             }
 
+            h264bsdFilterPoolHold(pStorage->filterPool);
+
             if (!pStorage->validSliceInAccessUnit)
             {
                 pStorage->currImage->data =
@@ -420,6 +463,9 @@ u32 h264bsdDecode(storage_t *pStorage, u8 *byteStrm, u32 len, u32 picId,
                     }
                     pStorage->currImage->data =
                         h264bsdAllocateDpbImage(pStorage->dpb);
+                    h264bsdFilterPoolStart(pStorage->filterPool,
+                        pStorage->currImage, pStorage->mb,
+                        pStorage->activePps->numSliceGroups == 1);
                 }
 
                 /* store slice header to storage if successfully decoded */
@@ -448,6 +494,7 @@ u32 h264bsdDecode(storage_t *pStorage, u8 *byteStrm, u32 len, u32 picId,
                 if (tmp != HANTRO_OK)
                 {
                     EPRINT("SLICE_DATA");
+                    h264bsdFilterPoolHold(pStorage->filterPool);
                     h264bsdMarkSliceCorrupted(pStorage,
                         pStorage->sliceHeader->firstMbInSlice);
                     return(H264BSD_ERROR);
@@ -471,7 +518,8 @@ u32 h264bsdDecode(storage_t *pStorage, u8 *byteStrm, u32 len, u32 picId,
 
     if (picReady)
     {
-        h264bsdFilterPicture(pStorage->currImage, pStorage->mb);
+        h264bsdFilterPoolFinish(pStorage->filterPool, pStorage->currImage,
+            pStorage->mb);
 
         h264bsdResetStorage(pStorage);
 
@@ -541,6 +589,8 @@ void h264bsdShutdown(storage_t *pStorage)
 
     ASSERT(pStorage);
 
+    h264bsdFilterPoolRelease(&pStorage->filterPool);
+
     for (i = 0; i < MAX_NUM_SEQ_PARAM_SETS; i++)
     {
         if (pStorage->sps[i])
@@ -0,0 +1,650 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*------------------------------------------------------------------------------
+
+    Table of contents
+
+     1. Include headers
+     2. External compiler flags
+     3. Module defines
+     4. Local function prototypes
+     5. Functions
+          h264bsdFilterPoolInit
+          h264bsdFilterPoolRelease
+          h264bsdFilterPoolStart
+          h264bsdFilterPoolMbDecoded
+          h264bsdFilterPoolHold
+          h264bsdFilterPoolFinish
+          RowAvailable
+          FilterRow
+          WorkerThread
+          CopyRow
+
+------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+    1. Include headers
+------------------------------------------------------------------------------*/
+
+#include "h264bsd_filter_pool.h"
+#include "h264bsd_deblocking.h"
+#include "h264bsd_util.h"
+
+/*------------------------------------------------------------------------------
+    2. External compiler flags
+--------------------------------------------------------------------------------
+
+--------------------------------------------------------------------------------
+    3. Module defines
+------------------------------------------------------------------------------*/
+
+/* maximum number of macroblocks filtered between two progress updates, keeps
+ * the thread filtering the row below close behind */
+#define FILTER_POOL_MB_CHUNK 4
+
+/*------------------------------------------------------------------------------
+    4. Local function prototypes
+------------------------------------------------------------------------------*/
+
+static u32 RowAvailable(filterPool_t *pPool);
+static void FilterRow(filterPool_t *pPool, u32 row);
+static void *WorkerThread(void *arg);
+static void CopyRow(image_t *image, u8 *backup, u32 row, u32 restore);
+
+/*------------------------------------------------------------------------------
+
+    Function: h264bsdFilterPoolInit
+
+        Functional description:
+            Create a pool of numThreads worker threads for deblocking
+            filtering. Deblocking of a macroblock row is started as soon as
+            the intra prediction of the row below cannot read its unfiltered
+            pixels any more, i.e. when the row below has been decoded, and the
+            row above has been filtered up to the macroblock above-right.
+            Workers filter consecutive rows as a wavefront, which produces
+            exactly the same output as h264bsdFilterPicture.
+
+        Inputs:
+            numThreads  number of worker threads, 0 disables the pool
+
+        Outputs:
+            ppPool      pointer to the created pool is stored here, NULL if
+                        numThreads is 0
+
+        Returns:
+            HANTRO_OK   success
+            HANTRO_NOK  memory allocation or thread creation failed
+
+------------------------------------------------------------------------------*/
+
+u32 h264bsdFilterPoolInit(filterPool_t **ppPool, u32 numThreads)
+{
+
+/* Variables */
+
+    u32 i;
+    filterPool_t *pPool;
+
+/* Code */
+
+    ASSERT(ppPool);
+
+    *ppPool = NULL;
+
+    if (numThreads == 0)
+        return(HANTRO_OK);
+
+    if (numThreads > FILTER_POOL_MAX_THREADS)
+        numThreads = FILTER_POOL_MAX_THREADS;
+
+    ALLOCATE(pPool, 1, filterPool_t);
+    if (pPool == NULL)
+        return(HANTRO_NOK);
+
+    H264SwDecMemset(pPool, 0, sizeof(filterPool_t));
+
+    pthread_mutex_init(&pPool->mutex, NULL);
+    pthread_cond_init(&pPool->cond, NULL);
+
+    for (i = 0; i < numThreads; i++)
+    {
+        if (pthread_create(&pPool->threads[i], NULL, WorkerThread, pPool))
+            break;
+        pPool->numThreads++;
+    }
+
+    if (pPool->numThreads != numThreads)
+    {
+        h264bsdFilterPoolRelease(&pPool);
+        return(HANTRO_NOK);
+    }
+
+    *ppPool = pPool;
+
+    return(HANTRO_OK);
+
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: h264bsdFilterPoolRelease
+
+        Functional description:
+            Stop the worker threads and free the pool. Filtering of a picture
+            left unfinished is abandoned.
+
+        Inputs:
+            ppPool      pointer to the pool, set to NULL
+
+        Outputs:
+            none
+
+        Returns:
+            none
+
+------------------------------------------------------------------------------*/
+
+void h264bsdFilterPoolRelease(filterPool_t **ppPool)
+{
+
+/* Variables */
+
+    u32 i;
+    filterPool_t *pPool;
+
+/* Code */
+
+    ASSERT(ppPool);
+
+    pPool = *ppPool;
+    if (pPool == NULL)
+        return;
+
+    pthread_mutex_lock(&pPool->mutex);
+    pPool->quit = HANTRO_TRUE;
+    pPool->active = HANTRO_FALSE;
+    pthread_cond_broadcast(&pPool->cond);
+    pthread_mutex_unlock(&pPool->mutex);
+
+    for (i = 0; i < pPool->numThreads; i++)
+        pthread_join(pPool->threads[i], NULL);
+
+    pthread_cond_destroy(&pPool->cond);
+    pthread_mutex_destroy(&pPool->mutex);
+
+    FREE(pPool->rowDone);
+    FREE(pPool->backup);
+    FREE(*ppPool);
+
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: h264bsdFilterPoolStart
+
+        Functional description:
+            Start a new picture. Rows are handed to the workers only if
+            enable is set, i.e. macroblocks are decoded in raster scan order
+            (no slice groups), otherwise the whole picture is filtered by
+            h264bsdFilterPoolFinish.
+
+        Inputs:
+            pPool       pointer to the pool, may be NULL
+            image       image of the new picture
+            mb          macroblock storage of the picture
+            enable      flag to enable filtering during decoding
+
+        Outputs:
+            none
+
+        Returns:
+            none
+
+------------------------------------------------------------------------------*/
+
+void h264bsdFilterPoolStart(filterPool_t *pPool, image_t *image,
+    mbStorage_t *mb, u32 enable)
+{
+
+/* Variables */
+
+    u32 size;
+
+/* Code */
+
+    ASSERT(image);
+    ASSERT(mb);
+
+    if (pPool == NULL)
+        return;
+
+    /* previous picture not finished, should not happen */
+    if (pPool->started)
+        h264bsdFilterPoolHold(pPool);
+
+    pthread_mutex_lock(&pPool->mutex);
+
+    if (pPool->rowDoneSize < image->height)
+    {
+        FREE(pPool->rowDone);
+        pPool->rowDoneSize = 0;
+        ALLOCATE(pPool->rowDone, image->height, u32);
+        if (pPool->rowDone == NULL)
+        {
+            /* filter the picture without the pool */
+            pPool->started = HANTRO_FALSE;
+            pthread_mutex_unlock(&pPool->mutex);
+            return;
+        }
+        pPool->rowDoneSize = image->height;
+    }
+    H264SwDecMemset(pPool->rowDone, 0, image->height * sizeof(u32));
+
+    size = image->width * image->height * 384;
+    if (enable && pPool->backupSize < size)
+    {
+        FREE(pPool->backup);
+        pPool->backupSize = 0;
+        ALLOCATE(pPool->backup, size, u8);
+        if (pPool->backup)
+            pPool->backupSize = size;
+        else
+            enable = HANTRO_FALSE;
+    }
+
+    pPool->image = *image;
+    pPool->mb = mb;
+    pPool->decodedEnd = 0;
+    pPool->nextRow = 0;
+    pPool->busy = 0;
+    pPool->rowsFinished = 0;
+    pPool->final = HANTRO_FALSE;
+    pPool->started = HANTRO_TRUE;
+    pPool->active = enable;
+
+    pPool->scanEnd = 0;
+    pPool->nextCheck = image->width;
+
+    pthread_mutex_unlock(&pPool->mutex);
+
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: h264bsdFilterPoolMbDecoded
+
+        Functional description:
+            Inform the pool that macroblock mbAddr has been decoded. Called
+            by the decoding thread after each macroblock; the macroblock
+            storage is only scanned, and the workers woken up, when a row of
+            the picture may have been completed.
+
+        Inputs:
+            pPool       pointer to the pool, may be NULL
+            mbAddr      address of the decoded macroblock
+
+        Outputs:
+            none
+
+        Returns:
+            none
+
+------------------------------------------------------------------------------*/
+
+void h264bsdFilterPoolMbDecoded(filterPool_t *pPool, u32 mbAddr)
+{
+
+/* Variables */
+
+    u32 i, picSizeInMbs;
+
+/* Code */
+
+    if (pPool == NULL || !pPool->active || mbAddr + 1 < pPool->nextCheck)
+        return;
+
+    picSizeInMbs = pPool->image.width * pPool->image.height;
+
+    for (i = pPool->scanEnd; i < picSizeInMbs && pPool->mb[i].decoded; i++)
+        ;
+    pPool->scanEnd = i;
+
+    /* publish complete rows only */
+    i -= i % pPool->image.width;
+    if (i > pPool->decodedEnd)
+    {
+        pthread_mutex_lock(&pPool->mutex);
+        pPool->decodedEnd = i;
+        pthread_cond_broadcast(&pPool->cond);
+        pthread_mutex_unlock(&pPool->mutex);
+    }
+    pPool->nextCheck = i + pPool->image.width;
+
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: h264bsdFilterPoolHold
+
+        Functional description:
+            Stop handing out rows of the current picture, wait until the
+            workers have released the rows they own and restore the
+            unfiltered rows. Called when a slice is found corrupted or the
+            picture is concealed: concealment reads unfiltered neighbours and
+            the macroblocks of a corrupted slice may be decoded again from a
+            redundant slice. The whole picture is then filtered by
+            h264bsdFilterPoolFinish as if the pool was not used.
+
+        Inputs:
+            pPool       pointer to the pool, may be NULL
+
+        Outputs:
+            none
+
+        Returns:
+            none
+
+------------------------------------------------------------------------------*/
+
+void h264bsdFilterPoolHold(filterPool_t *pPool)
+{
+
+/* Variables */
+
+    u32 row;
+
+/* Code */
+
+    if (pPool == NULL || !pPool->active)
+        return;
+
+    pthread_mutex_lock(&pPool->mutex);
+    pPool->active = HANTRO_FALSE;
+    pthread_cond_broadcast(&pPool->cond);
+    while (pPool->busy)
+        pthread_cond_wait(&pPool->cond, &pPool->mutex);
+    pthread_mutex_unlock(&pPool->mutex);
+
+    for (row = 0; row < pPool->nextRow; row++)
+    {
+        if (pPool->rowDone[row])
+        {
+            CopyRow(&pPool->image, pPool->backup, row, HANTRO_TRUE);
+            pPool->rowDone[row] = 0;
+        }
+    }
+
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: h264bsdFilterPoolFinish
+
+        Functional description:
+            Complete deblocking filtering of the picture. Replaces
+            h264bsdFilterPicture when the pool is used. The calling thread
+            filters rows together with the workers and returns when the whole
+            picture is filtered.
+
+        Inputs:
+            pPool       pointer to the pool, may be NULL
+            image       image to be filtered
+            mb          macroblock storage of the image
+
+        Outputs:
+            image       filtered image stored here
+
+        Returns:
+            none
+
+------------------------------------------------------------------------------*/
+
+void h264bsdFilterPoolFinish(filterPool_t *pPool, image_t *image,
+    mbStorage_t *mb)
+{
+
+/* Variables */
+
+    u32 row;
+
+/* Code */
+
+    ASSERT(image);
+    ASSERT(mb);
+
+    if (pPool == NULL || !pPool->started)
+    {
+        h264bsdFilterPicture(image, mb);
+        return;
+    }
+
+    ASSERT(image->data == pPool->image.data);
+
+    pthread_mutex_lock(&pPool->mutex);
+    if (pPool->active)
+    {
+        pPool->final = HANTRO_TRUE;
+        pthread_cond_broadcast(&pPool->cond);
+        while (pPool->rowsFinished < image->height)
+        {
+            if (RowAvailable(pPool))
+            {
+                row = pPool->nextRow++;
+                pPool->busy++;
+                FilterRow(pPool, row);
+            }
+            else
+                pthread_cond_wait(&pPool->cond, &pPool->mutex);
+        }
+        pPool->active = HANTRO_FALSE;
+        pPool->started = HANTRO_FALSE;
+        pthread_mutex_unlock(&pPool->mutex);
+        return;
+    }
+    pPool->started = HANTRO_FALSE;
+    pthread_mutex_unlock(&pPool->mutex);
+
+    /* pool was held (or never enabled), nothing filtered yet */
+    h264bsdFilterPicture(image, mb);
+
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: RowAvailable
+
+        Functional description:
+            Check if the next row may be handed out, called with the mutex
+            held. Row k can be filtered once macroblock row k+1 has been
+            decoded, the last row only when the picture is complete.
+
+------------------------------------------------------------------------------*/
+
+u32 RowAvailable(filterPool_t *pPool)
+{
+
+/* Variables */
+
+    u32 row;
+
+/* Code */
+
+    row = pPool->nextRow;
+
+    if (!pPool->active || row >= pPool->image.height)
+        return(HANTRO_FALSE);
+
+    if (pPool->final)
+        return(HANTRO_TRUE);
+
+    return((row + 2) * pPool->image.width <= pPool->decodedEnd ?
+        HANTRO_TRUE : HANTRO_FALSE);
+
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: FilterRow
+
+        Functional description:
+            Filter one macroblock row, called with the mutex held and the
+            row counted in busy. Macroblock x of the row is filtered after
+            macroblock x+1 of the row above; the mutex is released while
+            filtering. The row is given up unfinished if the pool is held.
+            The row is unfiltered when handed out (filtering modifies the
+            row above but not the row below), it is copied to the backup
+            before filtering.
+
+------------------------------------------------------------------------------*/
+
+void FilterRow(filterPool_t *pPool, u32 row)
+{
+
+/* Variables */
+
+    u32 x, limit, width, above;
+
+/* Code */
+
+    width = pPool->image.width;
+    x = 0;
+
+    pthread_mutex_unlock(&pPool->mutex);
+    CopyRow(&pPool->image, pPool->backup, row, HANTRO_FALSE);
+    pthread_mutex_lock(&pPool->mutex);
+
+    while (x < width)
+    {
+        if (!pPool->active)
+            break;
+
+        limit = width;
+        if (row)
+        {
+            above = pPool->rowDone[row - 1];
+            if (above < width)
+                limit = above ? above - 1 : 0;
+        }
+        limit = MIN(limit, x + FILTER_POOL_MB_CHUNK);
+
+        if (limit <= x)
+        {
+            pthread_cond_wait(&pPool->cond, &pPool->mutex);
+            continue;
+        }
+
+        pthread_mutex_unlock(&pPool->mutex);
+        h264bsdFilterMbs(&pPool->image, pPool->mb, row * width + x,
+            row * width + limit);
+        pthread_mutex_lock(&pPool->mutex);
+
+        x = limit;
+        pPool->rowDone[row] = x;
+        pthread_cond_broadcast(&pPool->cond);
+    }
+
+    if (x == width)
+        pPool->rowsFinished++;
+    pPool->busy--;
+    pthread_cond_broadcast(&pPool->cond);
+
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: WorkerThread
+
+        Functional description:
+            Main loop of a worker thread, takes the next row as soon as it
+            becomes available.
+
+------------------------------------------------------------------------------*/
+
+void *WorkerThread(void *arg)
+{
+
+/* Variables */
+
+    u32 row;
+    filterPool_t *pPool = (filterPool_t *)arg;
+
+/* Code */
+
+    pthread_mutex_lock(&pPool->mutex);
+    while (!pPool->quit)
+    {
+        if (RowAvailable(pPool))
+        {
+            row = pPool->nextRow++;
+            pPool->busy++;
+            FilterRow(pPool, row);
+        }
+        else
+            pthread_cond_wait(&pPool->cond, &pPool->mutex);
+    }
+    pthread_mutex_unlock(&pPool->mutex);
+
+    return(NULL);
+
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: CopyRow
+
+        Functional description:
+            Copy luma and chroma samples of a macroblock row from the image
+            to the backup buffer, or back if restore is set. The backup
+            buffer has the layout of the image.
+
+------------------------------------------------------------------------------*/
+
+void CopyRow(image_t *image, u8 *backup, u32 row, u32 restore)
+{
+
+/* Variables */
+
+    u32 width, picSize, offset;
+    u8 *src, *dst;
+
+/* Code */
+
+    width = image->width;
+    picSize = width * image->height;
+
+    if (restore)
+    {
+        src = backup;
+        dst = image->data;
+    }
+    else
+    {
+        src = image->data;
+        dst = backup;
+    }
+
+    /* luma */
+    offset = row * width * 256;
+    H264SwDecMemcpy(dst + offset, src + offset, width * 256);
+
+    /* cb and cr */
+    offset = picSize * 256 + row * width * 64;
+    H264SwDecMemcpy(dst + offset, src + offset, width * 64);
+    offset += picSize * 64;
+    H264SwDecMemcpy(dst + offset, src + offset, width * 64);
+
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*------------------------------------------------------------------------------
+
+    Table of contents
+
+    1. Include headers
+    2. Module defines
+    3. Data types
+    4. Function prototypes
+
+------------------------------------------------------------------------------*/
+
+#ifndef H264SWDEC_FILTER_POOL_H
+#define H264SWDEC_FILTER_POOL_H
+
+/*------------------------------------------------------------------------------
+    1. Include headers
+------------------------------------------------------------------------------*/
+
+#include <pthread.h>
+
+#include "basetype.h"
+#include "h264bsd_image.h"
+#include "h264bsd_macroblock_layer.h"
+
+/*------------------------------------------------------------------------------
+    2. Module defines
+------------------------------------------------------------------------------*/
+
+/* maximum number of worker threads of a filter pool */
+#define FILTER_POOL_MAX_THREADS 8
+
+/*------------------------------------------------------------------------------
+    3. Data types
+------------------------------------------------------------------------------*/
+
+/* pool of worker threads performing deblocking filtering of the current
+ * picture row by row while the rest of the picture is being decoded. All
+ * fields below mutex are protected by it, scanEnd and nextCheck are only
+ * accessed by the decoding thread. */
+typedef struct
+{
+    pthread_t threads[FILTER_POOL_MAX_THREADS];
+    u32 numThreads;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+
+    u32 quit;
+
+    /* picture being filtered */
+    image_t image;
+    mbStorage_t *mb;
+
+    /* number of macroblocks filtered on each macroblock row */
+    u32 *rowDone;
+    u32 rowDoneSize;
+
+    /* unfiltered copy of each row handed out, restored if the picture has
+     * to be concealed */
+    u8 *backup;
+    u32 backupSize;
+
+    /* picture started, rows may be handed to workers, all macroblocks of
+     * the picture available */
+    u32 started;
+    u32 active;
+    u32 final;
+
+    /* number of macroblocks decoded in raster scan order without gaps */
+    u32 decodedEnd;
+
+    /* next row to be handed out, number of rows owned by threads, number of
+     * rows completely filtered */
+    u32 nextRow;
+    u32 busy;
+    u32 rowsFinished;
+
+    u32 scanEnd;
+    u32 nextCheck;
+} filterPool_t;
+
+/*------------------------------------------------------------------------------
+    4. Function prototypes
+------------------------------------------------------------------------------*/
+
+u32 h264bsdFilterPoolInit(filterPool_t **ppPool, u32 numThreads);
+void h264bsdFilterPoolRelease(filterPool_t **ppPool);
+
+void h264bsdFilterPoolStart(filterPool_t *pPool, image_t *image,
+    mbStorage_t *mb, u32 enable);
+void h264bsdFilterPoolMbDecoded(filterPool_t *pPool, u32 mbAddr);
+void h264bsdFilterPoolHold(filterPool_t *pPool);
+void h264bsdFilterPoolFinish(filterPool_t *pPool, image_t *image,
+    mbStorage_t *mb);
+
+#endif /* #ifdef H264SWDEC_FILTER_POOL_H */
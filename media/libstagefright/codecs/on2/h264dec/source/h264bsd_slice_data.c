@@ -36,6 +36,7 @@
 #include "h264bsd_slice_data.h"
 #include "h264bsd_util.h"
 #include "h264bsd_vlc.h"
+#include "h264bsd_filter_pool.h"
 
 /*------------------------------------------------------------------------------
     2. External compiler flags
@@ -195,6 +196,8 @@ u32 h264bsdDecodeSliceData(strmData_t *pStrmData, storage_t *pStorage,
         if (pStorage->mb[currMbAddr].decoded == 1)
             mbCount++;
 
+        h264bsdFilterPoolMbDecoded(pStorage->filterPool, currMbAddr);
+
         /* keep on processing as long as there is stream data left or
          * processing of macroblocks to be skipped based on the last skipRun is
          * not finished */
@@ -18,17 +18,477 @@
 #define LOG_TAG "ColorConverter"
 #include <utils/Log.h>
 
+#include <pthread.h>
+#include <unistd.h>
+
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/ColorConverter.h>
 #include <media/stagefright/MediaErrors.h>
 
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define COLOR_CONVERTER_SIMD 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define COLOR_CONVERTER_SIMD 1
+#endif
+
 namespace android {
 
+// B = 1.164 * (Y - 16) + 2.018 * (U - 128)
+// G = 1.164 * (Y - 16) - 0.813 * (V - 128) - 0.391 * (U - 128)
+// R = 1.164 * (Y - 16) + 1.596 * (V - 128)
+
+// B = 298/256 * (Y - 16) + 517/256 * (U - 128)
+// G = .................. - 208/256 * (V - 128) - 100/256 * (U - 128)
+// R = .................. + 409/256 * (V - 128)
+
+// min_B = (298 * (- 16) + 517 * (- 128)) / 256 = -277
+// min_G = (298 * (- 16) - 208 * (255 - 128) - 100 * (255 - 128)) / 256 = -172
+// min_R = (298 * (- 16) + 409 * (- 128)) / 256 = -223
+
+// max_B = (298 * (255 - 16) + 517 * (255 - 128)) / 256 = 534
+// max_G = (298 * (255 - 16) - 208 * (- 128) - 100 * (- 128)) / 256 = 432
+// max_R = (298 * (255 - 16) + 409 * (255 - 128)) / 256 = 481
+
+// clip range -278 .. 535
+
+static const signed kClipMin = -278;
+static const signed kClipMax = 535;
+
+// Frames are only split into bands of at least this many pixels, below
+// that starting the threads costs more than it saves.
+static const size_t kMinPixelsPerBand = 256 * 256;
+static const size_t kMaxNumThreads = 4;
+
+// Where the samples of the source frame are. Luma samples are mYStep bytes
+// apart, the chroma samples shared by a pair of pixels are mUVStep bytes
+// apart in either plane, and a row of chroma serves 1 << mUVRowShift rows.
+struct ColorConverter::YUVLayout {
+    YUVLayout(
+            const uint8_t *y, size_t yStride, size_t yStep,
+            const uint8_t *u, const uint8_t *v, size_t uvStride,
+            size_t uvStep, size_t uvRowShift)
+        : mY(y),
+          mU(u),
+          mV(v),
+          mYStride(yStride),
+          mUVStride(uvStride),
+          mYStep(yStep),
+          mUVStep(uvStep),
+          mUVRowShift(uvRowShift) {
+    }
+
+    const uint8_t *mY;
+    const uint8_t *mU;
+    const uint8_t *mV;
+    size_t mYStride;
+    size_t mUVStride;
+    size_t mYStep;
+    size_t mUVStep;
+    size_t mUVRowShift;
+};
+
+struct ColorConverter::RGBLayout {
+    uint8_t *mBits;         // top left pixel of the crop rectangle
+    size_t mStride;         // in bytes
+    bool m32bit;            // R, G, B, A in memory order, RGB565 otherwise
+    bool mSwapRedBlue;
+};
+
+struct ColorConverter::Band {
+    const ColorConverter *mConverter;
+    const YUVLayout *mSrc;
+    const RGBLayout *mDst;
+    size_t mWidth;
+    size_t mFirstRow;
+    size_t mNumRows;
+    pthread_t mThread;
+    bool mThreadStarted;
+};
+
+// Converts the pixels [x, width) of a row, this is the reference arithmetic
+// the vector kernels must match.
+static void convertRowScalar(
+        const uint8_t *kAdjustedClip,
+        const uint8_t *src_y, size_t yStep,
+        const uint8_t *src_u, const uint8_t *src_v, size_t uvStep,
+        uint8_t *dst, bool dst32bit, bool swapRedBlue,
+        size_t x, size_t width) {
+    for (; x < width; x += 2) {
+        signed y1 = (signed)src_y[x * yStep] - 16;
+        signed y2 = (x + 1 < width) ? (signed)src_y[(x + 1) * yStep] - 16 : y1;
+
+        signed u = (signed)src_u[(x / 2) * uvStep] - 128;
+        signed v = (signed)src_v[(x / 2) * uvStep] - 128;
+
+        signed u_b = u * 517;
+        signed u_g = -u * 100;
+        signed v_g = -v * 208;
+        signed v_r = v * 409;
+
+        signed tmp1 = y1 * 298;
+        signed b1 = (tmp1 + u_b) / 256;
+        signed g1 = (tmp1 + v_g + u_g) / 256;
+        signed r1 = (tmp1 + v_r) / 256;
+
+        signed tmp2 = y2 * 298;
+        signed b2 = (tmp2 + u_b) / 256;
+        signed g2 = (tmp2 + v_g + u_g) / 256;
+        signed r2 = (tmp2 + v_r) / 256;
+
+        if (swapRedBlue) {
+            signed tmp = r1; r1 = b1; b1 = tmp;
+            tmp = r2; r2 = b2; b2 = tmp;
+        }
+
+        if (dst32bit) {
+            uint8_t *dst_ptr = dst + x * 4;
+
+            dst_ptr[0] = kAdjustedClip[r1];
+            dst_ptr[1] = kAdjustedClip[g1];
+            dst_ptr[2] = kAdjustedClip[b1];
+            dst_ptr[3] = 0xff;
+
+            if (x + 1 < width) {
+                dst_ptr[4] = kAdjustedClip[r2];
+                dst_ptr[5] = kAdjustedClip[g2];
+                dst_ptr[6] = kAdjustedClip[b2];
+                dst_ptr[7] = 0xff;
+            }
+        } else {
+            uint16_t *dst_ptr = (uint16_t *)dst + x;
+
+            dst_ptr[0] =
+                ((kAdjustedClip[r1] >> 3) << 11)
+                | ((kAdjustedClip[g1] >> 2) << 5)
+                | (kAdjustedClip[b1] >> 3);
+
+            if (x + 1 < width) {
+                dst_ptr[1] =
+                    ((kAdjustedClip[r2] >> 3) << 11)
+                    | ((kAdjustedClip[g2] >> 2) << 5)
+                    | (kAdjustedClip[b2] >> 3);
+            }
+        }
+    }
+}
+
+#ifdef COLOR_CONVERTER_SIMD
+
+// The vector kernels convert 16 pixels at a time, as the 8 even and the
+// 8 odd pixels which share the same 8 chroma samples. They are bit-exact
+// with convertRowScalar: splitting 298 = 256 + 42, 409 = 512 - 103,
+// 517 = 512 + 5 and -208 = -256 + 48 keeps every product within 16 bits,
+// and (256 * a + b) >> 8 == a + (b >> 8). The shift rounds negative values
+// down rather than towards zero, but those clip to 0 either way.
+
+enum SourceKind {
+    kPlanar,            // separate U and V planes
+    kSemiPlanar,        // interleaved U and V, in either order
+    kCbYCrY,            // U, Y, V, Y
+    kUnsupported,
+};
+
+static SourceKind getSourceKind(
+        const uint8_t *src_y, size_t yStep,
+        const uint8_t *src_u, const uint8_t *src_v, size_t uvStep) {
+    if (yStep == 1 && uvStep == 1) {
+        return kPlanar;
+    } else if (yStep == 1 && uvStep == 2
+            && (src_v == src_u + 1 || src_u == src_v + 1)) {
+        return kSemiPlanar;
+    } else if (yStep == 2 && uvStep == 4
+            && src_y == src_u + 1 && src_v == src_u + 2) {
+        return kCbYCrY;
+    }
+
+    return kUnsupported;
+}
+
+#if defined(__ARM_NEON__)
+
+static inline int16x8_t widen(uint8x8_t x, int16_t offset) {
+    return vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(x)), vdupq_n_s16(offset));
+}
+
+// y + base + ((y * 42 + frac) >> 8), clipped, even and odd pixels merged.
+static inline uint8x16_t channel(
+        int16x8_t yEven, int16x8_t yEven42, int16x8_t yOdd, int16x8_t yOdd42,
+        int16x8_t base, int16x8_t frac) {
+    int16x8_t even = vaddq_s16(
+            vaddq_s16(yEven, base), vshrq_n_s16(vaddq_s16(yEven42, frac), 8));
+    int16x8_t odd = vaddq_s16(
+            vaddq_s16(yOdd, base), vshrq_n_s16(vaddq_s16(yOdd42, frac), 8));
+
+    uint8x8x2_t pixels = vzip_u8(vqmovun_s16(even), vqmovun_s16(odd));
+    return vcombine_u8(pixels.val[0], pixels.val[1]);
+}
+
+static inline void convert16(
+        uint8x8_t yEven8, uint8x8_t yOdd8, uint8x8_t u8, uint8x8_t v8,
+        uint8_t *dst, bool dst32bit, bool swapRedBlue) {
+    int16x8_t yEven = widen(yEven8, 16);
+    int16x8_t yOdd = widen(yOdd8, 16);
+    int16x8_t u = widen(u8, 128);
+    int16x8_t v = widen(v8, 128);
+
+    int16x8_t yEven42 = vmulq_n_s16(yEven, 42);
+    int16x8_t yOdd42 = vmulq_n_s16(yOdd, 42);
+
+    uint8x16_t r = channel(yEven, yEven42, yOdd, yOdd42,
+            vshlq_n_s16(v, 1), vmulq_n_s16(v, -103));
+    uint8x16_t g = channel(yEven, yEven42, yOdd, yOdd42,
+            vnegq_s16(v), vmlsq_n_s16(vmulq_n_s16(v, 48), u, 100));
+    uint8x16_t b = channel(yEven, yEven42, yOdd, yOdd42,
+            vshlq_n_s16(u, 1), vmulq_n_s16(u, 5));
+
+    if (swapRedBlue) {
+        uint8x16_t tmp = r; r = b; b = tmp;
+    }
+
+    if (dst32bit) {
+        uint8x16x4_t rgba;
+        rgba.val[0] = r;
+        rgba.val[1] = g;
+        rgba.val[2] = b;
+        rgba.val[3] = vdupq_n_u8(0xff);
+        vst4q_u8(dst, rgba);
+    } else {
+        uint16x8_t lo = vshll_n_u8(vget_low_u8(r), 8);
+        lo = vsriq_n_u16(lo, vshll_n_u8(vget_low_u8(g), 8), 5);
+        lo = vsriq_n_u16(lo, vshll_n_u8(vget_low_u8(b), 8), 11);
+
+        uint16x8_t hi = vshll_n_u8(vget_high_u8(r), 8);
+        hi = vsriq_n_u16(hi, vshll_n_u8(vget_high_u8(g), 8), 5);
+        hi = vsriq_n_u16(hi, vshll_n_u8(vget_high_u8(b), 8), 11);
+
+        vst1q_u16((uint16_t *)dst, lo);
+        vst1q_u16((uint16_t *)dst + 8, hi);
+    }
+}
+
+// Returns the number of pixels converted, a multiple of 16.
+static size_t convertRowSIMD(
+        const uint8_t *src_y, size_t yStep,
+        const uint8_t *src_u, const uint8_t *src_v, size_t uvStep,
+        uint8_t *dst, bool dst32bit, bool swapRedBlue, size_t width) {
+    SourceKind kind = getSourceKind(src_y, yStep, src_u, src_v, uvStep);
+    size_t dstBytes = dst32bit ? 64 : 32;
+    size_t x = 0;
+
+    switch (kind) {
+        case kPlanar:
+            for (; x + 16 <= width; x += 16) {
+                uint8x8x2_t y = vld2_u8(src_y + x);
+                convert16(y.val[0], y.val[1],
+                        vld1_u8(src_u + x / 2), vld1_u8(src_v + x / 2),
+                        dst, dst32bit, swapRedBlue);
+                dst += dstBytes;
+            }
+            break;
+
+        case kSemiPlanar:
+        {
+            bool uFirst = src_u < src_v;
+            const uint8_t *src_uv = uFirst ? src_u : src_v;
+
+            for (; x + 16 <= width; x += 16) {
+                uint8x8x2_t y = vld2_u8(src_y + x);
+                uint8x8x2_t uv = vld2_u8(src_uv + x);
+                convert16(y.val[0], y.val[1],
+                        uv.val[uFirst ? 0 : 1], uv.val[uFirst ? 1 : 0],
+                        dst, dst32bit, swapRedBlue);
+                dst += dstBytes;
+            }
+            break;
+        }
+
+        case kCbYCrY:
+            for (; x + 16 <= width; x += 16) {
+                uint8x8x4_t uyvy = vld4_u8(src_u + x * 2);
+                convert16(uyvy.val[1], uyvy.val[3], uyvy.val[0], uyvy.val[2],
+                        dst, dst32bit, swapRedBlue);
+                dst += dstBytes;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    return x;
+}
+
+#else  // __SSE2__
+
+// y + base + ((y * 42 + frac) >> 8), clipped, even and odd pixels merged.
+static inline __m128i channel(
+        __m128i yEven, __m128i yEven42, __m128i yOdd, __m128i yOdd42,
+        __m128i base, __m128i frac) {
+    __m128i even = _mm_add_epi16(
+            _mm_add_epi16(yEven, base),
+            _mm_srai_epi16(_mm_add_epi16(yEven42, frac), 8));
+    __m128i odd = _mm_add_epi16(
+            _mm_add_epi16(yOdd, base),
+            _mm_srai_epi16(_mm_add_epi16(yOdd42, frac), 8));
+
+    return _mm_unpacklo_epi8(
+            _mm_packus_epi16(even, even), _mm_packus_epi16(odd, odd));
+}
+
+static inline __m128i pack565(__m128i r, __m128i g, __m128i b) {
+    return _mm_or_si128(
+            _mm_or_si128(
+                _mm_slli_epi16(_mm_and_si128(r, _mm_set1_epi16(0xf8)), 8),
+                _mm_slli_epi16(_mm_and_si128(g, _mm_set1_epi16(0xfc)), 3)),
+            _mm_srli_epi16(b, 3));
+}
+
+// All inputs hold 8 samples in 16-bit lanes.
+static inline void convert16(
+        __m128i yEven, __m128i yOdd, __m128i u, __m128i v,
+        uint8_t *dst, bool dst32bit, bool swapRedBlue) {
+    yEven = _mm_sub_epi16(yEven, _mm_set1_epi16(16));
+    yOdd = _mm_sub_epi16(yOdd, _mm_set1_epi16(16));
+    u = _mm_sub_epi16(u, _mm_set1_epi16(128));
+    v = _mm_sub_epi16(v, _mm_set1_epi16(128));
+
+    __m128i yEven42 = _mm_mullo_epi16(yEven, _mm_set1_epi16(42));
+    __m128i yOdd42 = _mm_mullo_epi16(yOdd, _mm_set1_epi16(42));
+
+    __m128i r = channel(yEven, yEven42, yOdd, yOdd42,
+            _mm_slli_epi16(v, 1), _mm_mullo_epi16(v, _mm_set1_epi16(-103)));
+    __m128i g = channel(yEven, yEven42, yOdd, yOdd42,
+            _mm_sub_epi16(_mm_setzero_si128(), v),
+            _mm_sub_epi16(
+                _mm_mullo_epi16(v, _mm_set1_epi16(48)),
+                _mm_mullo_epi16(u, _mm_set1_epi16(100))));
+    __m128i b = channel(yEven, yEven42, yOdd, yOdd42,
+            _mm_slli_epi16(u, 1), _mm_mullo_epi16(u, _mm_set1_epi16(5)));
+
+    if (swapRedBlue) {
+        __m128i tmp = r; r = b; b = tmp;
+    }
+
+    __m128i *out = (__m128i *)dst;
+
+    if (dst32bit) {
+        __m128i alpha = _mm_set1_epi8((char)0xff);
+
+        __m128i rg = _mm_unpacklo_epi8(r, g);
+        __m128i ba = _mm_unpacklo_epi8(b, alpha);
+        _mm_storeu_si128(out, _mm_unpacklo_epi16(rg, ba));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(rg, ba));
+
+        rg = _mm_unpackhi_epi8(r, g);
+        ba = _mm_unpackhi_epi8(b, alpha);
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(rg, ba));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(rg, ba));
+    } else {
+        __m128i zero = _mm_setzero_si128();
+
+        _mm_storeu_si128(out, pack565(
+                _mm_unpacklo_epi8(r, zero),
+                _mm_unpacklo_epi8(g, zero),
+                _mm_unpacklo_epi8(b, zero)));
+        _mm_storeu_si128(out + 1, pack565(
+                _mm_unpackhi_epi8(r, zero),
+                _mm_unpackhi_epi8(g, zero),
+                _mm_unpackhi_epi8(b, zero)));
+    }
+}
+
+// Returns the number of pixels converted, a multiple of 16.
+static size_t convertRowSIMD(
+        const uint8_t *src_y, size_t yStep,
+        const uint8_t *src_u, const uint8_t *src_v, size_t uvStep,
+        uint8_t *dst, bool dst32bit, bool swapRedBlue, size_t width) {
+    SourceKind kind = getSourceKind(src_y, yStep, src_u, src_v, uvStep);
+    size_t dstBytes = dst32bit ? 64 : 32;
+    size_t x = 0;
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i lowBytes = _mm_set1_epi16(0xff);
+    __m128i lowWords = _mm_set1_epi32(0xffff);
+
+    switch (kind) {
+        case kPlanar:
+            for (; x + 16 <= width; x += 16) {
+                __m128i y = _mm_loadu_si128((const __m128i *)(src_y + x));
+                __m128i u = _mm_loadl_epi64((const __m128i *)(src_u + x / 2));
+                __m128i v = _mm_loadl_epi64((const __m128i *)(src_v + x / 2));
+
+                convert16(_mm_and_si128(y, lowBytes), _mm_srli_epi16(y, 8),
+                        _mm_unpacklo_epi8(u, zero), _mm_unpacklo_epi8(v, zero),
+                        dst, dst32bit, swapRedBlue);
+                dst += dstBytes;
+            }
+            break;
+
+        case kSemiPlanar:
+        {
+            bool uFirst = src_u < src_v;
+            const uint8_t *src_uv = uFirst ? src_u : src_v;
+
+            for (; x + 16 <= width; x += 16) {
+                __m128i y = _mm_loadu_si128((const __m128i *)(src_y + x));
+                __m128i uv = _mm_loadu_si128((const __m128i *)(src_uv + x));
+                __m128i first = _mm_and_si128(uv, lowBytes);
+                __m128i second = _mm_srli_epi16(uv, 8);
+
+                convert16(_mm_and_si128(y, lowBytes), _mm_srli_epi16(y, 8),
+                        uFirst ? first : second, uFirst ? second : first,
+                        dst, dst32bit, swapRedBlue);
+                dst += dstBytes;
+            }
+            break;
+        }
+
+        case kCbYCrY:
+            for (; x + 16 <= width; x += 16) {
+                __m128i lo = _mm_loadu_si128((const __m128i *)(src_u + x * 2));
+                __m128i hi = _mm_loadu_si128((const __m128i *)(src_u + x * 2 + 16));
+
+                // 16-bit lanes of Y in pixel order, and of alternating U, V.
+                __m128i yLo = _mm_srli_epi16(lo, 8);
+                __m128i yHi = _mm_srli_epi16(hi, 8);
+                __m128i uvLo = _mm_and_si128(lo, lowBytes);
+                __m128i uvHi = _mm_and_si128(hi, lowBytes);
+
+                convert16(
+                        _mm_packs_epi32(
+                            _mm_and_si128(yLo, lowWords),
+                            _mm_and_si128(yHi, lowWords)),
+                        _mm_packs_epi32(
+                            _mm_srli_epi32(yLo, 16), _mm_srli_epi32(yHi, 16)),
+                        _mm_packs_epi32(
+                            _mm_and_si128(uvLo, lowWords),
+                            _mm_and_si128(uvHi, lowWords)),
+                        _mm_packs_epi32(
+                            _mm_srli_epi32(uvLo, 16), _mm_srli_epi32(uvHi, 16)),
+                        dst, dst32bit, swapRedBlue);
+                dst += dstBytes;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    return x;
+}
+
+#endif  // __ARM_NEON__
+
+#endif  // COLOR_CONVERTER_SIMD
+
 ColorConverter::ColorConverter(
         OMX_COLOR_FORMATTYPE from, OMX_COLOR_FORMATTYPE to)
     : mSrcFormat(from),
       mDstFormat(to),
-      mClip(NULL) {
+      mClip(NULL),
+      mNumThreads(0) {
 }
 
 ColorConverter::~ColorConverter() {
@@ -37,7 +497,7 @@ ColorConverter::~ColorConverter() {
 }
 
 bool ColorConverter::isValid() const {
-    if (mDstFormat != OMX_COLOR_Format16bitRGB565) {
+    if (mDstFormat != OMX_COLOR_Format16bitRGB565 && !isDst32bit()) {
         return false;
     }
 
@@ -54,6 +514,15 @@ bool ColorConverter::isValid() const {
     }
 }
 
+bool ColorConverter::isDst32bit() const {
+    return mDstFormat == OMX_COLOR_Format32bitARGB8888
+        || mDstFormat == (OMX_COLOR_FORMATTYPE)kColorFormat32bitRGBA8888;
+}
+
+void ColorConverter::setNumThreads(size_t numThreads) {
+    mNumThreads = numThreads;
+}
+
 ColorConverter::BitmapParams::BitmapParams(
         void *bits,
         size_t width, size_t height,
@@ -85,7 +554,7 @@ status_t ColorConverter::convert(
         size_t dstWidth, size_t dstHeight,
         size_t dstCropLeft, size_t dstCropTop,
         size_t dstCropRight, size_t dstCropBottom) {
-    if (mDstFormat != OMX_COLOR_Format16bitRGB565) {
+    if (mDstFormat != OMX_COLOR_Format16bitRGB565 && !isDst32bit()) {
         return ERROR_UNSUPPORTED;
     }
 
@@ -132,384 +601,268 @@ status_t ColorConverter::convert(
     return err;
 }
 
-status_t ColorConverter::convertCbYCrY(
-        const BitmapParams &src, const BitmapParams &dst) {
-    // XXX Untested
-
-    uint8_t *kAdjustedClip = initClip();
-
-    if (!((src.mCropLeft & 1) == 0
-        && src.cropWidth() == dst.cropWidth()
-        && src.cropHeight() == dst.cropHeight())) {
-        return ERROR_UNSUPPORTED;
-    }
+ColorConverter::RGBLayout ColorConverter::getRGBLayout(
+        const BitmapParams &dst, bool swapRedBlue) const {
+    size_t bytesPerPixel = isDst32bit() ? 4 : 2;
 
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
-        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
+    RGBLayout layout;
+    layout.mBits = (uint8_t *)dst.mBits
+        + (dst.mCropTop * dst.mWidth + dst.mCropLeft) * bytesPerPixel;
+    layout.mStride = dst.mWidth * bytesPerPixel;
+    layout.m32bit = isDst32bit();
 
-    const uint8_t *src_ptr = (const uint8_t *)src.mBits
-        + (src.mCropTop * dst.mWidth + src.mCropLeft) * 2;
+    // OMX_COLOR_Format32bitARGB8888 is B, G, R, A in memory order.
+    layout.mSwapRedBlue =
+        swapRedBlue != (mDstFormat == OMX_COLOR_Format32bitARGB8888);
 
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            signed y1 = (signed)src_ptr[2 * x + 1] - 16;
-            signed y2 = (signed)src_ptr[2 * x + 3] - 16;
-            signed u = (signed)src_ptr[2 * x] - 128;
-            signed v = (signed)src_ptr[2 * x + 2] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[r1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[b1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[r2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[b2] >> 3);
-
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
-        }
-
-        src_ptr += src.mWidth * 2;
-        dst_ptr += dst.mWidth;
-    }
-
-    return OK;
+    return layout;
 }
 
-status_t ColorConverter::convertYUV420Planar(
-        const BitmapParams &src, const BitmapParams &dst) {
-    if (!((src.mCropLeft & 1) == 0
-            && src.cropWidth() == dst.cropWidth()
-            && src.cropHeight() == dst.cropHeight())) {
-        return ERROR_UNSUPPORTED;
+void ColorConverter::convertRows(
+        const YUVLayout &src, const RGBLayout &dst, size_t width,
+        size_t firstRow, size_t numRows) const {
+    const uint8_t *kAdjustedClip = &mClip[-kClipMin];
+
+    for (size_t y = firstRow; y < firstRow + numRows; ++y) {
+        const uint8_t *src_y = src.mY + y * src.mYStride;
+        const uint8_t *src_u = src.mU + (y >> src.mUVRowShift) * src.mUVStride;
+        const uint8_t *src_v = src.mV + (y >> src.mUVRowShift) * src.mUVStride;
+        uint8_t *dst_ptr = dst.mBits + y * dst.mStride;
+
+        size_t x = 0;
+#ifdef COLOR_CONVERTER_SIMD
+        x = convertRowSIMD(
+                src_y, src.mYStep, src_u, src_v, src.mUVStep,
+                dst_ptr, dst.m32bit, dst.mSwapRedBlue, width);
+#endif
+
+        convertRowScalar(
+                kAdjustedClip, src_y, src.mYStep, src_u, src_v, src.mUVStep,
+                dst_ptr, dst.m32bit, dst.mSwapRedBlue, x, width);
     }
+}
 
-    uint8_t *kAdjustedClip = initClip();
-
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
-        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
-
-    const uint8_t *src_y =
-        (const uint8_t *)src.mBits + src.mCropTop * src.mWidth + src.mCropLeft;
+// static
+void *ColorConverter::BandWrapper(void *me) {
+    Band *band = static_cast<Band *>(me);
 
-    const uint8_t *src_u =
-        (const uint8_t *)src_y + src.mWidth * src.mHeight
-        + src.mCropTop * (src.mWidth / 2) + src.mCropLeft / 2;
+    band->mConverter->convertRows(
+            *band->mSrc, *band->mDst, band->mWidth,
+            band->mFirstRow, band->mNumRows);
 
-    const uint8_t *src_v =
-        src_u + (src.mWidth / 2) * (src.mHeight / 2);
+    return NULL;
+}
 
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            // B = 1.164 * (Y - 16) + 2.018 * (U - 128)
-            // G = 1.164 * (Y - 16) - 0.813 * (V - 128) - 0.391 * (U - 128)
-            // R = 1.164 * (Y - 16) + 1.596 * (V - 128)
+status_t ColorConverter::convertFrame(
+        const YUVLayout &src, const RGBLayout &dst,
+        size_t width, size_t height) {
+    initClip();
 
-            // B = 298/256 * (Y - 16) + 517/256 * (U - 128)
-            // G = .................. - 208/256 * (V - 128) - 100/256 * (U - 128)
-            // R = .................. + 409/256 * (V - 128)
+    size_t numBands = mNumThreads;
+    if (numBands == 0) {
+        long numCPUs = sysconf(_SC_NPROCESSORS_ONLN);
+        numBands = (numCPUs > 1) ? (size_t)numCPUs : 1;
 
-            // min_B = (298 * (- 16) + 517 * (- 128)) / 256 = -277
-            // min_G = (298 * (- 16) - 208 * (255 - 128) - 100 * (255 - 128)) / 256 = -172
-            // min_R = (298 * (- 16) + 409 * (- 128)) / 256 = -223
+        if (numBands > kMaxNumThreads) {
+            numBands = kMaxNumThreads;
+        }
+    }
 
-            // max_B = (298 * (255 - 16) + 517 * (255 - 128)) / 256 = 534
-            // max_G = (298 * (255 - 16) - 208 * (- 128) - 100 * (- 128)) / 256 = 432
-            // max_R = (298 * (255 - 16) + 409 * (255 - 128)) / 256 = 481
+    size_t maxNumBands = width * height / kMinPixelsPerBand;
+    if (numBands > maxNumBands) {
+        numBands = maxNumBands;
+    }
 
-            // clip range -278 .. 535
+    if (numBands <= 1) {
+        convertRows(src, dst, width, 0, height);
+        return OK;
+    }
 
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
+    // Even band heights keep the rows sharing a row of chroma together.
+    size_t rowsPerBand = ((height + numBands - 1) / numBands + 1) & ~1;
 
-            signed u = (signed)src_u[x / 2] - 128;
-            signed v = (signed)src_v[x / 2] - 128;
+    Band *bands = new Band[numBands];
+    size_t firstRow = 0;
 
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
+    for (size_t i = 0; i < numBands; ++i) {
+        Band *band = &bands[i];
 
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
+        band->mConverter = this;
+        band->mSrc = &src;
+        band->mDst = &dst;
+        band->mWidth = width;
+        band->mFirstRow = firstRow;
+        band->mNumRows = (height - firstRow < rowsPerBand)
+            ? height - firstRow : rowsPerBand;
+        band->mThreadStarted = false;
 
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
+        firstRow += band->mNumRows;
+    }
 
-            uint32_t rgb1 =
-                ((kAdjustedClip[r1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[b1] >> 3);
+    // The calling thread converts the first band itself, and any band
+    // a thread could not be started for.
+    for (size_t i = 1; i < numBands; ++i) {
+        if (bands[i].mNumRows == 0) {
+            continue;
+        }
 
-            uint32_t rgb2 =
-                ((kAdjustedClip[r2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[b2] >> 3);
+        bands[i].mThreadStarted = pthread_create(
+                &bands[i].mThread, NULL, BandWrapper, &bands[i]) == 0;
 
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
+        if (!bands[i].mThreadStarted) {
+            BandWrapper(&bands[i]);
         }
+    }
 
-        src_y += src.mWidth;
+    BandWrapper(&bands[0]);
 
-        if (y & 1) {
-            src_u += src.mWidth / 2;
-            src_v += src.mWidth / 2;
+    for (size_t i = 1; i < numBands; ++i) {
+        if (bands[i].mThreadStarted) {
+            pthread_join(bands[i].mThread, NULL);
         }
-
-        dst_ptr += dst.mWidth;
     }
 
+    delete[] bands;
+    bands = NULL;
+
     return OK;
 }
 
-status_t ColorConverter::convertQCOMYUV420SemiPlanar(
+status_t ColorConverter::convertCbYCrY(
         const BitmapParams &src, const BitmapParams &dst) {
-    uint8_t *kAdjustedClip = initClip();
+    // XXX Untested
 
+    if (!((src.mCropLeft & 1) == 0
+        && src.cropWidth() == dst.cropWidth()
+        && src.cropHeight() == dst.cropHeight())) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    const uint8_t *src_ptr = (const uint8_t *)src.mBits
+        + (src.mCropTop * dst.mWidth + src.mCropLeft) * 2;
+
+    YUVLayout layout(
+            src_ptr + 1, src.mWidth * 2, 2,
+            src_ptr, src_ptr + 2, src.mWidth * 2, 4, 0);
+
+    return convertFrame(
+            layout, getRGBLayout(dst, false),
+            src.cropWidth(), src.cropHeight());
+}
+
+status_t ColorConverter::convertYUV420Planar(
+        const BitmapParams &src, const BitmapParams &dst) {
     if (!((src.mCropLeft & 1) == 0
             && src.cropWidth() == dst.cropWidth()
             && src.cropHeight() == dst.cropHeight())) {
         return ERROR_UNSUPPORTED;
     }
 
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
-        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
-
     const uint8_t *src_y =
         (const uint8_t *)src.mBits + src.mCropTop * src.mWidth + src.mCropLeft;
 
     const uint8_t *src_u =
         (const uint8_t *)src_y + src.mWidth * src.mHeight
-        + src.mCropTop * src.mWidth + src.mCropLeft;
-
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
-
-            signed u = (signed)src_u[x & ~1] - 128;
-            signed v = (signed)src_u[(x & ~1) + 1] - 128;
+        + src.mCropTop * (src.mWidth / 2) + src.mCropLeft / 2;
 
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
+    const uint8_t *src_v =
+        src_u + (src.mWidth / 2) * (src.mHeight / 2);
 
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
+    YUVLayout layout(
+            src_y, src.mWidth, 1,
+            src_u, src_v, src.mWidth / 2, 1, 1);
 
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
+    return convertFrame(
+            layout, getRGBLayout(dst, false),
+            src.cropWidth(), src.cropHeight());
+}
 
-            uint32_t rgb1 =
-                ((kAdjustedClip[b1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[r1] >> 3);
+// The RGB565 output of the two semi-planar formats below has always taken
+// the chroma bytes in the opposite order and swapped red and blue to make
+// up for it, which it keeps doing. The 32-bit outputs use the specified
+// chroma order.
 
-            uint32_t rgb2 =
-                ((kAdjustedClip[b2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[r2] >> 3);
+status_t ColorConverter::convertQCOMYUV420SemiPlanar(
+        const BitmapParams &src, const BitmapParams &dst) {
+    if (!((src.mCropLeft & 1) == 0
+            && src.cropWidth() == dst.cropWidth()
+            && src.cropHeight() == dst.cropHeight())) {
+        return ERROR_UNSUPPORTED;
+    }
 
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
-        }
+    const uint8_t *src_y =
+        (const uint8_t *)src.mBits + src.mCropTop * src.mWidth + src.mCropLeft;
 
-        src_y += src.mWidth;
+    const uint8_t *src_uv =
+        (const uint8_t *)src_y + src.mWidth * src.mHeight
+        + src.mCropTop * src.mWidth + src.mCropLeft;
 
-        if (y & 1) {
-            src_u += src.mWidth;
-        }
+    // V, U
+    bool legacy = !isDst32bit();
 
-        dst_ptr += dst.mWidth;
-    }
+    YUVLayout layout(
+            src_y, src.mWidth, 1,
+            legacy ? src_uv : src_uv + 1, legacy ? src_uv + 1 : src_uv,
+            src.mWidth, 2, 1);
 
-    return OK;
+    return convertFrame(
+            layout, getRGBLayout(dst, legacy),
+            src.cropWidth(), src.cropHeight());
 }
 
 status_t ColorConverter::convertYUV420SemiPlanar(
         const BitmapParams &src, const BitmapParams &dst) {
     // XXX Untested
 
-    uint8_t *kAdjustedClip = initClip();
-
     if (!((src.mCropLeft & 1) == 0
             && src.cropWidth() == dst.cropWidth()
             && src.cropHeight() == dst.cropHeight())) {
         return ERROR_UNSUPPORTED;
     }
 
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
-        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
-
     const uint8_t *src_y =
         (const uint8_t *)src.mBits + src.mCropTop * src.mWidth + src.mCropLeft;
 
-    const uint8_t *src_u =
+    const uint8_t *src_uv =
         (const uint8_t *)src_y + src.mWidth * src.mHeight
         + src.mCropTop * src.mWidth + src.mCropLeft;
 
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
-
-            signed v = (signed)src_u[x & ~1] - 128;
-            signed u = (signed)src_u[(x & ~1) + 1] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[b1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[r1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[b2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[r2] >> 3);
-
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
-        }
-
-        src_y += src.mWidth;
-
-        if (y & 1) {
-            src_u += src.mWidth;
-        }
+    // U, V
+    bool legacy = !isDst32bit();
 
-        dst_ptr += dst.mWidth;
-    }
+    YUVLayout layout(
+            src_y, src.mWidth, 1,
+            legacy ? src_uv + 1 : src_uv, legacy ? src_uv : src_uv + 1,
+            src.mWidth, 2, 1);
 
-    return OK;
+    return convertFrame(
+            layout, getRGBLayout(dst, legacy),
+            src.cropWidth(), src.cropHeight());
 }
 
 status_t ColorConverter::convertTIYUV420PackedSemiPlanar(
         const BitmapParams &src, const BitmapParams &dst) {
-    uint8_t *kAdjustedClip = initClip();
-
     if (!((src.mCropLeft & 1) == 0
             && src.cropWidth() == dst.cropWidth()
             && src.cropHeight() == dst.cropHeight())) {
         return ERROR_UNSUPPORTED;
     }
 
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
-        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
-
     const uint8_t *src_y = (const uint8_t *)src.mBits;
 
-    const uint8_t *src_u =
+    const uint8_t *src_uv =
         (const uint8_t *)src_y + src.mWidth * (src.mHeight - src.mCropTop / 2);
 
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
-
-            signed u = (signed)src_u[x & ~1] - 128;
-            signed v = (signed)src_u[(x & ~1) + 1] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
+    YUVLayout layout(
+            src_y, src.mWidth, 1,
+            src_uv, src_uv + 1, src.mWidth, 2, 1);
 
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[r1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[b1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[r2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[b2] >> 3);
-
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
-        }
-
-        src_y += src.mWidth;
-
-        if (y & 1) {
-            src_u += src.mWidth;
-        }
-
-        dst_ptr += dst.mWidth;
-    }
-
-    return OK;
+    return convertFrame(
+            layout, getRGBLayout(dst, false),
+            src.cropWidth(), src.cropHeight());
 }
 
 uint8_t *ColorConverter::initClip() {
-    static const signed kClipMin = -278;
-    static const signed kClipMax = 535;
-
     if (mClip == NULL) {
         mClip = new uint8_t[kClipMax - kClipMin + 1];
 
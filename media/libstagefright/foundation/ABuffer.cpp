@@ -40,6 +40,17 @@ ABuffer::ABuffer(void *data, size_t capacity)
       mOwnsData(false) {
 }
 
+// static
+sp<ABuffer> ABuffer::CreateAsSlice(
+        const sp<ABuffer> &buffer, size_t offset, size_t size) {
+    CHECK_LE(offset + size, buffer->size());
+
+    sp<ABuffer> slice = new ABuffer(buffer->data() + offset, size);
+    slice->mParent = buffer;
+
+    return slice;
+}
+
 ABuffer::~ABuffer() {
     if (mOwnsData) {
         if (mData != NULL) {
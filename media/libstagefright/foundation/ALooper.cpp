@@ -19,6 +19,7 @@
 #include <utils/Log.h>
 
 #include <sys/time.h>
+#include <cutils/atomic.h>
 
 #include "ALooper.h"
 
@@ -67,11 +68,17 @@ int64_t ALooper::GetNowUs() {
 }
 
 ALooper::ALooper()
-    : mRunningLocally(false) {
+    : mPostedEvents(NULL),
+      mImmediateHead(NULL),
+      mImmediateTail(NULL),
+      mNextSeq(0),
+      mRunningLocally(false),
+      mRunning(0) {
 }
 
 ALooper::~ALooper() {
     stop();
+    clearEvents();
 }
 
 void ALooper::setName(const char *name) {
@@ -97,6 +104,7 @@ status_t ALooper::start(
             }
 
             mRunningLocally = true;
+            android_atomic_release_store(1, &mRunning);
         }
 
         do {
@@ -112,11 +120,13 @@ status_t ALooper::start(
     }
 
     mThread = new LooperThread(this, canCallJava);
+    android_atomic_release_store(1, &mRunning);
 
     status_t err = mThread->run(
             mName.empty() ? "ALooper" : mName.c_str(), priority);
     if (err != OK) {
         mThread.clear();
+        android_atomic_release_store(0, &mRunning);
     }
 
     return err;
@@ -133,6 +143,7 @@ status_t ALooper::stop() {
         runningLocally = mRunningLocally;
         mThread.clear();
         mRunningLocally = false;
+        android_atomic_release_store(0, &mRunning);
     }
 
     if (thread == NULL && !runningLocally) {
@@ -155,58 +166,180 @@ status_t ALooper::stop() {
 }
 
 void ALooper::post(const sp<AMessage> &msg, int64_t delayUs) {
-    Mutex::Autolock autoLock(mLock);
+    Event *event = new Event;
+    event->mWhenUs = delayUs > 0 ? GetNowUs() + delayUs : GetNowUs();
+    event->mMessage = msg;
+    event->mDelayed = delayUs > 0;
+
+    Event *head;
+    do {
+        head = mPostedEvents;
+        event->mNext = head;
+    } while (android_atomic_release_cas(
+            (int32_t) head, (int32_t) event, (volatile int32_t *) &mPostedEvents) != 0);
+
+    if (head == NULL) {
+        // The looper may be waiting for an event.  It checks for posted events
+        // with mLock held before it waits, so this signal cannot get lost.
+        Mutex::Autolock autoLock(mLock);
+        mQueueChangedCondition.signal();
+    }
+}
 
-    int64_t whenUs;
-    if (delayUs > 0) {
-        whenUs = GetNowUs() + delayUs;
-    } else {
-        whenUs = GetNowUs();
+// static
+bool ALooper::isEarlier(const Event *a, const Event *b) {
+    return a->mWhenUs < b->mWhenUs
+        || (a->mWhenUs == b->mWhenUs && (int32_t)(a->mSeq - b->mSeq) < 0);
+}
+
+void ALooper::takePostedEvents() {
+    Event *head;
+    do {
+        head = mPostedEvents;
+        if (head == NULL) {
+            return;
+        }
+    } while (android_atomic_acquire_cas(
+            (int32_t) head, 0, (volatile int32_t *) &mPostedEvents) != 0);
+
+    // the stack holds the most recently posted event first
+    Event *first = NULL;
+    while (head != NULL) {
+        Event *next = head->mNext;
+        head->mNext = first;
+        first = head;
+        head = next;
     }
 
-    List<Event>::iterator it = mEventQueue.begin();
-    while (it != mEventQueue.end() && (*it).mWhenUs <= whenUs) {
-        ++it;
+    while (first != NULL) {
+        Event *event = first;
+        first = first->mNext;
+
+        event->mSeq = mNextSeq++;
+        if (event->mDelayed) {
+            pushDelayedEvent(event);
+        } else {
+            event->mNext = NULL;
+            if (mImmediateTail != NULL) {
+                mImmediateTail->mNext = event;
+            } else {
+                mImmediateHead = event;
+            }
+            mImmediateTail = event;
+        }
     }
+}
 
-    Event event;
-    event.mWhenUs = whenUs;
-    event.mMessage = msg;
+void ALooper::pushDelayedEvent(Event *event) {
+    size_t i = mDelayedEvents.size();
+    mDelayedEvents.push(event);
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        Event *parentEvent = mDelayedEvents.itemAt(parent);
+        if (!isEarlier(event, parentEvent)) {
+            break;
+        }
+        mDelayedEvents.editItemAt(i) = parentEvent;
+        i = parent;
+    }
+    mDelayedEvents.editItemAt(i) = event;
+}
 
-    if (it == mEventQueue.begin()) {
-        mQueueChangedCondition.signal();
+ALooper::Event *ALooper::popDelayedEvent() {
+    Event *top = mDelayedEvents.itemAt(0);
+    Event *last = mDelayedEvents.top();
+    mDelayedEvents.pop();
+
+    size_t n = mDelayedEvents.size();
+    if (n > 0) {
+        size_t i = 0;
+        for (;;) {
+            size_t child = 2 * i + 1;
+            if (child >= n) {
+                break;
+            }
+            if (child + 1 < n && isEarlier(
+                    mDelayedEvents.itemAt(child + 1), mDelayedEvents.itemAt(child))) {
+                ++child;
+            }
+            if (!isEarlier(mDelayedEvents.itemAt(child), last)) {
+                break;
+            }
+            mDelayedEvents.editItemAt(i) = mDelayedEvents.itemAt(child);
+            i = child;
+        }
+        mDelayedEvents.editItemAt(i) = last;
+    }
+
+    return top;
+}
+
+void ALooper::clearEvents() {
+    takePostedEvents();
+
+    while (mImmediateHead != NULL) {
+        Event *event = mImmediateHead;
+        mImmediateHead = event->mNext;
+        delete event;
     }
+    mImmediateTail = NULL;
 
-    mEventQueue.insert(it, event);
+    for (size_t i = 0; i < mDelayedEvents.size(); ++i) {
+        delete mDelayedEvents.itemAt(i);
+    }
+    mDelayedEvents.clear();
 }
 
 bool ALooper::loop() {
-    Event event;
+    if (android_atomic_acquire_load(&mRunning) == 0) {
+        return false;
+    }
 
-    {
+    takePostedEvents();
+
+    // the earliest of the first immediate event and the first delayed event that is due
+    Event *event = mImmediateHead;
+    int64_t delayUs = -1;
+    if (!mDelayedEvents.isEmpty()) {
+        Event *delayed = mDelayedEvents.itemAt(0);
+        if (event == NULL || delayed->mWhenUs <= event->mWhenUs) {
+            int64_t nowUs = GetNowUs();
+            if (delayed->mWhenUs <= nowUs) {
+                event = delayed;
+            } else if (event == NULL) {
+                delayUs = delayed->mWhenUs - nowUs;
+            }
+        }
+    }
+
+    if (event == NULL) {
         Mutex::Autolock autoLock(mLock);
-        if (mThread == NULL && !mRunningLocally) {
+        if (mRunning == 0) {
             return false;
         }
-        if (mEventQueue.empty()) {
-            mQueueChangedCondition.wait(mLock);
-            return true;
+        if (mPostedEvents == NULL) {
+            if (delayUs < 0) {
+                mQueueChangedCondition.wait(mLock);
+            } else {
+                mQueueChangedCondition.waitRelative(mLock, delayUs * 1000ll);
+            }
         }
-        int64_t whenUs = (*mEventQueue.begin()).mWhenUs;
-        int64_t nowUs = GetNowUs();
-
-        if (whenUs > nowUs) {
-            int64_t delayUs = whenUs - nowUs;
-            mQueueChangedCondition.waitRelative(mLock, delayUs * 1000ll);
+        return true;
+    }
 
-            return true;
+    if (event == mImmediateHead) {
+        mImmediateHead = event->mNext;
+        if (mImmediateHead == NULL) {
+            mImmediateTail = NULL;
         }
-
-        event = *mEventQueue.begin();
-        mEventQueue.erase(mEventQueue.begin());
+    } else {
+        popDelayedEvent();
     }
 
-    gLooperRoster.deliverMessage(event.mMessage);
+    sp<AMessage> msg = event->mMessage;
+    delete event;
+
+    gLooperRoster.deliverMessage(msg);
 
     // NOTE: It's important to note that at this point our "ALooper" object
     // may no longer exist (its final reference may have gone away while
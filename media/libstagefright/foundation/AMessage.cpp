@@ -17,6 +17,8 @@
 #include "AMessage.h"
 
 #include <ctype.h>
+#include <pthread.h>
+#include <string.h>
 
 #include "AAtomizer.h"
 #include "ABuffer.h"
@@ -25,16 +27,120 @@
 #include "AString.h"
 
 #include <binder/Parcel.h>
+#include <cutils/atomic.h>
 #include <media/stagefright/foundation/hexdump.h>
 
 namespace android {
 
 extern ALooperRoster gLooperRoster;
 
+// Messages are created and destroyed at a high rate by ACodec and NuPlayer,
+// so each thread keeps a few of the freed messages and item tables around
+// for reuse.  A block freed on a thread other than the one that allocated it
+// simply moves to the pool of the freeing thread.  Each thread also caches
+// the atoms of the names it has recently set, to spare AAtomizer's lock.
+struct MessagePool {
+    enum {
+        kMaxNumFree = 16,
+        kNumCachedAtoms = 64,
+    };
+
+    enum Class {
+        kClassMessage,
+        kClassTable,
+        kNumClasses
+    };
+
+    void *mFree[kNumClasses][kMaxNumFree];
+    size_t mNumFree[kNumClasses];
+
+    const char *mAtoms[kNumCachedAtoms];
+};
+
+static pthread_key_t gPoolKey;
+static pthread_once_t gPoolKeyOnce = PTHREAD_ONCE_INIT;
+
+static void destroyPool(void *ptr) {
+    MessagePool *pool = static_cast<MessagePool *>(ptr);
+
+    for (size_t c = 0; c < MessagePool::kNumClasses; ++c) {
+        for (size_t i = 0; i < pool->mNumFree[c]; ++i) {
+            ::operator delete(pool->mFree[c][i]);
+        }
+    }
+    delete pool;
+}
+
+static void createPoolKey() {
+    CHECK_EQ(pthread_key_create(&gPoolKey, destroyPool), 0);
+}
+
+static MessagePool *getPool() {
+    pthread_once(&gPoolKeyOnce, createPoolKey);
+
+    MessagePool *pool = static_cast<MessagePool *>(pthread_getspecific(gPoolKey));
+    if (pool == NULL) {
+        pool = new MessagePool;
+        memset(pool, 0, sizeof(*pool));
+        pthread_setspecific(gPoolKey, pool);
+    }
+    return pool;
+}
+
+static void *poolAllocate(MessagePool::Class c, size_t size) {
+    MessagePool *pool = getPool();
+    if (pool->mNumFree[c] > 0) {
+        return pool->mFree[c][--pool->mNumFree[c]];
+    }
+    return ::operator new(size);
+}
+
+static void poolFree(MessagePool::Class c, void *ptr) {
+    MessagePool *pool = getPool();
+    if (pool->mNumFree[c] < MessagePool::kMaxNumFree) {
+        pool->mFree[c][pool->mNumFree[c]++] = ptr;
+    } else {
+        ::operator delete(ptr);
+    }
+}
+
+static inline uint32_t hashName(const char *name) {
+    uint32_t hash = 0;
+    while (*name != '\0') {
+        hash = 31 * hash + (uint8_t)*name++;
+    }
+    return hash;
+}
+
+static const char *atomize(const char *name, uint32_t hash) {
+    const char **atom = &getPool()->mAtoms[hash % MessagePool::kNumCachedAtoms];
+    if (*atom == NULL || strcmp(*atom, name)) {
+        *atom = AAtomizer::Atomize(name);
+    }
+    return *atom;
+}
+
+// static
+void *AMessage::operator new(size_t size) {
+    if (size != sizeof(AMessage)) {
+        return ::operator new(size);
+    }
+    return poolAllocate(MessagePool::kClassMessage, size);
+}
+
+// static
+void AMessage::operator delete(void *ptr, size_t size) {
+    if (size != sizeof(AMessage)) {
+        ::operator delete(ptr);
+        return;
+    }
+    poolFree(MessagePool::kClassMessage, ptr);
+}
+
 AMessage::AMessage(uint32_t what, ALooper::handler_id target)
     : mWhat(what),
       mTarget(target),
-      mNumItems(0) {
+      mTable(NULL) {
 }
 
 AMessage::~AMessage() {
@@ -58,14 +164,87 @@ ALooper::handler_id AMessage::target() const {
 }
 
 void AMessage::clear() {
-    for (size_t i = 0; i < mNumItems; ++i) {
-        Item *item = &mItems[i];
-        freeItem(item);
+    if (mTable != NULL) {
+        releaseTable(mTable);
+        mTable = NULL;
+    }
+}
+
+// static
+AMessage::ItemTable *AMessage::allocateTable() {
+    ItemTable *table = static_cast<ItemTable *>(
+            poolAllocate(MessagePool::kClassTable, sizeof(ItemTable)));
+
+    table->mRefCount = 1;
+    table->mNumItems = 0;
+
+    return table;
+}
+
+// static
+void AMessage::releaseTable(ItemTable *table) {
+    if (android_atomic_dec(&table->mRefCount) != 1) {
+        return;
+    }
+
+    for (size_t i = 0; i < table->mNumItems; ++i) {
+        freeItem(&table->mItems[i], table);
+    }
+    poolFree(MessagePool::kClassTable, table);
+}
+
+// static
+void AMessage::copyItems(ItemTable *to, const ItemTable *from) {
+    to->mNumItems = from->mNumItems;
+
+    for (size_t i = 0; i < from->mNumItems; ++i) {
+        const Item *fromItem = &from->mItems[i];
+        Item *toItem = &to->mItems[i];
+
+        toItem->mName = fromItem->mName;
+        toItem->mNameHash = fromItem->mNameHash;
+        toItem->mType = fromItem->mType;
+
+        switch (fromItem->mType) {
+            case kTypeString:
+            {
+                toItem->u.stringValue =
+                    new AString(*fromItem->u.stringValue);
+                break;
+            }
+
+            case kTypeObject:
+            case kTypeBuffer:
+            {
+                toItem->u.refValue = fromItem->u.refValue;
+                if (toItem->u.refValue != NULL) {
+                    toItem->u.refValue->incStrong(to);
+                }
+                break;
+            }
+
+            case kTypeMessage:
+            {
+                sp<AMessage> copy;
+                if (fromItem->u.refValue != NULL) {
+                    copy = static_cast<AMessage *>(fromItem->u.refValue)->dup();
+                    copy->incStrong(to);
+                }
+                toItem->u.refValue = copy.get();
+                break;
+            }
+
+            default:
+            {
+                toItem->u = fromItem->u;
+                break;
+            }
+        }
     }
-    mNumItems = 0;
 }
 
-void AMessage::freeItem(Item *item) {
+// static
+void AMessage::freeItem(Item *item, const void *id) {
     switch (item->mType) {
         case kTypeString:
         {
@@ -78,7 +257,7 @@ void AMessage::freeItem(Item *item) {
         case kTypeBuffer:
         {
             if (item->u.refValue != NULL) {
-                item->u.refValue->decStrong(this);
+                item->u.refValue->decStrong(id);
             }
             break;
         }
@@ -88,25 +267,42 @@ void AMessage::freeItem(Item *item) {
     }
 }
 
+AMessage::ItemTable *AMessage::editTable() {
+    if (mTable == NULL) {
+        mTable = allocateTable();
+    } else if (android_atomic_acquire_load(&mTable->mRefCount) > 1) {
+        ItemTable *table = allocateTable();
+        copyItems(table, mTable);
+        releaseTable(mTable);
+        mTable = table;
+    }
+
+    return mTable;
+}
+
 AMessage::Item *AMessage::allocateItem(const char *name) {
-    name = AAtomizer::Atomize(name);
+    ItemTable *table = editTable();
+    uint32_t hash = hashName(name);
 
     size_t i = 0;
-    while (i < mNumItems && mItems[i].mName != name) {
+    while (i < table->mNumItems
+            && (table->mItems[i].mNameHash != hash
+                || strcmp(table->mItems[i].mName, name))) {
         ++i;
     }
 
     Item *item;
 
-    if (i < mNumItems) {
-        item = &mItems[i];
-        freeItem(item);
+    if (i < table->mNumItems) {
+        item = &table->mItems[i];
+        freeItem(item, table);
     } else {
-        CHECK(mNumItems < kMaxNumItems);
-        i = mNumItems++;
-        item = &mItems[i];
+        CHECK(table->mNumItems < kMaxNumItems);
+        i = table->mNumItems++;
+        item = &table->mItems[i];
 
-        item->mName = name;
+        item->mName = atomize(name, hash);
+        item->mNameHash = hash;
     }
 
     return item;
@@ -114,12 +310,16 @@ AMessage::Item *AMessage::allocateItem(const char *name) {
 
 const AMessage::Item *AMessage::findItem(
         const char *name, Type type) const {
-    name = AAtomizer::Atomize(name);
+    if (mTable == NULL) {
+        return NULL;
+    }
+
+    uint32_t hash = hashName(name);
 
-    for (size_t i = 0; i < mNumItems; ++i) {
-        const Item *item = &mItems[i];
+    for (size_t i = 0; i < mTable->mNumItems; ++i) {
+        const Item *item = &mTable->mItems[i];
 
-        if (item->mName == name) {
+        if (item->mNameHash == hash && !strcmp(item->mName, name)) {
             return item->mType == type ? item : NULL;
         }
     }
@@ -172,7 +372,7 @@ void AMessage::setObjectInternal(
     Item *item = allocateItem(name);
     item->mType = type;
 
-    if (obj != NULL) { obj->incStrong(this); }
+    if (obj != NULL) { obj->incStrong(mTable); }
     item->u.refValue = obj.get();
 }
 
@@ -188,7 +388,7 @@ void AMessage::setMessage(const char *name, const sp<AMessage> &obj) {
     Item *item = allocateItem(name);
     item->mType = kTypeMessage;
 
-    if (obj != NULL) { obj->incStrong(this); }
+    if (obj != NULL) { obj->incStrong(mTable); }
     item->u.refValue = obj.get();
 }
 
@@ -283,49 +483,29 @@ bool AMessage::senderAwaitsResponse(uint32_t *replyID) const {
 
 sp<AMessage> AMessage::dup() const {
     sp<AMessage> msg = new AMessage(mWhat, mTarget);
-    msg->mNumItems = mNumItems;
-
-    for (size_t i = 0; i < mNumItems; ++i) {
-        const Item *from = &mItems[i];
-        Item *to = &msg->mItems[i];
 
-        to->mName = from->mName;
-        to->mType = from->mType;
-
-        switch (from->mType) {
-            case kTypeString:
-            {
-                to->u.stringValue =
-                    new AString(*from->u.stringValue);
-                break;
-            }
-
-            case kTypeObject:
-            case kTypeBuffer:
-            {
-                to->u.refValue = from->u.refValue;
-                to->u.refValue->incStrong(msg.get());
-                break;
-            }
-
-            case kTypeMessage:
-            {
-                sp<AMessage> copy =
-                    static_cast<AMessage *>(from->u.refValue)->dup();
-
-                to->u.refValue = copy.get();
-                to->u.refValue->incStrong(msg.get());
-                break;
-            }
+    if (mTable == NULL) {
+        return msg;
+    }
 
-            default:
-            {
-                to->u = from->u;
-                break;
-            }
+    // Contained messages can be modified through findMessage(), so a table
+    // holding any must be copied right away to give the copy messages of its own.
+    bool hasMessages = false;
+    for (size_t i = 0; i < mTable->mNumItems; ++i) {
+        if (mTable->mItems[i].mType == kTypeMessage) {
+            hasMessages = true;
+            break;
         }
     }
 
+    if (hasMessages) {
+        msg->mTable = allocateTable();
+        copyItems(msg->mTable, mTable);
+    } else {
+        android_atomic_inc(&mTable->mRefCount);
+        msg->mTable = mTable;
+    }
+
     return msg;
 }
 
@@ -368,8 +548,8 @@ AString AMessage::debugString(int32_t indent) const {
     }
     s.append(") = {\n");
 
-    for (size_t i = 0; i < mNumItems; ++i) {
-        const Item &item = mItems[i];
+    for (size_t i = 0; i < countEntries(); ++i) {
+        const Item &item = mTable->mItems[i];
 
         switch (item.mType) {
             case kTypeInt32:
@@ -459,12 +639,17 @@ sp<AMessage> AMessage::FromParcel(const Parcel &parcel) {
     int32_t what = parcel.readInt32();
     sp<AMessage> msg = new AMessage(what);
 
-    msg->mNumItems = static_cast<size_t>(parcel.readInt32());
+    size_t numItems = static_cast<size_t>(parcel.readInt32());
+    CHECK_LE(numItems, (size_t)kMaxNumItems);
+
+    ItemTable *table = msg->editTable();
+    table->mNumItems = numItems;
 
-    for (size_t i = 0; i < msg->mNumItems; ++i) {
-        Item *item = &msg->mItems[i];
+    for (size_t i = 0; i < numItems; ++i) {
+        Item *item = &table->mItems[i];
 
         item->mName = AAtomizer::Atomize(parcel.readCString());
+        item->mNameHash = hashName(item->mName);
         item->mType = static_cast<Type>(parcel.readInt32());
 
         switch (item->mType) {
@@ -507,7 +692,7 @@ sp<AMessage> AMessage::FromParcel(const Parcel &parcel) {
             case kTypeMessage:
             {
                 sp<AMessage> subMsg = AMessage::FromParcel(parcel);
-                subMsg->incStrong(msg.get());
+                subMsg->incStrong(table);
 
                 item->u.refValue = subMsg.get();
                 break;
@@ -526,10 +711,10 @@ sp<AMessage> AMessage::FromParcel(const Parcel &parcel) {
 
 void AMessage::writeToParcel(Parcel *parcel) const {
     parcel->writeInt32(static_cast<int32_t>(mWhat));
-    parcel->writeInt32(static_cast<int32_t>(mNumItems));
+    parcel->writeInt32(static_cast<int32_t>(countEntries()));
 
-    for (size_t i = 0; i < mNumItems; ++i) {
-        const Item &item = mItems[i];
+    for (size_t i = 0; i < countEntries(); ++i) {
+        const Item &item = mTable->mItems[i];
 
         parcel->writeCString(item.mName);
         parcel->writeInt32(static_cast<int32_t>(item.mType));
@@ -587,19 +772,19 @@ void AMessage::writeToParcel(Parcel *parcel) const {
 }
 
 size_t AMessage::countEntries() const {
-    return mNumItems;
+    return mTable != NULL ? mTable->mNumItems : 0;
 }
 
 const char *AMessage::getEntryNameAt(size_t index, Type *type) const {
-    if (index >= mNumItems) {
+    if (index >= countEntries()) {
         *type = kTypeInt32;
 
         return NULL;
     }
 
-    *type = mItems[index].mType;
+    *type = mTable->mItems[index].mType;
 
-    return mItems[index].mName;
+    return mTable->mItems[index].mName;
 }
 
 }  // namespace android
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "bytescan.h"
+
+#include <string.h>
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace android {
+
+#if !defined(__ARM_NEON__) && !defined(__SSE2__)
+// Returns whether any byte of x is 0x00.
+static inline bool hasZeroByte(unsigned long x) {
+    static const unsigned long kOnes = (unsigned long)-1 / 0xff;
+    return ((x - kOnes) & ~x & (kOnes << 7)) != 0;
+}
+#endif
+
+// Returns whether any of the 16 bytes at data is 0x00.
+static inline bool blockHasZeroByte(const uint8_t *data) {
+#if defined(__ARM_NEON__)
+    uint8x16_t zero = vceqq_u8(vld1q_u8(data), vdupq_n_u8(0));
+    uint32x2_t any = vreinterpret_u32_u8(
+            vorr_u8(vget_low_u8(zero), vget_high_u8(zero)));
+    return (vget_lane_u32(any, 0) | vget_lane_u32(any, 1)) != 0;
+#elif defined(__SSE2__)
+    __m128i v = _mm_loadu_si128((const __m128i *)data);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) != 0;
+#else
+    for (size_t i = 0; i < 16; i += sizeof(unsigned long)) {
+        unsigned long word;
+        memcpy(&word, &data[i], sizeof(word));
+        if (hasZeroByte(word)) {
+            return true;
+        }
+    }
+    return false;
+#endif
+}
+
+size_t findStartCodePrefix(const uint8_t *data, size_t size) {
+    static const size_t kBlockSize = 16;
+
+    size_t offset = 0;
+    while (offset + 2 < size) {
+        // The first byte of a start code is 0x00, skip blocks without any.
+        while (offset + kBlockSize + 2 <= size
+                && !blockHasZeroByte(&data[offset])) {
+            offset += kBlockSize;
+        }
+
+        size_t end = offset + kBlockSize;
+        if (end > size - 2) {
+            end = size - 2;
+        }
+
+        for (; offset < end; ++offset) {
+            if (data[offset] == 0x00 && data[offset + 1] == 0x00
+                    && data[offset + 2] == 0x01) {
+                return offset;
+            }
+        }
+    }
+
+    return size;
+}
+
+size_t findSyncWord(const uint8_t *data, size_t size, uint8_t mask) {
+    if (size < 2) {
+        return size;
+    }
+
+    // memchr() is vectorized by the C library.
+    const uint8_t *ptr = data;
+    const uint8_t *last = &data[size - 1];
+    while (ptr < last
+            && (ptr = (const uint8_t *)memchr(ptr, 0xff, last - ptr)) != NULL) {
+        if ((ptr[1] & mask) == mask) {
+            return ptr - data;
+        }
+        ++ptr;
+    }
+
+    return size;
+}
+
+}  // namespace android
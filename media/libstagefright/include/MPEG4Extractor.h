@@ -92,6 +92,20 @@ private:
     bool mIsDrm;
     status_t parseDrmSINF(off64_t *offset, off64_t data_offset);
 
+    enum {
+        kMediaDataHintSize = 256 * 1024,
+    };
+
+    off64_t mFirstMdatOffset;  // Of the data, -1 if no 'mdat' seen yet
+
+    // Sample tables that could not be copied, pinned in a caching source
+    // instead until the extractor goes away.
+    struct PinnedRange {
+        off64_t mOffset;
+        size_t mSize;
+    };
+    Vector<PinnedRange> mPinnedRanges;
+
     status_t parseTrackHeader(off64_t data_offset, off64_t data_size);
 
     Track *findTrackByMimePrefix(const char *mimePrefix);
@@ -51,6 +51,9 @@ struct NuCachedSource2 : public DataSource {
 
     virtual String8 getMIMEType() const;
 
+    virtual void hintRange(off64_t offset, size_t size, bool pin);
+    virtual void releaseRange(off64_t offset, size_t size);
+
     ////////////////////////////////////////////////////////////////////////////
 
     size_t cachedSize();
@@ -84,6 +87,15 @@ private:
         // Read data after a 15 sec timeout whether we're actively
         // fetching or not.
         kDefaultKeepAliveIntervalUs     = 15000000,
+
+        // Pages outside of the range being fetched stay cached, up to this
+        // many bytes, plus the pinned ones.
+        kMaxRetainedBytes               = 8 * 1024 * 1024,
+        kMaxPinnedBytes                 = 4 * 1024 * 1024,
+
+        // Hinted ranges are only prefetched while the reader has at least
+        // this much data ahead of it.
+        kPrefetchMarginBytes            = 2 * 1024 * 1024,
     };
 
     enum {
@@ -103,6 +115,13 @@ private:
     mutable Mutex mLock;
     Condition mCondition;
 
+    struct Range {
+        off64_t mOffset;
+        size_t mSize;
+    };
+
+    // The cache is sparse: mCacheOffset is where the range being fetched,
+    // the "window", starts, and it ends at the first byte not cached.
     PageCache *mCache;
     off64_t mCacheOffset;
     status_t mFinalStatus;
@@ -122,14 +141,26 @@ private:
 
     bool mDisconnectAtHighwatermark;
     bool mForceStop;
+
+    List<Range> mPinnedRanges;
+    size_t mPinnedBytes;
+    List<Range> mPrefetchRanges;
+    bool mPrefetching;  // Partway through the first of mPrefetchRanges
+
     void onMessageReceived(const sp<AMessage> &msg);
     void onFetch();
     void onRead(const sp<AMessage> &msg);
 
     void fetchInternal();
+    bool prefetchIfNecessary();
+    ssize_t readIntoCache(off64_t offset);
     ssize_t readInternal(off64_t offset, void *data, size_t size);
     status_t seekInternal_l(off64_t offset);
 
+    off64_t windowEnd_l() const;
+    void pageAlignRange(off64_t offset, size_t size, Range *range);
+    bool isPinned_l(off64_t offset, size_t size) const;
+
     size_t approxDataRemaining_l(status_t *finalStatus) const;
 
     void restartPrefetcherIfNecessary_l(
@@ -118,6 +118,9 @@ public:
 
     virtual void binderDied(const wp<IBinder> &the_late_who);
 
+    // Per node buffer sharing and copy statistics.
+    virtual status_t dump(int fd, const Vector<String16> &args);
+
     OMX_ERRORTYPE OnEvent(
             node_id node,
             OMX_IN OMX_EVENTTYPE eEvent,
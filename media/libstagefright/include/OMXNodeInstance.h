@@ -21,6 +21,7 @@
 #include "OMX.h"
 
 #include <utils/RefBase.h>
+#include <utils/String8.h>
 #include <utils/threads.h>
 
 namespace android {
@@ -30,7 +31,7 @@ struct OMXMaster;
 
 struct OMXNodeInstance {
     OMXNodeInstance(
-            OMX *owner, const sp<IOMXObserver> &observer);
+            OMX *owner, const sp<IOMXObserver> &observer, const char *name);
 
     void setHandle(OMX::node_id node_id, OMX_HANDLETYPE handle);
 
@@ -105,6 +106,8 @@ struct OMXNodeInstance {
     void onObserverDied(OMXMaster *master);
     void onGetHandleFailed();
 
+    void dump(String8 *result);
+
     static OMX_CALLBACKTYPE kCallbacks;
 
 private:
@@ -115,6 +118,7 @@ private:
     OMX_HANDLETYPE mHandle;
     sp<IOMXObserver> mObserver;
     bool mDying;
+    String8 mName;
 
     struct ActiveBuffer {
         OMX_U32 mPortIndex;
@@ -122,6 +126,19 @@ private:
     };
     Vector<ActiveBuffer> mActiveBuffers;
 
+    struct PortStats {
+        size_t mNumBackupBuffers;
+        int64_t mNumBytesCopied;    // Between backup and component buffers
+    };
+
+    // Buffer data is copied on the callback dispatcher thread as well, which
+    // does not hold mLock.
+    Mutex mStatsLock;
+    KeyedVector<OMX_U32, PortStats> mPortStats;
+
+    PortStats *editPortStats_l(OMX_U32 portIndex);
+    void addBytesCopied(OMX_U32 portIndex, size_t size);
+
     ~OMXNodeInstance();
 
     void addActiveBuffer(OMX_U32 portIndex, OMX::buffer_id id);
@@ -111,6 +111,19 @@ private:
     uint32_t mTimeToSampleCount;
     uint32_t *mTimeToSample;
 
+    // The first sample and its decode time of every
+    // kTimeToSampleCheckpointInterval-th time-to-sample entry, so that a
+    // sample or a time can be found without walking the whole table.
+    struct TimeToSampleCheckpoint {
+        uint32_t mSampleIndex;
+        uint64_t mTime;
+    };
+    TimeToSampleCheckpoint *mTimeToSampleCheckpoints;
+    uint32_t mNumTimeToSampleCheckpoints;
+    uint32_t mNumTimedSamples;  // samples covered by the time-to-sample table
+
+    // Only built by findSampleAtTime() for tables whose composition offsets
+    // spread too far to search a window of samples around the time.
     struct SampleTimeEntry {
         uint32_t mSampleIndex;
         uint64_t mCompositionTime;
@@ -120,6 +133,8 @@ private:
     uint32_t *mCompositionTimeDeltaEntries;
     size_t mNumCompositionTimeDeltaEntries;
     CompositionDeltaLookup *mCompositionDeltaLookup;
+    int32_t mMinCompositionTimeOffset;
+    int32_t mMaxCompositionTimeOffset;
 
     off64_t mSyncSampleOffset;
     uint32_t mNumSyncSamples;
@@ -140,6 +155,23 @@ private:
     status_t getSampleSize_l(uint32_t sample_index, size_t *sample_size);
     uint32_t getCompositionTimeOffset(uint32_t sampleIndex);
 
+    // Finds the time-to-sample entry that covers sampleIndex (or the last
+    // one), and the first sample and decode time of that entry.
+    void findTimeToSampleEntry(
+            uint32_t sampleIndex, uint32_t *entry,
+            uint32_t *entrySampleIndex, uint64_t *entryTime) const;
+
+    uint64_t getDecodeTime(uint32_t sampleIndex) const;
+
+    // Returns the first sample decoded at or after "time", or
+    // mNumTimedSamples if there is none.
+    uint32_t findFirstSampleDecodedAt(int64_t time) const;
+
+    status_t getSampleTime(uint32_t sampleIndex, uint64_t *time);
+
+    status_t findSampleAtTimeInWindow(
+            uint64_t req_time, uint32_t *sample_index, uint32_t flags);
+
     static int CompareIncreasingTime(const void *, const void *);
 
     void buildSampleEntriesTable();
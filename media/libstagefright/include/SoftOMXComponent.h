@@ -45,6 +45,9 @@ protected:
 
     const char *name() const;
 
+    // For codecs sizing their thread pools.
+    static int GetCPUCoreCount();
+
     void notify(
             OMX_EVENTTYPE event,
             OMX_U32 data1, OMX_U32 data2, OMX_PTR data);
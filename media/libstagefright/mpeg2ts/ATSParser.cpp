@@ -82,6 +82,10 @@ struct ATSParser::Program : public RefBase {
         return mParser->mFlags;
     }
 
+    // Enters this program's streams into |streamsByPID| wherever the
+    // PID is not claimed by an earlier program yet.
+    void addStreamsByPID(Stream **streamsByPID);
+
 private:
     ATSParser *mParser;
     unsigned mProgramNumber;
@@ -108,7 +112,7 @@ struct ATSParser::Stream : public RefBase {
     status_t parse(
             unsigned continuity_counter,
             unsigned payload_unit_start_indicator,
-            ABitReader *br);
+            const uint8_t *data, size_t size);
 
     void signalDiscontinuity(
             DiscontinuityType type, const sp<AMessage> &extra);
@@ -207,12 +211,26 @@ bool ATSParser::Program::parsePID(
         return false;
     }
 
+    size_t payloadSizeBits = br->numBitsLeft();
+    CHECK_EQ(payloadSizeBits % 8, 0u);
+
     *err = mStreams.editValueAt(index)->parse(
-            continuity_counter, payload_unit_start_indicator, br);
+            continuity_counter, payload_unit_start_indicator,
+            br->data(), payloadSizeBits / 8);
 
     return true;
 }
 
+void ATSParser::Program::addStreamsByPID(Stream **streamsByPID) {
+    for (size_t i = 0; i < mStreams.size(); ++i) {
+        unsigned pid = mStreams.keyAt(i);
+
+        if (streamsByPID[pid] == NULL) {
+            streamsByPID[pid] = mStreams.editValueAt(i).get();
+        }
+    }
+}
+
 void ATSParser::Program::signalDiscontinuity(
         DiscontinuityType type, const sp<AMessage> &extra) {
     int64_t mediaTimeUs;
@@ -521,7 +539,8 @@ ATSParser::Stream::~Stream() {
 
 status_t ATSParser::Stream::parse(
         unsigned continuity_counter,
-        unsigned payload_unit_start_indicator, ABitReader *br) {
+        unsigned payload_unit_start_indicator,
+        const uint8_t *data, size_t size) {
     if (mQueue == NULL) {
         return OK;
     }
@@ -559,10 +578,7 @@ status_t ATSParser::Stream::parse(
         return OK;
     }
 
-    size_t payloadSizeBits = br->numBitsLeft();
-    CHECK_EQ(payloadSizeBits % 8, 0u);
-
-    size_t neededSize = mBuffer->size() + payloadSizeBits / 8;
+    size_t neededSize = mBuffer->size() + size;
     if (mBuffer->capacity() < neededSize) {
         // Increment in multiples of 64K.
         neededSize = (neededSize + 65535) & ~65535;
@@ -575,8 +591,8 @@ status_t ATSParser::Stream::parse(
         mBuffer = newBuffer;
     }
 
-    memcpy(mBuffer->data() + mBuffer->size(), br->data(), payloadSizeBits / 8);
-    mBuffer->setRange(0, mBuffer->size() + payloadSizeBits / 8);
+    memcpy(mBuffer->data() + mBuffer->size(), data, size);
+    mBuffer->setRange(0, mBuffer->size() + size);
 
     return OK;
 }
@@ -921,6 +937,7 @@ ATSParser::ATSParser(uint32_t flags)
     : mFlags(flags),
       mAbsoluteTimeAnchorUs(-1ll),
       mNumTSPacketsParsed(0),
+      mStreamsByPIDValid(false),
       mNumPCRs(0) {
     mPSISections.add(0 /* PID */, new PSISection);
 }
@@ -931,8 +948,23 @@ ATSParser::~ATSParser() {
 status_t ATSParser::feedTSPacket(const void *data, size_t size) {
     CHECK_EQ(size, kTSPacketSize);
 
-    ABitReader br((const uint8_t *)data, kTSPacketSize);
-    return parseTS(&br);
+    return parseTSPacket((const uint8_t *)data);
+}
+
+status_t ATSParser::feedTSPackets(const void *data, size_t count) {
+    const uint8_t *packet = (const uint8_t *)data;
+
+    for (size_t i = 0; i < count; ++i) {
+        status_t err = parseTSPacket(packet);
+
+        if (err != OK) {
+            return err;
+        }
+
+        packet += kTSPacketSize;
+    }
+
+    return OK;
 }
 
 void ATSParser::signalDiscontinuity(
@@ -1057,6 +1089,10 @@ status_t ATSParser::parsePID(
             return OK;
         }
 
+        // The section may add programs, streams or sections, or swap
+        // the PIDs of two streams.
+        mStreamsByPIDValid = false;
+
         ABitReader sectionBits(section->data(), section->size());
 
         if (PID == 0) {
@@ -1204,6 +1240,53 @@ status_t ATSParser::parseTS(ABitReader *br) {
     return err;
 }
 
+status_t ATSParser::parseTSPacket(const uint8_t *packet) {
+    // Packets without an adaptation field that belong to an elementary
+    // stream make up the bulk of a transport stream, their payload goes
+    // straight to the stream without a bit reader or any PID lookups.
+    unsigned adaptation_field_control = (packet[3] >> 4) & 3;
+
+    if (packet[0] == 0x47 && adaptation_field_control == 1) {
+        if (!mStreamsByPIDValid) {
+            rebuildStreamsByPID();
+        }
+
+        unsigned PID = ((packet[1] & 0x1f) << 8) | packet[2];
+        Stream *stream = mStreamsByPID[PID];
+
+        if (stream != NULL) {
+            unsigned payload_unit_start_indicator = (packet[1] >> 6) & 1;
+            unsigned continuity_counter = packet[3] & 0x0f;
+
+            status_t err = stream->parse(
+                    continuity_counter, payload_unit_start_indicator,
+                    packet + 4, kTSPacketSize - 4);
+
+            ++mNumTSPacketsParsed;
+
+            return err;
+        }
+    }
+
+    ABitReader br(packet, kTSPacketSize);
+    return parseTS(&br);
+}
+
+void ATSParser::rebuildStreamsByPID() {
+    memset(mStreamsByPID, 0, sizeof(mStreamsByPID));
+
+    for (size_t i = 0; i < mPrograms.size(); ++i) {
+        mPrograms.editItemAt(i)->addStreamsByPID(mStreamsByPID);
+    }
+
+    // Sections take precedence over streams on the same PID, see parsePID.
+    for (size_t i = 0; i < mPSISections.size(); ++i) {
+        mStreamsByPID[mPSISections.keyAt(i)] = NULL;
+    }
+
+    mStreamsByPIDValid = true;
+}
+
 sp<MediaSource> ATSParser::getSource(SourceType type) {
     int which = -1;  // any
 
@@ -64,6 +64,10 @@ struct ATSParser : public RefBase {
 
     status_t feedTSPacket(const void *data, size_t size);
 
+    // Feeds |count| consecutive packets of 188 bytes each, stops at the
+    // first packet that fails to parse and returns its error.
+    status_t feedTSPackets(const void *data, size_t count);
+
     void signalDiscontinuity(
             DiscontinuityType type, const sp<AMessage> &extra);
 
@@ -108,6 +112,15 @@ private:
 
     size_t mNumTSPacketsParsed;
 
+    // Elementary streams indexed by PID, for packets that carry nothing but
+    // payload. Rebuilt lazily once a PSI section may have changed the
+    // programs or their streams, does not hold references: the streams
+    // are owned by their programs.
+    Stream *mStreamsByPID[8192];
+    bool mStreamsByPIDValid;
+
+    void rebuildStreamsByPID();
+
     void parseProgramAssociationTable(ABitReader *br);
     void parseProgramMap(ABitReader *br);
     void parsePES(ABitReader *br);
@@ -119,6 +132,7 @@ private:
 
     void parseAdaptationField(ABitReader *br, unsigned PID);
     status_t parseTS(ABitReader *br);
+    status_t parseTSPacket(const uint8_t *packet);
 
     void updatePCR(unsigned PID, uint64_t PCR, size_t byteOffsetFromStart);
 
@@ -24,6 +24,7 @@
 #include <media/stagefright/foundation/ABitReader.h>
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/bytescan.h>
 #include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/MediaDefs.h>
 #include <media/stagefright/MetaData.h>
@@ -46,7 +47,12 @@ sp<MetaData> ElementaryStreamQueue::getFormat() {
 
 void ElementaryStreamQueue::clear(bool clearFormat) {
     if (mBuffer != NULL) {
-        mBuffer->setRange(0, 0);
+        if (mBuffer->getStrongCount() == 1) {
+            mBuffer->setRange(0, 0);
+        } else {
+            // Access units still refer to its data.
+            mBuffer.clear();
+        }
     }
 
     mRangeInfos.clear();
@@ -56,6 +62,14 @@ void ElementaryStreamQueue::clear(bool clearFormat) {
     }
 }
 
+// Size of the chunks that the queued data is appended to.
+static const size_t kMinChunkSize = 256 * 1024;
+
+void ElementaryStreamQueue::consume(size_t size) {
+    CHECK_LE(size, mBuffer->size());
+    mBuffer->setRange(mBuffer->offset() + size, mBuffer->size() - size);
+}
+
 static bool IsSeeminglyValidADTSHeader(const uint8_t *ptr, size_t size) {
     if (size < 3) {
         // Not enough data to verify header.
@@ -135,11 +149,15 @@ status_t ElementaryStreamQueue::appendData(
                 uint8_t *ptr = (uint8_t *)data;
 
                 ssize_t startOffset = -1;
-                for (size_t i = 0; i + 3 < size; ++i) {
-                    if (!memcmp("\x00\x00\x00\x01", &ptr[i], 4)) {
+                size_t i = 0;
+                while (i + 3 < size) {
+                    // find a 0x00 0x00 0x01 prefix preceded by 0x00
+                    i += findStartCodePrefix(&ptr[i + 1], size - i - 1);
+                    if (i + 3 < size && ptr[i] == 0x00) {
                         startOffset = i;
                         break;
                     }
+                    ++i;
                 }
 
                 if (startOffset < 0) {
@@ -168,11 +186,9 @@ status_t ElementaryStreamQueue::appendData(
                 uint8_t *ptr = (uint8_t *)data;
 
                 ssize_t startOffset = -1;
-                for (size_t i = 0; i + 2 < size; ++i) {
-                    if (!memcmp("\x00\x00\x01", &ptr[i], 3)) {
-                        startOffset = i;
-                        break;
-                    }
+                size_t i = findStartCodePrefix(ptr, size);
+                if (i < size) {
+                    startOffset = i;
                 }
 
                 if (startOffset < 0) {
@@ -201,7 +217,8 @@ status_t ElementaryStreamQueue::appendData(
                 }
 #else
                 ssize_t startOffset = -1;
-                for (size_t i = 0; i < size; ++i) {
+                for (size_t i = findSyncWord(ptr, size, 0xf0); i < size;
+                        i += 1 + findSyncWord(&ptr[i + 1], size - i - 1, 0xf0)) {
                     if (IsSeeminglyValidADTSHeader(&ptr[i], size - i)) {
                         startOffset = i;
                         break;
@@ -228,7 +245,8 @@ status_t ElementaryStreamQueue::appendData(
                 uint8_t *ptr = (uint8_t *)data;
 
                 ssize_t startOffset = -1;
-                for (size_t i = 0; i < size; ++i) {
+                for (size_t i = findSyncWord(ptr, size, 0xe0); i < size;
+                        i += 1 + findSyncWord(&ptr[i + 1], size - i - 1, 0xe0)) {
                     if (IsSeeminglyValidMPEGAudioHeader(&ptr[i], size - i)) {
                         startOffset = i;
                         break;
@@ -261,25 +279,40 @@ status_t ElementaryStreamQueue::appendData(
         }
     }
 
-    size_t neededSize = (mBuffer == NULL ? 0 : mBuffer->size()) + size;
-    if (mBuffer == NULL || neededSize > mBuffer->capacity()) {
-        neededSize = (neededSize + 65535) & ~65535;
-
-        ALOGV("resizing buffer to size %d", neededSize);
+    if (mBuffer == NULL
+            || mBuffer->offset() + mBuffer->size() + size > mBuffer->capacity()) {
+        size_t neededSize = (mBuffer == NULL ? 0 : mBuffer->size()) + size;
 
-        sp<ABuffer> buffer = new ABuffer(neededSize);
-        if (mBuffer != NULL) {
-            memcpy(buffer->data(), mBuffer->data(), mBuffer->size());
-            buffer->setRange(0, mBuffer->size());
+        if (mBuffer != NULL && mBuffer->getStrongCount() == 1
+                && neededSize <= mBuffer->capacity()) {
+            // No access unit refers to the consumed data any more, move
+            // the remaining partial access unit back to the front.
+            memmove(mBuffer->base(), mBuffer->data(), mBuffer->size());
+            mBuffer->setRange(0, mBuffer->size());
         } else {
-            buffer->setRange(0, 0);
-        }
+            // Start a new chunk and carry over only the queued data, the
+            // previous one lives on as long as its access units do.
+            neededSize = (neededSize * 2 + 65535) & ~65535;
+            if (neededSize < kMinChunkSize) {
+                neededSize = kMinChunkSize;
+            }
 
-        mBuffer = buffer;
+            ALOGV("allocating chunk of size %d", neededSize);
+
+            sp<ABuffer> buffer = new ABuffer(neededSize);
+            if (mBuffer != NULL) {
+                memcpy(buffer->data(), mBuffer->data(), mBuffer->size());
+                buffer->setRange(0, mBuffer->size());
+            } else {
+                buffer->setRange(0, 0);
+            }
+
+            mBuffer = buffer;
+        }
     }
 
     memcpy(mBuffer->data() + mBuffer->size(), data, size);
-    mBuffer->setRange(0, mBuffer->size() + size);
+    mBuffer->setRange(mBuffer->offset(), mBuffer->size() + size);
 
     RangeInfo info;
     info.mLength = size;
@@ -305,15 +338,11 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnit() {
         RangeInfo info = *mRangeInfos.begin();
         mRangeInfos.erase(mRangeInfos.begin());
 
-        sp<ABuffer> accessUnit = new ABuffer(info.mLength);
-        memcpy(accessUnit->data(), mBuffer->data(), info.mLength);
+        sp<ABuffer> accessUnit =
+            ABuffer::CreateAsSlice(mBuffer, 0, info.mLength);
         accessUnit->meta()->setInt64("timeUs", info.mTimestampUs);
 
-        memmove(mBuffer->data(),
-                mBuffer->data() + info.mLength,
-                mBuffer->size() - info.mLength);
-
-        mBuffer->setRange(0, mBuffer->size() - info.mLength);
+        consume(info.mLength);
 
         if (mFormat == NULL) {
             mFormat = MakeAVCCodecSpecificData(accessUnit);
@@ -371,8 +400,10 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitPCMAudio() {
         return NULL;
     }
 
-    sp<ABuffer> accessUnit = new ABuffer(payloadSize);
-    memcpy(accessUnit->data(), mBuffer->data() + 4, payloadSize);
+    // The samples are converted in place, the slice is the only reference
+    // to this part of the queued data once it has been consumed.
+    sp<ABuffer> accessUnit = ABuffer::CreateAsSlice(mBuffer, 4, payloadSize);
+    consume(4 + payloadSize);
 
     int64_t timeUs = fetchTimestamp(payloadSize + 4);
     CHECK_GE(timeUs, 0ll);
@@ -383,13 +414,6 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitPCMAudio() {
         ptr[i] = ntohs(ptr[i]);
     }
 
-    memmove(
-            mBuffer->data(),
-            mBuffer->data() + 4 + payloadSize,
-            mBuffer->size() - 4 - payloadSize);
-
-    mBuffer->setRange(0, mBuffer->size() - 4 - payloadSize);
-
     return accessUnit;
 }
 
@@ -469,12 +493,8 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitAAC() {
         return NULL;
     }
 
-    sp<ABuffer> accessUnit = new ABuffer(offset);
-    memcpy(accessUnit->data(), mBuffer->data(), offset);
-
-    memmove(mBuffer->data(), mBuffer->data() + offset,
-            mBuffer->size() - offset);
-    mBuffer->setRange(0, mBuffer->size() - offset);
+    sp<ABuffer> accessUnit = ABuffer::CreateAsSlice(mBuffer, 0, offset);
+    consume(offset);
 
     accessUnit->meta()->setInt64("timeUs", timeUs);
 
@@ -566,7 +586,31 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitH264() {
             // the current one, separated by 0x00 0x00 0x00 0x01 startcodes.
 
             size_t auSize = 4 * nals.size() + totalSize;
-            sp<ABuffer> accessUnit = new ABuffer(auSize);
+
+            const NALPosition &last = nals.itemAt(nals.size() - 1);
+            size_t nextScan = last.nalOffset + last.nalSize;
+
+            // Usually the stream already has exactly that layout, and the
+            // access unit can share the queued data.
+            bool contiguous = nextScan >= auSize;
+            size_t expectedOffset = nextScan - auSize + 4;
+            for (size_t i = 0; contiguous && i < nals.size(); ++i) {
+                const NALPosition &pos = nals.itemAt(i);
+
+                contiguous = pos.nalOffset == expectedOffset
+                    && !memcmp(mBuffer->data() + pos.nalOffset - 4,
+                               "\x00\x00\x00\x01", 4);
+
+                expectedOffset += pos.nalSize + 4;
+            }
+
+            sp<ABuffer> accessUnit;
+            if (contiguous) {
+                accessUnit = ABuffer::CreateAsSlice(
+                        mBuffer, nextScan - auSize, auSize);
+            } else {
+                accessUnit = new ABuffer(auSize);
+            }
 
 #if !LOG_NDEBUG
             AString out;
@@ -576,9 +620,9 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitH264() {
             for (size_t i = 0; i < nals.size(); ++i) {
                 const NALPosition &pos = nals.itemAt(i);
 
+#if !LOG_NDEBUG
                 unsigned nalType = mBuffer->data()[pos.nalOffset] & 0x1f;
 
-#if !LOG_NDEBUG
                 char tmp[128];
                 sprintf(tmp, "0x%02x", nalType);
                 if (i > 0) {
@@ -587,25 +631,21 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitH264() {
                 out.append(tmp);
 #endif
 
-                memcpy(accessUnit->data() + dstOffset, "\x00\x00\x00\x01", 4);
+                if (!contiguous) {
+                    memcpy(accessUnit->data() + dstOffset,
+                           "\x00\x00\x00\x01", 4);
 
-                memcpy(accessUnit->data() + dstOffset + 4,
-                       mBuffer->data() + pos.nalOffset,
-                       pos.nalSize);
+                    memcpy(accessUnit->data() + dstOffset + 4,
+                           mBuffer->data() + pos.nalOffset,
+                           pos.nalSize);
+                }
 
                 dstOffset += pos.nalSize + 4;
             }
 
             ALOGV("accessUnit contains nal types %s", out.c_str());
 
-            const NALPosition &pos = nals.itemAt(nals.size() - 1);
-            size_t nextScan = pos.nalOffset + pos.nalSize;
-
-            memmove(mBuffer->data(),
-                    mBuffer->data() + nextScan,
-                    mBuffer->size() - nextScan);
-
-            mBuffer->setRange(0, mBuffer->size() - nextScan);
+            consume(nextScan);
 
             int64_t timeUs = fetchTimestamp(nextScan);
             CHECK_GE(timeUs, 0ll);
@@ -654,14 +694,8 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGAudio() {
 
     unsigned layer = 4 - ((header >> 17) & 3);
 
-    sp<ABuffer> accessUnit = new ABuffer(frameSize);
-    memcpy(accessUnit->data(), data, frameSize);
-
-    memmove(mBuffer->data(),
-            mBuffer->data() + frameSize,
-            mBuffer->size() - frameSize);
-
-    mBuffer->setRange(0, mBuffer->size() - frameSize);
+    sp<ABuffer> accessUnit = ABuffer::CreateAsSlice(mBuffer, 0, frameSize);
+    consume(frameSize);
 
     int64_t timeUs = fetchTimestamp(frameSize);
     CHECK_GE(timeUs, 0ll);
@@ -746,9 +780,9 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
 
     size_t offset = 0;
     while (offset + 3 < size) {
-        if (memcmp(&data[offset], "\x00\x00\x01", 3)) {
-            ++offset;
-            continue;
+        offset += findStartCodePrefix(&data[offset], size - offset);
+        if (offset + 3 >= size) {
+            break;
         }
 
         pprevStartCode = prevStartCode;
@@ -756,11 +790,11 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
         currentStartCode = data[offset + 3];
 
         if (currentStartCode == 0xb3 && mFormat == NULL) {
-            memmove(mBuffer->data(), mBuffer->data() + offset, size - offset);
+            consume(offset);
+            data = mBuffer->data();
             size -= offset;
             (void)fetchTimestamp(offset);
             offset = 0;
-            mBuffer->setRange(0, size);
         }
 
         if ((prevStartCode == 0xb3 && currentStartCode != 0xb5)
@@ -786,11 +820,8 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
                 sp<ABuffer> csd = new ABuffer(offset);
                 memcpy(csd->data(), data, offset);
 
-                memmove(mBuffer->data(),
-                        mBuffer->data() + offset,
-                        mBuffer->size() - offset);
-
-                mBuffer->setRange(0, mBuffer->size() - offset);
+                consume(offset);
+                data = mBuffer->data();
                 size -= offset;
                 (void)fetchTimestamp(offset);
                 offset = 0;
@@ -811,14 +842,9 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
             if (!sawPictureStart) {
                 sawPictureStart = true;
             } else {
-                sp<ABuffer> accessUnit = new ABuffer(offset);
-                memcpy(accessUnit->data(), data, offset);
-
-                memmove(mBuffer->data(),
-                        mBuffer->data() + offset,
-                        mBuffer->size() - offset);
-
-                mBuffer->setRange(0, mBuffer->size() - offset);
+                sp<ABuffer> accessUnit =
+                    ABuffer::CreateAsSlice(mBuffer, 0, offset);
+                consume(offset);
 
                 int64_t timeUs = fetchTimestamp(offset);
                 CHECK_GE(timeUs, 0ll);
@@ -854,13 +880,9 @@ static ssize_t getNextChunkSize(
         TRESPASS();
     }
 
-    size_t offset = 3;
-    while (offset + 2 < size) {
-        if (!memcmp(&data[offset], kStartCode, 3)) {
-            return offset;
-        }
-
-        ++offset;
+    size_t offset = 3 + findStartCodePrefix(&data[3], size - 3);
+    if (offset < size) {
+        return offset;
     }
 
     return -EAGAIN;
@@ -972,12 +994,9 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEG4Video() {
                 if (chunkType == 0xb6) {
                     offset += chunkSize;
 
-                    sp<ABuffer> accessUnit = new ABuffer(offset);
-                    memcpy(accessUnit->data(), data, offset);
-
-                    memmove(data, &data[offset], size - offset);
-                    size -= offset;
-                    mBuffer->setRange(0, size);
+                    sp<ABuffer> accessUnit =
+                        ABuffer::CreateAsSlice(mBuffer, 0, offset);
+                    consume(offset);
 
                     int64_t timeUs = fetchTimestamp(offset);
                     CHECK_GE(timeUs, 0ll);
@@ -1006,10 +1025,10 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEG4Video() {
 
         if (discard) {
             (void)fetchTimestamp(offset);
-            memmove(data, &data[offset], size - offset);
+            consume(offset);
+            data = mBuffer->data();
             size -= offset;
             offset = 0;
-            mBuffer->setRange(0, size);
         } else {
             offset += chunkSize;
         }
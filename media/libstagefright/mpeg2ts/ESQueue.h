@@ -60,6 +60,9 @@ private:
     Mode mMode;
     uint32_t mFlags;
 
+    // The range of mBuffer holds the queued data.  Access units are
+    // returned as slices of mBuffer, so the data before its range is never
+    // overwritten while one of them is still referenced.
     sp<ABuffer> mBuffer;
     List<RangeInfo> mRangeInfos;
 
@@ -76,6 +79,9 @@ private:
     // returns its timestamp in us (or -1 if no time information).
     int64_t fetchTimestamp(size_t size);
 
+    // Drops the first size bytes of the queued data.
+    void consume(size_t size);
+
     DISALLOW_EVIL_CONSTRUCTORS(ElementaryStreamQueue);
 };
 
@@ -37,6 +37,9 @@ namespace android {
 
 static const size_t kTSPacketSize = 188;
 
+// Packets read from the data source and handed to the parser at a time.
+static const size_t kNumTSPacketsPerRead = 32;
+
 struct MPEG2TSSource : public MediaSource {
     MPEG2TSSource(
             const sp<MPEG2TSExtractor> &extractor,
@@ -186,7 +189,8 @@ void MPEG2TSExtractor::init() {
             }
         }
 
-        if (++numPacketsParsed > 10000) {
+        numPacketsParsed += kNumTSPacketsPerRead;
+        if (numPacketsParsed > 10000) {
             break;
         }
     }
@@ -197,15 +201,18 @@ void MPEG2TSExtractor::init() {
 status_t MPEG2TSExtractor::feedMore() {
     Mutex::Autolock autoLock(mLock);
 
-    uint8_t packet[kTSPacketSize];
-    ssize_t n = mDataSource->readAt(mOffset, packet, kTSPacketSize);
+    uint8_t packets[kNumTSPacketsPerRead * kTSPacketSize];
+    ssize_t n = mDataSource->readAt(mOffset, packets, sizeof(packets));
 
     if (n < (ssize_t)kTSPacketSize) {
         return (n < 0) ? (status_t)n : ERROR_END_OF_STREAM;
     }
 
-    mOffset += n;
-    return mParser->feedTSPacket(packet, kTSPacketSize);
+    // A trailing partial packet is read again by the next call.
+    size_t numPackets = n / kTSPacketSize;
+
+    mOffset += numPackets * kTSPacketSize;
+    return mParser->feedTSPackets(packets, numPackets);
 }
 
 void MPEG2TSExtractor::setLiveSession(const sp<LiveSession> &liveSession) {
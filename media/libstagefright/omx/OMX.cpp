@@ -19,6 +19,7 @@
 #include <utils/Log.h>
 
 #include <dlfcn.h>
+#include <unistd.h>
 
 #include "../include/OMX.h"
 
@@ -26,6 +27,7 @@
 
 #include <binder/IMemory.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <utils/String8.h>
 #include <utils/threads.h>
 
 #include "OMXMaster.h"
@@ -223,7 +225,7 @@ status_t OMX::allocateNode(
 
     *node = 0;
 
-    OMXNodeInstance *instance = new OMXNodeInstance(this, observer);
+    OMXNodeInstance *instance = new OMXNodeInstance(this, observer, name);
 
     OMX_COMPONENTTYPE *handle;
     OMX_ERRORTYPE err = mMaster->makeComponentInstance(
@@ -407,6 +409,21 @@ status_t OMX::setInternalOption(
     return OK;
 }
 
+status_t OMX::dump(int fd, const Vector<String16> &args) {
+    String8 result;
+
+    Mutex::Autolock autoLock(mLock);
+
+    result.appendFormat(" OMX nodes: %d\n", mNodeIDToInstance.size());
+    for (size_t i = 0; i < mNodeIDToInstance.size(); ++i) {
+        mNodeIDToInstance.valueAt(i)->dump(&result);
+    }
+
+    write(fd, result.string(), result.size());
+
+    return OK;
+}
+
 OMX_ERRORTYPE OMX::OnEvent(
         node_id node,
         OMX_IN OMX_EVENTTYPE eEvent,
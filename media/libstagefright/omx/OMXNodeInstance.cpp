@@ -48,24 +48,29 @@ struct BufferMeta {
           mIsBackup(false) {
     }
 
-    void CopyFromOMX(const OMX_BUFFERHEADERTYPE *header) {
+    // Both return the number of bytes copied.
+    size_t CopyFromOMX(const OMX_BUFFERHEADERTYPE *header) {
         if (!mIsBackup) {
-            return;
+            return 0;
         }
 
         memcpy((OMX_U8 *)mMem->pointer() + header->nOffset,
                header->pBuffer + header->nOffset,
                header->nFilledLen);
+
+        return header->nFilledLen;
     }
 
-    void CopyToOMX(const OMX_BUFFERHEADERTYPE *header) {
+    size_t CopyToOMX(const OMX_BUFFERHEADERTYPE *header) {
         if (!mIsBackup) {
-            return;
+            return 0;
         }
 
         memcpy(header->pBuffer + header->nOffset,
                (const OMX_U8 *)mMem->pointer() + header->nOffset,
                header->nFilledLen);
+
+        return header->nFilledLen;
     }
 
 private:
@@ -84,12 +89,13 @@ OMX_CALLBACKTYPE OMXNodeInstance::kCallbacks = {
 };
 
 OMXNodeInstance::OMXNodeInstance(
-        OMX *owner, const sp<IOMXObserver> &observer)
+        OMX *owner, const sp<IOMXObserver> &observer, const char *name)
     : mOwner(owner),
       mNodeID(NULL),
       mHandle(NULL),
       mObserver(observer),
-      mDying(false) {
+      mDying(false),
+      mName(name) {
 }
 
 OMXNodeInstance::~OMXNodeInstance() {
@@ -576,6 +582,9 @@ status_t OMXNodeInstance::allocateBufferWithBackup(
         OMX::buffer_id *buffer) {
     Mutex::Autolock autoLock(mLock);
 
+    // Clients only ask for backup buffers for components with one of the
+    // requires-allocate-buffer quirks.  No software component has them, so
+    // those are always given useBuffer() and never copy.
     BufferMeta *buffer_meta = new BufferMeta(params, true);
 
     OMX_BUFFERHEADERTYPE *header;
@@ -600,6 +609,9 @@ status_t OMXNodeInstance::allocateBufferWithBackup(
 
     addActiveBuffer(portIndex, *buffer);
 
+    Mutex::Autolock statsLock(mStatsLock);
+    ++editPortStats_l(portIndex)->mNumBackupBuffers;
+
     return OK;
 }
 
@@ -652,7 +664,7 @@ status_t OMXNodeInstance::emptyBuffer(
 
     BufferMeta *buffer_meta =
         static_cast<BufferMeta *>(header->pAppPrivate);
-    buffer_meta->CopyToOMX(header);
+    addBytesCopied(header->nInputPortIndex, buffer_meta->CopyToOMX(header));
 
     OMX_ERRORTYPE err = OMX_EmptyThisBuffer(mHandle, header);
 
@@ -698,7 +710,8 @@ void OMXNodeInstance::onMessage(const omx_message &msg) {
         BufferMeta *buffer_meta =
             static_cast<BufferMeta *>(buffer->pAppPrivate);
 
-        buffer_meta->CopyFromOMX(buffer);
+        addBytesCopied(
+                buffer->nOutputPortIndex, buffer_meta->CopyFromOMX(buffer));
     }
 
     mObserver->onMessage(msg);
@@ -787,4 +800,44 @@ void OMXNodeInstance::freeActiveBuffers() {
     }
 }
 
+OMXNodeInstance::PortStats *OMXNodeInstance::editPortStats_l(
+        OMX_U32 portIndex) {
+    ssize_t index = mPortStats.indexOfKey(portIndex);
+
+    if (index < 0) {
+        PortStats stats;
+        stats.mNumBackupBuffers = 0;
+        stats.mNumBytesCopied = 0;
+
+        index = mPortStats.add(portIndex, stats);
+    }
+
+    return &mPortStats.editValueAt(index);
+}
+
+void OMXNodeInstance::addBytesCopied(OMX_U32 portIndex, size_t size) {
+    if (size == 0) {
+        return;
+    }
+
+    Mutex::Autolock autoLock(mStatsLock);
+    editPortStats_l(portIndex)->mNumBytesCopied += size;
+}
+
+void OMXNodeInstance::dump(String8 *result) {
+    Mutex::Autolock autoLock(mStatsLock);
+
+    result->appendFormat("  node %p: %s\n", mNodeID, mName.string());
+
+    for (size_t i = 0; i < mPortStats.size(); ++i) {
+        const PortStats &stats = mPortStats.valueAt(i);
+
+        result->appendFormat(
+                "    port %lu: %d backup buffers, %lld bytes copied\n",
+                mPortStats.keyAt(i),
+                stats.mNumBackupBuffers,
+                stats.mNumBytesCopied);
+    }
+}
+
 }  // namespace android
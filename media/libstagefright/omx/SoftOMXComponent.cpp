@@ -22,6 +22,8 @@
 
 #include <media/stagefright/foundation/ADebug.h>
 
+#include <unistd.h>
+
 namespace android {
 
 SoftOMXComponent::SoftOMXComponent(
@@ -85,6 +87,20 @@ const char *SoftOMXComponent::name() const {
     return mName.c_str();
 }
 
+// static
+int SoftOMXComponent::GetCPUCoreCount() {
+    int cpuCoreCount = 1;
+#if defined(_SC_NPROCESSORS_ONLN)
+    cpuCoreCount = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    // _SC_NPROC_ONLN must be defined...
+    cpuCoreCount = sysconf(_SC_NPROC_ONLN);
+#endif
+    CHECK(cpuCoreCount >= 1);
+    ALOGV("Number of CPU cores: %d", cpuCoreCount);
+    return cpuCoreCount;
+}
+
 void SoftOMXComponent::notify(
         OMX_EVENTTYPE event,
         OMX_U32 data1, OMX_U32 data2, OMX_PTR data) {
@@ -24,7 +24,8 @@ LOCAL_SRC_FILES:=               \
     AudioPolicyService.cpp      \
     ServiceUtilities.cpp        \
 	AudioResamplerCubic.cpp.arm \
-    AudioResamplerSinc.cpp.arm
+    AudioResamplerSinc.cpp.arm  \
+    AudioResamplerPolyphase.cpp.arm
 
 LOCAL_SRC_FILES += StateQueue.cpp
 
@@ -99,7 +100,8 @@ LOCAL_SRC_FILES:=               \
 	test-resample.cpp 			\
     AudioResampler.cpp.arm      \
 	AudioResamplerCubic.cpp.arm \
-    AudioResamplerSinc.cpp.arm
+    AudioResamplerSinc.cpp.arm  \
+    AudioResamplerPolyphase.cpp.arm
 
 LOCAL_SHARED_LIBRARIES := \
 	libdl \
@@ -112,5 +114,18 @@ LOCAL_MODULE_TAGS := optional
 
 include $(BUILD_EXECUTABLE)
 
+#
+# build audio mixer kernel test tool
+#
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=               \
+    test-mixer.cpp
+
+LOCAL_MODULE:= test-mixer
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_EXECUTABLE)
 
 include $(call all-makefiles-under,$(LOCAL_PATH))
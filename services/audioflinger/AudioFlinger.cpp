@@ -1985,7 +1985,8 @@ AudioFlinger::PlaybackThread::PlaybackThread(const sp<AudioFlinger>& audioFlinge
         standbyDelay(AudioFlinger::mStandbyTimeInNsecs),
         mScreenState(gScreenState),
         // index 0 is reserved for normal mixer's submix
-        mFastTrackAvailMask(((1 << FastMixerState::kMaxFastTracks) - 1) & ~1)
+        mFastTrackAvailMask(((1 << FastMixerState::kMaxFastTracks) - 1) & ~1),
+        mOverwriteChain(NULL)
 {
     snprintf(mName, kNameLength, "AudioOut_%X", id);
 
@@ -2702,7 +2703,10 @@ AudioFlinger::MixerThread::MixerThread(const sp<AudioFlinger>& audioFlinger, Aud
     :   PlaybackThread(audioFlinger, output, id, device, type),
         // mAudioMixer below
         // mFastMixer below
-        mFastMixerFutex(0)
+        mFastMixerFutex(0),
+        // mFloatMixBuffer below
+        mFloatMixActive(false),
+        mFloatMixEffects(false)
         // mOutputSink below
         // mPipeSink below
         // mNormalSink below
@@ -2825,6 +2829,25 @@ AudioFlinger::MixerThread::MixerThread(const sp<AudioFlinger>& audioFlinger, Aud
         mFastMixer = NULL;
     }
 
+    // optionally mix into a float bus that is converted to the HAL format only by mOutputSink
+    mFloatMixBuffer = NULL;
+#ifndef SRS_PROCESSING  // post-processing works on the 16-bit mMixBuffer
+    char value[PROPERTY_VALUE_MAX];
+    if (type == MIXER && mFastMixer == NULL && mChannelCount == FCC_2 &&
+            property_get("af.mixer.float", value, "0") > 0 && atoi(value) != 0) {
+        const NBAIO_Format offers[1] = {Format_from_SR_C_Float(mSampleRate, mChannelCount)};
+        numCounterOffers = 0;
+        if (offers[0] != Format_Invalid &&
+                mOutputSink->negotiate(offers, 1, NULL, numCounterOffers) == 0) {
+            mFloatMixBuffer = new float[mNormalFrameCount * mChannelCount];
+            memset(mFloatMixBuffer, 0, mNormalFrameCount * mChannelCount * sizeof(float));
+            ALOGI("MixerThread %d uses a float mix bus", id);
+        } else {
+            ALOGW("float mix bus not supported by output %d", id);
+        }
+    }
+#endif
+
     switch (kUseFastMixer) {
     case FastMixer_Never:
     case FastMixer_Dynamic:
@@ -2873,6 +2896,7 @@ AudioFlinger::MixerThread::~MixerThread()
 #endif
     }
     delete mAudioMixer;
+    delete[] mFloatMixBuffer;
 }
 
 class CpuStats {
@@ -3192,12 +3216,16 @@ if (mType == MIXER) {
 
 void AudioFlinger::MixerThread::threadLoop_removeTracks(const Vector< sp<Track> >& tracksToRemove)
 {
+    // push the coalesced fast track changes of a cycle that did not write
+    if (mFastMixer != NULL) {
+        mFastMixer->sq()->endCoalescing();
+    }
     PlaybackThread::threadLoop_removeTracks(tracksToRemove);
 }
 
 void AudioFlinger::MixerThread::threadLoop_write()
 {
-    // FIXME we should only do one push per cycle; confirm this is true
+    // At most one push per cycle: this also pushes the fast track changes of prepareTracks_l().
     // Start the fast mixer if it's not already running
     if (mFastMixer != NULL) {
         FastMixerStateQueue *sq = mFastMixer->sq();
@@ -3217,17 +3245,38 @@ void AudioFlinger::MixerThread::threadLoop_write()
             }
             state->mCommand = FastMixerState::MIX_WRITE;
             sq->end();
-            sq->push(FastMixerStateQueue::BLOCK_UNTIL_PUSHED);
+            sq->endCoalescing(FastMixerStateQueue::BLOCK_UNTIL_PUSHED);
             if (kUseFastMixer == FastMixer_Dynamic) {
                 mNormalSink = mPipeSink;
             }
         } else {
             sq->end(false /*didModify*/);
+            sq->endCoalescing(FastMixerStateQueue::BLOCK_UNTIL_PUSHED);
+        }
+    }
+    if (mFloatMixBuffer != NULL) {
+        const size_t sampleCount = mNormalFrameCount * mChannelCount;
+        const float scale = 1.0f / 32768;
+        if (!mFloatMixActive) {
+            // a global effect chain has processed the whole mix in mMixBuffer
+            for (size_t i = 0; i < sampleCount; i++) {
+                mFloatMixBuffer[i] = mMixBuffer[i] * scale;
+            }
+        } else if (mFloatMixEffects) {
+            // effect chains have accumulated their 16-bit output into mMixBuffer
+            for (size_t i = 0; i < sampleCount; i++) {
+                mFloatMixBuffer[i] += mMixBuffer[i] * scale;
+            }
         }
     }
     PlaybackThread::threadLoop_write();
 }
 
+const void *AudioFlinger::MixerThread::sinkBuffer() const
+{
+    return mFloatMixBuffer != NULL ? (const void *) mFloatMixBuffer : mMixBuffer;
+}
+
 // shared by MIXER and DIRECT, overridden by DUPLICATING
 void AudioFlinger::PlaybackThread::threadLoop_write()
 {
@@ -3253,7 +3302,7 @@ void AudioFlinger::PlaybackThread::threadLoop_write()
                         (pipe->maxFrames() * 7) / 8 : mNormalFrameCount * 2);
             }
         }
-        ssize_t framesWritten = mNormalSink->write(mMixBuffer, count);
+        ssize_t framesWritten = mNormalSink->write(sinkBuffer(), count);
 #if defined(ATRACE_TAG) && (ATRACE_TAG != ATRACE_TAG_NEVER)
         Tracer::traceEnd(ATRACE_TAG);
 #endif
@@ -3361,6 +3410,9 @@ void AudioFlinger::MixerThread::threadLoop_sleepTime()
         }
     } else if (mBytesWritten != 0 || (mMixerStatus == MIXER_TRACKS_ENABLED)) {
         memset (mMixBuffer, 0, mixBufferSize);
+        if (mFloatMixBuffer != NULL) {
+            memset(mFloatMixBuffer, 0, mNormalFrameCount * mChannelCount * sizeof(float));
+        }
         sleepTime = 0;
         ALOGV_IF((mBytesWritten == 0 && (mMixerStatus == MIXER_TRACKS_ENABLED)), "anticipated start");
     }
@@ -3371,6 +3423,44 @@ void AudioFlinger::MixerThread::threadLoop_sleepTime()
 AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTracks_l(
         Vector< sp<Track> > *tracksToRemove)
 {
+    // global effect chains process the 16-bit mix in place, so they bypass the float bus
+    mFloatMixActive = mFloatMixBuffer != NULL &&
+            getEffectChain_l(AUDIO_SESSION_OUTPUT_MIX) == 0 &&
+            getEffectChain_l(AUDIO_SESSION_OUTPUT_STAGE) == 0;
+    mFloatMixEffects = mFloatMixActive && mEffectChains.size() != 0;
+
+    // When all tracks belong to the session of the only track effect chain, that chain is the
+    // only producer for the mix buffer: its last effect overwrites the mix buffer instead of
+    // accumulating into it, so the mix buffer doesn't need to be cleared first.
+    EffectChain *overwriteChain = NULL;
+    for (size_t i = 0; i < mEffectChains.size(); i++) {
+        if (mEffectChains[i]->sessionId() <= AUDIO_SESSION_OUTPUT_MIX) {
+            continue;
+        }
+        if (overwriteChain != NULL) {
+            overwriteChain = NULL;
+            break;
+        }
+        overwriteChain = mEffectChains[i].get();
+    }
+    if (overwriteChain != NULL) {
+        int session = overwriteChain->sessionId();
+        for (size_t i = 0; i < mTracks.size(); i++) {
+            if (mTracks[i]->sessionId() != session) {
+                overwriteChain = NULL;
+                break;
+            }
+        }
+    }
+    if (overwriteChain != mOverwriteChain) {
+        if (mOverwriteChain != NULL) {
+            mOverwriteChain->setOverwriteOutput_l(false);
+        }
+        if (overwriteChain != NULL) {
+            overwriteChain->setOverwriteOutput_l(true);
+        }
+        mOverwriteChain = overwriteChain;
+    }
 
     mixer_state mixerStatus = MIXER_IDLE;
     // find out which tracks need to be processed
@@ -3403,6 +3493,9 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
     FastMixerStateQueue::block_t block = FastMixerStateQueue::BLOCK_UNTIL_PUSHED;
     if (mFastMixer != NULL) {
         sq = mFastMixer->sq();
+        // track changes that need not be acknowledged are pushed along with any
+        // command change in threadLoop_write(), or at the end of the cycle
+        sq->beginCoalescing();
         state = sq->begin();
     }
 
@@ -3717,10 +3810,25 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
                 AudioMixer::RESAMPLE,
                 AudioMixer::SAMPLE_RATE,
                 (void *)(cblk->sampleRate));
-            mAudioMixer->setParameter(
-                name,
-                AudioMixer::TRACK,
-                AudioMixer::MAIN_BUFFER, (void *)track->mainBuffer());
+            if (mFloatMixActive && track->mainBuffer() == mMixBuffer) {
+                mAudioMixer->setParameter(
+                    name,
+                    AudioMixer::TRACK,
+                    AudioMixer::MAIN_BUFFER, (void *)mFloatMixBuffer);
+                mAudioMixer->setParameter(
+                    name,
+                    AudioMixer::TRACK,
+                    AudioMixer::MAIN_FORMAT, (void *)AudioMixer::MAIN_FORMAT_FLOAT);
+            } else {
+                mAudioMixer->setParameter(
+                    name,
+                    AudioMixer::TRACK,
+                    AudioMixer::MAIN_BUFFER, (void *)track->mainBuffer());
+                mAudioMixer->setParameter(
+                    name,
+                    AudioMixer::TRACK,
+                    AudioMixer::MAIN_FORMAT, (void *)AudioMixer::MAIN_FORMAT_PCM_16_BIT);
+            }
             mAudioMixer->setParameter(
                 name,
                 AudioMixer::TRACK,
@@ -3851,7 +3959,19 @@ track_is_ready: ;
     // mix buffer must be cleared if all tracks are connected to an
     // effect chain as in this case the mixer will not write to
     // mix buffer and track effects will accumulate into it
-    if ((mixedTracks != 0 && mixedTracks == tracksWithEffect) || (mixedTracks == 0 && fastTracks > 0)) {
+    if (mFloatMixActive) {
+        // the mixer writes only the float bus, so effect chains always accumulate into a
+        // cleared mix buffer, and the float bus is cleared when no track is mixed into it
+        if (mFloatMixEffects && overwriteChain == NULL) {
+            memset(mMixBuffer, 0, mNormalFrameCount * mChannelCount * sizeof(int16_t));
+        }
+        if (mixedTracks == tracksWithEffect) {
+            memset(mFloatMixBuffer, 0, mNormalFrameCount * mChannelCount * sizeof(float));
+        }
+    } else if (overwriteChain != NULL) {
+        // the track effect chain will overwrite the whole mix buffer
+    } else if ((mixedTracks != 0 && mixedTracks == tracksWithEffect) ||
+            (mixedTracks == 0 && fastTracks > 0)) {
         // FIXME as a performance optimization, should remember previous zero status
         memset(mMixBuffer, 0, mNormalFrameCount * mChannelCount * sizeof(int16_t));
     }
@@ -4024,6 +4144,11 @@ bool AudioFlinger::MixerThread::checkForNewParameters_l()
                 mAudioMixer = NULL;
                 readOutputParameters();
                 mAudioMixer = new AudioMixer(mNormalFrameCount, mSampleRate);
+                if (mFloatMixBuffer != NULL) {
+                    delete[] mFloatMixBuffer;
+                    mFloatMixBuffer = new float[mNormalFrameCount * mChannelCount];
+                    memset(mFloatMixBuffer, 0, mNormalFrameCount * mChannelCount * sizeof(float));
+                }
                 for (size_t i = 0; i < mTracks.size() ; i++) {
                     int name = getTrackName_l(mTracks[i]->mChannelMask, mTracks[i]->mSessionId);
                     if (name < 0) break;
@@ -4069,12 +4194,43 @@ void AudioFlinger::MixerThread::dumpInternals(int fd, const Vector<String16>& ar
 
     snprintf(buffer, SIZE, "AudioMixer tracks: %08x\n", mAudioMixer->trackNames());
     result.append(buffer);
+    snprintf(buffer, SIZE, "float mix bus: %s\n", mFloatMixBuffer == NULL ? "off" :
+            (mFloatMixActive ? "on" : "bypassed by global effects"));
+    result.append(buffer);
     write(fd, result.string(), result.size());
 
     // Make a non-atomic copy of fast mixer dump state so it won't change underneath us
     FastMixerDumpState copy = mFastMixerDumpState;
     copy.dump(fd);
 
+    // Write the fast mixer histograms and underrun timeline in binary form on request
+    bool wantSnapshot = false;
+    for (size_t i = 0; i < args.size(); i++) {
+        if (args[i] == String16("--fastmixer-snapshot")) {
+            wantSnapshot = true;
+            break;
+        }
+    }
+    if (wantSnapshot && mFastMixer != NULL) {
+        char snapshotPath[64];
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        struct tm tm;
+        localtime_r(&tv.tv_sec, &tm);
+        strftime(snapshotPath, sizeof(snapshotPath), "/data/misc/media/fastmixer-%T.bin", &tm);
+        int snapshotFd = open(snapshotPath, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+        if (snapshotFd >= 0) {
+            FastMixerSnapshot snapshot;
+            copy.snapshot(&snapshot);
+            write(snapshotFd, &snapshot, sizeof(snapshot));
+            close(snapshotFd);
+            fdprintf(fd, "FastMixer snapshot copied to %s\n", snapshotPath);
+        } else {
+            fdprintf(fd, "FastMixer unable to create snapshot %s: %s\n", snapshotPath,
+                    strerror(errno));
+        }
+    }
+
 #ifdef STATE_QUEUE_DUMP
     // Similar for state queue
     StateQueueObserverDump observerCopy = mStateQueueObserverDump;
@@ -9252,6 +9408,11 @@ size_t AudioFlinger::PlaybackThread::removeEffectChain_l(const sp<EffectChain>&
     for (size_t i = 0; i < mEffectChains.size(); i++) {
         if (chain == mEffectChains[i]) {
             mEffectChains.removeAt(i);
+            // the chain may be moved to another thread, where it won't be the only producer
+            if (chain.get() == mOverwriteChain) {
+                chain->setOverwriteOutput_l(false);
+                mOverwriteChain = NULL;
+            }
             // detach all active tracks from the chain
             for (size_t i = 0 ; i < mActiveTracks.size() ; ++i) {
                 sp<Track> track = mActiveTracks[i].promote();
@@ -9367,7 +9528,7 @@ AudioFlinger::EffectModule::EffectModule(ThreadBase *thread,
       mStatus(NO_INIT), mState(IDLE),
       // mMaxDisableWaitCnt is set by configure() and not used before then
       // mDisableWaitCnt is set by process() and updateState() and not used before then
-      mSuspended(false)
+      mSuspended(false), mOverwriteOutput(false)
 #ifdef QCOM_HARDWARE
       ,mIsForLPA(false)
 #endif
@@ -9555,6 +9716,12 @@ void AudioFlinger::EffectModule::process()
     if (mState == DESTROYED || mEffectInterface == NULL ||
             mConfig.inputCfg.buffer.raw == NULL ||
             mConfig.outputCfg.buffer.raw == NULL) {
+        // nobody else writes the output buffer when this effect is its only producer
+        if (mOverwriteOutput && mConfig.outputCfg.buffer.raw != NULL &&
+                mConfig.inputCfg.buffer.raw != mConfig.outputCfg.buffer.raw) {
+            memset(mConfig.outputCfg.buffer.raw, 0,
+                   mConfig.outputCfg.buffer.frameCount * 2 * sizeof(int16_t));
+        }
         return;
     }
 
@@ -9584,7 +9751,13 @@ void AudioFlinger::EffectModule::process()
     } else if ((mDescriptor.flags & EFFECT_FLAG_TYPE_MASK) == EFFECT_FLAG_TYPE_INSERT &&
                 mConfig.inputCfg.buffer.raw != mConfig.outputCfg.buffer.raw) {
         // If an insert effect is idle and input buffer is different from output buffer,
-        // accumulate input onto output
+        // accumulate input onto output, or copy it if there is nothing to accumulate onto.
+        // The input buffer is cleared by the chain when no track is active.
+        if (mOverwriteOutput) {
+            memcpy(mConfig.outputCfg.buffer.raw, mConfig.inputCfg.buffer.raw,
+                   mConfig.inputCfg.buffer.frameCount * 2 * sizeof(int16_t));   //always stereo
+            return;
+        }
         sp<EffectChain> chain = mChain.promote();
         if (chain != 0 && chain->activeTrackCnt() != 0) {
             size_t frameCnt = mConfig.inputCfg.buffer.frameCount * 2;  //always stereo here
@@ -9679,7 +9852,9 @@ status_t AudioFlinger::EffectModule::configure(bool isForLPA, int sampleRate, in
     // Auxiliary effect:
     //      accumulates in output buffer: input buffer != output buffer
     // Therefore: accumulate <=> input buffer != output buffer
-    if (mConfig.inputCfg.buffer.raw != mConfig.outputCfg.buffer.raw) {
+    // unless the effect is the only producer for the output buffer (see
+    // EffectChain::setOverwriteOutput_l()), which then needs no clearing before process()
+    if (mConfig.inputCfg.buffer.raw != mConfig.outputCfg.buffer.raw && !mOverwriteOutput) {
         mConfig.outputCfg.accessMode = EFFECT_BUFFER_ACCESS_ACCUMULATE;
     } else {
         mConfig.outputCfg.accessMode = EFFECT_BUFFER_ACCESS_WRITE;
@@ -10455,7 +10630,7 @@ void AudioFlinger::EffectHandle::dump(char* buffer, size_t size)
 AudioFlinger::EffectChain::EffectChain(ThreadBase *thread,
                                         int sessionId)
     : mThread(thread), mSessionId(sessionId), mActiveTrackCnt(0), mTrackCnt(0), mTailBufferCount(0),
-      mOwnInBuffer(false), mVolumeCtrlIdx(-1), mLeftVolume(UINT_MAX), mRightVolume(UINT_MAX),
+      mOwnInBuffer(false), mOverwriteOutput(false), mVolumeCtrlIdx(-1), mLeftVolume(UINT_MAX), mRightVolume(UINT_MAX),
       mNewLeftVolume(UINT_MAX), mNewRightVolume(UINT_MAX)
 #ifdef QCOM_HARDWARE
       ,mIsForLPATrack(false)
@@ -10692,6 +10867,7 @@ status_t AudioFlinger::EffectChain::addEffect_l(const sp<EffectModule>& effect)
 
         // always read samples from chain input buffer
         effect->setInBuffer(mInBuffer);
+        effect->setOverwriteOutput(mOverwriteOutput);
 
         // if last effect in the chain, output samples to chain
         // output buffer, otherwise to chain input buffer
@@ -10745,6 +10921,24 @@ size_t AudioFlinger::EffectChain::removeEffect_l(const sp<EffectModule>& effect)
     return mEffects.size();
 }
 
+// setOverwriteOutput_l() must be called with PlaybackThread::mLock held
+void AudioFlinger::EffectChain::setOverwriteOutput_l(bool overwrite)
+{
+    Mutex::Autolock _l(mLock);
+    if (overwrite == mOverwriteOutput) {
+        return;
+    }
+    mOverwriteOutput = overwrite;
+    size_t size = mEffects.size();
+    for (size_t i = 0; i < size; i++) {
+        mEffects[i]->setOverwriteOutput(overwrite);
+    }
+    // only the last effect has an output buffer different from its input buffer
+    if (size != 0) {
+        mEffects[size - 1]->configure();
+    }
+}
+
 // setDevice_l() must be called with PlaybackThread::mLock held
 void AudioFlinger::EffectChain::setDevice_l(audio_devices_t device)
 {
@@ -10845,12 +11039,13 @@ void AudioFlinger::EffectChain::dump(int fd, const Vector<String16>& args)
         result.append("\tCould not lock mutex:\n");
     }
 
-    result.append("\tNum fx In buffer   Out buffer   Active tracks:\n");
-    snprintf(buffer, SIZE, "\t%02d     0x%08x  0x%08x   %d\n",
+    result.append("\tNum fx In buffer   Out buffer   Active tracks Overwrite:\n");
+    snprintf(buffer, SIZE, "\t%02d     0x%08x  0x%08x   %d             %s\n",
             mEffects.size(),
             (uint32_t)mInBuffer,
             (uint32_t)mOutBuffer,
-            mActiveTrackCnt);
+            mActiveTrackCnt,
+            mOverwriteOutput ? "yes" : "no");
     result.append(buffer);
     write(fd, result.string(), result.size());
 
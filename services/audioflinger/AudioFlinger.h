@@ -1098,6 +1098,9 @@ protected:
         virtual     void        threadLoop_standby();
         virtual     void        threadLoop_removeTracks(const Vector< sp<Track> >& tracksToRemove);
 
+                    // buffer written to mNormalSink by threadLoop_write(), mMixBuffer by default
+        virtual     const void* sinkBuffer() const { return mMixBuffer; }
+
                     // prepareTracks_l reads and writes mActiveTracks, and returns
                     // the pending set of tracks to remove via Vector 'tracksToRemove'.  The caller
                     // is responsible for clearing or destroying this Vector later on, when it
@@ -1296,6 +1299,10 @@ public:
                     // accessed by both binder threads and within threadLoop(), lock on mutex needed
                     unsigned    mFastTrackAvailMask;    // bit i set if fast track [i] is available
 
+                    // MIXER only: the track effect chain that is the only producer for
+                    // mMixBuffer, if any; see MixerThread::prepareTracks_l()
+                    EffectChain*    mOverwriteChain;
+
     };
 
     class MixerThread : public PlaybackThread {
@@ -1327,6 +1334,7 @@ public:
         virtual     void        threadLoop_sleepTime();
         virtual     void        threadLoop_removeTracks(const Vector< sp<Track> >& tracksToRemove);
         virtual     uint32_t    correctLatency(uint32_t latency) const;
+        virtual     const void* sinkBuffer() const;
 
                     AudioMixer* mAudioMixer;    // normal mixer
     private:
@@ -1346,6 +1354,16 @@ public:
                     //          mFastMixer->sq()    // for mutating and pushing state
                     int32_t     mFastMixerFutex;    // for cold idle
 
+                    // float mix bus, non-NULL if enabled by property af.mixer.float and accepted
+                    // by mOutputSink, which then converts to the HAL format once per write.
+                    // Never used together with a fast mixer, whose pipe is 16-bit.
+                    float*      mFloatMixBuffer;
+                    // set by prepareTracks_l() for the current cycle: tracks without effects are
+                    // mixed into mFloatMixBuffer, unless a global effect chain needs mMixBuffer
+                    bool        mFloatMixActive;
+                    // and the 16-bit effect chain outputs in mMixBuffer must be added to it
+                    bool        mFloatMixEffects;
+
     public:
         virtual     bool        hasFastMixer() const { return mFastMixer != NULL; }
         virtual     FastTrackUnderruns getFastTrackUnderruns(size_t fastIndex) const {
@@ -1831,6 +1849,9 @@ private:
         int16_t     *inBuffer() { return mConfig.inputCfg.buffer.s16; }
         void        setOutBuffer(int16_t *buffer) { mConfig.outputCfg.buffer.s16 = buffer; }
         int16_t     *outBuffer() { return mConfig.outputCfg.buffer.s16; }
+        // overwrite instead of accumulate when the output buffer differs from the input
+        // buffer; takes effect at the next configure()
+        void        setOverwriteOutput(bool overwrite) { mOverwriteOutput = overwrite; }
         void        setChain(const wp<EffectChain>& chain) { mChain = chain; }
         void        setThread(const wp<ThreadBase>& thread) { mThread = thread; }
         const wp<ThreadBase>& thread() { return mThread; }
@@ -1893,6 +1914,7 @@ mutable Mutex               mLock;      // mutex for process, commands and handl
                                         // sending disable command.
         uint32_t mDisableWaitCnt;       // current process() calls count during disable period.
         bool     mSuspended;            // effect is suspended: temporarily disabled by framework
+        bool     mOverwriteOutput;      // sole producer for a separate output buffer
 #ifdef QCOM_HARDWARE
         bool     mIsForLPA;
 #endif
@@ -2036,6 +2058,12 @@ mutable Mutex               mLock;      // mutex for process, commands and handl
             return mOutBuffer;
         }
 
+        // Whether this chain is the only producer for its output buffer, in which case its last
+        // effect overwrites the output buffer instead of accumulating into it, and the mixer
+        // does not need to clear it first.
+        void setOverwriteOutput_l(bool overwrite);
+        bool overwriteOutput() const { return mOverwriteOutput; }
+
         void incTrackCnt() { android_atomic_inc(&mTrackCnt); }
         void decTrackCnt() { android_atomic_dec(&mTrackCnt); }
         int32_t trackCnt() const { return android_atomic_acquire_load(&mTrackCnt); }
@@ -2107,6 +2135,7 @@ mutable Mutex               mLock;      // mutex for process, commands and handl
         int32_t mTailBufferCount;   // current effect tail buffer count
         int32_t mMaxTailBuffers;    // maximum effect tail buffers
         bool mOwnInBuffer;          // true if the chain owns its input buffer
+        bool mOverwriteOutput;      // true if the chain is the only producer for mOutBuffer
         int mVolumeCtrlIdx;         // index of insert effect having control over volume
         uint32_t mLeftVolume;       // previous volume on left channel
         uint32_t mRightVolume;      // previous volume on right channel
@@ -39,6 +39,7 @@
 #include <media/EffectsFactoryApi.h>
 
 #include "AudioMixer.h"
+#include "AudioMixerSimd.h"
 
 namespace android {
 
@@ -202,6 +203,7 @@ int AudioMixer::getTrackName(audio_channel_mask_t channelMask, int sessionId)
         t->sampleRate = mSampleRate;
         // setParameter(name, TRACK, MAIN_BUFFER, mixBuffer) is required before enable(name)
         t->mainBuffer = NULL;
+        t->mainFormat = MAIN_FORMAT_PCM_16_BIT;
         t->auxBuffer = NULL;
         // see t->localTimeFreq in constructor above
 
@@ -446,6 +448,15 @@ void AudioMixer::setParameter(int name, int target, int param, void *value)
         case FORMAT:
             ALOG_ASSERT(valueInt == AUDIO_FORMAT_PCM_16_BIT);
             break;
+        case MAIN_FORMAT:
+            ALOG_ASSERT(valueInt == MAIN_FORMAT_PCM_16_BIT || valueInt == MAIN_FORMAT_FLOAT,
+                    "bad main buffer format %d", valueInt);
+            if (track.mainFormat != valueInt) {
+                track.mainFormat = valueInt;
+                ALOGV("setParameter(TRACK, MAIN_FORMAT, %d)", valueInt);
+                invalidateState(1 << name);
+            }
+            break;
         // FIXME do we want to support setting the downmix type from AudioFlinger?
         //         for a specific track? or per mixer?
         /* case DOWNMIX_TYPE:
@@ -650,6 +661,7 @@ void AudioMixer::process__validate(state_t* state, int64_t pts)
     // compute everything we need...
     int countActiveTracks = 0;
     bool all16BitsStereoNoResample = true;
+    bool all16BitsNoAux = true;
     bool resampling = false;
     bool volumeRamp = false;
     uint32_t en = state->enabledTracks;
@@ -674,25 +686,43 @@ void AudioMixer::process__validate(state_t* state, int64_t pts)
         }
         t.needs = n;
 
+        if (t.mainFormat != MAIN_FORMAT_PCM_16_BIT) {
+            // process__OneTrack16BitsStereoNoResampling() clamps directly into the main buffer
+            all16BitsStereoNoResample = false;
+        }
+
         if ((n & NEEDS_MUTE__MASK) == NEEDS_MUTE_ENABLED) {
             t.hook = track__nop;
         } else {
             if ((n & NEEDS_AUX__MASK) == NEEDS_AUX_ENABLED) {
                 all16BitsStereoNoResample = false;
+                all16BitsNoAux = false;
             }
             if ((n & NEEDS_RESAMPLE__MASK) == NEEDS_RESAMPLE_ENABLED) {
                 all16BitsStereoNoResample = false;
                 resampling = true;
+#ifdef AUDIO_MIXER_SIMD
+                t.hook = track__genericResampleSimd;
+#else
                 t.hook = track__genericResample;
+#endif
                 ALOGV_IF((n & NEEDS_CHANNEL_COUNT__MASK) > NEEDS_CHANNEL_2,
                         "Track %d needs downmix + resample", i);
             } else {
                 if ((n & NEEDS_CHANNEL_COUNT__MASK) == NEEDS_CHANNEL_1){
+#ifdef AUDIO_MIXER_SIMD
+                    t.hook = track__16BitsMonoSimd;
+#else
                     t.hook = track__16BitsMono;
+#endif
                     all16BitsStereoNoResample = false;
                 }
                 if ((n & NEEDS_CHANNEL_COUNT__MASK) >= NEEDS_CHANNEL_2){
+#ifdef AUDIO_MIXER_SIMD
+                    t.hook = track__16BitsStereoSimd;
+#else
                     t.hook = track__16BitsStereo;
+#endif
                     ALOGV_IF((n & NEEDS_CHANNEL_COUNT__MASK) > NEEDS_CHANNEL_2,
                             "Track %d needs downmix", i);
                 }
@@ -720,19 +750,20 @@ void AudioMixer::process__validate(state_t* state, int64_t pts)
                 delete [] state->resampleTemp;
                 state->resampleTemp = NULL;
             }
-            state->hook = process__genericNoResampling;
-            if (all16BitsStereoNoResample && !volumeRamp) {
-                if (countActiveTracks == 1) {
-                    state->hook = process__OneTrack16BitsStereoNoResampling;
-                }
+            if (all16BitsStereoNoResample && !volumeRamp && countActiveTracks == 1) {
+                state->hook = process__OneTrack16BitsStereoNoResampling;
+            } else if (all16BitsNoAux) {
+                state->hook = process__NTracks16BitsNoResampling;
+            } else {
+                state->hook = process__genericNoResampling;
             }
         }
     }
 
     ALOGV("mixer configuration change: %d activeTracks (%08x) "
-        "all16BitsStereoNoResample=%d, resampling=%d, volumeRamp=%d",
+        "all16BitsStereoNoResample=%d, all16BitsNoAux=%d, resampling=%d, volumeRamp=%d",
         countActiveTracks, state->enabledTracks,
-        all16BitsStereoNoResample, resampling, volumeRamp);
+        all16BitsStereoNoResample, all16BitsNoAux, resampling, volumeRamp);
 
    state->hook(state, pts);
 
@@ -765,6 +796,12 @@ void AudioMixer::process__validate(state_t* state, int64_t pts)
 
 
 void AudioMixer::track__genericResample(track_t* t, int32_t* out, size_t outFrameCount, int32_t* temp, int32_t* aux)
+{
+    genericResample(t, out, outFrameCount, temp, aux, volumeRampStereo, volumeStereo);
+}
+
+void AudioMixer::genericResample(track_t* t, int32_t* out, size_t outFrameCount, int32_t* temp,
+        int32_t* aux, hook_t rampHook, hook_t volumeHook)
 {
     t->resampler->setSampleRate(t->sampleRate);
 
@@ -777,16 +814,16 @@ void AudioMixer::track__genericResample(track_t* t, int32_t* out, size_t outFram
         memset(temp, 0, outFrameCount * MAX_NUM_CHANNELS * sizeof(int32_t));
         t->resampler->resample(temp, outFrameCount, t->bufferProvider);
         if (CC_UNLIKELY(t->volumeInc[0]|t->volumeInc[1]|t->auxInc)) {
-            volumeRampStereo(t, out, outFrameCount, temp, aux);
+            rampHook(t, out, outFrameCount, temp, aux);
         } else {
-            volumeStereo(t, out, outFrameCount, temp, aux);
+            volumeHook(t, out, outFrameCount, temp, aux);
         }
     } else {
         if (CC_UNLIKELY(t->volumeInc[0]|t->volumeInc[1])) {
             t->resampler->setVolume(UNITY_GAIN, UNITY_GAIN);
             memset(temp, 0, outFrameCount * MAX_NUM_CHANNELS * sizeof(int32_t));
             t->resampler->resample(temp, outFrameCount, t->bufferProvider);
-            volumeRampStereo(t, out, outFrameCount, temp, aux);
+            rampHook(t, out, outFrameCount, temp, aux);
         }
 
         // constant gain
@@ -1047,11 +1084,73 @@ void AudioMixer::track__16BitsMono(track_t* t, int32_t* out, size_t frameCount,
     t->in = in;
 }
 
+#ifdef AUDIO_MIXER_SIMD
+// The aux send paths are rare, so they stay on the scalar hooks.
+
+void AudioMixer::track__genericResampleSimd(track_t* t, int32_t* out, size_t outFrameCount, int32_t* temp, int32_t* aux)
+{
+    genericResample(t, out, outFrameCount, temp, aux, volumeRampStereoSimd, volumeStereoSimd);
+}
+
+void AudioMixer::volumeRampStereoSimd(track_t* t, int32_t* out, size_t frameCount, int32_t* temp, int32_t* aux)
+{
+    if (CC_UNLIKELY(aux != NULL)) {
+        volumeRampStereo(t, out, frameCount, temp, aux);
+        return;
+    }
+    volumeRampStereo32_simd(out, temp, frameCount, &t->prevVolume[0], &t->prevVolume[1],
+            t->volumeInc[0], t->volumeInc[1]);
+    t->adjustVolumeRamp(false);
+}
+
+void AudioMixer::volumeStereoSimd(track_t* t, int32_t* out, size_t frameCount, int32_t* temp, int32_t* aux)
+{
+    if (CC_UNLIKELY(aux != NULL)) {
+        volumeStereo(t, out, frameCount, temp, aux);
+        return;
+    }
+    volumeStereo32_simd(out, temp, frameCount, t->volume[0], t->volume[1]);
+}
+
+void AudioMixer::track__16BitsStereoSimd(track_t* t, int32_t* out, size_t frameCount, int32_t* temp, int32_t* aux)
+{
+    if (CC_UNLIKELY(aux != NULL)) {
+        track__16BitsStereo(t, out, frameCount, temp, aux);
+        return;
+    }
+    const int16_t *in = static_cast<const int16_t *>(t->in);
+    if (CC_UNLIKELY(t->volumeInc[0]|t->volumeInc[1])) {
+        mixRampStereo16_simd(out, in, frameCount, &t->prevVolume[0], &t->prevVolume[1],
+                t->volumeInc[0], t->volumeInc[1]);
+        t->adjustVolumeRamp(false);
+    } else {
+        mixStereo16_simd(out, in, frameCount, t->volume[0], t->volume[1]);
+    }
+    t->in = in + frameCount * MAX_NUM_CHANNELS;
+}
+
+void AudioMixer::track__16BitsMonoSimd(track_t* t, int32_t* out, size_t frameCount, int32_t* temp, int32_t* aux)
+{
+    if (CC_UNLIKELY(aux != NULL)) {
+        track__16BitsMono(t, out, frameCount, temp, aux);
+        return;
+    }
+    const int16_t *in = static_cast<const int16_t *>(t->in);
+    if (CC_UNLIKELY(t->volumeInc[0]|t->volumeInc[1])) {
+        mixRampMono16_simd(out, in, frameCount, &t->prevVolume[0], &t->prevVolume[1],
+                t->volumeInc[0], t->volumeInc[1]);
+        t->adjustVolumeRamp(false);
+    } else {
+        mixMono16_simd(out, in, frameCount, t->volume[0], t->volume[1]);
+    }
+    t->in = in + frameCount;
+}
+#endif // AUDIO_MIXER_SIMD
+
 // no-op case
 void AudioMixer::process__nop(state_t* state, int64_t pts)
 {
     uint32_t e0 = state->enabledTracks;
-    size_t bufSize = state->frameCount * sizeof(int16_t) * MAX_NUM_CHANNELS;
     while (e0) {
         // process by group of tracks with same output buffer to
         // avoid multiple memset() on same buffer
@@ -1069,7 +1168,8 @@ void AudioMixer::process__nop(state_t* state, int64_t pts)
         }
         e0 &= ~(e1);
 
-        memset(t1.mainBuffer, 0, bufSize);
+        memset(t1.mainBuffer, 0, state->frameCount * MAX_NUM_CHANNELS *
+                (t1.mainFormat == MAIN_FORMAT_FLOAT ? sizeof(float) : sizeof(int16_t)));
 
         while (e1) {
             i = 31 - __builtin_clz(e1);
@@ -1134,8 +1234,7 @@ void AudioMixer::process__genericNoResampling(state_t* state, int64_t pts)
             }
         }
         e0 &= ~(e1);
-        // this assumes output 16 bits stereo, no resampling
-        int32_t *out = t1.mainBuffer;
+        // this assumes output stereo, no resampling
         size_t numFrames = 0;
         do {
             memset(outTemp, 0, sizeof(outTemp));
@@ -1175,8 +1274,7 @@ void AudioMixer::process__genericNoResampling(state_t* state, int64_t pts)
                     }
                 }
             }
-            ditherAndClamp(out, outTemp, BLOCKSIZE);
-            out += BLOCKSIZE;
+            writeMainBuffer(t1, numFrames, outTemp, BLOCKSIZE);
             numFrames += BLOCKSIZE;
         } while (numFrames < state->frameCount);
     }
@@ -1218,7 +1316,6 @@ void AudioMixer::process__genericResampling(state_t* state, int64_t pts)
             }
         }
         e0 &= ~(e1);
-        int32_t *out = t1.mainBuffer;
         memset(outTemp, 0, size);
         while (e1) {
             const int i = 31 - __builtin_clz(e1);
@@ -1257,7 +1354,7 @@ void AudioMixer::process__genericResampling(state_t* state, int64_t pts)
                 }
             }
         }
-        ditherAndClamp(out, outTemp, numFrames);
+        writeMainBuffer(t1, 0, outTemp, numFrames);
     }
 }
 
@@ -1324,108 +1421,134 @@ void AudioMixer::process__OneTrack16BitsStereoNoResampling(state_t* state,
     }
 }
 
-#if 0
-// 2 tracks is also a common case
-// NEVER used in current implementation of process__validate()
-// only use if the 2 tracks have the same output buffer
-void AudioMixer::process__TwoTracks16BitsStereoNoResampling(state_t* state,
-                                                            int64_t pts)
+// any number of 16-bit stereo or mono tracks, without resampling or aux send.
+// Each track's provider data is accumulated directly into a single int32 buffer
+// of NTRACKS_BLOCKSIZE frames, which is then clamped to 16 bits once per block.
+void AudioMixer::process__NTracks16BitsNoResampling(state_t* state, int64_t pts)
 {
-    int i;
-    uint32_t en = state->enabledTracks;
-
-    i = 31 - __builtin_clz(en);
-    const track_t& t0 = state->tracks[i];
-    AudioBufferProvider::Buffer& b0(t0.buffer);
-
-    en &= ~(1<<i);
-    i = 31 - __builtin_clz(en);
-    const track_t& t1 = state->tracks[i];
-    AudioBufferProvider::Buffer& b1(t1.buffer);
-
-    const int16_t *in0;
-    const int16_t vl0 = t0.volume[0];
-    const int16_t vr0 = t0.volume[1];
-    size_t frameCount0 = 0;
-
-    const int16_t *in1;
-    const int16_t vl1 = t1.volume[0];
-    const int16_t vr1 = t1.volume[1];
-    size_t frameCount1 = 0;
-
-    //FIXME: only works if two tracks use same buffer
-    int32_t* out = t0.mainBuffer;
-    size_t numFrames = state->frameCount;
-    const int16_t *buff = NULL;
-
+    int32_t accum[NTRACKS_BLOCKSIZE * MAX_NUM_CHANNELS] __attribute__((aligned(32)));
 
-    while (numFrames) {
+    // acquire each track's buffer
+    uint32_t enabledTracks = state->enabledTracks;
+    uint32_t e0 = enabledTracks;
+    while (e0) {
+        const int i = 31 - __builtin_clz(e0);
+        e0 &= ~(1<<i);
+        track_t& t = state->tracks[i];
+        t.buffer.frameCount = state->frameCount;
+        t.bufferProvider->getNextBuffer(&t.buffer, pts);
+        t.frameCount = t.buffer.frameCount;
+        t.in = t.buffer.raw;
+        // t.in == NULL can happen if the track was flushed just after having
+        // been enabled for mixing.
+        if (t.in == NULL)
+            enabledTracks &= ~(1<<i);
+    }
 
-        if (frameCount0 == 0) {
-            b0.frameCount = numFrames;
-            int64_t outputPTS = calculateOutputPTS(t0, pts,
-                                                   out - t0.mainBuffer);
-            t0.bufferProvider->getNextBuffer(&b0, outputPTS);
-            if (b0.i16 == NULL) {
-                if (buff == NULL) {
-                    buff = new int16_t[MAX_NUM_CHANNELS * state->frameCount];
-                }
-                in0 = buff;
-                b0.frameCount = numFrames;
-            } else {
-                in0 = b0.i16;
+    e0 = enabledTracks;
+    while (e0) {
+        // process by group of tracks with same output buffer
+        uint32_t e1 = e0, e2 = e0;
+        int j = 31 - __builtin_clz(e1);
+        track_t& t1 = state->tracks[j];
+        e2 &= ~(1<<j);
+        while (e2) {
+            j = 31 - __builtin_clz(e2);
+            e2 &= ~(1<<j);
+            track_t& t2 = state->tracks[j];
+            if (CC_UNLIKELY(t2.mainBuffer != t1.mainBuffer)) {
+                e1 &= ~(1<<j);
             }
-            frameCount0 = b0.frameCount;
         }
-        if (frameCount1 == 0) {
-            b1.frameCount = numFrames;
-            int64_t outputPTS = calculateOutputPTS(t1, pts,
-                                                   out - t0.mainBuffer);
-            t1.bufferProvider->getNextBuffer(&b1, outputPTS);
-            if (b1.i16 == NULL) {
-                if (buff == NULL) {
-                    buff = new int16_t[MAX_NUM_CHANNELS * state->frameCount];
+        e0 &= ~(e1);
+        size_t numFrames = 0;
+        while (numFrames < state->frameCount) {
+            size_t blockFrames = state->frameCount - numFrames;
+            if (blockFrames > (size_t) NTRACKS_BLOCKSIZE) {
+                blockFrames = NTRACKS_BLOCKSIZE;
+            }
+            memset(accum, 0, blockFrames * MAX_NUM_CHANNELS * sizeof(int32_t));
+            e2 = e1;
+            while (e2) {
+                const int i = 31 - __builtin_clz(e2);
+                e2 &= ~(1<<i);
+                track_t& t = state->tracks[i];
+                size_t outFrames = 0;
+                while (outFrames < blockFrames) {
+                    if (t.frameCount == 0) {
+                        t.bufferProvider->releaseBuffer(&t.buffer);
+                        t.buffer.frameCount = state->frameCount - numFrames - outFrames;
+                        int64_t outputPTS = calculateOutputPTS(t, pts, numFrames + outFrames);
+                        t.bufferProvider->getNextBuffer(&t.buffer, outputPTS);
+                        t.in = t.buffer.raw;
+                        if (t.in == NULL) {
+                            enabledTracks &= ~(1<<i);
+                            e1 &= ~(1<<i);
+                            break;
+                        }
+                        t.frameCount = t.buffer.frameCount;
+                    }
+                    size_t inFrames = blockFrames - outFrames;
+                    if (inFrames > t.frameCount) {
+                        inFrames = t.frameCount;
+                    }
+                    mixTrack16(t, accum + outFrames * MAX_NUM_CHANNELS, inFrames);
+                    t.frameCount -= inFrames;
+                    outFrames += inFrames;
                 }
-                in1 = buff;
-                b1.frameCount = numFrames;
-            } else {
-                in1 = b1.i16;
             }
-            frameCount1 = b1.frameCount;
+            writeMainBuffer(t1, numFrames, accum, blockFrames);
+            numFrames += blockFrames;
         }
+    }
 
-        size_t outFrames = frameCount0 < frameCount1?frameCount0:frameCount1;
+    // release each track's buffer
+    e0 = enabledTracks;
+    while (e0) {
+        const int i = 31 - __builtin_clz(e0);
+        e0 &= ~(1<<i);
+        track_t& t = state->tracks[i];
+        t.bufferProvider->releaseBuffer(&t.buffer);
+    }
+}
 
-        numFrames -= outFrames;
-        frameCount0 -= outFrames;
-        frameCount1 -= outFrames;
+void AudioMixer::writeMainBuffer(const track_t& t, size_t offset, const int32_t* acc,
+        size_t frameCount)
+{
+    if (t.mainFormat == MAIN_FORMAT_FLOAT) {
+        float *out = reinterpret_cast<float *>(t.mainBuffer) + offset * MAX_NUM_CHANNELS;
+        accumToFloat(out, acc, frameCount * MAX_NUM_CHANNELS);
+    } else {
+        // one int32_t holds a 16-bit stereo frame
+        ditherAndClamp(t.mainBuffer + offset, acc, frameCount);
+    }
+}
 
-        do {
-            int32_t l0 = *in0++;
-            int32_t r0 = *in0++;
-            l0 = mul(l0, vl0);
-            r0 = mul(r0, vr0);
-            int32_t l = *in1++;
-            int32_t r = *in1++;
-            l = mulAdd(l, vl1, l0) >> 12;
-            r = mulAdd(r, vr1, r0) >> 12;
-            // clamping...
-            l = clamp16(l);
-            r = clamp16(r);
-            *out++ = (r<<16) | (l & 0xFFFF);
-        } while (--outFrames);
-
-        if (frameCount0 == 0) {
-            t0.bufferProvider->releaseBuffer(&b0);
+void AudioMixer::mixTrack16(track_t& t, int32_t* out, size_t frameCount)
+{
+    const int16_t *in = static_cast<const int16_t *>(t.in);
+    const bool stereo = (t.needs & NEEDS_CHANNEL_COUNT__MASK) >= NEEDS_CHANNEL_2;
+
+    if ((t.needs & NEEDS_MUTE__MASK) == NEEDS_MUTE_ENABLED) {
+        // nothing to mix, but the frames are consumed
+    } else if (CC_UNLIKELY(t.volumeInc[0]|t.volumeInc[1])) {
+        if (stereo) {
+            mixRampStereo16(out, in, frameCount, &t.prevVolume[0], &t.prevVolume[1],
+                    t.volumeInc[0], t.volumeInc[1]);
+        } else {
+            mixRampMono16(out, in, frameCount, &t.prevVolume[0], &t.prevVolume[1],
+                    t.volumeInc[0], t.volumeInc[1]);
         }
-        if (frameCount1 == 0) {
-            t1.bufferProvider->releaseBuffer(&b1);
+        t.adjustVolumeRamp(false);
+    } else {
+        if (stereo) {
+            mixStereo16(out, in, frameCount, t.volume[0], t.volume[1]);
+        } else {
+            mixMono16(out, in, frameCount, t.volume[0], t.volume[1]);
         }
     }
-
-    delete [] buff;
+    t.in = in + (stereo ? frameCount * MAX_NUM_CHANNELS : frameCount);
 }
-#endif
 
 int64_t AudioMixer::calculateOutputPTS(const track_t& t, int64_t basePTS,
                                        int outputFrameIndex)
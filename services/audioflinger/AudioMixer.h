@@ -69,6 +69,7 @@ public:
         MAIN_BUFFER     = 0x4002,
         AUX_BUFFER      = 0x4003,
         DOWNMIX_TYPE    = 0X4004,
+        MAIN_FORMAT     = 0x4005, // one of MAIN_FORMAT_* below, the sample format of MAIN_BUFFER
         // for target RESAMPLE
         SAMPLE_RATE     = 0x4100, // Configure sample rate conversion on this track name;
                                   // parameter 'value' is the new sample rate in Hz.
@@ -87,6 +88,12 @@ public:
         AUXLEVEL        = 0x4210,
     };
 
+    enum { // values for MAIN_FORMAT
+        MAIN_FORMAT_PCM_16_BIT  = 0,    // stereo 16-bit, dithered and clamped (default)
+        MAIN_FORMAT_FLOAT       = 1,    // stereo float, unity gain full scale is +/-1.0,
+                                        // not clamped so that headroom is kept after the mix
+    };
+
 
     // For all APIs with "name": TRACK0 <= name < TRACK0 + MAX_NUM_TRACKS
 
@@ -141,6 +148,9 @@ private:
 
     typedef void (*hook_t)(track_t* t, int32_t* output, size_t numOutFrames, int32_t* temp, int32_t* aux);
     static const int BLOCKSIZE = 16; // 4 cache lines
+    // frames accumulated per pass of process__NTracks16BitsNoResampling(); the int32_t stereo
+    // accumulator (2 KB) stays in L1 while all tracks are summed into it
+    static const int NTRACKS_BLOCKSIZE = 256;
 
     struct track_t {
         uint32_t    needs;
@@ -165,7 +175,8 @@ private:
 
         uint8_t     channelCount;   // 1 or 2, redundant with (needs & NEEDS_CHANNEL_COUNT__MASK)
         uint8_t     format;         // always 16
-        uint16_t    enabled;        // actually bool
+        uint8_t     enabled;        // actually bool
+        uint8_t     mainFormat;     // MAIN_FORMAT_PCM_16_BIT or MAIN_FORMAT_FLOAT
         audio_channel_mask_t channelMask;
 
         // actual buffer provider used by the track hooks, see DownmixerBufferProvider below
@@ -261,16 +272,33 @@ private:
     static void volumeRampStereo(track_t* t, int32_t* out, size_t frameCount, int32_t* temp, int32_t* aux);
     static void volumeStereo(track_t* t, int32_t* out, size_t frameCount, int32_t* temp, int32_t* aux);
 
+    // NEON / SSE2 versions of the hooks above, selected by process__validate() when
+    // AUDIO_MIXER_SIMD is available.  The scalar hooks are kept as the bit-exact reference,
+    // and are still used for the aux send paths.
+    static void track__genericResampleSimd(track_t* t, int32_t* out, size_t numFrames, int32_t* temp, int32_t* aux);
+    static void track__16BitsStereoSimd(track_t* t, int32_t* out, size_t numFrames, int32_t* temp, int32_t* aux);
+    static void track__16BitsMonoSimd(track_t* t, int32_t* out, size_t numFrames, int32_t* temp, int32_t* aux);
+    static void volumeRampStereoSimd(track_t* t, int32_t* out, size_t frameCount, int32_t* temp, int32_t* aux);
+    static void volumeStereoSimd(track_t* t, int32_t* out, size_t frameCount, int32_t* temp, int32_t* aux);
+
+    static void genericResample(track_t* t, int32_t* out, size_t outFrameCount, int32_t* temp,
+            int32_t* aux, hook_t rampHook, hook_t volumeHook);
+
     static void process__validate(state_t* state, int64_t pts);
     static void process__nop(state_t* state, int64_t pts);
     static void process__genericNoResampling(state_t* state, int64_t pts);
     static void process__genericResampling(state_t* state, int64_t pts);
     static void process__OneTrack16BitsStereoNoResampling(state_t* state,
                                                           int64_t pts);
-#if 0
-    static void process__TwoTracks16BitsStereoNoResampling(state_t* state,
-                                                           int64_t pts);
-#endif
+    static void process__NTracks16BitsNoResampling(state_t* state, int64_t pts);
+
+    // convert frameCount frames of the Q4.27 accumulator to the format of t.mainBuffer,
+    // starting at frame offset; all tracks sharing a main buffer share its format
+    static void writeMainBuffer(const track_t& t, size_t offset, const int32_t* acc,
+            size_t frameCount);
+
+    // mix frameCount frames of a 16-bit stereo or mono track from t.in into out
+    static void mixTrack16(track_t& t, int32_t* out, size_t frameCount);
 
     static int64_t calculateOutputPTS(const track_t& t, int64_t basePTS,
                                       int outputFrameIndex);
@@ -0,0 +1,467 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_MIXER_SIMD_H
+#define ANDROID_AUDIO_MIXER_SIMD_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define AUDIO_MIXER_SIMD 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define AUDIO_MIXER_SIMD 1
+#endif
+
+namespace android {
+
+// ----------------------------------------------------------------------------
+
+// Inner loops of the AudioMixer track hooks, for 16-bit input without aux send.
+//
+// Each kernel exists as a scalar reference (suffix _c) which is the exact arithmetic
+// of the original AudioMixer hooks, and, when AUDIO_MIXER_SIMD is defined, a NEON or SSE2
+// version (suffix _simd) which must produce bit-exact output with respect to the reference.
+// test-mixer.cpp checks this equivalence.
+//
+// All kernels accumulate into 'out', which is interleaved stereo Q19.12 (int32_t per sample).
+// Volumes are in the same formats as AudioMixer::track_t: constant gains are 3.12 fixed point,
+// ramped gains are 3.12 in the upper 16 bits of a 16.16 value.
+// The ramped kernels update *vl and *vr with the volume to apply to the next frame.
+
+// constant gain, interleaved stereo 16-bit input
+static inline void mixStereo16_c(int32_t* out, const int16_t* in, size_t frameCount,
+        int16_t vl, int16_t vr)
+{
+    while (frameCount--) {
+        out[0] += (int32_t)in[0] * vl;
+        out[1] += (int32_t)in[1] * vr;
+        in += 2;
+        out += 2;
+    }
+}
+
+// constant gain, mono 16-bit input
+static inline void mixMono16_c(int32_t* out, const int16_t* in, size_t frameCount,
+        int16_t vl, int16_t vr)
+{
+    while (frameCount--) {
+        int32_t l = *in++;
+        out[0] += l * vl;
+        out[1] += l * vr;
+        out += 2;
+    }
+}
+
+// volume ramp, interleaved stereo 16-bit input
+static inline void mixRampStereo16_c(int32_t* out, const int16_t* in, size_t frameCount,
+        int32_t* vl, int32_t* vr, int32_t vlInc, int32_t vrInc)
+{
+    int32_t l = *vl;
+    int32_t r = *vr;
+    while (frameCount--) {
+        *out++ += (l >> 16) * (int32_t) *in++;
+        *out++ += (r >> 16) * (int32_t) *in++;
+        l += vlInc;
+        r += vrInc;
+    }
+    *vl = l;
+    *vr = r;
+}
+
+// volume ramp, mono 16-bit input
+static inline void mixRampMono16_c(int32_t* out, const int16_t* in, size_t frameCount,
+        int32_t* vl, int32_t* vr, int32_t vlInc, int32_t vrInc)
+{
+    int32_t l = *vl;
+    int32_t r = *vr;
+    while (frameCount--) {
+        int32_t s = *in++;
+        *out++ += (l >> 16) * s;
+        *out++ += (r >> 16) * s;
+        l += vlInc;
+        r += vrInc;
+    }
+    *vl = l;
+    *vr = r;
+}
+
+// constant gain, interleaved stereo Q19.12 input (resampler output), as in volumeStereo()
+static inline void volumeStereo32_c(int32_t* out, const int32_t* temp, size_t frameCount,
+        int16_t vl, int16_t vr)
+{
+    while (frameCount--) {
+        int16_t l = (int16_t)(*temp++ >> 12);
+        int16_t r = (int16_t)(*temp++ >> 12);
+        out[0] += (int32_t)l * vl;
+        out[1] += (int32_t)r * vr;
+        out += 2;
+    }
+}
+
+// volume ramp, interleaved stereo Q19.12 input (resampler output), as in volumeRampStereo()
+static inline void volumeRampStereo32_c(int32_t* out, const int32_t* temp, size_t frameCount,
+        int32_t* vl, int32_t* vr, int32_t vlInc, int32_t vrInc)
+{
+    int32_t l = *vl;
+    int32_t r = *vr;
+    while (frameCount--) {
+        *out++ += (l >> 16) * (*temp++ >> 12);
+        *out++ += (r >> 16) * (*temp++ >> 12);
+        l += vlInc;
+        r += vrInc;
+    }
+    *vl = l;
+    *vr = r;
+}
+
+// Q4.27 accumulator to float, for the float main buffer; unity gain full scale maps to 1.0
+// and nothing is clamped, so the result keeps the 24 dB of headroom of the accumulator
+static inline void accumToFloat_c(float* out, const int32_t* in, size_t sampleCount)
+{
+    const float scale = 1.0f / (1 << 27);
+    while (sampleCount--) {
+        *out++ = *in++ * scale;
+    }
+}
+
+#ifdef AUDIO_MIXER_SIMD
+
+#if defined(__SSE2__) && !defined(__ARM_NEON__)
+// SSE2 has no 32-bit low multiply; the low 32 bits of the unsigned
+// 32x32->64 product are the same as those of the signed product.
+static inline __m128i mixer_mullo_epi32(__m128i a, __m128i b)
+{
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+            _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+// sign-extend the low / high four int16_t of x to int32_t
+static inline __m128i mixer_cvtlo_epi16(__m128i x)
+{
+    return _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+}
+
+static inline __m128i mixer_cvthi_epi16(__m128i x)
+{
+    return _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+}
+#endif
+
+static inline void mixStereo16_simd(int32_t* out, const int16_t* in, size_t frameCount,
+        int16_t vl, int16_t vr)
+{
+    size_t n = frameCount >> 2;
+#ifdef __ARM_NEON__
+    const int16_t v[4] = { vl, vr, vl, vr };
+    const int16x4_t vol = vld1_s16(v);
+    while (n--) {
+        int16x8_t x = vld1q_s16(in);
+        vst1q_s32(out, vmlal_s16(vld1q_s32(out), vget_low_s16(x), vol));
+        vst1q_s32(out + 4, vmlal_s16(vld1q_s32(out + 4), vget_high_s16(x), vol));
+        in += 8;
+        out += 8;
+    }
+#else
+    const __m128i vol = _mm_set_epi16(vr, vl, vr, vl, vr, vl, vr, vl);
+    while (n--) {
+        __m128i x = _mm_loadu_si128((const __m128i*)in);
+        __m128i lo = _mm_mullo_epi16(x, vol);
+        __m128i hi = _mm_mulhi_epi16(x, vol);
+        __m128i* o = (__m128i*)out;
+        _mm_storeu_si128(o, _mm_add_epi32(_mm_loadu_si128(o), _mm_unpacklo_epi16(lo, hi)));
+        _mm_storeu_si128(o + 1,
+                _mm_add_epi32(_mm_loadu_si128(o + 1), _mm_unpackhi_epi16(lo, hi)));
+        in += 8;
+        out += 8;
+    }
+#endif
+    mixStereo16_c(out, in, frameCount & 3, vl, vr);
+}
+
+static inline void mixMono16_simd(int32_t* out, const int16_t* in, size_t frameCount,
+        int16_t vl, int16_t vr)
+{
+    size_t n = frameCount >> 2;
+#ifdef __ARM_NEON__
+    const int16_t v[4] = { vl, vr, vl, vr };
+    const int16x4_t vol = vld1_s16(v);
+    while (n--) {
+        int16x4_t x = vld1_s16(in);
+        int16x4x2_t d = vzip_s16(x, x);
+        vst1q_s32(out, vmlal_s16(vld1q_s32(out), d.val[0], vol));
+        vst1q_s32(out + 4, vmlal_s16(vld1q_s32(out + 4), d.val[1], vol));
+        in += 4;
+        out += 8;
+    }
+#else
+    const __m128i vol = _mm_set_epi16(vr, vl, vr, vl, vr, vl, vr, vl);
+    while (n--) {
+        __m128i x = _mm_loadl_epi64((const __m128i*)in);
+        __m128i d = _mm_unpacklo_epi16(x, x);
+        __m128i lo = _mm_mullo_epi16(d, vol);
+        __m128i hi = _mm_mulhi_epi16(d, vol);
+        __m128i* o = (__m128i*)out;
+        _mm_storeu_si128(o, _mm_add_epi32(_mm_loadu_si128(o), _mm_unpacklo_epi16(lo, hi)));
+        _mm_storeu_si128(o + 1,
+                _mm_add_epi32(_mm_loadu_si128(o + 1), _mm_unpackhi_epi16(lo, hi)));
+        in += 4;
+        out += 8;
+    }
+#endif
+    mixMono16_c(out, in, frameCount & 3, vl, vr);
+}
+
+static inline void mixRampStereo16_simd(int32_t* out, const int16_t* in, size_t frameCount,
+        int32_t* vl, int32_t* vr, int32_t vlInc, int32_t vrInc)
+{
+    size_t n = frameCount >> 2;
+    if (n) {
+        // two frames per vector: { l(f), r(f), l(f+1), r(f+1) }
+#ifdef __ARM_NEON__
+        const int32_t v0[4] = { *vl, *vr, *vl + vlInc, *vr + vrInc };
+        const int32_t i0[4] = { vlInc * 2, vrInc * 2, vlInc * 2, vrInc * 2 };
+        int32x4_t v = vld1q_s32(v0);
+        const int32x4_t inc = vld1q_s32(i0);
+        while (n--) {
+            int16x8_t x = vld1q_s16(in);
+            vst1q_s32(out, vmlaq_s32(vld1q_s32(out), vshrq_n_s32(v, 16),
+                    vmovl_s16(vget_low_s16(x))));
+            v = vaddq_s32(v, inc);
+            vst1q_s32(out + 4, vmlaq_s32(vld1q_s32(out + 4), vshrq_n_s32(v, 16),
+                    vmovl_s16(vget_high_s16(x))));
+            v = vaddq_s32(v, inc);
+            in += 8;
+            out += 8;
+        }
+        *vl = vgetq_lane_s32(v, 0);
+        *vr = vgetq_lane_s32(v, 1);
+#else
+        __m128i v = _mm_set_epi32(*vr + vrInc, *vl + vlInc, *vr, *vl);
+        const __m128i inc = _mm_set_epi32(vrInc * 2, vlInc * 2, vrInc * 2, vlInc * 2);
+        while (n--) {
+            __m128i x = _mm_loadu_si128((const __m128i*)in);
+            __m128i* o = (__m128i*)out;
+            _mm_storeu_si128(o, _mm_add_epi32(_mm_loadu_si128(o),
+                    mixer_mullo_epi32(_mm_srai_epi32(v, 16), mixer_cvtlo_epi16(x))));
+            v = _mm_add_epi32(v, inc);
+            _mm_storeu_si128(o + 1, _mm_add_epi32(_mm_loadu_si128(o + 1),
+                    mixer_mullo_epi32(_mm_srai_epi32(v, 16), mixer_cvthi_epi16(x))));
+            v = _mm_add_epi32(v, inc);
+            in += 8;
+            out += 8;
+        }
+        *vl = _mm_cvtsi128_si32(v);
+        *vr = _mm_cvtsi128_si32(_mm_srli_si128(v, 4));
+#endif
+    }
+    mixRampStereo16_c(out, in, frameCount & 3, vl, vr, vlInc, vrInc);
+}
+
+static inline void mixRampMono16_simd(int32_t* out, const int16_t* in, size_t frameCount,
+        int32_t* vl, int32_t* vr, int32_t vlInc, int32_t vrInc)
+{
+    size_t n = frameCount >> 2;
+    if (n) {
+#ifdef __ARM_NEON__
+        const int32_t v0[4] = { *vl, *vr, *vl + vlInc, *vr + vrInc };
+        const int32_t i0[4] = { vlInc * 2, vrInc * 2, vlInc * 2, vrInc * 2 };
+        int32x4_t v = vld1q_s32(v0);
+        const int32x4_t inc = vld1q_s32(i0);
+        while (n--) {
+            int16x4_t x = vld1_s16(in);
+            int16x4x2_t d = vzip_s16(x, x);
+            vst1q_s32(out, vmlaq_s32(vld1q_s32(out), vshrq_n_s32(v, 16), vmovl_s16(d.val[0])));
+            v = vaddq_s32(v, inc);
+            vst1q_s32(out + 4, vmlaq_s32(vld1q_s32(out + 4), vshrq_n_s32(v, 16),
+                    vmovl_s16(d.val[1])));
+            v = vaddq_s32(v, inc);
+            in += 4;
+            out += 8;
+        }
+        *vl = vgetq_lane_s32(v, 0);
+        *vr = vgetq_lane_s32(v, 1);
+#else
+        __m128i v = _mm_set_epi32(*vr + vrInc, *vl + vlInc, *vr, *vl);
+        const __m128i inc = _mm_set_epi32(vrInc * 2, vlInc * 2, vrInc * 2, vlInc * 2);
+        while (n--) {
+            __m128i x = _mm_loadl_epi64((const __m128i*)in);
+            __m128i d = _mm_unpacklo_epi16(x, x);
+            __m128i* o = (__m128i*)out;
+            _mm_storeu_si128(o, _mm_add_epi32(_mm_loadu_si128(o),
+                    mixer_mullo_epi32(_mm_srai_epi32(v, 16), mixer_cvtlo_epi16(d))));
+            v = _mm_add_epi32(v, inc);
+            _mm_storeu_si128(o + 1, _mm_add_epi32(_mm_loadu_si128(o + 1),
+                    mixer_mullo_epi32(_mm_srai_epi32(v, 16), mixer_cvthi_epi16(d))));
+            v = _mm_add_epi32(v, inc);
+            in += 4;
+            out += 8;
+        }
+        *vl = _mm_cvtsi128_si32(v);
+        *vr = _mm_cvtsi128_si32(_mm_srli_si128(v, 4));
+#endif
+    }
+    mixRampMono16_c(out, in, frameCount & 3, vl, vr, vlInc, vrInc);
+}
+
+static inline void volumeStereo32_simd(int32_t* out, const int32_t* temp, size_t frameCount,
+        int16_t vl, int16_t vr)
+{
+    size_t n = frameCount >> 1;
+#ifdef __ARM_NEON__
+    const int32_t v[4] = { vl, vr, vl, vr };
+    const int32x4_t vol = vld1q_s32(v);
+    while (n--) {
+        // (int16_t)(x >> 12) is bits 12..27 of x, sign-extended
+        int32x4_t s = vshrq_n_s32(vshlq_n_s32(vld1q_s32(temp), 4), 16);
+        vst1q_s32(out, vmlaq_s32(vld1q_s32(out), s, vol));
+        temp += 4;
+        out += 4;
+    }
+#else
+    const __m128i vol = _mm_set_epi32(vr, vl, vr, vl);
+    while (n--) {
+        // (int16_t)(x >> 12) is bits 12..27 of x, sign-extended
+        __m128i s = _mm_srai_epi32(_mm_slli_epi32(_mm_loadu_si128((const __m128i*)temp), 4), 16);
+        __m128i* o = (__m128i*)out;
+        _mm_storeu_si128(o, _mm_add_epi32(_mm_loadu_si128(o), mixer_mullo_epi32(s, vol)));
+        temp += 4;
+        out += 4;
+    }
+#endif
+    volumeStereo32_c(out, temp, frameCount & 1, vl, vr);
+}
+
+static inline void volumeRampStereo32_simd(int32_t* out, const int32_t* temp, size_t frameCount,
+        int32_t* vl, int32_t* vr, int32_t vlInc, int32_t vrInc)
+{
+    size_t n = frameCount >> 1;
+    if (n) {
+#ifdef __ARM_NEON__
+        const int32_t v0[4] = { *vl, *vr, *vl + vlInc, *vr + vrInc };
+        const int32_t i0[4] = { vlInc * 2, vrInc * 2, vlInc * 2, vrInc * 2 };
+        int32x4_t v = vld1q_s32(v0);
+        const int32x4_t inc = vld1q_s32(i0);
+        while (n--) {
+            vst1q_s32(out, vmlaq_s32(vld1q_s32(out), vshrq_n_s32(v, 16),
+                    vshrq_n_s32(vld1q_s32(temp), 12)));
+            v = vaddq_s32(v, inc);
+            temp += 4;
+            out += 4;
+        }
+        *vl = vgetq_lane_s32(v, 0);
+        *vr = vgetq_lane_s32(v, 1);
+#else
+        __m128i v = _mm_set_epi32(*vr + vrInc, *vl + vlInc, *vr, *vl);
+        const __m128i inc = _mm_set_epi32(vrInc * 2, vlInc * 2, vrInc * 2, vlInc * 2);
+        while (n--) {
+            __m128i t = _mm_srai_epi32(_mm_loadu_si128((const __m128i*)temp), 12);
+            __m128i* o = (__m128i*)out;
+            _mm_storeu_si128(o, _mm_add_epi32(_mm_loadu_si128(o),
+                    mixer_mullo_epi32(_mm_srai_epi32(v, 16), t)));
+            v = _mm_add_epi32(v, inc);
+            temp += 4;
+            out += 4;
+        }
+        *vl = _mm_cvtsi128_si32(v);
+        *vr = _mm_cvtsi128_si32(_mm_srli_si128(v, 4));
+#endif
+    }
+    volumeRampStereo32_c(out, temp, frameCount & 1, vl, vr, vlInc, vrInc);
+}
+
+static inline void accumToFloat_simd(float* out, const int32_t* in, size_t sampleCount)
+{
+    size_t n = sampleCount >> 2;
+#ifdef __ARM_NEON__
+    while (n--) {
+        vst1q_f32(out, vcvtq_n_f32_s32(vld1q_s32(in), 27));
+        in += 4;
+        out += 4;
+    }
+#else
+    const __m128 scale = _mm_set1_ps(1.0f / (1 << 27));
+    while (n--) {
+        _mm_storeu_ps(out, _mm_mul_ps(_mm_cvtepi32_ps(
+                _mm_loadu_si128((const __m128i*)in)), scale));
+        in += 4;
+        out += 4;
+    }
+#endif
+    accumToFloat_c(out, in, sampleCount & 3);
+}
+
+#endif // AUDIO_MIXER_SIMD
+
+// Best available implementation of the 16-bit kernels for this architecture.
+
+static inline void mixStereo16(int32_t* out, const int16_t* in, size_t frameCount,
+        int16_t vl, int16_t vr)
+{
+#ifdef AUDIO_MIXER_SIMD
+    mixStereo16_simd(out, in, frameCount, vl, vr);
+#else
+    mixStereo16_c(out, in, frameCount, vl, vr);
+#endif
+}
+
+static inline void mixMono16(int32_t* out, const int16_t* in, size_t frameCount,
+        int16_t vl, int16_t vr)
+{
+#ifdef AUDIO_MIXER_SIMD
+    mixMono16_simd(out, in, frameCount, vl, vr);
+#else
+    mixMono16_c(out, in, frameCount, vl, vr);
+#endif
+}
+
+static inline void mixRampStereo16(int32_t* out, const int16_t* in, size_t frameCount,
+        int32_t* vl, int32_t* vr, int32_t vlInc, int32_t vrInc)
+{
+#ifdef AUDIO_MIXER_SIMD
+    mixRampStereo16_simd(out, in, frameCount, vl, vr, vlInc, vrInc);
+#else
+    mixRampStereo16_c(out, in, frameCount, vl, vr, vlInc, vrInc);
+#endif
+}
+
+static inline void mixRampMono16(int32_t* out, const int16_t* in, size_t frameCount,
+        int32_t* vl, int32_t* vr, int32_t vlInc, int32_t vrInc)
+{
+#ifdef AUDIO_MIXER_SIMD
+    mixRampMono16_simd(out, in, frameCount, vl, vr, vlInc, vrInc);
+#else
+    mixRampMono16_c(out, in, frameCount, vl, vr, vlInc, vrInc);
+#endif
+}
+
+static inline void accumToFloat(float* out, const int32_t* in, size_t sampleCount)
+{
+#ifdef AUDIO_MIXER_SIMD
+    accumToFloat_simd(out, in, sampleCount);
+#else
+    accumToFloat_c(out, in, sampleCount);
+#endif
+}
+
+// ----------------------------------------------------------------------------
+}; // namespace android
+
+#endif // ANDROID_AUDIO_MIXER_SIMD_H
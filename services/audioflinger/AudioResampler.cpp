@@ -25,6 +25,7 @@
 #include "AudioResampler.h"
 #include "AudioResamplerSinc.h"
 #include "AudioResamplerCubic.h"
+#include "AudioResamplerPolyphase.h"
 
 #ifdef __arm__
 #include <machine/cpu-features.h>
@@ -85,6 +86,7 @@ bool AudioResampler::qualityIsSupported(src_quality quality)
     case MED_QUALITY:
     case HIGH_QUALITY:
     case VERY_HIGH_QUALITY:
+    case POLYPHASE_QUALITY:
         return true;
     default:
         return false;
@@ -105,7 +107,7 @@ void AudioResampler::init_routine()
         if (*endptr == '\0') {
             defaultQuality = (src_quality) l;
             ALOGD("forcing AudioResampler quality to %d", defaultQuality);
-            if (defaultQuality < DEFAULT_QUALITY || defaultQuality > VERY_HIGH_QUALITY) {
+            if (defaultQuality < DEFAULT_QUALITY || defaultQuality > POLYPHASE_QUALITY) {
                 defaultQuality = DEFAULT_QUALITY;
             }
         }
@@ -121,6 +123,8 @@ uint32_t AudioResampler::qualityMHz(src_quality quality)
         return 3;
     case MED_QUALITY:
         return 6;
+    case POLYPHASE_QUALITY:
+        return 12;
     case HIGH_QUALITY:
         return 20;
     case VERY_HIGH_QUALITY:
@@ -175,6 +179,9 @@ AudioResampler* AudioResampler::create(int bitDepth, int inChannelCount,
         case VERY_HIGH_QUALITY:
             quality = HIGH_QUALITY;
             break;
+        case POLYPHASE_QUALITY:
+            quality = MED_QUALITY;
+            break;
         }
     }
     pthread_mutex_unlock(&mutex);
@@ -200,6 +207,10 @@ AudioResampler* AudioResampler::create(int bitDepth, int inChannelCount,
         ALOGV("Create VERY_HIGH_QUALITY sinc Resampler = %d", quality);
         resampler = new AudioResamplerSinc(bitDepth, inChannelCount, sampleRate, quality);
         break;
+    case POLYPHASE_QUALITY:
+        ALOGV("Create POLYPHASE_QUALITY sinc Resampler");
+        resampler = new AudioResamplerPolyphase(bitDepth, inChannelCount, sampleRate);
+        break;
     }
 
     // initialize resampler
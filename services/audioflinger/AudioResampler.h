@@ -31,6 +31,7 @@ public:
     //  LOW_QUALITY: linear interpolator (1st order)
     //  MED_QUALITY: cubic interpolator (3rd order)
     //  HIGH_QUALITY: fixed multi-tap FIR (e.g. 48KHz->44.1KHz)
+    //  POLYPHASE_QUALITY: 32-tap FIR with a filter bank precomputed per rate pair
     // NOTE: high quality SRC will only be supported for
     // certain fixed rate conversions. Sample rate cannot be
     // changed dynamically.
@@ -40,6 +41,7 @@ public:
         MED_QUALITY=2,
         HIGH_QUALITY=3,
         VERY_HIGH_QUALITY=4,
+        POLYPHASE_QUALITY=5,
     };
 
     static AudioResampler* create(int bitDepth, int inChannelCount,
@@ -0,0 +1,482 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "AudioResamplerPolyphase"
+//#define LOG_NDEBUG 0
+
+#include <malloc.h>
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <cutils/atomic.h>
+#include <cutils/compiler.h>
+
+#include <utils/Log.h>
+
+#include "AudioResamplerPolyphase.h"
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace android {
+// ----------------------------------------------------------------------------
+
+// Kaiser window shape, about 70 dB of stopband attenuation with 32 taps
+static const double kKaiserBeta = 7.0;
+
+// passband edge, as a fraction of the lower of the input and output Nyquist frequencies
+static const double kCutoff = 0.91;
+
+// number of unreferenced banks kept around for tracks that come back at the same rate
+static const int kMaxUnusedBanks = 4;
+
+// log2(kMaxPhases), used to pick the phase from the 30-bit phase accumulator
+static const int kApproxPhaseShift = 30 - 10;
+
+static pthread_mutex_t gBankLock = PTHREAD_MUTEX_INITIALIZER;
+// signalled when a bank needs computing or may be evicted, and when a bank is ready
+static pthread_cond_t gBankWork = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t gBankReady = PTHREAD_COND_INITIALIZER;
+static pthread_once_t gBankThreadOnce = PTHREAD_ONCE_INIT;
+
+/*static*/ AudioResamplerPolyphase::Bank* AudioResamplerPolyphase::sBanks = NULL;
+/*static*/ uint32_t AudioResamplerPolyphase::sBankClock = 0;
+
+// ----------------------------------------------------------------------------
+
+// dot product of kNumTaps samples with one phase of the bank, result is Q14
+static inline int32_t dotProduct(const int16_t* samples, const int16_t* coefs)
+{
+    const int n = AudioResamplerPolyphase::kNumTaps;
+#if defined(__ARM_NEON__)
+    int32x4_t acc = vdupq_n_s32(0);
+    for (int i = 0; i < n; i += 8) {
+        int16x8_t s = vld1q_s16(samples + i);
+        int16x8_t c = vld1q_s16(coefs + i);
+        acc = vmlal_s16(acc, vget_low_s16(s), vget_low_s16(c));
+        acc = vmlal_s16(acc, vget_high_s16(s), vget_high_s16(c));
+    }
+    int32x2_t sum = vpadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+    sum = vpadd_s32(sum, sum);
+    return vget_lane_s32(sum, 0);
+#elif defined(__SSE2__)
+    __m128i acc = _mm_setzero_si128();
+    for (int i = 0; i < n; i += 8) {
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(
+                _mm_loadu_si128((const __m128i*)(samples + i)),
+                _mm_load_si128((const __m128i*)(coefs + i))));
+    }
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(acc);
+#else
+    int32_t acc = 0;
+    for (int i = 0; i < n; i++) {
+        acc += (int32_t)samples[i] * coefs[i];
+    }
+    return acc;
+#endif
+}
+
+// zeroth order modified Bessel function of the first kind, for the Kaiser window
+static double besselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    const double y = x * x / 4.0;
+    for (int k = 1; k < 64 && term > sum * 1e-12; k++) {
+        term *= y / ((double)k * k);
+        sum += term;
+    }
+    return sum;
+}
+
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+    while (b != 0) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// ----------------------------------------------------------------------------
+
+void AudioResamplerPolyphase::computeBank(Bank* bank)
+{
+    const uint32_t g = gcd(bank->inSampleRate, bank->outSampleRate);
+    const uint32_t L = bank->outSampleRate / g;
+    const uint32_t M = bank->inSampleRate / g;
+    if (L <= kMaxPhases) {
+        bank->numPhases = L;
+        bank->phaseStep = M;
+    } else {
+        bank->numPhases = kMaxPhases;
+        bank->phaseStep = 0;
+    }
+
+    const double ratio = (double)bank->outSampleRate / bank->inSampleRate;
+    const double cutoff = (ratio < 1.0 ? ratio : 1.0) * kCutoff;
+    const double halfWidth = kNumTaps / 2;
+    const double i0Beta = besselI0(kKaiserBeta);
+
+    bank->coefs = (int16_t*)memalign(32, bank->numPhases * kNumTaps * sizeof(int16_t));
+    double h[kNumTaps];
+    for (uint32_t p = 0; p < bank->numPhases; p++) {
+        // distance in input frames from each tap to the output instant; the output lags
+        // the newest sample by (kNumTaps / 2 - p / L) frames
+        double sum = 0;
+        for (int j = 0; j < kNumTaps; j++) {
+            double x = j - (halfWidth - 1) - (double)p / bank->numPhases;
+            double w = 1.0 - (x / halfWidth) * (x / halfWidth);
+            double s = cutoff * x;
+            double sinc = (s == 0) ? 1.0 : sin(M_PI * s) / (M_PI * s);
+            h[j] = w > 0 ? cutoff * sinc * besselI0(kKaiserBeta * sqrt(w)) / i0Beta : 0;
+            sum += h[j];
+        }
+        // normalize each phase to unity gain at DC
+        int16_t* c = bank->coefs + p * kNumTaps;
+        for (int j = 0; j < kNumTaps; j++) {
+            double v = floor(h[j] / sum * (1 << kCoefBits) + 0.5);
+            c[j] = (int16_t)(v > 32767 ? 32767 : (v < -32768 ? -32768 : v));
+        }
+    }
+    ALOGV("computed %u phase bank for %d -> %d Hz (%s)", bank->numPhases,
+            bank->inSampleRate, bank->outSampleRate, bank->phaseStep ? "exact" : "approximate");
+}
+
+void AudioResamplerPolyphase::startBankThread()
+{
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread, &attr, bankThread, NULL) != 0) {
+        // resamplers keep interpolating linearly
+        ALOGE("unable to start the filter bank thread");
+    }
+    pthread_attr_destroy(&attr);
+}
+
+void* AudioResamplerPolyphase::bankThread(void* /*arg*/)
+{
+    pthread_mutex_lock(&gBankLock);
+    for (;;) {
+        Bank* pending = NULL;
+        for (Bank* b = sBanks; b != NULL; b = b->next) {
+            if (!b->ready) {
+                pending = b;
+                break;
+            }
+        }
+        if (pending != NULL) {
+            // only this thread unlinks banks, so pending stays valid while unlocked
+            pthread_mutex_unlock(&gBankLock);
+            computeBank(pending);
+            pthread_mutex_lock(&gBankLock);
+            android_atomic_release_store(1, &pending->ready);
+            pthread_cond_broadcast(&gBankReady);
+            continue;
+        }
+
+        // keep the most recently used unreferenced banks, free the others
+        Bank* evicted = NULL;
+        for (;;) {
+            int unused = 0;
+            Bank** oldest = NULL;
+            for (Bank** link = &sBanks; *link != NULL; link = &(*link)->next) {
+                if ((*link)->refCount == 0) {
+                    unused++;
+                    if (oldest == NULL ||
+                            (int32_t)((*link)->lastUsed - (*oldest)->lastUsed) < 0) {
+                        oldest = link;
+                    }
+                }
+            }
+            if (unused <= kMaxUnusedBanks) {
+                break;
+            }
+            Bank* b = *oldest;
+            *oldest = b->next;
+            b->next = evicted;
+            evicted = b;
+        }
+        if (evicted != NULL) {
+            pthread_mutex_unlock(&gBankLock);
+            while (evicted != NULL) {
+                Bank* b = evicted;
+                evicted = b->next;
+                free(b->coefs);
+                delete b;
+            }
+            pthread_mutex_lock(&gBankLock);
+            continue;
+        }
+
+        pthread_cond_wait(&gBankWork, &gBankLock);
+    }
+    return NULL;
+}
+
+void AudioResamplerPolyphase::releaseBank_l(Bank* bank)
+{
+    if (bank == NULL) {
+        return;
+    }
+    bank->refCount--;
+    bank->lastUsed = ++sBankClock;
+    pthread_cond_signal(&gBankWork);
+}
+
+// Must be called with gBankLock held.  Switches mBank to the bank for the current
+// rates, queueing it for the bank thread if it does not exist yet.
+void AudioResamplerPolyphase::updateBank_l()
+{
+    Bank* bank;
+    for (bank = sBanks; bank != NULL; bank = bank->next) {
+        if (bank->inSampleRate == mInSampleRate && bank->outSampleRate == (int32_t)mSampleRate) {
+            break;
+        }
+    }
+    if (bank == NULL) {
+        bank = new Bank;
+        bank->inSampleRate = mInSampleRate;
+        bank->outSampleRate = mSampleRate;
+        bank->numPhases = 0;
+        bank->phaseStep = 0;
+        bank->coefs = NULL;
+        bank->ready = 0;
+        bank->refCount = 0;
+        bank->next = sBanks;
+        sBanks = bank;
+        pthread_cond_signal(&gBankWork);
+    }
+    bank->refCount++;
+    bank->lastUsed = ++sBankClock;
+    releaseBank_l(mBank);
+    mBank = bank;
+}
+
+// Called on the mixer thread: never waits for the lock, a busy lock only means
+// that the switch happens on a later call.
+void AudioResamplerPolyphase::updateBank()
+{
+    pthread_once(&gBankThreadOnce, startBankThread);
+    if (pthread_mutex_trylock(&gBankLock) != 0) {
+        return;
+    }
+    updateBank_l();
+    pthread_mutex_unlock(&gBankLock);
+}
+
+void AudioResamplerPolyphase::waitForBank()
+{
+    pthread_once(&gBankThreadOnce, startBankThread);
+    pthread_mutex_lock(&gBankLock);
+    if (mBank == NULL || mBank->inSampleRate != mInSampleRate) {
+        updateBank_l();
+    }
+    while (!mBank->ready) {
+        pthread_cond_wait(&gBankReady, &gBankLock);
+    }
+    pthread_mutex_unlock(&gBankLock);
+}
+
+// ----------------------------------------------------------------------------
+
+AudioResamplerPolyphase::AudioResamplerPolyphase(int bitDepth,
+        int inChannelCount, int32_t sampleRate)
+    : AudioResampler(bitDepth, inChannelCount, sampleRate, POLYPHASE_QUALITY),
+    mBank(NULL), mRingIndex(0), mPhase(0), mPhaseUnits(1U << kNumPhaseBits),
+    mPendingFrames(0)
+{
+    mRing[0] = mRing[1] = NULL;
+}
+
+AudioResamplerPolyphase::~AudioResamplerPolyphase()
+{
+    pthread_mutex_lock(&gBankLock);
+    releaseBank_l(mBank);
+    pthread_mutex_unlock(&gBankLock);
+    free(mRing[0]);
+    free(mRing[1]);
+}
+
+void AudioResamplerPolyphase::init()
+{
+    for (int i = 0; i < mChannelCount; i++) {
+        mRing[i] = (int16_t*)memalign(32, 2 * kNumTaps * sizeof(int16_t));
+        memset(mRing[i], 0, 2 * kNumTaps * sizeof(int16_t));
+    }
+}
+
+void AudioResamplerPolyphase::setSampleRate(int32_t inSampleRate)
+{
+    AudioResampler::setSampleRate(inSampleRate);
+    if (mBank == NULL || mBank->inSampleRate != inSampleRate) {
+        updateBank();
+    }
+}
+
+void AudioResamplerPolyphase::reset()
+{
+    AudioResampler::reset();
+    for (int i = 0; i < mChannelCount; i++) {
+        memset(mRing[i], 0, 2 * kNumTaps * sizeof(int16_t));
+    }
+    mRingIndex = 0;
+    mPhase = 0;
+    mPendingFrames = 0;
+}
+
+void AudioResamplerPolyphase::resample(int32_t* out, size_t outFrameCount,
+        AudioBufferProvider* provider)
+{
+    if (CC_UNLIKELY(mBank == NULL || mBank->inSampleRate != mInSampleRate)) {
+        updateBank();
+    }
+    const Bank* bank = NULL;
+    if (mBank != NULL && mBank->inSampleRate == mInSampleRate &&
+            android_atomic_acquire_load(&mBank->ready)) {
+        bank = mBank;
+    }
+
+    // carry the fractional position over when switching between banks, or between
+    // a bank and linear interpolation
+    const uint32_t phaseUnits = (bank != NULL && bank->phaseStep) ?
+            bank->numPhases : 1U << kNumPhaseBits;
+    if (CC_UNLIKELY(phaseUnits != mPhaseUnits)) {
+        mPhase = (uint32_t)(((uint64_t)mPhase * phaseUnits) / mPhaseUnits);
+        mPhaseUnits = phaseUnits;
+    }
+
+    // select the appropriate resampler
+    switch (mChannelCount) {
+    case 1:
+        resample<1>(out, outFrameCount, provider, bank);
+        break;
+    case 2:
+        resample<2>(out, outFrameCount, provider, bank);
+        break;
+    }
+}
+
+template<int CHANNELS>
+void AudioResamplerPolyphase::resample(int32_t* out, size_t outFrameCount,
+        AudioBufferProvider* provider, const Bank* bank)
+{
+    const int16_t* const coefs = bank != NULL ? bank->coefs : NULL;
+    const uint32_t numPhases = bank != NULL ? bank->numPhases : 0;
+    const uint32_t phaseStep = bank != NULL ? bank->phaseStep : 0;
+    const uint32_t phaseIncrement = mPhaseIncrement;
+    const int32_t vl = mVolume[0];
+    const int32_t vr = mVolume[1];
+    int16_t* const ringL = mRing[0];
+    int16_t* const ringR = mRing[CHANNELS - 1];
+
+    size_t inputIndex = mInputIndex;
+    size_t ringIndex = mRingIndex;
+    uint32_t phase = mPhase;
+    size_t pendingFrames = mPendingFrames;
+    size_t outputIndex = 0;
+    size_t inFrameCount = (outFrameCount*mInSampleRate)/mSampleRate + 1;
+
+    while (outputIndex < outFrameCount) {
+        // read the input frames that precede the next output frame
+        while (pendingFrames) {
+            if (mBuffer.frameCount == 0) {
+                mBuffer.frameCount = inFrameCount;
+                provider->getNextBuffer(&mBuffer, calculateOutputPTS(outputIndex));
+                if (mBuffer.raw == NULL) {
+                    goto resample_exit;
+                }
+            }
+            const int16_t* in = mBuffer.i16 + inputIndex*CHANNELS;
+            size_t n = mBuffer.frameCount - inputIndex;
+            if (n > pendingFrames) {
+                n = pendingFrames;
+            }
+            inputIndex += n;
+            pendingFrames -= n;
+            while (n--) {
+                ringL[ringIndex] = ringL[ringIndex + kNumTaps] = in[0];
+                if (CHANNELS == 2) {
+                    ringR[ringIndex] = ringR[ringIndex + kNumTaps] = in[1];
+                }
+                in += CHANNELS;
+                if (++ringIndex == (size_t)kNumTaps) {
+                    ringIndex = 0;
+                }
+            }
+            if (inputIndex >= mBuffer.frameCount) {
+                inputIndex = 0;
+                provider->releaseBuffer(&mBuffer);
+                mBuffer.frameCount = 0;
+            }
+        }
+
+        int32_t l, r;
+        if (CC_LIKELY(coefs != NULL)) {
+            const int16_t* c = coefs +
+                    (phaseStep ? phase : phase >> kApproxPhaseShift) * kNumTaps;
+            l = dotProduct(ringL + ringIndex, c);
+            r = (CHANNELS == 2) ? dotProduct(ringR + ringIndex, c) : l;
+        } else {
+            // no bank yet: interpolate between the two taps around the output
+            // instant, Q14 like the dot product
+            const int32_t frac = phase >> (kNumPhaseBits - kCoefBits);
+            const int16_t* sl = ringL + ringIndex + kNumTaps / 2 - 1;
+            l = (sl[0] << kCoefBits) + (sl[1] - sl[0]) * frac;
+            if (CHANNELS == 2) {
+                const int16_t* sr = ringR + ringIndex + kNumTaps / 2 - 1;
+                r = (sr[0] << kCoefBits) + (sr[1] - sr[0]) * frac;
+            } else {
+                r = l;
+            }
+        }
+        out[0] += (int32_t)(((int64_t)l * vl) >> kCoefBits);
+        out[1] += (int32_t)(((int64_t)r * vr) >> kCoefBits);
+        out += 2;
+        outputIndex++;
+
+        if (phaseStep) {
+            phase += phaseStep;
+            while (phase >= numPhases) {
+                phase -= numPhases;
+                pendingFrames++;
+            }
+        } else {
+            phase += phaseIncrement;
+            pendingFrames += phase >> kNumPhaseBits;
+            phase &= kPhaseMask;
+        }
+    }
+
+resample_exit:
+    mInputIndex = inputIndex;
+    mRingIndex = ringIndex;
+    mPhase = phase;
+    mPendingFrames = pendingFrames;
+}
+
+// ----------------------------------------------------------------------------
+}; // namespace android
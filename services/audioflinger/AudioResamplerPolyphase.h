@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_RESAMPLER_POLYPHASE_H
+#define ANDROID_AUDIO_RESAMPLER_POLYPHASE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <cutils/log.h>
+
+#include "AudioResampler.h"
+
+namespace android {
+
+// ----------------------------------------------------------------------------
+
+// Windowed-sinc resampler using a polyphase filter bank that is computed once per
+// input / output sample rate pair, instead of interpolating the coefficients for every
+// output sample like AudioResamplerSinc.  Banks are shared by all resamplers that
+// use the same pair of rates.
+//
+// When the reduced ratio outRate / inRate = L / M has L <= kMaxPhases, each of the L
+// phases is exact and the phase advances by exactly M per output frame.  Otherwise
+// the bank has kMaxPhases phases and the phase is the nearest lower one from the
+// regular 30-bit phase accumulator.
+//
+// Banks are computed by a background thread, never by the mixer thread that calls
+// setSampleRate() and resample().  Until the bank for the current rates is ready,
+// the output is linearly interpolated from the same history, with the same delay.
+
+class AudioResamplerPolyphase : public AudioResampler {
+public:
+    AudioResamplerPolyphase(int bitDepth, int inChannelCount, int32_t sampleRate);
+
+    virtual ~AudioResamplerPolyphase();
+
+    virtual void setSampleRate(int32_t inSampleRate);
+    virtual void resample(int32_t* out, size_t outFrameCount,
+            AudioBufferProvider* provider);
+    virtual void reset();
+
+    // Blocks until the bank for the current rates has been computed.  For tools that
+    // want the filtered output from the first frame; never call it from the mixer.
+    void waitForBank();
+
+    // number of taps of each phase, a multiple of 8 for the SIMD dot products
+    static const int kNumTaps = 32;
+    static const uint32_t kMaxPhases = 1024;
+    // coefficients are Q2.14, which leaves headroom for the sum of the products
+    static const int kCoefBits = 14;
+
+private:
+    struct Bank {
+        int32_t     inSampleRate;
+        int32_t     outSampleRate;
+        uint32_t    numPhases;      // L
+        uint32_t    phaseStep;      // M when exact, otherwise 0
+        int16_t*    coefs;          // numPhases * kNumTaps, oldest sample first
+        // set by the bank thread once the three fields above are valid
+        volatile int32_t ready;
+        int         refCount;
+        uint32_t    lastUsed;       // value of sBankClock when last acquired or released
+        Bank*       next;
+    };
+
+    // all banks in use or recently used, and the clock that orders their use,
+    // protected by a file-scope lock
+    static Bank* sBanks;
+    static uint32_t sBankClock;
+
+    static void startBankThread();
+    static void* bankThread(void* arg);
+    static void computeBank(Bank* bank);
+    static void releaseBank_l(Bank* bank);
+
+    void init();
+    void updateBank();
+    void updateBank_l();
+
+    template<int CHANNELS>
+    void resample(int32_t* out, size_t outFrameCount,
+            AudioBufferProvider* provider, const Bank* bank);
+
+    Bank*       mBank;          // bank for the current rates, possibly not ready yet
+    // ring of the last kNumTaps input frames per channel, each sample is written twice
+    // so that the window &mRing[c][mRingIndex] is always contiguous
+    int16_t*    mRing[2];
+    size_t      mRingIndex;
+    uint32_t    mPhase;         // current phase, in units of 1/mPhaseUnits input frames
+    uint32_t    mPhaseUnits;    // L of an exact bank, otherwise 2^30
+    size_t      mPendingFrames; // input frames to read before the next output frame
+};
+
+// ----------------------------------------------------------------------------
+}; // namespace android
+
+#endif /*ANDROID_AUDIO_RESAMPLER_POLYPHASE_H*/
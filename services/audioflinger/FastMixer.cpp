@@ -18,6 +18,7 @@
 //#define LOG_NDEBUG 0
 
 #include <sys/atomics.h>
+#include <string.h>
 #include <time.h>
 #include <utils/Log.h>
 #include <utils/Trace.h>
@@ -70,9 +71,9 @@ bool FastMixer::threadLoop()
     long warmupNs = 0;      // warmup complete when write cycle is greater than to this value
     FastMixerDumpState dummyDumpState, *dumpState = &dummyDumpState;
     bool ignoreNextOverrun = true;  // used to ignore initial overrun and first after an underrun
-#ifdef FAST_MIXER_STATISTICS
     struct timespec oldLoad = {0, 0};    // previous value of clock_gettime(CLOCK_THREAD_CPUTIME_ID)
     bool oldLoadValid = false;  // whether oldLoad is valid
+#ifdef FAST_MIXER_STATISTICS
     uint32_t bounds = 0;
     bool full = false;      // whether we have collected at least kSamplingN samples
 #ifdef CPU_FREQUENCY_STATISTICS
@@ -351,6 +352,8 @@ bool FastMixer::threadLoop()
         // do work using current state here
         if ((command & FastMixerState::MIX) && (mixer != NULL) && isWarm) {
             ALOG_ASSERT(mixBuffer != NULL);
+            // start of this cycle, approximately, for the underrun timeline
+            uint32_t cycleMs = oldTs.tv_sec * 1000 + oldTs.tv_nsec / 1000000;
             // for each track, update volume and check for underrun
             unsigned currentTrackMask = current->mTrackMask;
             while (currentTrackMask != 0) {
@@ -381,6 +384,7 @@ bool FastMixer::threadLoop()
 #endif
                 FastTrackDump *ftDump = &dumpState->mTracks[i];
                 FastTrackUnderruns underruns = ftDump->mUnderruns;
+                FastTrackUnderrunStatus previousStatus = underruns.mBitFields.mMostRecent;
                 if (framesReady < frameCount) {
                     if (framesReady == 0) {
                         underruns.mBitFields.mEmpty++;
@@ -397,6 +401,10 @@ bool FastMixer::threadLoop()
                     underruns.mBitFields.mMostRecent = UNDERRUN_FULL;
                     mixer->enable(name);
                 }
+                if (underruns.mBitFields.mMostRecent != UNDERRUN_FULL &&
+                        underruns.mBitFields.mMostRecent != previousStatus) {
+                    ftDump->addUnderrunEpisode(cycleMs, underruns.mBitFields.mMostRecent);
+                }
                 ftDump->mUnderruns = underruns;
                 ftDump->mFramesReady = framesReady;
             }
@@ -513,16 +521,7 @@ bool FastMixer::threadLoop()
                     ignoreNextOverrun = false;
                 }
               }
-#ifdef FAST_MIXER_STATISTICS
               if (isWarm) {
-                // advance the FIFO queue bounds
-                size_t i = bounds & (FastMixerDumpState::kSamplingN - 1);
-                bounds = (bounds & 0xFFFF0000) | ((bounds + 1) & 0xFFFF);
-                if (full) {
-                    bounds += 0x10000;
-                } else if (!(bounds & (FastMixerDumpState::kSamplingN - 1))) {
-                    full = true;
-                }
                 // compute the delta value of clock_gettime(CLOCK_MONOTONIC)
                 uint32_t monotonicNs = nsec;
                 if (sec > 0 && sec < 4) {
@@ -544,12 +543,26 @@ bool FastMixer::threadLoop()
                         if (sec > 0 && sec < 4) {
                             loadNs += sec * 1000000000;
                         }
+                        dumpState->mLoadHistogram.add(loadNs);
                     } else {
                         // first time through the loop
                         oldLoadValid = true;
                     }
                     oldLoad = newLoad;
                 }
+                // the histograms are cheap enough to always be collected
+                dumpState->mCycleHistogram.add(monotonicNs);
+                dumpState->mJitterHistogram.add(monotonicNs > (uint32_t) periodNs ?
+                        monotonicNs - periodNs : periodNs - monotonicNs);
+#ifdef FAST_MIXER_STATISTICS
+                // advance the FIFO queue bounds
+                size_t i = bounds & (FastMixerDumpState::kSamplingN - 1);
+                bounds = (bounds & 0xFFFF0000) | ((bounds + 1) & 0xFFFF);
+                if (full) {
+                    bounds += 0x10000;
+                } else if (!(bounds & (FastMixerDumpState::kSamplingN - 1))) {
+                    full = true;
+                }
 #ifdef CPU_FREQUENCY_STATISTICS
                 // get the absolute value of CPU clock frequency in kHz
                 int cpuNum = sched_getcpu();
@@ -567,12 +580,12 @@ bool FastMixer::threadLoop()
                 // this store #4 is not atomic with respect to stores #1, #2, #3 above, but
                 // the newest open and oldest closed halves are atomic with respect to each other
                 dumpState->mBounds = bounds;
+#endif
 #if defined(ATRACE_TAG) && (ATRACE_TAG != ATRACE_TAG_NEVER)
                 ATRACE_INT("cycle_ms", monotonicNs / 1000000);
                 ATRACE_INT("load_us", loadNs / 1000);
 #endif
               }
-#endif
             } else {
                 // first time through the loop
                 oldTsValid = true;
@@ -616,6 +629,43 @@ FastMixerDumpState::~FastMixerDumpState()
 {
 }
 
+FastMixerHistogram::FastMixerHistogram()
+{
+    memset(mBuckets, 0, sizeof(mBuckets));
+}
+
+void FastMixerHistogram::dump(int fd, const char *title) const
+{
+    uint32_t total = 0;
+    uint32_t first = kBuckets, last = 0;
+    for (uint32_t k = 0; k < kBuckets; ++k) {
+        if (mBuckets[k] != 0) {
+            total += mBuckets[k];
+            if (first == kBuckets) {
+                first = k;
+            }
+            last = k;
+        }
+    }
+    fdprintf(fd, "  %s, %u cycles:\n", title, total);
+    for (uint32_t k = first; k <= last && k < kBuckets; ++k) {
+        if (mBuckets[k] == 0) {
+            continue;
+        }
+        uint32_t lowUs = k == 0 ? 0 : 1 << (k - 1);
+        if (k == kBuckets - 1) {
+            fdprintf(fd, "    %7u-        us: %u\n", lowUs, mBuckets[k]);
+        } else {
+            fdprintf(fd, "    %7u-%7u us: %u\n", lowUs, 1 << k, mBuckets[k]);
+        }
+    }
+}
+
+FastTrackDump::FastTrackDump() : mFramesReady(0), mUnderrunEpisodes(0)
+{
+    memset(mUnderrunTimeline, 0, sizeof(mUnderrunTimeline));
+}
+
 // helper function called by qsort()
 static int compare_uint32_t(const void *pa, const void *pb)
 {
@@ -760,6 +810,10 @@ void FastMixerDumpState::dump(int fd)
     // then we might display an obsolete track or omit an active track.
     // Instead we always display all tracks, with an indication
     // of whether we think the track is active.
+    fdprintf(fd, "Histograms since FastMixer creation (bucket k counts [2^(k-1), 2^k) us):\n");
+    mCycleHistogram.dump(fd, "wall clock time per mix cycle");
+    mLoadHistogram.dump(fd, "thread CPU time per mix cycle");
+    mJitterHistogram.dump(fd, "deviation of mix cycle from mix period");
     uint32_t trackMask = mTrackMask;
     fdprintf(fd, "Fast tracks: kMaxFastTracks=%u activeMask=%#x\n",
             FastMixerState::kMaxFastTracks, trackMask);
@@ -789,6 +843,58 @@ void FastMixerDumpState::dump(int fd)
                 (underruns.mBitFields.mEmpty) & UNDERRUN_MASK,
                 mostRecent, ftDump->mFramesReady);
     }
+    // underrun episodes, most recent first, in ms before this dump
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint32_t nowMs = (ts.tv_sec * 1000 + ts.tv_nsec / 1000000) & 0x3FFFFFFF;
+    bool header = false;
+    for (uint32_t i = 0; i < FastMixerState::kMaxFastTracks; ++i) {
+        const FastTrackDump *ftDump = &mTracks[i];
+        uint32_t episodes = ftDump->mUnderrunEpisodes;
+        if (episodes == 0) {
+            continue;
+        }
+        if (!header) {
+            fdprintf(fd, "Underrun timeline: most recent episodes, in ms before now\n");
+            header = true;
+        }
+        fdprintf(fd, "%5u total=%u", i, episodes);
+        uint32_t n = episodes < FastTrackDump::kUnderrunTimelineN ?
+                episodes : FastTrackDump::kUnderrunTimelineN;
+        for (uint32_t j = 1; j <= n; ++j) {
+            uint32_t entry = ftDump->mUnderrunTimeline[(episodes - j) &
+                    (FastTrackDump::kUnderrunTimelineN - 1)];
+            uint32_t agoMs = (nowMs - (entry >> 2)) & 0x3FFFFFFF;
+            fdprintf(fd, " -%u%s", agoMs, (entry & 3) == UNDERRUN_EMPTY ? "e" : "p");
+        }
+        fdprintf(fd, "\n");
+    }
+    if (header) {
+        fdprintf(fd, "  (p = partial, e = empty)\n");
+    }
+}
+
+void FastMixerDumpState::snapshot(FastMixerSnapshot *snapshot) const
+{
+    memset(snapshot, 0, sizeof(*snapshot));
+    snapshot->mMagic = FastMixerSnapshot::kMagic;
+    snapshot->mVersion = FastMixerSnapshot::kVersion;
+    snapshot->mSize = sizeof(*snapshot);
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    snapshot->mMonotonicMs = (ts.tv_sec * 1000 + ts.tv_nsec / 1000000) & 0x3FFFFFFF;
+    snapshot->mSampleRate = mSampleRate;
+    snapshot->mFrameCount = mFrameCount;
+    snapshot->mUnderruns = mUnderruns;
+    snapshot->mOverruns = mOverruns;
+    memcpy(snapshot->mCycleHist, mCycleHistogram.mBuckets, sizeof(snapshot->mCycleHist));
+    memcpy(snapshot->mLoadHist, mLoadHistogram.mBuckets, sizeof(snapshot->mLoadHist));
+    memcpy(snapshot->mJitterHist, mJitterHistogram.mBuckets, sizeof(snapshot->mJitterHist));
+    for (uint32_t i = 0; i < FastMixerState::kMaxFastTracks; ++i) {
+        snapshot->mUnderrunEpisodes[i] = mTracks[i].mUnderrunEpisodes;
+        memcpy(snapshot->mUnderrunTimeline[i], mTracks[i].mUnderrunTimeline,
+                sizeof(snapshot->mUnderrunTimeline[i]));
+    }
 }
 
 }   // namespace android
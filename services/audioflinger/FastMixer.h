@@ -70,12 +70,68 @@ private:
     uint32_t mAtomic;
 };
 
+// Log2 histogram of durations with a fixed number of buckets.  Bucket 0 counts durations
+// below 1 us, bucket k > 0 counts durations in [2^(k-1), 2^k) us, and the last bucket also
+// counts everything longer.  Like the rest of the dump state it has a single writer, the fast
+// mixer thread, and each bucket is a word that is updated without atomics or barriers.
+struct FastMixerHistogram {
+    static const uint32_t kBuckets = 24;    // the last bucket starts at 2^22 us, about 4 s
+
+    FastMixerHistogram();
+    void add(uint32_t ns) {
+        uint32_t us = ns / 1000;
+        uint32_t k = us != 0 ? 32 - __builtin_clz(us) : 0;
+        mBuckets[k < kBuckets ? k : kBuckets - 1]++;
+    }
+    void dump(int fd, const char *title) const;
+
+    uint32_t mBuckets[kBuckets];
+};
+
 // Represents the dump state of a fast track
 struct FastTrackDump {
-    FastTrackDump() : mFramesReady(0) { }
+    FastTrackDump();
     /*virtual*/ ~FastTrackDump() { }
+
+    // Record the start of an underrun episode, i.e. a cycle with a partial or empty status
+    // that differs from the status of the previous cycle.
+    void addUnderrunEpisode(uint32_t monotonicMs, FastTrackUnderrunStatus status) {
+        mUnderrunTimeline[mUnderrunEpisodes & (kUnderrunTimelineN - 1)] =
+                (monotonicMs << 2) | status;
+        mUnderrunEpisodes++;
+    }
+
     FastTrackUnderruns mUnderruns;
     size_t mFramesReady;        // most recent value only; no long-term statistics kept
+
+    // The most recent underrun episodes, oldest first from index mUnderrunEpisodes.  Each entry
+    // packs the CLOCK_MONOTONIC time in ms (modulo 2^30) of the episode's first cycle in bits
+    // 2-31 and its FastTrackUnderrunStatus in bits 0-1, so that it is written atomically.
+    static const uint32_t kUnderrunTimelineN = 16;  // must be a power of 2
+    uint32_t mUnderrunTimeline[kUnderrunTimelineN];
+    uint32_t mUnderrunEpisodes; // total number of episodes, never reset
+};
+
+// Fixed layout binary copy of the FastMixer histograms and underrun timelines, so that they
+// can be saved by dumpsys and analyzed offline.  The layout only changes along with kVersion.
+struct FastMixerSnapshot {
+    static const uint32_t kMagic = 0x464d5348;  // 'FMSH'
+    static const uint32_t kVersion = 1;
+
+    uint32_t mMagic;
+    uint32_t mVersion;
+    uint32_t mSize;             // sizeof(FastMixerSnapshot)
+    uint32_t mMonotonicMs;      // CLOCK_MONOTONIC time in ms of the snapshot, modulo 2^30
+    uint32_t mSampleRate;
+    uint32_t mFrameCount;
+    uint32_t mUnderruns;
+    uint32_t mOverruns;
+    // FastMixerHistogram bucket counts, bucket k holds durations of [2^(k-1), 2^k) us
+    uint32_t mCycleHist[FastMixerHistogram::kBuckets];
+    uint32_t mLoadHist[FastMixerHistogram::kBuckets];
+    uint32_t mJitterHist[FastMixerHistogram::kBuckets];
+    uint32_t mUnderrunEpisodes[FastMixerState::kMaxFastTracks];
+    uint32_t mUnderrunTimeline[FastMixerState::kMaxFastTracks][FastTrackDump::kUnderrunTimelineN];
 };
 
 // The FastMixerDumpState keeps a cache of FastMixer statistics that can be logged by dumpsys.
@@ -89,6 +145,7 @@ struct FastMixerDumpState {
     /*virtual*/ ~FastMixerDumpState();
 
     void dump(int fd);          // should only be called on a stable copy, not the original
+    void snapshot(FastMixerSnapshot *snapshot) const;   // also on a stable copy
 
     FastMixerState::Command mCommand;   // current command
     uint32_t mWriteSequence;    // incremented before and after each write()
@@ -104,6 +161,12 @@ struct FastMixerDumpState {
     uint32_t mTrackMask;        // mask of active tracks
     FastTrackDump   mTracks[FastMixerState::kMaxFastTracks];
 
+    // Always collected, from the first cycle after warmup: wall clock time of each mix cycle,
+    // thread CPU time of each cycle, and deviation of each cycle from the nominal mix period.
+    FastMixerHistogram mCycleHistogram;
+    FastMixerHistogram mLoadHistogram;
+    FastMixerHistogram mJitterHistogram;
+
 #ifdef FAST_MIXER_STATISTICS
     // Recently collected samples of per-cycle monotonic time, thread CPU time, and CPU frequency.
     // kSamplingN is the size of the sampling frame, and must be a power of 2 <= 0x8000.
@@ -39,4 +39,28 @@ FastMixerState::~FastMixerState()
 {
 }
 
+size_t FastMixerState::update(const FastMixerState& src)
+{
+    size_t copied = sizeof(FastMixerState) - sizeof(mFastTracks);
+    if (mFastTracksGen != src.mFastTracksGen) {
+        for (unsigned i = 0; i < kMaxFastTracks; ++i) {
+            if (mFastTracks[i].mGeneration != src.mFastTracks[i].mGeneration) {
+                mFastTracks[i] = src.mFastTracks[i];
+                copied += sizeof(FastTrack);
+            }
+        }
+    }
+    mFastTracksGen = src.mFastTracksGen;
+    mTrackMask = src.mTrackMask;
+    mOutputSink = src.mOutputSink;
+    mOutputSinkGen = src.mOutputSinkGen;
+    mFrameCount = src.mFrameCount;
+    mCommand = src.mCommand;
+    mColdFutexAddr = src.mColdFutexAddr;
+    mColdGen = src.mColdGen;
+    mDumpState = src.mDumpState;
+    mTeeSink = src.mTeeSink;
+    return copied;
+}
+
 }   // namespace android
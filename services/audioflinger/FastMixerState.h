@@ -77,6 +77,12 @@ struct FastMixerState {
     // This might be a one-time configuration rather than per-state
     FastMixerDumpState* mDumpState; // if non-NULL, then update dump state periodically
     NBAIO_Sink* mTeeSink;       // if non-NULL, then duplicate write()s to this non-blocking sink
+
+    // For StateQueue: make this state equal to src, a newer state of the same queue.
+    // Any field added above must also be copied here.
+    // Fast tracks with the same generation in both states are known to be equal and are skipped,
+    // as are all of them if mFastTracksGen is unchanged.  Returns the number of bytes copied.
+    size_t      update(const FastMixerState& src);
 };  // struct FastMixerState
 
 }   // namespace android
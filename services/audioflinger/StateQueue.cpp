@@ -34,6 +34,7 @@ void StateQueueMutatorDump::dump(int fd)
 {
     fdprintf(fd, "State queue mutator: pushDirty=%u pushAck=%u blockedSequence=%u\n",
             mPushDirty, mPushAck, mBlockedSequence);
+    fdprintf(fd, "  pushCoalesced=%u copyBytesSaved=%u\n", mPushCoalesced, mCopyBytesSaved);
 }
 #endif
 
@@ -42,7 +43,8 @@ void StateQueueMutatorDump::dump(int fd)
 template<typename T> StateQueue<T>::StateQueue() :
     mNext(NULL), mAck(NULL), mCurrent(NULL),
     mMutating(&mStates[0]), mExpecting(NULL),
-    mInMutation(false), mIsDirty(false), mIsInitialized(false)
+    mInMutation(false), mIsDirty(false), mIsInitialized(false),
+    mIsCoalescing(false), mDeferredPushes(0)
 #ifdef STATE_QUEUE_DUMP
     , mObserverDump(&mObserverDummyDump), mMutatorDump(&mMutatorDummyDump)
 #endif
@@ -88,7 +90,25 @@ template<typename T> void StateQueue<T>::end(bool didModify)
     mInMutation = false;
 }
 
+template<typename T> void StateQueue<T>::beginCoalescing()
+{
+    ALOG_ASSERT(!mInMutation, "beginCoalescing() called when in a mutation");
+    ALOG_ASSERT(!mIsCoalescing, "beginCoalescing() called when already coalescing");
+    mIsCoalescing = true;
+}
+
+template<typename T> bool StateQueue<T>::endCoalescing(StateQueue<T>::block_t block)
+{
+    mIsCoalescing = false;
+    return doPush(block, mDeferredPushes > 0 /*isFlush*/);
+}
+
 template<typename T> bool StateQueue<T>::push(StateQueue<T>::block_t block)
+{
+    return doPush(block, false /*isFlush*/);
+}
+
+template<typename T> bool StateQueue<T>::doPush(StateQueue<T>::block_t block, bool isFlush)
 {
 #define PUSH_BLOCK_ACK_NS    3000000L   // 3 ms: time between checks for ack in push()
                                         //       FIXME should be configurable
@@ -104,9 +124,16 @@ template<typename T> bool StateQueue<T>::push(StateQueue<T>::block_t block)
 
     if (mIsDirty) {
 
+        if (!isFlush) {
 #ifdef STATE_QUEUE_DUMP
-        mMutatorDump->mPushDirty++;
+            mMutatorDump->mPushDirty++;
 #endif
+            // leave it dirty, to be squashed with any later mutations of this window
+            if (mIsCoalescing && block != BLOCK_UNTIL_ACKED) {
+                mDeferredPushes++;
+                return true;
+            }
+        }
 
         // wait for prior push to be acknowledged
         if (mExpecting != NULL) {
@@ -141,12 +168,24 @@ template<typename T> bool StateQueue<T>::push(StateQueue<T>::block_t block)
         // publish
         android_atomic_release_store((int32_t) mMutating, (volatile int32_t *) &mNext);
         mExpecting = mMutating;
+#ifdef STATE_QUEUE_DUMP
+        // a flush stands in for the last of the deferred pushes, any other push for itself
+        mMutatorDump->mPushCoalesced += isFlush ? mDeferredPushes - 1 : mDeferredPushes;
+#endif
+        mDeferredPushes = 0;
 
-        // copy with circular wraparound
+        // copy with circular wraparound; the next state was pushed kN pushes ago,
+        // so only the parts that changed since then need to be copied
         if (++mMutating >= &mStates[kN]) {
             mMutating = &mStates[0];
         }
-        *mMutating = *mExpecting;
+#ifdef STATE_QUEUE_DUMP
+        size_t copied =
+#endif
+                mMutating->update(*mExpecting);
+#ifdef STATE_QUEUE_DUMP
+        mMutatorDump->mCopyBytesSaved += sizeof(T) - copied;
+#endif
         mIsDirty = false;
 
     }
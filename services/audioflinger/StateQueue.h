@@ -36,18 +36,28 @@ struct StateQueueObserverDump {
 };
 
 struct StateQueueMutatorDump {
-    StateQueueMutatorDump() : mPushDirty(0), mPushAck(0), mBlockedSequence(0) { }
+    StateQueueMutatorDump() : mPushDirty(0), mPushAck(0), mBlockedSequence(0),
+        mPushCoalesced(0), mCopyBytesSaved(0) { }
     /*virtual*/ ~StateQueueMutatorDump() { }
     unsigned    mPushDirty;       // incremented each time push() is called with a dirty state
     unsigned    mPushAck;         // incremented each time push(BLOCK_UNTIL_ACKED) is called
     unsigned    mBlockedSequence; // incremented before and after each time that push()
                                   // blocks for more than one PUSH_BLOCK_ACK_NS;
                                   // if odd, then mutator is currently blocked inside push()
+    unsigned    mPushCoalesced;   // number of dirty pushes that were squashed into a later push
+                                  // by a coalescing window, i.e. pushes saved
+    unsigned    mCopyBytesSaved;  // bytes not copied by T::update() after each push, modulo 2^32
     void        dump(int fd);
 };
 #endif
 
 // manages a FIFO queue of states
+//
+// T must be copy-constructible, and must also provide
+//      size_t update(const T& src);
+// which makes *this equal to src, given that *this is an older state of the same queue,
+// and returns the number of bytes that it actually copied.  This lets a state type which
+// tracks generations of its parts copy only the parts that changed since *this was pushed.
 template<typename T> class StateQueue {
 
 public:
@@ -94,6 +104,16 @@ public:
     };
     bool    push(block_t block = BLOCK_NEVER);
 
+    // Open a coalescing window.  Until endCoalescing(), push(BLOCK_NEVER) and
+    // push(BLOCK_UNTIL_PUSHED) of a dirty state do not publish it but return true, and the state
+    // remains dirty so that later mutations are squashed into the same push.
+    // push(BLOCK_UNTIL_ACKED) still pushes immediately, including any deferred modifications.
+    // Windows cannot be nested, and must not be opened in the middle of a mutation.
+    void    beginCoalescing();
+
+    // Close the coalescing window, if any, and push the state as for push(block).
+    bool    endCoalescing(block_t block = BLOCK_UNTIL_PUSHED);
+
     // Return whether the current state is dirty (modified and not pushed).
     bool    isDirty() const { return mIsDirty; }
 
@@ -108,6 +128,10 @@ public:
 #endif
 
 private:
+    // Implements push(); isFlush is true when called by endCoalescing() on behalf of
+    // the deferred pushes, rather than by a push() of its own.
+    bool    doPush(block_t block, bool isFlush);
+
     static const unsigned kN = 4;       // values != 4 are not supported by this code
     T                 mStates[kN];      // written by mutator, read by observer
 
@@ -124,6 +148,8 @@ private:
     bool              mInMutation;      // whether we're currently in the middle of a mutation
     bool              mIsDirty;         // whether mutating state has been modified since last push
     bool              mIsInitialized;   // whether mutating state has been initialized yet
+    bool              mIsCoalescing;    // whether a coalescing window is open
+    unsigned          mDeferredPushes;  // dirty pushes deferred by the current coalescing window
 
 #ifdef STATE_QUEUE_DUMP
     StateQueueObserverDump  mObserverDummyDump; // default area for observer dump if not set
@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Mixes N synthetic tracks through the scalar and the SIMD AudioMixer kernels,
+// checks that both produce bit-exact output, and reports the time spent in each.
+
+#include "AudioMixerSimd.h"
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+using namespace android;
+
+static int usage(const char* name) {
+    fprintf(stderr,"Usage: %s [-t tracks] [-f frames] [-n iterations]\n", name);
+    fprintf(stderr,"    -t    number of tracks to mix (default 8)\n");
+    fprintf(stderr,"    -f    frames per mix period (default 1024)\n");
+    fprintf(stderr,"    -n    number of mix periods (default 1000)\n");
+    return -1;
+}
+
+static int64_t systemTimeNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+enum kernel_t {
+    STEREO16,
+    MONO16,
+    RAMP_STEREO16,
+    RAMP_MONO16,
+    VOLUME_STEREO32,
+    VOLUME_RAMP_STEREO32,
+    ACCUM_TO_FLOAT,
+    NUM_KERNELS
+};
+
+static const char* const kKernelNames[NUM_KERNELS] = {
+    "track__16BitsStereo",
+    "track__16BitsMono",
+    "track__16BitsStereo (ramp)",
+    "track__16BitsMono (ramp)",
+    "volumeStereo",
+    "volumeRampStereo",
+    "float main buffer",
+};
+
+struct Track {
+    int16_t* in16;      // stereo or mono 16-bit input
+    int32_t* in32;      // stereo Q19.12 input, as produced by a resampler
+    int16_t vl, vr;
+    int32_t rampL, rampR;
+    int32_t incL, incR;
+};
+
+// Mix all tracks into out with either the reference or the SIMD kernel.
+static void mix(kernel_t kernel, bool simd, Track* tracks, int numTracks,
+        int32_t* out, size_t frameCount) {
+    memset(out, 0, frameCount * 2 * sizeof(int32_t));
+    for (int i = 0; i < numTracks; i++) {
+        Track& t = tracks[i];
+        int32_t vl = t.rampL;
+        int32_t vr = t.rampR;
+        switch (kernel) {
+        case STEREO16:
+#ifdef AUDIO_MIXER_SIMD
+            if (simd) {
+                mixStereo16_simd(out, t.in16, frameCount, t.vl, t.vr);
+                break;
+            }
+#endif
+            mixStereo16_c(out, t.in16, frameCount, t.vl, t.vr);
+            break;
+        case MONO16:
+#ifdef AUDIO_MIXER_SIMD
+            if (simd) {
+                mixMono16_simd(out, t.in16, frameCount, t.vl, t.vr);
+                break;
+            }
+#endif
+            mixMono16_c(out, t.in16, frameCount, t.vl, t.vr);
+            break;
+        case RAMP_STEREO16:
+#ifdef AUDIO_MIXER_SIMD
+            if (simd) {
+                mixRampStereo16_simd(out, t.in16, frameCount, &vl, &vr, t.incL, t.incR);
+                break;
+            }
+#endif
+            mixRampStereo16_c(out, t.in16, frameCount, &vl, &vr, t.incL, t.incR);
+            break;
+        case RAMP_MONO16:
+#ifdef AUDIO_MIXER_SIMD
+            if (simd) {
+                mixRampMono16_simd(out, t.in16, frameCount, &vl, &vr, t.incL, t.incR);
+                break;
+            }
+#endif
+            mixRampMono16_c(out, t.in16, frameCount, &vl, &vr, t.incL, t.incR);
+            break;
+        case VOLUME_STEREO32:
+#ifdef AUDIO_MIXER_SIMD
+            if (simd) {
+                volumeStereo32_simd(out, t.in32, frameCount, t.vl, t.vr);
+                break;
+            }
+#endif
+            volumeStereo32_c(out, t.in32, frameCount, t.vl, t.vr);
+            break;
+        case VOLUME_RAMP_STEREO32:
+#ifdef AUDIO_MIXER_SIMD
+            if (simd) {
+                volumeRampStereo32_simd(out, t.in32, frameCount, &vl, &vr, t.incL, t.incR);
+                break;
+            }
+#endif
+            volumeRampStereo32_c(out, t.in32, frameCount, &vl, &vr, t.incL, t.incR);
+            break;
+        case ACCUM_TO_FLOAT:
+            // not accumulated, each track overwrites the previous one
+#ifdef AUDIO_MIXER_SIMD
+            if (simd) {
+                accumToFloat_simd((float*)out, t.in32, frameCount * 2);
+                break;
+            }
+#endif
+            accumToFloat_c((float*)out, t.in32, frameCount * 2);
+            break;
+        default:
+            break;
+        }
+        // the final ramp position is part of the result as well
+        out[frameCount * 2] += vl;
+        out[frameCount * 2 + 1] += vr;
+    }
+}
+
+int main(int argc, char* argv[]) {
+
+    const char* const progname = argv[0];
+    int numTracks = 8;
+    size_t frameCount = 1024;
+    int iterations = 1000;
+
+    int ch;
+    while ((ch = getopt(argc, argv, "t:f:n:")) != -1) {
+        switch (ch) {
+        case 't':
+            numTracks = atoi(optarg);
+            break;
+        case 'f':
+            frameCount = atoi(optarg);
+            break;
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+        default:
+            usage(progname);
+            return -1;
+        }
+    }
+    if (numTracks <= 0 || frameCount == 0 || iterations <= 0) {
+        usage(progname);
+        return -1;
+    }
+
+#ifndef AUDIO_MIXER_SIMD
+    printf("no SIMD kernels for this architecture, timing the reference only\n");
+#endif
+
+    srand(1);
+    Track* tracks = new Track[numTracks];
+    for (int i = 0; i < numTracks; i++) {
+        Track& t = tracks[i];
+        t.in16 = new int16_t[frameCount * 2];
+        t.in32 = new int32_t[frameCount * 2];
+        for (size_t j = 0; j < frameCount * 2; j++) {
+            t.in16[j] = (int16_t)rand();
+            t.in32[j] = (int32_t)(rand() ^ (rand() << 16));
+        }
+        t.vl = rand() & 0x1fff;     // up to 2x boost, as allowed by the mixer
+        t.vr = rand() & 0x1fff;
+        t.rampL = t.vl << 16;
+        t.rampR = t.vr << 16;
+        t.incL = ((rand() & 0xff) - 0x80) * 0x100 / (int32_t)frameCount;
+        t.incR = ((rand() & 0xff) - 0x80) * 0x100 / (int32_t)frameCount;
+    }
+    // the extra frame holds the final ramp volumes
+    int32_t* ref = new int32_t[(frameCount + 1) * 2];
+    int32_t* out = new int32_t[(frameCount + 1) * 2];
+
+    int failures = 0;
+    for (int k = 0; k < NUM_KERNELS; k++) {
+        kernel_t kernel = (kernel_t)k;
+
+        mix(kernel, false, tracks, numTracks, ref, frameCount);
+        mix(kernel, true, tracks, numTracks, out, frameCount);
+        bool match = memcmp(ref, out, (frameCount + 1) * 2 * sizeof(int32_t)) == 0;
+        if (!match) {
+            failures++;
+        }
+
+        int64_t start = systemTimeNs();
+        for (int n = 0; n < iterations; n++) {
+            mix(kernel, false, tracks, numTracks, ref, frameCount);
+        }
+        int64_t scalarNs = systemTimeNs() - start;
+
+        start = systemTimeNs();
+        for (int n = 0; n < iterations; n++) {
+            mix(kernel, true, tracks, numTracks, out, frameCount);
+        }
+        int64_t simdNs = systemTimeNs() - start;
+
+        printf("%-28s %s  scalar %8.3f ms  simd %8.3f ms  speedup %.2fx\n",
+                kKernelNames[k], match ? "bit-exact" : "MISMATCH ",
+                scalarNs / 1e6, simdNs / 1e6, simdNs ? (double)scalarNs / simdNs : 0.0);
+    }
+
+    for (int i = 0; i < numTracks; i++) {
+        delete[] tracks[i].in16;
+        delete[] tracks[i].in32;
+    }
+    delete[] tracks;
+    delete[] ref;
+    delete[] out;
+
+    return failures ? 1 : 0;
+}
@@ -15,6 +15,7 @@
  */
 
 #include "AudioResampler.h"
+#include "AudioResamplerPolyphase.h"
 #include <media/AudioBufferProvider.h>
 #include <unistd.h>
 #include <stdio.h>
@@ -62,9 +63,11 @@ struct HeaderWav {
 };
 
 static int usage(const char* name) {
-    fprintf(stderr,"Usage: %s [-p] [-h] [-s] [-q {dq|lq|mq|hq|vhq}] [-i input-sample-rate] "
+    fprintf(stderr,"Usage: %s [-p] [-c] [-a] [-h] [-s] [-q {dq|lq|mq|hq|vhq|pq}] [-i input-sample-rate] "
                    "[-o output-sample-rate] [<input-file>] <output-file>\n", name);
     fprintf(stderr,"    -p    enable profiling\n");
+    fprintf(stderr,"    -c    compare the speed of the hq, vhq and pq resamplers\n");
+    fprintf(stderr,"    -a    check the accuracy of the hq, vhq and pq resamplers on pure tones\n");
     fprintf(stderr,"    -h    create wav file\n");
     fprintf(stderr,"    -s    stereo\n");
     fprintf(stderr,"    -q    resampler quality\n");
@@ -73,15 +76,53 @@ static int usage(const char* name) {
     fprintf(stderr,"              mq  : medium quality\n");
     fprintf(stderr,"              hq  : high quality\n");
     fprintf(stderr,"              vhq : very high quality\n");
+    fprintf(stderr,"              pq  : polyphase quality\n");
     fprintf(stderr,"    -i    input file sample rate\n");
     fprintf(stderr,"    -o    output file sample rate\n");
     return -1;
 }
 
+// the banks are computed in the background, wait for them so that the filtered
+// output is measured from the first frame
+static void waitForFilter(AudioResampler* resampler, AudioResampler::src_quality quality) {
+    if (quality == AudioResampler::POLYPHASE_QUALITY) {
+        static_cast<AudioResamplerPolyphase*>(resampler)->waitForBank();
+    }
+}
+
+// Signal to noise and distortion ratio in dB of the left channel of out, which should
+// be a sine of freq Hz at rate Hz: the least-squares fit of a sine of that frequency,
+// whatever its phase and amplitude, against everything else.
+static double sinad(const int32_t* out, size_t frames, double freq, int rate) {
+    const double w = 2 * M_PI * freq / rate;
+    double ss = 0, cc = 0, sc = 0, ys = 0, yc = 0;
+    for (size_t i = 0; i < frames; i++) {
+        double s = sin(w * i), c = cos(w * i), y = out[i * 2];
+        ss += s * s;
+        cc += c * c;
+        sc += s * c;
+        ys += y * s;
+        yc += y * c;
+    }
+    const double det = ss * cc - sc * sc;
+    const double a = (ys * cc - yc * sc) / det;
+    const double b = (yc * ss - ys * sc) / det;
+    double signal = 0, noise = 0;
+    for (size_t i = 0; i < frames; i++) {
+        double fit = a * sin(w * i) + b * cos(w * i);
+        double e = out[i * 2] - fit;
+        signal += fit * fit;
+        noise += e * e;
+    }
+    return 10 * log10(signal / (noise > 0 ? noise : 1e-30));
+}
+
 int main(int argc, char* argv[]) {
 
     const char* const progname = argv[0];
     bool profiling = false;
+    bool compare = false;
+    bool accuracy = false;
     bool writeHeader = false;
     int channels = 1;
     int input_freq = 0;
@@ -89,11 +130,17 @@ int main(int argc, char* argv[]) {
     AudioResampler::src_quality quality = AudioResampler::DEFAULT_QUALITY;
 
     int ch;
-    while ((ch = getopt(argc, argv, "phsq:i:o:")) != -1) {
+    while ((ch = getopt(argc, argv, "pcahsq:i:o:")) != -1) {
         switch (ch) {
         case 'p':
             profiling = true;
             break;
+        case 'c':
+            compare = true;
+            break;
+        case 'a':
+            accuracy = true;
+            break;
         case 'h':
             writeHeader = true;
             break;
@@ -111,6 +158,8 @@ int main(int argc, char* argv[]) {
                 quality = AudioResampler::HIGH_QUALITY;
             else if (!strcmp(optarg, "vhq"))
                 quality = AudioResampler::VERY_HIGH_QUALITY;
+            else if (!strcmp(optarg, "pq"))
+                quality = AudioResampler::POLYPHASE_QUALITY;
             else {
                 usage(progname);
                 return -1;
@@ -233,6 +282,108 @@ int main(int argc, char* argv[]) {
         delete resampler;
     }
 
+    if (compare) {
+        // resample the same input with each of the sinc qualities and time each one
+        static const struct {
+            AudioResampler::src_quality quality;
+            const char* name;
+        } kQualities[] = {
+            { AudioResampler::HIGH_QUALITY,      "hq"  },
+            { AudioResampler::VERY_HIGH_QUALITY, "vhq" },
+            { AudioResampler::POLYPHASE_QUALITY, "pq"  },
+        };
+        size_t out_frames = output_size/8;
+        for (size_t q = 0; q < sizeof(kQualities) / sizeof(kQualities[0]); q++) {
+            AudioResampler* resampler = AudioResampler::create(16, channels,
+                    output_freq, kQualities[q].quality);
+            resampler->setSampleRate(input_freq);
+            resampler->setVolume(0x1000, 0x1000);
+            waitForFilter(resampler, kQualities[q].quality);
+
+            memset(output_vaddr, 0, output_size);
+            timespec start, end;
+            clock_gettime(CLOCK_MONOTONIC_HR, &start);
+            resampler->resample((int*) output_vaddr, out_frames, &provider);
+            resampler->resample((int*) output_vaddr, out_frames, &provider);
+            resampler->resample((int*) output_vaddr, out_frames, &provider);
+            resampler->resample((int*) output_vaddr, out_frames, &provider);
+            clock_gettime(CLOCK_MONOTONIC_HR, &end);
+            int64_t start_ns = start.tv_sec * 1000000000LL + start.tv_nsec;
+            int64_t end_ns = end.tv_sec * 1000000000LL + end.tv_nsec;
+            int64_t time = (end_ns - start_ns)/4;
+            printf("%-4s %f Mspl/s\n", kQualities[q].name, out_frames/(time/1e9)/1e6);
+
+            delete resampler;
+        }
+    }
+
+    if (accuracy) {
+        // resample full scale tones across the passband with each of the sinc qualities,
+        // and check that the polyphase one reaches kMinSinad on all of them
+        static const struct {
+            AudioResampler::src_quality quality;
+            const char* name;
+        } kQualities[] = {
+            { AudioResampler::HIGH_QUALITY,      "hq"  },
+            { AudioResampler::VERY_HIGH_QUALITY, "vhq" },
+            { AudioResampler::POLYPHASE_QUALITY, "pq"  },
+        };
+        static const double kTones[] = { 100, 1000, 5000, 10000, 15000 };
+        // the window gives about 70 dB, the nearest lower phase of the 1024 phase bank
+        // used for inexact ratios costs a few dB more at high frequencies
+        static const double kMinSinad = 60.0;
+        const size_t nq = sizeof(kQualities) / sizeof(kQualities[0]);
+        const int nyquist = (input_freq < output_freq ? input_freq : output_freq) / 2;
+        const size_t tone_frames = input_freq;              // one second
+        const size_t skip = 256;                            // filter warm-up and tail
+        const size_t tone_out_frames = (int64_t)tone_frames * output_freq / input_freq - 2 * skip;
+        int16_t* tone = (int16_t*)malloc(tone_frames * channels * sizeof(int16_t));
+        int32_t* tone_out = (int32_t*)malloc((tone_out_frames + skip) * 2 * sizeof(int32_t));
+        bool failed = false;
+
+        printf("tone (Hz)");
+        for (size_t q = 0; q < nq; q++) {
+            printf("  %9s", kQualities[q].name);
+        }
+        printf("   SINAD (dB)\n");
+        for (size_t t = 0; t < sizeof(kTones) / sizeof(kTones[0]); t++) {
+            if (kTones[t] > 0.8 * nyquist) {
+                continue;
+            }
+            for (size_t i = 0; i < tone_frames; i++) {
+                int16_t y = (int16_t)floor(32000 * sin(2 * M_PI * kTones[t] * i / input_freq) + 0.5);
+                for (int j = 0; j < channels; j++) {
+                    tone[i * channels + j] = y;
+                }
+            }
+            printf("%9.0f", kTones[t]);
+            double result[nq];
+            for (size_t q = 0; q < nq; q++) {
+                Provider toneProvider(tone, tone_frames * channels * sizeof(int16_t), channels);
+                AudioResampler* resampler = AudioResampler::create(16, channels,
+                        output_freq, kQualities[q].quality);
+                resampler->setSampleRate(input_freq);
+                resampler->setVolume(0x1000, 0x1000);
+                waitForFilter(resampler, kQualities[q].quality);
+                memset(tone_out, 0, (tone_out_frames + skip) * 2 * sizeof(int32_t));
+                resampler->resample(tone_out, tone_out_frames + skip, &toneProvider);
+                result[q] = sinad(tone_out + skip * 2, tone_out_frames, kTones[t], output_freq);
+                printf("  %9.1f", result[q]);
+                delete resampler;
+            }
+            if (result[nq - 1] < kMinSinad) {
+                printf("  FAIL");
+                failed = true;
+            }
+            printf("\n");
+        }
+        free(tone);
+        free(tone_out);
+        if (failed) {
+            return 1;
+        }
+    }
+
     AudioResampler* resampler = AudioResampler::create(16, channels,
             output_freq, quality);
     size_t out_frames = output_size/8;